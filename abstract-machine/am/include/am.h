@@ -46,6 +46,9 @@ extern "C" {
 // ----------------------- TRM: Turing Machine -----------------------
 extern   Area        heap;
 void     putch       (char ch);
+#if defined(__PLATFORM_NEMU)
+void     putnstr     (const char *s, size_t len); // one bulk serial request
+#endif
 void     halt        (int code) __attribute__((__noreturn__));
 
 // -------------------- IOE: Input/Output Devices --------------------
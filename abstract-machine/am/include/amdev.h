@@ -9,7 +9,7 @@
 
 AM_DEVREG( 1, UART_CONFIG,  RD, bool present);
 AM_DEVREG( 2, UART_TX,      WR, char data);
-AM_DEVREG( 3, UART_RX,      RD, char data);
+AM_DEVREG( 3, UART_RX,      RD, int data);
 AM_DEVREG( 4, TIMER_CONFIG, RD, bool present, has_rtc);
 AM_DEVREG( 5, TIMER_RTC,    RD, int year, month, day, hour, minute, second);
 AM_DEVREG( 6, TIMER_UPTIME, RD, uint64_t us);
@@ -44,6 +44,21 @@ AM_DEVREG(25, INPUT_MOUSE,  RD, int type; int x, y; int button; int buttons; int
 AM_DEVREG(26, TIMER_REALTIME, RD, uint64_t us);
 #endif
 
+#if defined(__PLATFORM_NEMU)
+// NEMU-only 2D command queue: `n` struct gpu_cmd records executed by the VGA
+// device on the host before the write returns.
+AM_DEVREG(27, GPU_CMDQ,     WR, void *cmds; int n);
+// NEMU-only voice mixer: `n` struct audio_mix_cmd records run by the audio
+// device on the host before the write returns; AUDIO_VOICES reads one bit per
+// voice that is still playing or paused.
+AM_DEVREG(28, AUDIO_MIXQ,   WR, void *cmds; int n);
+AM_DEVREG(29, AUDIO_VOICES, RD, uint32_t active);
+// NEMU-only scatter-gather disk read: `blkcnt` blocks from `blkno` are copied
+// through `n` struct disk_sg_seg physical ranges in order; the segment lengths
+// must add up to exactly blkcnt blocks.
+AM_DEVREG(30, DISK_SGREAD,  WR, const void *segs; int n; int blkno, blkcnt);
+#endif
+
 // Input
 
 #define AM_KEYS(_) \
@@ -108,4 +123,63 @@ struct gpu_canvas {
   };
 } __attribute__((packed));
 
+#if defined(__PLATFORM_NEMU)
+// AM_GPU_CMDQ operations.  Surfaces are a pointer plus pitch in bytes, or the
+// framebuffer with AM_GPU_CMD_DST_FB / AM_GPU_CMD_SRC_FB.  Only COPY may
+// overlap; only STRETCH reads src_w/src_h.
+#define AM_GPU_OP_FILL      1
+#define AM_GPU_OP_COPY      2
+#define AM_GPU_OP_COLORKEY  3
+#define AM_GPU_OP_STRETCH   4
+#define AM_GPU_OP_PAL8      5
+
+#define AM_GPU_CMD_BILINEAR 0x1
+#define AM_GPU_CMD_DST_FB   0x2
+#define AM_GPU_CMD_SRC_FB   0x4
+
+struct gpu_cmd {
+  uint32_t op, flags;
+  uint64_t dst, src, aux;     // aux: PAL8 palette, 256 ARGB words
+  uint32_t dst_pitch, src_pitch;
+  uint16_t dst_x, dst_y, dst_w, dst_h;
+  uint16_t src_x, src_y, src_w, src_h;
+  uint32_t color;             // FILL colour or COLORKEY key
+  uint32_t bpp;               // bytes per pixel, 1 or 4; PAL8 is 1 -> 4
+};
+
+// AM_AUDIO_MIXQ operations.  PLAY starts a voice on PCM that stays in the
+// caller's memory until the voice is stopped or reads back as finished; MIX
+// adds `len` frames of every playing voice, resampled to the stream rate,
+// into an S16 buffer laid out like the stream.
+#define AM_AUDIO_MIX_PLAY   1
+#define AM_AUDIO_MIX_STOP   2
+#define AM_AUDIO_MIX_PAUSE  3
+#define AM_AUDIO_MIX_RESUME 4
+#define AM_AUDIO_MIX_SET    5   // volume and pan only
+#define AM_AUDIO_MIX_MIX    6
+
+#define AM_AUDIO_FMT_U8     1
+#define AM_AUDIO_FMT_S16    2
+#define AM_AUDIO_NR_VOICES  16
+#define AM_AUDIO_MAX_VOLUME 128
+
+struct audio_mix_cmd {
+  uint32_t op;
+  uint16_t voice, volume;     // volume 0..128
+  uint64_t buf;               // PLAY: PCM; MIX: S16 frames to add into
+  uint32_t len;               // PLAY: bytes; MIX: output frames
+  uint32_t freq;              // PLAY: source rate in Hz
+  uint8_t format, channels;   // PLAY: AM_AUDIO_FMT_*, 1 or 2
+  uint8_t pan_l, pan_r;       // 0..255 per side
+  int32_t loops;              // PLAY: extra passes, -1 forever
+};
+
+// AM_DISK_SGREAD segment: a physical byte range, any length and alignment.
+#define AM_DISK_SG_MAX      1024
+
+struct disk_sg_seg {
+  uint32_t addr, len;
+};
+#endif
+
 #endif
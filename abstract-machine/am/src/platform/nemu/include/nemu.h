@@ -68,13 +68,275 @@ enum
     NEMU_VGACTL_BLIT_CMD = 5u,
     NEMU_VGACTL_CAPTURE_DST = 6u,
     NEMU_VGACTL_CAPTURE_CMD = 7u,
+    NEMU_VGACTL_QUEUE_BASE_LO = 8u,
+    NEMU_VGACTL_QUEUE_BASE_HI = 9u,
+    NEMU_VGACTL_QUEUE_SIZE = 10u,
+    NEMU_VGACTL_QUEUE_HEAD = 11u,
+    NEMU_VGACTL_QUEUE_TAIL = 12u,
+    NEMU_VGACTL_NR_REGS = 13u,
 };
 
 #define NEMU_VGACTL_BLIT_CMD_COPY 1u
 #define NEMU_VGACTL_CAPTURE_CMD_COPY 1u
 
+/*
+ * 2D command queue.  The guest owns a ring of NEMU_GPU_CMD_SIZE-byte commands
+ * at QUEUE_BASE (a guest virtual address, translated like BLIT_SRC) holding
+ * QUEUE_SIZE entries, a power of two.  Writing BASE or SIZE resets both
+ * indices to zero.  HEAD and TAIL are free-running entry counts; a write to
+ * TAIL is the doorbell, and NEMU executes every command from HEAD up to TAIL
+ * before the write retires, so HEAD == TAIL on return.
+ *
+ * Surfaces are given as a guest address plus a pitch in bytes, or as the
+ * framebuffer when the matching *_FB flag is set (address and pitch are then
+ * ignored).  Rectangles are already clipped by the guest.  COPY, COLORKEY
+ * and PAL8 use the destination size for the source as well; only STRETCH
+ * reads SRC_W/SRC_H.  COPY is the only operation whose source and
+ * destination may overlap.
+ */
+enum
+{
+    NEMU_GPU_CMD_OP = 0x00u,
+    NEMU_GPU_CMD_FLAGS = 0x04u,
+    NEMU_GPU_CMD_DST = 0x08u,   // 64-bit
+    NEMU_GPU_CMD_SRC = 0x10u,   // 64-bit
+    NEMU_GPU_CMD_AUX = 0x18u,   // 64-bit, PAL8: 256 ARGB words
+    NEMU_GPU_CMD_DST_PITCH = 0x20u,
+    NEMU_GPU_CMD_SRC_PITCH = 0x24u,
+    NEMU_GPU_CMD_DST_X = 0x28u, // 16-bit x, y, w, h
+    NEMU_GPU_CMD_SRC_X = 0x30u, // 16-bit x, y, w, h
+    NEMU_GPU_CMD_COLOR = 0x38u, // FILL colour or COLORKEY key
+    NEMU_GPU_CMD_BPP = 0x3cu,   // bytes per pixel, 1 or 4; PAL8 is 1 -> 4
+    NEMU_GPU_CMD_SIZE = 0x40u,
+};
+
+enum
+{
+    NEMU_GPU_OP_FILL = 1u,
+    NEMU_GPU_OP_COPY = 2u,
+    NEMU_GPU_OP_COLORKEY = 3u,
+    NEMU_GPU_OP_STRETCH = 4u,
+    NEMU_GPU_OP_PAL8 = 5u,
+};
+
+#define NEMU_GPU_FLAG_BILINEAR 0x1u
+#define NEMU_GPU_FLAG_DST_FB 0x2u
+#define NEMU_GPU_FLAG_SRC_FB 0x4u
+
 #define AUDIO_ADDR (DEVICE_BASE + 0x0000200)
 #define DISK_ADDR (DEVICE_BASE + 0x0000300)
+#define HARTCTL_ADDR (DEVICE_BASE + 0x0000400)
+#define SERIAL_BULK_ADDR (MMIO_BASE + 0x0000500)
+
+/*
+ * Bulk serial output.  The guest stores a buffer address (a guest virtual
+ * address, translated like the audio BULK_SRC) and a length, then writes
+ * NEMU_SERIAL_BULK_CMD_WRITE to CMD; NEMU has queued every byte for the host
+ * console when the write retires.  The single-byte port keeps working.
+ */
+enum
+{
+    NEMU_SERIAL_BULK_SRC_LO = 0x00u,
+    NEMU_SERIAL_BULK_SRC_HI = 0x04u,
+    NEMU_SERIAL_BULK_LEN = 0x08u,
+    NEMU_SERIAL_BULK_CMD = 0x0cu,
+    NEMU_SERIAL_BULK_MMIO_SIZE = 0x10u,
+};
+
+#define NEMU_SERIAL_BULK_CMD_WRITE 1u
+
+/*
+ * 16550 registers at SERIAL_PORT that NEMU models.  Received bytes wait in an
+ * RX FIFO fed from the host console; LSR_BI stays set once the host input has
+ * reached end of file and the FIFO is empty.  IER_RDI raises NEMU_IRQ_SERIAL
+ * while either condition holds.
+ */
+enum
+{
+    NEMU_SERIAL_RBR = 0,
+    NEMU_SERIAL_THR = 0,
+    NEMU_SERIAL_IER = 1,
+    NEMU_SERIAL_IIR = 2,
+    NEMU_SERIAL_LSR = 5,
+    NEMU_SERIAL_NR_PORTS = 8,
+};
+
+#define NEMU_SERIAL_IER_RDI 0x01u
+#define NEMU_SERIAL_IIR_NONE 0x01u
+#define NEMU_SERIAL_IIR_RDI 0x04u
+#define NEMU_SERIAL_IIR_FIFO 0xc0u
+#define NEMU_SERIAL_LSR_DR 0x01u
+#define NEMU_SERIAL_LSR_BI 0x10u
+#define NEMU_SERIAL_LSR_THRE 0x20u
+#define NEMU_SERIAL_LSR_TEMT 0x40u
+
+/*
+ * Host voice mixer, word registers in the audio control page after the nine
+ * stream registers.  The guest points MIX_CMDS at MIX_COUNT records of
+ * NEMU_AUDIO_CMD_SIZE bytes (a guest virtual address, translated like
+ * BULK_SRC) and writes NEMU_AUDIO_MIX_RUN to MIX_DOORBELL; every record has
+ * run when the write retires.  VOICE_ACTIVE reads one bit per voice that is
+ * playing or paused.
+ *
+ * PLAY starts a voice on guest PCM (U8 or S16, mono or stereo, any rate) that
+ * stays in guest memory and is read again on every MIX, so it must stay
+ * mapped until the voice is stopped or reads back as finished.  MIX adds
+ * LEN output frames of every playing voice, resampled to the stream rate,
+ * into the S16 buffer at BUF with saturation, in the stream's channel layout.
+ * Voices are reset whenever the stream is initialised.
+ */
+enum
+{
+    NEMU_AUDIO_MIX_CMDS_LO = 9u,
+    NEMU_AUDIO_MIX_CMDS_HI = 10u,
+    NEMU_AUDIO_MIX_COUNT = 11u,
+    NEMU_AUDIO_MIX_DOORBELL = 12u,
+    NEMU_AUDIO_VOICE_ACTIVE = 13u,
+    NEMU_AUDIO_NR_REGS = 14u,
+};
+
+#define NEMU_AUDIO_MIX_RUN 1u
+#define NEMU_AUDIO_NR_VOICES 16u
+
+enum
+{
+    NEMU_AUDIO_CMD_OP = 0x00u,
+    NEMU_AUDIO_CMD_VOICE = 0x04u,   // 16-bit voice, 16-bit volume 0..128
+    NEMU_AUDIO_CMD_BUF = 0x08u,     // 64-bit, PLAY: PCM; MIX: S16 frames
+    NEMU_AUDIO_CMD_LEN = 0x10u,     // PLAY: bytes; MIX: output frames
+    NEMU_AUDIO_CMD_FREQ = 0x14u,    // PLAY: source rate in Hz
+    NEMU_AUDIO_CMD_FORMAT = 0x18u,  // 8-bit format, channels, left, right pan
+    NEMU_AUDIO_CMD_LOOPS = 0x1cu,   // PLAY: extra passes, -1 forever
+    NEMU_AUDIO_CMD_SIZE = 0x20u,
+};
+
+enum
+{
+    NEMU_AUDIO_OP_PLAY = 1u,
+    NEMU_AUDIO_OP_STOP = 2u,
+    NEMU_AUDIO_OP_PAUSE = 3u,
+    NEMU_AUDIO_OP_RESUME = 4u,
+    NEMU_AUDIO_OP_SET = 5u, // volume and pan only
+    NEMU_AUDIO_OP_MIX = 6u,
+};
+
+#define NEMU_AUDIO_FMT_U8 1u
+#define NEMU_AUDIO_FMT_S16 2u
+#define NEMU_AUDIO_MAX_VOLUME 128u
+
+/*
+ * Hart control, RV64 only.  Secondary harts start stopped; the boot hart
+ * selects one through HARTID, fills in START_PC and OPAQUE, then writes
+ * NEMU_HARTCTL_CMD_START to CMD.  The hart begins at START_PC in M-mode with
+ * a0 = hart ID and a1 = OPAQUE.  Reading CMD returns 1 while the selected hart
+ * is running.
+ */
+enum
+{
+    NEMU_HARTCTL_NR_HARTS = 0x00u,
+    NEMU_HARTCTL_HARTID = 0x04u,
+    NEMU_HARTCTL_START_PC_LO = 0x08u,
+    NEMU_HARTCTL_START_PC_HI = 0x0cu,
+    NEMU_HARTCTL_OPAQUE_LO = 0x10u,
+    NEMU_HARTCTL_OPAQUE_HI = 0x14u,
+    NEMU_HARTCTL_CMD = 0x18u,
+    NEMU_HARTCTL_MMIO_SIZE = 0x1cu,
+};
+
+#define NEMU_HARTCTL_CMD_START 1u
+
+/*
+ * RV64 interrupt controllers at their customary RISC-V addresses.  The CLINT
+ * provides per-hart msip/mtimecmp and a shared 1 MHz mtime; the PLIC uses the
+ * SiFive register layout with one M-mode context per hart.
+ */
+#define CLINT_ADDR 0x02000000
+#define PLIC_ADDR 0x0c000000
+
+enum
+{
+    NEMU_CLINT_MSIP = 0x0000u,
+    NEMU_CLINT_MTIMECMP = 0x4000u,
+    NEMU_CLINT_MTIME = 0xbff8u,
+    NEMU_CLINT_MMIO_SIZE = 0x10000u,
+};
+
+#define NEMU_CLINT_TIMEBASE_HZ 1000000u
+
+enum
+{
+    NEMU_PLIC_PRIORITY = 0x0u,
+    NEMU_PLIC_PENDING = 0x1000u,
+    NEMU_PLIC_ENABLE = 0x2000u,
+    NEMU_PLIC_ENABLE_STRIDE = 0x80u,
+    NEMU_PLIC_CONTEXT = 0x200000u,
+    NEMU_PLIC_CONTEXT_STRIDE = 0x1000u,
+    NEMU_PLIC_THRESHOLD = 0x0u,
+    NEMU_PLIC_CLAIM = 0x4u,
+};
+
+#define NEMU_PLIC_MAX_CONTEXT 8
+#define NEMU_PLIC_MMIO_SIZE (NEMU_PLIC_CONTEXT + NEMU_PLIC_MAX_CONTEXT * NEMU_PLIC_CONTEXT_STRIDE)
+
+/* PLIC source IDs of the NEMU devices; source 0 means "no interrupt". */
+enum
+{
+    NEMU_IRQ_KEYBOARD = 1,
+    NEMU_IRQ_MOUSE = 2,
+    NEMU_IRQ_DISK = 3,
+    NEMU_IRQ_AUDIO = 4,
+    NEMU_IRQ_SERIAL = 5,
+    NEMU_IRQ_VIRTIO_BLK = 6,
+    NEMU_IRQ_NR,
+};
+
+/*
+ * virtio-mmio (version 2) block device with one split virtqueue.  Offsets are
+ * the standard virtio-mmio register layout; the block config space starts at
+ * NEMU_VIRTIO_CONFIG.
+ */
+#define VIRTIO_BLK_ADDR (DEVICE_BASE + 0x0001000)
+
+enum
+{
+    NEMU_VIRTIO_MAGIC = 0x000,
+    NEMU_VIRTIO_VERSION = 0x004,
+    NEMU_VIRTIO_DEVICE_ID = 0x008,
+    NEMU_VIRTIO_VENDOR_ID = 0x00c,
+    NEMU_VIRTIO_DEVICE_FEATURES = 0x010,
+    NEMU_VIRTIO_DEVICE_FEATURES_SEL = 0x014,
+    NEMU_VIRTIO_DRIVER_FEATURES = 0x020,
+    NEMU_VIRTIO_DRIVER_FEATURES_SEL = 0x024,
+    NEMU_VIRTIO_QUEUE_SEL = 0x030,
+    NEMU_VIRTIO_QUEUE_NUM_MAX = 0x034,
+    NEMU_VIRTIO_QUEUE_NUM = 0x038,
+    NEMU_VIRTIO_QUEUE_READY = 0x044,
+    NEMU_VIRTIO_QUEUE_NOTIFY = 0x050,
+    NEMU_VIRTIO_INTERRUPT_STATUS = 0x060,
+    NEMU_VIRTIO_INTERRUPT_ACK = 0x064,
+    NEMU_VIRTIO_STATUS = 0x070,
+    NEMU_VIRTIO_QUEUE_DESC_LO = 0x080,
+    NEMU_VIRTIO_QUEUE_DESC_HI = 0x084,
+    NEMU_VIRTIO_QUEUE_DRIVER_LO = 0x090,
+    NEMU_VIRTIO_QUEUE_DRIVER_HI = 0x094,
+    NEMU_VIRTIO_QUEUE_DEVICE_LO = 0x0a0,
+    NEMU_VIRTIO_QUEUE_DEVICE_HI = 0x0a4,
+    NEMU_VIRTIO_CONFIG_GENERATION = 0x0fc,
+    NEMU_VIRTIO_CONFIG = 0x100,
+    NEMU_VIRTIO_MMIO_SIZE = 0x200,
+};
+
+/* virtio-blk config space, relative to NEMU_VIRTIO_CONFIG. */
+enum
+{
+    NEMU_VIRTIO_BLK_CAPACITY = 0x00, // 64-bit, in 512-byte sectors
+    NEMU_VIRTIO_BLK_SIZE_MAX = 0x08,
+    NEMU_VIRTIO_BLK_SEG_MAX = 0x0c,
+    NEMU_VIRTIO_BLK_BLK_SIZE = 0x14,
+};
+
+#define NEMU_VIRTIO_MAGIC_VALUE 0x74726976u // "virt"
+#define NEMU_VIRTIO_ID_BLOCK 2u
 #define FB_ADDR (MMIO_BASE + 0x1000000)
 
 #define NEMU_MAX_SCREEN_W 1024
@@ -88,11 +350,20 @@ extern char _pmem_start;
 
 #define AUDIO_SBUF_SIZE 0x10000
 
+#if defined(__ISA_RISCV64__)
+#define NEMU_PADDR_SPACE_INTC \
+    , RANGE(CLINT_ADDR, CLINT_ADDR + NEMU_CLINT_MMIO_SIZE), \
+        RANGE(PLIC_ADDR, PLIC_ADDR + NEMU_PLIC_MMIO_SIZE)
+#else
+#define NEMU_PADDR_SPACE_INTC
+#endif
+
 #define NEMU_PADDR_SPACE \
     RANGE(&_pmem_start, PMEM_END), \
         RANGE(FB_ADDR, FB_ADDR + NEMU_FB_SIZE_MAX), \
-        RANGE(MMIO_BASE, MMIO_BASE + 0x1000),                     /* serial, rtc, screen, keyboard, audio-ctl, disk */ \
-        RANGE(AUDIO_SBUF_ADDR, AUDIO_SBUF_ADDR + AUDIO_SBUF_SIZE) /* audio sample buffer */
+        RANGE(MMIO_BASE, MMIO_BASE + 0x2000),                     /* serial, rtc, screen, keyboard, audio-ctl, disk, hartctl, virtio-blk */ \
+        RANGE(AUDIO_SBUF_ADDR, AUDIO_SBUF_ADDR + AUDIO_SBUF_SIZE) /* audio sample buffer */ \
+            NEMU_PADDR_SPACE_INTC
 
 typedef uintptr_t PTE;
 
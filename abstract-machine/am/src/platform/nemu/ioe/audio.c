@@ -1,4 +1,5 @@
 #include <am.h>
+#include <klib.h>
 #include <nemu.h>
 
 #define AUDIO_FREQ_ADDR (AUDIO_ADDR + 0x00)
@@ -11,6 +12,13 @@
 #define AUDIO_BULK_LEN_ADDR (AUDIO_ADDR + 0x1c)
 #define AUDIO_BULK_CMD_ADDR (AUDIO_ADDR + 0x20)
 #define AUDIO_BULK_CMD_APPEND 1u
+#define AUDIO_REG_ADDR(reg) (AUDIO_ADDR + (reg) * sizeof(uint32_t))
+
+_Static_assert(sizeof(struct audio_mix_cmd) == NEMU_AUDIO_CMD_SIZE, "audio_mix_cmd size mismatch");
+_Static_assert(offsetof(struct audio_mix_cmd, buf) == NEMU_AUDIO_CMD_BUF, "audio_mix_cmd layout mismatch");
+_Static_assert(offsetof(struct audio_mix_cmd, format) == NEMU_AUDIO_CMD_FORMAT, "audio_mix_cmd layout mismatch");
+_Static_assert(offsetof(struct audio_mix_cmd, loops) == NEMU_AUDIO_CMD_LOOPS, "audio_mix_cmd layout mismatch");
+_Static_assert(AM_AUDIO_NR_VOICES == NEMU_AUDIO_NR_VOICES, "voice count mismatch");
 
 /* Cached after AM_AUDIO_CONFIG so AM_AUDIO_PLAY can check ring-buffer capacity
  * without rereading the mostly-static configuration register on every poll.
@@ -82,3 +90,24 @@ void __am_audio_play(AM_AUDIO_PLAY_T *ctl)
     outl(AUDIO_BULK_LEN_ADDR, len);
     outl(AUDIO_BULK_CMD_ADDR, AUDIO_BULK_CMD_APPEND);
 }
+
+void __am_audio_mixq(AM_AUDIO_MIXQ_T *ctl)
+{
+    if (ctl->n <= 0)
+    {
+        return;
+    }
+
+    // NEMU reads the records straight from the caller and runs them all
+    // before the doorbell write retires.
+    const uint64_t cmds = (uintptr_t)ctl->cmds;
+    outl(AUDIO_REG_ADDR(NEMU_AUDIO_MIX_CMDS_LO), (uint32_t)cmds);
+    outl(AUDIO_REG_ADDR(NEMU_AUDIO_MIX_CMDS_HI), (uint32_t)(cmds >> 32));
+    outl(AUDIO_REG_ADDR(NEMU_AUDIO_MIX_COUNT), (uint32_t)ctl->n);
+    outl(AUDIO_REG_ADDR(NEMU_AUDIO_MIX_DOORBELL), NEMU_AUDIO_MIX_RUN);
+}
+
+void __am_audio_voices(AM_AUDIO_VOICES_T *stat)
+{
+    stat->active = inl(AUDIO_REG_ADDR(NEMU_AUDIO_VOICE_ACTIVE));
+}
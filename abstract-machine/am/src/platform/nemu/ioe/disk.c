@@ -12,6 +12,9 @@ enum
     reg_blkno,
     reg_io_blkcnt,
     reg_cmd,
+    reg_irq,
+    reg_sg,
+    reg_sg_count,
 };
 
 // The NEMU disk model exposes a compact MMIO register file at DISK_ADDR.
@@ -19,6 +22,7 @@ enum
 // them to 32-bit addresses so the C side stays tied to the device contract.
 #define DISK_REG(offset) (DISK_ADDR + (offset) * sizeof(uint32_t))
 #define DISK_CMD_GO 1u
+#define DISK_CMD_SGREAD 2u
 
 void __am_disk_config(AM_DISK_CONFIG_T *cfg)
 {
@@ -65,4 +69,34 @@ void __am_disk_blkio(AM_DISK_BLKIO_T *io)
     while (inl(DISK_REG(reg_ready)) == 0)
     {
     }
+
+    // Completion is polled above, so acknowledge the PLIC line straight away.
+    outl(DISK_REG(reg_irq), 0);
+}
+
+void __am_disk_sgread(AM_DISK_SGREAD_T *io)
+{
+    if (io->blkcnt <= 0 || io->n <= 0)
+    {
+        return;
+    }
+
+    // Same handshake as BLKIO; the segment list itself is read by NEMU, so it
+    // must stay in place until ready comes back.
+    while (inl(DISK_REG(reg_ready)) == 0)
+    {
+    }
+
+    outl(DISK_REG(reg_write), 0);
+    outl(DISK_REG(reg_sg), (uintptr_t)io->segs);
+    outl(DISK_REG(reg_sg_count), (uint32_t)io->n);
+    outl(DISK_REG(reg_blkno), (uint32_t)io->blkno);
+    outl(DISK_REG(reg_io_blkcnt), (uint32_t)io->blkcnt);
+    outl(DISK_REG(reg_cmd), DISK_CMD_SGREAD);
+
+    while (inl(DISK_REG(reg_ready)) == 0)
+    {
+    }
+
+    outl(DISK_REG(reg_irq), 0);
 }
@@ -9,8 +9,23 @@ static inline uintptr_t vgactl_reg_addr(uint32_t reg)
     return VGACTL_ADDR + (uintptr_t)reg * sizeof(uint32_t);
 }
 
+/*
+ * The device reads commands straight out of this ring.  It is drained before
+ * the TAIL doorbell write retires, so a full ring only costs one extra
+ * doorbell and HEAD never has to be polled.
+ */
+#define GPU_CMDQ_ENTRIES 64
+
+_Static_assert(sizeof(struct gpu_cmd) == NEMU_GPU_CMD_SIZE, "gpu_cmd size mismatch");
+_Static_assert(offsetof(struct gpu_cmd, aux) == NEMU_GPU_CMD_AUX, "gpu_cmd layout mismatch");
+_Static_assert(offsetof(struct gpu_cmd, dst_x) == NEMU_GPU_CMD_DST_X, "gpu_cmd layout mismatch");
+_Static_assert(offsetof(struct gpu_cmd, src_x) == NEMU_GPU_CMD_SRC_X, "gpu_cmd layout mismatch");
+_Static_assert(offsetof(struct gpu_cmd, bpp) == NEMU_GPU_CMD_BPP, "gpu_cmd layout mismatch");
+
 static int W;
 static int H;
+static struct gpu_cmd gpu_cmdq[GPU_CMDQ_ENTRIES];
+static uint32_t gpu_cmdq_tail;
 static uint8_t gpu_accel_vmem[GPU_ACCEL_VMEM_SIZE];
 static uint32_t gpu_accel_frame[GPU_ACCEL_VMEM_SIZE / sizeof(uint32_t)];
 static uint8_t gpu_accel_scratch[GPU_ACCEL_VMEM_SIZE];
@@ -133,6 +148,12 @@ void __am_gpu_init()
      */
     W = vgainfo >> 16;
     H = (vgainfo << 16) >> 16;
+
+    const uint64_t ring = (uintptr_t)gpu_cmdq;
+    outl(vgactl_reg_addr(NEMU_VGACTL_QUEUE_BASE_LO), (uint32_t)ring);
+    outl(vgactl_reg_addr(NEMU_VGACTL_QUEUE_BASE_HI), (uint32_t)(ring >> 32));
+    outl(vgactl_reg_addr(NEMU_VGACTL_QUEUE_SIZE), GPU_CMDQ_ENTRIES);
+    gpu_cmdq_tail = 0;
 }
 
 void __am_gpu_config(AM_GPU_CONFIG_T *cfg)
@@ -225,3 +246,28 @@ void __am_gpu_render(AM_GPU_RENDER_T *ctl)
     };
     __am_gpu_fbdraw(&draw);
 }
+
+void __am_gpu_cmdq(AM_GPU_CMDQ_T *ctl)
+{
+    const struct gpu_cmd *cmds = ctl->cmds;
+    int pending = 0;
+
+    assert(ctl->n >= 0);
+
+    for (int i = 0; i < ctl->n; i++)
+    {
+        gpu_cmdq[gpu_cmdq_tail % GPU_CMDQ_ENTRIES] = cmds[i];
+        gpu_cmdq_tail++;
+
+        if (++pending == GPU_CMDQ_ENTRIES)
+        {
+            outl(vgactl_reg_addr(NEMU_VGACTL_QUEUE_TAIL), gpu_cmdq_tail);
+            pending = 0;
+        }
+    }
+
+    if (pending != 0)
+    {
+        outl(vgactl_reg_addr(NEMU_VGACTL_QUEUE_TAIL), gpu_cmdq_tail);
+    }
+}
@@ -14,13 +14,20 @@ void __am_gpu_status(AM_GPU_STATUS_T *);
 void __am_gpu_fbdraw(AM_GPU_FBDRAW_T *);
 void __am_gpu_memcpy(AM_GPU_MEMCPY_T *);
 void __am_gpu_render(AM_GPU_RENDER_T *);
+void __am_gpu_cmdq(AM_GPU_CMDQ_T *);
+void __am_uart_config(AM_UART_CONFIG_T *);
+void __am_uart_tx(AM_UART_TX_T *);
+void __am_uart_rx(AM_UART_RX_T *);
 void __am_audio_config(AM_AUDIO_CONFIG_T *);
 void __am_audio_ctrl(AM_AUDIO_CTRL_T *);
 void __am_audio_status(AM_AUDIO_STATUS_T *);
 void __am_audio_play(AM_AUDIO_PLAY_T *);
+void __am_audio_mixq(AM_AUDIO_MIXQ_T *);
+void __am_audio_voices(AM_AUDIO_VOICES_T *);
 void __am_disk_config(AM_DISK_CONFIG_T *cfg);
 void __am_disk_status(AM_DISK_STATUS_T *stat);
 void __am_disk_blkio(AM_DISK_BLKIO_T *io);
+void __am_disk_sgread(AM_DISK_SGREAD_T *io);
 
 static void __am_timer_config(AM_TIMER_CONFIG_T *cfg)
 {
@@ -28,7 +35,6 @@ static void __am_timer_config(AM_TIMER_CONFIG_T *cfg)
     cfg->has_rtc = true;
 }
 static void __am_input_config(AM_INPUT_CONFIG_T *cfg) { cfg->present = true; }
-static void __am_uart_config(AM_UART_CONFIG_T *cfg) { cfg->present = false; }
 static void __am_net_config(AM_NET_CONFIG_T *cfg) { cfg->present = false; }
 
 typedef void (*handler_t)(void *buf);
@@ -45,14 +51,20 @@ static void *lut[128] = {
     [AM_GPU_STATUS] = __am_gpu_status,
     [AM_GPU_MEMCPY] = __am_gpu_memcpy,
     [AM_GPU_RENDER] = __am_gpu_render,
+    [AM_GPU_CMDQ] = __am_gpu_cmdq,
     [AM_UART_CONFIG] = __am_uart_config,
+    [AM_UART_TX] = __am_uart_tx,
+    [AM_UART_RX] = __am_uart_rx,
     [AM_AUDIO_CONFIG] = __am_audio_config,
     [AM_AUDIO_CTRL] = __am_audio_ctrl,
     [AM_AUDIO_STATUS] = __am_audio_status,
     [AM_AUDIO_PLAY] = __am_audio_play,
+    [AM_AUDIO_MIXQ] = __am_audio_mixq,
+    [AM_AUDIO_VOICES] = __am_audio_voices,
     [AM_DISK_CONFIG] = __am_disk_config,
     [AM_DISK_STATUS] = __am_disk_status,
     [AM_DISK_BLKIO] = __am_disk_blkio,
+    [AM_DISK_SGREAD] = __am_disk_sgread,
     [AM_NET_CONFIG] = __am_net_config,
 };
 
@@ -0,0 +1,24 @@
+#include <am.h>
+#include <nemu.h>
+
+#define ASCII_EOT 0x04
+
+void __am_uart_config(AM_UART_CONFIG_T *cfg) { cfg->present = true; }
+
+void __am_uart_tx(AM_UART_TX_T *uart) { outb(SERIAL_PORT + NEMU_SERIAL_THR, uart->data); }
+
+void __am_uart_rx(AM_UART_RX_T *uart)
+{
+    const uint8_t lsr = inb(SERIAL_PORT + NEMU_SERIAL_LSR);
+    /* Like native AM, -1 means nothing is waiting.  A break (host end of file)
+     * is handed over as EOT, which the caller may treat as a terminal's ^D.
+     */
+    if (lsr & NEMU_SERIAL_LSR_DR)
+    {
+        uart->data = inb(SERIAL_PORT + NEMU_SERIAL_RBR);
+    }
+    else
+    {
+        uart->data = (lsr & NEMU_SERIAL_LSR_BI) ? ASCII_EOT : -1;
+    }
+}
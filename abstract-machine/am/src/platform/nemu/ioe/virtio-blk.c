@@ -0,0 +1,267 @@
+#include <am.h>
+#include <klib.h>
+#include <nemu.h>
+
+/*
+ * AM disk over NEMU's virtio-blk device, built instead of disk.c with
+ * DISK=virtio.  It is deliberately minimal: one request at a time on one
+ * split virtqueue, polled to completion like the legacy disk handshake, so
+ * AM_DISK_BLKIO and AM_DISK_SGREAD keep their synchronous contract.  NEMU has
+ * to be configured with CONFIG_HAS_VIRTIO_BLK.
+ */
+
+#define VIRTIO_REG(offset) (VIRTIO_BLK_ADDR + (offset))
+#define VIRTIO_SECTOR 512u
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 1u
+#define VIRTIO_STATUS_DRIVER 2u
+#define VIRTIO_STATUS_DRIVER_OK 4u
+#define VIRTIO_STATUS_FEATURES_OK 8u
+// VIRTIO_F_VERSION_1 is feature bit 32, bit 0 of the second feature word.
+#define VIRTIO_F_VERSION_1_HI 1u
+
+#define VIRTQ_DESC_F_NEXT 1u
+#define VIRTQ_DESC_F_WRITE 2u
+
+#define VIRTIO_BLK_T_IN 0u
+#define VIRTIO_BLK_T_OUT 1u
+
+// A request is the header, the data descriptors and the status byte.
+#define VIRTQ_NUM 128u
+#define VIRTQ_DATA_MAX (VIRTQ_NUM - 2u)
+
+struct virtq_desc
+{
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+/* The three queue areas, and the request header and status the device reads and writes. */
+static struct
+{
+    struct virtq_desc desc[VIRTQ_NUM];
+    struct
+    {
+        uint16_t flags;
+        uint16_t idx;
+        uint16_t ring[VIRTQ_NUM];
+    } avail;
+    struct
+    {
+        uint16_t flags;
+        volatile uint16_t idx;
+        struct
+        {
+            uint32_t id;
+            uint32_t len;
+        } ring[VIRTQ_NUM];
+    } used __attribute__((aligned(4)));
+    struct
+    {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t sector;
+    } hdr;
+    volatile uint8_t status;
+} vq __attribute__((aligned(16)));
+
+static uint64_t capacity = 0;
+// 0 until the first AM_DISK_CONFIG, then 1 for a usable device or -1.
+static int probed = 0;
+
+static void virtio_write64(uint32_t lo, uintptr_t value)
+{
+    outl(VIRTIO_REG(lo), (uint32_t)value);
+    outl(VIRTIO_REG(lo + 4), (uint32_t)((uint64_t)value >> 32));
+}
+
+static bool virtio_probe(void)
+{
+    if (inl(VIRTIO_REG(NEMU_VIRTIO_MAGIC)) != NEMU_VIRTIO_MAGIC_VALUE ||
+        inl(VIRTIO_REG(NEMU_VIRTIO_VERSION)) != 2 ||
+        inl(VIRTIO_REG(NEMU_VIRTIO_DEVICE_ID)) != NEMU_VIRTIO_ID_BLOCK)
+    {
+        return false;
+    }
+
+    outl(VIRTIO_REG(NEMU_VIRTIO_STATUS), 0);
+    outl(VIRTIO_REG(NEMU_VIRTIO_STATUS), VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // Only VERSION_1 is accepted; the block features are optional.
+    outl(VIRTIO_REG(NEMU_VIRTIO_DEVICE_FEATURES_SEL), 1);
+    if ((inl(VIRTIO_REG(NEMU_VIRTIO_DEVICE_FEATURES)) & VIRTIO_F_VERSION_1_HI) == 0 ||
+        inl(VIRTIO_REG(NEMU_VIRTIO_QUEUE_NUM_MAX)) < VIRTQ_NUM)
+    {
+        return false;
+    }
+    outl(VIRTIO_REG(NEMU_VIRTIO_DRIVER_FEATURES_SEL), 0);
+    outl(VIRTIO_REG(NEMU_VIRTIO_DRIVER_FEATURES), 0);
+    outl(VIRTIO_REG(NEMU_VIRTIO_DRIVER_FEATURES_SEL), 1);
+    outl(VIRTIO_REG(NEMU_VIRTIO_DRIVER_FEATURES), VIRTIO_F_VERSION_1_HI);
+    outl(VIRTIO_REG(NEMU_VIRTIO_STATUS),
+         VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_FEATURES_OK);
+
+    outl(VIRTIO_REG(NEMU_VIRTIO_QUEUE_SEL), 0);
+    outl(VIRTIO_REG(NEMU_VIRTIO_QUEUE_NUM), VIRTQ_NUM);
+    virtio_write64(NEMU_VIRTIO_QUEUE_DESC_LO, (uintptr_t)vq.desc);
+    virtio_write64(NEMU_VIRTIO_QUEUE_DRIVER_LO, (uintptr_t)&vq.avail);
+    virtio_write64(NEMU_VIRTIO_QUEUE_DEVICE_LO, (uintptr_t)&vq.used);
+    outl(VIRTIO_REG(NEMU_VIRTIO_QUEUE_READY), 1);
+    outl(VIRTIO_REG(NEMU_VIRTIO_STATUS), VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER |
+                                             VIRTIO_STATUS_FEATURES_OK | VIRTIO_STATUS_DRIVER_OK);
+
+    const uint32_t config = NEMU_VIRTIO_CONFIG + NEMU_VIRTIO_BLK_CAPACITY;
+    capacity = inl(VIRTIO_REG(config)) | ((uint64_t)inl(VIRTIO_REG(config + 4)) << 32);
+    return capacity > 0;
+}
+
+/*
+ * Run one request over n physical data ranges and wait for its used entry.
+ * Reading InterruptStatus makes NEMU publish finished requests, so the loop
+ * sees completion without waiting for the next device update.
+ */
+static void virtio_request(bool write, uint64_t sector, const struct disk_sg_seg *data, int n)
+{
+    vq.hdr.type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    vq.hdr.reserved = 0;
+    vq.hdr.sector = sector;
+    vq.status = 0xff;
+
+    vq.desc[0] = (struct virtq_desc){(uintptr_t)&vq.hdr, sizeof(vq.hdr), VIRTQ_DESC_F_NEXT, 1};
+    for (int i = 0; i < n; i++)
+    {
+        vq.desc[i + 1] = (struct virtq_desc){data[i].addr, data[i].len,
+                                             VIRTQ_DESC_F_NEXT | (write ? 0 : VIRTQ_DESC_F_WRITE), i + 2};
+    }
+    vq.desc[n + 1] = (struct virtq_desc){(uintptr_t)&vq.status, 1, VIRTQ_DESC_F_WRITE, 0};
+
+    const uint16_t used = vq.used.idx;
+
+    vq.avail.ring[vq.avail.idx % VIRTQ_NUM] = 0;
+    __sync_synchronize();
+    vq.avail.idx++;
+    outl(VIRTIO_REG(NEMU_VIRTIO_QUEUE_NOTIFY), 0);
+
+    uint32_t isr = 0;
+
+    while (vq.used.idx == used)
+    {
+        isr = inl(VIRTIO_REG(NEMU_VIRTIO_INTERRUPT_STATUS));
+    }
+
+    isr |= inl(VIRTIO_REG(NEMU_VIRTIO_INTERRUPT_STATUS));
+    outl(VIRTIO_REG(NEMU_VIRTIO_INTERRUPT_ACK), isr);
+
+    // AM disk I/O cannot fail, and a read-only image refuses every write.
+    if (vq.status != 0)
+    {
+        panic("virtio-blk: request failed");
+    }
+}
+
+void __am_disk_config(AM_DISK_CONFIG_T *cfg)
+{
+    if (probed == 0)
+    {
+        probed = virtio_probe() ? 1 : -1;
+    }
+
+    cfg->present = probed > 0;
+    cfg->blksz = cfg->present ? (int)VIRTIO_SECTOR : 0;
+    cfg->blkcnt = cfg->present ? (int)capacity : 0;
+}
+
+void __am_disk_status(AM_DISK_STATUS_T *stat)
+{
+    // Requests complete before the call that issued them returns.
+    stat->ready = true;
+}
+
+void __am_disk_blkio(AM_DISK_BLKIO_T *io)
+{
+    if (io->blkcnt <= 0)
+    {
+        return;
+    }
+
+    const struct disk_sg_seg data = {(uint32_t)(uintptr_t)io->buf, (uint32_t)io->blkcnt * VIRTIO_SECTOR};
+
+    virtio_request(io->write, (uint64_t)io->blkno, &data, 1);
+}
+
+/*
+ * A list longer than one chain goes out as several requests.  Each covers
+ * whole sectors; the partial sector at its end starts the next one.
+ */
+void __am_disk_sgread(AM_DISK_SGREAD_T *io)
+{
+    static struct disk_sg_seg data[VIRTQ_DATA_MAX];
+    const struct disk_sg_seg *segs = io->segs;
+    uint64_t sector = (uint64_t)io->blkno;
+    uint32_t skip = 0;
+    int i = 0;
+
+    if (io->blkcnt <= 0 || io->n <= 0)
+    {
+        return;
+    }
+
+    while (true)
+    {
+        while (i < io->n && segs[i].len == skip)
+        {
+            i++;
+            skip = 0;
+        }
+
+        if (i == io->n)
+        {
+            return;
+        }
+
+        uint32_t bytes = 0;
+        int last = i;
+
+        for (; last < io->n && last - i < (int)VIRTQ_DATA_MAX; last++)
+        {
+            bytes += segs[last].len - (last == i ? skip : 0);
+        }
+
+        if (last < io->n)
+        {
+            bytes -= bytes % VIRTIO_SECTOR;
+        }
+
+        if (bytes == 0)
+        {
+            panic("virtio-blk: segments too short for one sector per request");
+        }
+
+        int n = 0;
+
+        for (uint32_t left = bytes; left > 0; n++)
+        {
+            uint32_t len = segs[i].len - skip;
+
+            if (len > left)
+            {
+                len = left;
+            }
+
+            data[n] = (struct disk_sg_seg){segs[i].addr + skip, len};
+            left -= len;
+            skip += len;
+
+            if (skip == segs[i].len)
+            {
+                i++;
+                skip = 0;
+            }
+        }
+
+        virtio_request(false, sector, data, n);
+        sector += bytes / VIRTIO_SECTOR;
+    }
+}
@@ -1,7 +1,79 @@
 #include <am.h>
+#include <nemu.h>
 #include <stdatomic.h>
 #include <klib-macros.h>
 
+#if defined(__ISA_RISCV64__)
+#define MPE_MAX_CPU 8
+#define MPE_STACK_SIZE 0x8000
+
+// Hart 0 keeps the boot stack from the linker script; every secondary hart gets
+// one of these. They are indexed by hart ID, so slot 0 is simply unused.
+static uint8_t mpe_stack[MPE_MAX_CPU][MPE_STACK_SIZE] __attribute__((aligned(16)));
+static void (*mpe_entry)() = NULL;
+static uintptr_t mpe_mtvec = 0;
+static uintptr_t mpe_satp = 0;
+
+void __am_mpe_secondary_start();
+
+// NEMU starts a secondary hart here in M-mode with a0 = hart ID and a1 = the
+// opaque word passed through hartctl, which mpe_init() sets to the stack top.
+asm(".pushsection .text\n"
+    ".globl __am_mpe_secondary_start\n"
+    "__am_mpe_secondary_start:\n"
+    "  mv sp, a1\n"
+    "  mv s0, zero\n"
+    "  call __am_mpe_secondary_main\n"
+    ".popsection\n");
+
+void __am_mpe_secondary_main()
+{
+    // Secondary harts come out of reset with empty trap and translation state.
+    // Share the boot hart's CTE vector and kernel address space before entering
+    // the common MPE entry point.
+    asm volatile("csrw mtvec, %0" : : "r"(mpe_mtvec));
+    asm volatile("csrw mscratch, zero");
+    asm volatile("csrw satp, %0" : : "r"(mpe_satp));
+    mpe_entry();
+    panic("MPE entry returns");
+}
+
+bool mpe_init(void (*entry)())
+{
+    mpe_entry = entry;
+    asm volatile("csrr %0, mtvec" : "=r"(mpe_mtvec));
+    asm volatile("csrr %0, satp" : "=r"(mpe_satp));
+
+    for (int id = 1; id < cpu_count(); id++)
+    {
+        const uintptr_t pc = (uintptr_t)__am_mpe_secondary_start;
+        const uintptr_t sp = (uintptr_t)&mpe_stack[id][MPE_STACK_SIZE];
+
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_HARTID, id);
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_START_PC_LO, (uint32_t)pc);
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_START_PC_HI, (uint32_t)(pc >> 32));
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_OPAQUE_LO, (uint32_t)sp);
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_OPAQUE_HI, (uint32_t)(sp >> 32));
+        outl(HARTCTL_ADDR + NEMU_HARTCTL_CMD, NEMU_HARTCTL_CMD_START);
+    }
+
+    entry();
+    panic("MPE entry returns");
+}
+
+int cpu_count()
+{
+    int n = inl(HARTCTL_ADDR + NEMU_HARTCTL_NR_HARTS);
+    return n > MPE_MAX_CPU ? MPE_MAX_CPU : n;
+}
+
+int cpu_current()
+{
+    uintptr_t id;
+    asm volatile("csrr %0, mhartid" : "=r"(id));
+    return (int)id;
+}
+#else
 bool mpe_init(void (*entry)())
 {
     // The NEMU AM target is single-core, so MPE startup is a direct call on the
@@ -22,6 +94,7 @@ int cpu_current()
 {
     return 0;
 }
+#endif
 
 int atomic_xchg(int *addr, int newval)
 {
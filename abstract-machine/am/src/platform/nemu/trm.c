@@ -14,6 +14,30 @@ void putch(char ch)
     outb(SERIAL_PORT, ch);
 }
 
+// The bulk registers are MMIO on every ISA, including the ones whose outl() is port I/O.
+static inline void serial_bulk_outl(uint32_t reg, uint32_t data)
+{
+    *(volatile uint32_t *)(uintptr_t)(SERIAL_BULK_ADDR + reg) = data;
+}
+
+void putnstr(const char *s, size_t len)
+{
+    // Whole strings go through the bulk register instead: NEMU copies the bytes
+    // out of guest memory in one MMIO write rather than trapping per character.
+    while (len > 0)
+    {
+        const uint32_t n = len > 0x80000000u ? 0x80000000u : (uint32_t)len;
+        const uint64_t src = (uint64_t)(uintptr_t)s;
+
+        serial_bulk_outl(NEMU_SERIAL_BULK_SRC_LO, (uint32_t)src);
+        serial_bulk_outl(NEMU_SERIAL_BULK_SRC_HI, (uint32_t)(src >> 32));
+        serial_bulk_outl(NEMU_SERIAL_BULK_LEN, n);
+        serial_bulk_outl(NEMU_SERIAL_BULK_CMD, NEMU_SERIAL_BULK_CMD_WRITE);
+        s += n;
+        len -= n;
+    }
+}
+
 void halt(int code)
 {
     // nemu_trap() is the agreed exit path between AM guests and the emulator.
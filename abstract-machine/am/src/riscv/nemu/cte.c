@@ -1,6 +1,7 @@
 #include <am.h>
 #include <riscv/riscv.h>
 #include <klib.h>
+#include <nemu.h>
 
 static Context *(*user_handler)(Event, Context *) = NULL;
 
@@ -9,8 +10,19 @@ enum {
   NP_USER = 1,
 };
 
+/*
+ * RV64 NEMU built with CONFIG_HAS_CLINT has a CLINT and (optionally) a PLIC;
+ * scripts/riscv64-nemu.mk mirrors that option as NEMU_HAS_CLINT.  Without it,
+ * as on every RV32 NEMU, the CLINT MMIO window does not exist and NEMU raises
+ * its legacy host-alarm timer interrupt on its own.
+ */
+#if __riscv_xlen == 64 && defined(NEMU_HAS_CLINT)
+#define CTE_CLINT 1
+#endif
+
 #if __riscv_xlen == 64
 #define IRQ_TIMER ((uintptr_t)0x8000000000000007ull)
+#define IRQ_EXTERNAL ((uintptr_t)0x800000000000000bull)
 #elif __riscv_xlen == 32
 #define IRQ_TIMER ((uintptr_t)0x80000007u)
 #else
@@ -20,10 +32,50 @@ enum {
 #define CAUSE_ECALL_U 8u
 #define CAUSE_ECALL_S 9u
 #define CAUSE_ECALL_M 11u
+#define CAUSE_FETCH_PAGE_FAULT 12u
+#define CAUSE_LOAD_PAGE_FAULT  13u
+#define CAUSE_STORE_PAGE_FAULT 15u
 #define MSTATUS_MIE   ((uintptr_t)1u << 3)
 #define MSTATUS_MPIE  ((uintptr_t)1u << 7)
 #define MSTATUS_MPP_M ((uintptr_t)3u << 11)
 
+#ifdef CTE_CLINT
+/*
+ * With a CLINT the timer tick is the mtimecmp comparator of the current hart,
+ * re-armed on every tick; device interrupts are claimed from the hart's PLIC
+ * context and reported as EVENT_IRQ_IODEV with the source ID in ev.cause.  No
+ * PLIC source is enabled here: a driver that wants one sets its priority and
+ * enable bit itself.
+ */
+#define CTE_TIMER_HZ 60
+#define MIE_MTIE ((uintptr_t)1u << 7)
+#define MIE_MEIE ((uintptr_t)1u << 11)
+
+static uintptr_t hart_id() {
+  uintptr_t id;
+  asm volatile("csrr %0, mhartid" : "=r"(id));
+  return id;
+}
+
+static void timer_rearm() {
+  volatile uint64_t *mtime = (volatile uint64_t *)(CLINT_ADDR + NEMU_CLINT_MTIME);
+  volatile uint64_t *mtimecmp = (volatile uint64_t *)(CLINT_ADDR + NEMU_CLINT_MTIMECMP) + hart_id();
+  *mtimecmp = *mtime + NEMU_CLINT_TIMEBASE_HZ / CTE_TIMER_HZ;
+}
+
+static uintptr_t plic_claim_complete() {
+  uintptr_t claim = PLIC_ADDR + NEMU_PLIC_CONTEXT + hart_id() * NEMU_PLIC_CONTEXT_STRIDE + NEMU_PLIC_CLAIM;
+  uint32_t src = inl(claim);
+  /*
+   * Sources are level-triggered, so completing before the handler runs is
+   * safe: a device that is still asserting simply interrupts again once the
+   * handler returns with MIE restored.
+   */
+  if (src != 0) outl(claim, src);
+  return src;
+}
+#endif
+
 Context *__am_irq_handle(Context *c) {
   void __am_get_cur_as(Context *c);
   __am_get_cur_as(c);
@@ -33,6 +85,26 @@ Context *__am_irq_handle(Context *c) {
     switch (c->mcause) {
       case IRQ_TIMER:
         ev.event = EVENT_IRQ_TIMER;
+#ifdef CTE_CLINT
+        timer_rearm();
+#endif
+        break;
+#ifdef CTE_CLINT
+      case IRQ_EXTERNAL:
+        ev.event = EVENT_IRQ_IODEV;
+        ev.cause = plic_claim_complete();
+        break;
+#endif
+      case CAUSE_FETCH_PAGE_FAULT:
+      case CAUSE_LOAD_PAGE_FAULT:
+      case CAUSE_STORE_PAGE_FAULT:
+        /*
+         * mepc stays on the faulting instruction, so returning the same
+         * context retries it once the OS has mapped ev.ref.
+         */
+        ev.event = EVENT_PAGEFAULT;
+        ev.cause = c->mcause;
+        asm volatile("csrr %0, mtval" : "=r"(ev.ref));
         break;
       default: ev.event = EVENT_ERROR; break;
     }
@@ -65,6 +137,12 @@ bool cte_init(Context *(*handler)(Event, Context *)) {
   // register event handler
   user_handler = handler;
 
+#ifdef CTE_CLINT
+  // interrupts still need mstatus.MIE, which the OS turns on with iset()
+  timer_rearm();
+  asm volatile("csrs mie, %0" : : "r"(MIE_MTIE | MIE_MEIE));
+#endif
+
   return true;
 }
 
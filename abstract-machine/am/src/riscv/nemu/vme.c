@@ -92,7 +92,7 @@ bool vme_init(void *(*pgalloc_f)(int), void (*pgfree_f)(void *))
         void *va = segments[i].start;
         for (; va < segments[i].end; va += PGSIZE)
         {
-            map(&kas, va, va, 0);
+            map(&kas, va, va, MMAP_READ | MMAP_WRITE);
         }
     }
 
@@ -114,9 +114,44 @@ void protect(AddrSpace *as)
     memcpy(updir, kas.ptr, PGSIZE);
 }
 
+static void free_table(PTE *table, int level)
+{
+    // Leaf pages belong to the kernel that mapped them; only tables are freed.
+    for (int i = 0; level > 0 && i < (int)PTE_PER_PAGE; i++)
+    {
+        PTE pte = table[i];
+
+        if ((pte & PTE_V) != 0 && (pte & (PTE_R | PTE_W | PTE_X)) == 0)
+        {
+            free_table((PTE *)(((uintptr_t)pte >> PTE_PPN_SHIFT) << PAGE_SHIFT), level - 1);
+        }
+    }
+
+    pgfree_usr(table);
+}
+
 void unprotect(AddrSpace *as)
 {
-    (void)as;
+    PTE *updir = (PTE *)as->ptr;
+    const int root_shift = PAGE_SHIFT + (PT_LEVELS - 1) * VPN_BITS;
+    const uintptr_t first = (uintptr_t)as->area.start >> root_shift;
+    const uintptr_t last = ((uintptr_t)as->area.end - 1) >> root_shift;
+
+    // Root entries outside USER_SPACE were copied from kas and point at shared
+    // kernel tables; the ones inside it lead to tables private to this space.
+    for (uintptr_t vpn = first; vpn <= last; vpn++)
+    {
+        PTE pte = updir[vpn];
+
+        if ((pte & PTE_V) != 0)
+        {
+            assert((pte & (PTE_R | PTE_W | PTE_X)) == 0);
+            free_table((PTE *)(((uintptr_t)pte >> PTE_PPN_SHIFT) << PAGE_SHIFT), PT_LEVELS - 2);
+        }
+    }
+
+    pgfree_usr(updir);
+    as->ptr = NULL;
 }
 
 void __am_get_cur_as(Context *c)
@@ -146,8 +181,6 @@ void __am_switch(Context *c)
 
 void map(AddrSpace *as, void *va, void *pa, int prot)
 {
-    (void)prot;
-
     // ---- Basic sanity checks ----
     assert(as != NULL);
     assert(as->ptr != NULL);
@@ -218,10 +251,21 @@ void map(AddrSpace *as, void *va, void *pa, int prot)
     }
 
     // Build flags for leaf PTE.
-    // In PA, we do not implement fine-grained protection,
-    // so we can set R/W/X all to 1 to avoid permission faults.
-    // Also set A and D to 1, avoiding hardware A/D update complexity.
-    uintptr_t flags = PTE_V | PTE_R | PTE_W | PTE_X | PTE_A | PTE_D;
+    // AM has no execute permission, so every readable page is also executable.
+    // MMAP_WRITE alone still needs R: W without R is a reserved encoding, and
+    // MMAP_NONE leaves an invalid PTE behind.
+    // A and D are preset to 1, avoiding hardware A/D update complexity.
+    uintptr_t flags = 0;
+
+    if (prot & (MMAP_READ | MMAP_WRITE))
+    {
+        flags |= PTE_V | PTE_R | PTE_X | PTE_A | PTE_D;
+    }
+
+    if (prot & MMAP_WRITE)
+    {
+        flags |= PTE_W;
+    }
 
     // Mark user pages with U=1, kernel pages keep U=0.
     // User space is as->area, protect() sets it to USER_SPACE.
@@ -624,7 +624,11 @@ int vprintf(const char *fmt, va_list ap)
     static char buffer[PRINTF_BUFFER_SIZE];
 
     int ret = vsnprintf(buffer, PRINTF_BUFFER_SIZE, fmt, ap);
+#if defined(__PLATFORM_NEMU)
+    putnstr(buffer, strlen(buffer));
+#else
     putstr(buffer);
+#endif
     return ret;
 }
 
@@ -1,10 +1,12 @@
+# DISK=virtio backs AM_DISK_* with NEMU's virtio-blk device (CONFIG_HAS_VIRTIO_BLK).
 AM_SRCS := platform/nemu/trm.c \
            platform/nemu/ioe/ioe.c \
            platform/nemu/ioe/timer.c \
            platform/nemu/ioe/input.c \
+           platform/nemu/ioe/uart.c \
            platform/nemu/ioe/gpu.c \
            platform/nemu/ioe/audio.c \
-           platform/nemu/ioe/disk.c \
+           platform/nemu/ioe/$(if $(filter virtio,$(DISK)),virtio-blk.c,disk.c) \
            platform/nemu/mpe.c
 
 CFLAGS    += -fdata-sections -ffunction-sections
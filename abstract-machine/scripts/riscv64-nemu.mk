@@ -2,7 +2,13 @@ include $(AM_HOME)/scripts/isa/riscv.mk
 NEMU_DEFCONFIG ?= riscv64-am-headless_defconfig
 include $(AM_HOME)/scripts/platform/nemu.mk
 CFLAGS  += -DISA_H=\"riscv/riscv.h\"
-COMMON_CFLAGS += -march=rv64im_zicsr_zifencei -mabi=lp64  # overwrite
+# CLINT=1 drives the CTE timer from NEMU's CLINT, which needs CONFIG_HAS_CLINT
+# (native RV64 builds with devices have it by default).  CLINT=0 keeps NEMU's
+# legacy alarm tick.  The default follows $(NEMU_HOME)/.config when there is one.
+NEMU_DOTCONFIG := $(wildcard $(NEMU_HOME)/.config)
+CLINT ?= $(if $(NEMU_DOTCONFIG),$(if $(shell grep -s '^CONFIG_HAS_CLINT=y' $(NEMU_DOTCONFIG)),1,0),1)
+CFLAGS  += $(if $(filter 1,$(CLINT)),-DNEMU_HAS_CLINT)
+COMMON_CFLAGS += -march=rv64ima_zicsr_zifencei -mabi=lp64  # overwrite
 
 AM_SRCS += riscv/nemu/start.S \
            riscv/nemu/cte.c \
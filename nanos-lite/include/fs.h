@@ -3,6 +3,7 @@
 
 #include <common.h>
 #include <nanos_syscall_abi.h>
+#include <proc.h>
 
 #ifndef SEEK_SET
 enum
@@ -14,39 +15,87 @@ enum
 #endif
 
 /*
- * Open a special device file or a regular backend file.  pathname is always an
- * absolute Navy path for regular files; flags currently matter mainly for
- * truncate-on-open save-file handling.
+ * Open files are kernel handles numbered from 1.  Each one is shared by the
+ * process descriptors and kernel holders (a loaded image, an mmap() area) that
+ * refer to it, and keeps the offset they all move.  The calls taking a file
+ * below fail with -1 when it is not open, so a descriptor that fs_fd_file()
+ * could not resolve may be passed on unchecked.
+ */
+
+/*
+ * Open a special device file or a regular backend file and return the new open
+ * file, holding one reference, or -1.  pathname is always an absolute Navy path
+ * for regular files; flags currently matter mainly for truncate-on-open
+ * save-file handling.
  */
 int fs_open(const char *pathname, int flags, int mode);
 
-/* Read from the descriptor's current offset and advance that offset on success. */
-size_t fs_read(int fd, void *buf, size_t len);
+/* Read from the file's current offset and advance that offset on success. */
+size_t fs_read(int file, void *buf, size_t len);
 
-/* Write at the descriptor's current offset and advance it by the accepted count. */
-size_t fs_write(int fd, const void *buf, size_t len);
+/* Write at the file's current offset and advance it by the accepted count. */
+size_t fs_write(int file, const void *buf, size_t len);
 
 /*
- * Reposition a descriptor using SEEK_SET, SEEK_CUR, or SEEK_END.  Regular files
+ * Reposition a file using SEEK_SET, SEEK_CUR, or SEEK_END.  Regular files
  * delegate bound checks to the selected backend; special files use their table
  * size, for example the framebuffer byte length.
  */
-size_t fs_lseek(int fd, size_t offset, int whence);
+size_t fs_lseek(int file, size_t offset, int whence);
+
+/* Drop one reference to an open file; the last one closes it. */
+int fs_close(int file);
 
-/* Release a regular descriptor slot.  Special descriptors are stable and no-op. */
-int fs_close(int fd);
+/*
+ * Open the regular file or directory behind an open file again, with its own
+ * offset, and return the new open file or -1.  Unlike a shared reference the
+ * two do not share state.
+ */
+int fs_reopen(int file);
+
+/*
+ * Like fs_reopen(), but the new file is read-only, and -1 unless file is an
+ * open, readable regular file.  mmap() reads file pages through such a handle
+ * long after the caller closed its own descriptor.
+ */
+int fs_reopen_readonly(int file);
+
+/*
+ * Per-process descriptor tables.  pcb->fds[fd] holds one reference to the
+ * open file behind fd; fork() copies the table, so parent and child share
+ * those files and their offsets, but closing a descriptor only drops the
+ * caller's reference.
+ */
+/* Give file the lowest free descriptor of pcb and return it, or -1 if none is free. */
+int fs_fd_install(PCB *pcb, int file);
+/* The open file behind fd, or -1 if pcb has no such descriptor. */
+int fs_fd_file(const PCB *pcb, int fd);
+/* Free a descriptor and drop its reference; -1 if fd is not open. */
+int fs_fd_close(PCB *pcb, int fd);
+/* Open the console as descriptors 0, 1 and 2 of a process with none yet. */
+void fs_fd_stdio(PCB *pcb);
+/* Give child a copy of the parent's table, taking a reference for every entry. */
+void fs_fd_fork(PCB *child, const PCB *parent);
+/* Close every descriptor of a process that is going away. */
+void fs_fd_release(PCB *pcb);
 
 /* Fill project-owned syscall metadata for a pathname. */
 int fs_stat(const char *pathname, NanosStat *buf);
 
-/* Fill project-owned syscall metadata for an open descriptor. */
-int fs_fstat(int fd, NanosStat *buf);
+/* Fill project-owned syscall metadata for an open file. */
+int fs_fstat(int file, NanosStat *buf);
 
 /* Return fixed-size NanosDirent syscall records for an open directory. */
-int fs_getdents(int fd, void *buf, int len);
+int fs_getdents(int file, void *buf, int len);
 
 /* Resize an open regular file. */
-int fs_ftruncate(int fd, size_t size);
+int fs_ftruncate(int file, size_t size);
+
+/*
+ * Write cached disk blocks back.  The cache is shared by every file, so this
+ * flushes all of it; file -1 is the whole-system sync().
+ */
+int fs_fsync(int file);
 
 /* Resize a regular file by pathname. */
 int fs_truncate(const char *pathname, size_t size);
@@ -12,5 +12,19 @@
 #define PG_ALIGN __attribute((aligned(PGSIZE)))
 
 void *new_page(size_t);
+// Like new_page(), but NULL instead of a panic when memory runs out.
+void *try_new_page(size_t);
+void free_page(void *);
+
+/*
+ * Hand a dead address space to the allocator.  mm_retire() only queues it;
+ * mm_reap() frees every queued space whose root is not active_pdir, the page
+ * table the current trap came from.
+ */
+void mm_retire(AddrSpace *as);
+void mm_reap(void *active_pdir);
+
+/* Build child as a copy-on-write copy of parent's user pages. */
+void mm_fork(AddrSpace *child, AddrSpace *parent);
 
 #endif
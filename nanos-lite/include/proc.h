@@ -6,14 +6,69 @@
 
 #define STACK_SIZE (8 * PGSIZE)
 
+/*
+ * Processes are allocated on demand, but each belongs to one of these slots:
+ * the three foreground apps switched with F1-F3 and the optional background
+ * slot.  A forked child joins its parent's slot.
+ */
 enum
 {
-    MAX_NR_PROC = 4,
+    NR_PROC_SLOTS = 4,
     NR_FOREGROUND_PROC = 3,
     HELLO_PROC = 3,
 };
 
-typedef union
+enum
+{
+    MAX_IMAGE_SEGMENTS = 8,
+};
+
+/*
+ * One PT_LOAD segment of a demand-paged image: bytes [vaddr, file_end) come
+ * from the executable at offset, the rest up to mem_end read as zero.  Pages
+ * are filled by the page-fault handler the first time they are touched.
+ */
+typedef struct
+{
+    uintptr_t vaddr;
+    uintptr_t file_end;
+    uintptr_t mem_end;
+    size_t offset;
+    // Read-only pages are shared through the page cache.
+    bool writable;
+} ImageSegment;
+
+enum
+{
+    MAX_MMAP_AREAS = 16,
+    MAX_FDS = 64,
+};
+
+/*
+ * One mmap() area covering the whole pages [start, end).  A file area reads
+ * through its own handle fd from offset on, with bytes past file_size reading
+ * as zero; an anonymous area has fd -1 and is all zeros.  Like image pages,
+ * its pages are filled by the page-fault handler on first touch.
+ */
+typedef struct
+{
+    uintptr_t start;
+    uintptr_t end;
+    int prot;
+    int fd;
+    // File identity, the page cache key, and the file size at mmap() time.
+    uint64_t file_id;
+    size_t file_size;
+    size_t offset;
+} MmapArea;
+
+/* Processes sleeping until a device has something for them, in arrival order. */
+typedef struct
+{
+    union pcb_u *head;
+} WaitQueue;
+
+typedef union pcb_u
 {
     /*
      * The union gives each PCB one page-aligned kernel stack and lets the process
@@ -26,14 +81,97 @@ typedef union
     {
         Context *cp;
         AddrSpace as;
-        // we do not free memory, so use `max_brk' to determine when to call _map()
+        // Current program break; heap pages are mapped up to ROUNDUP(max_brk).
         uintptr_t max_brk;
+        // End of the loaded image, the lowest break brk() accepts.
+        uintptr_t brk_start;
+        // Executable kept open for demand paging; valid while nr_segments > 0.
+        int image_fd;
+        // File identity of the executable, the page cache key.
+        uint64_t image_id;
+        int nr_segments;
+        ImageSegment segments[MAX_IMAGE_SEGMENTS];
+        int nr_mmaps;
+        MmapArea mmaps[MAX_MMAP_AREAS];
+        // Open file behind each descriptor, 0 for a free one; see fs_fd_install().
+        int fds[MAX_FDS];
+        int pid;
+        int slot;
+        // Next PCB on the process list or the list of exited ones.
+        union pcb_u *next;
+        // PROC_READY or PROC_BLOCKED; a blocked process is linked on one WaitQueue.
+        int state;
+        union pcb_u *wait_next;
+        // Set by proc_wakeup() for the restarted syscall, see proc_block().
+        // proc_forbid_block() sets it too.
+        bool woken;
+        // Timer ticks left before schedule() may hand the CPU to a peer.
+        int slice;
+        // Traps taken and the kernel time they cost, for /proc/<pid>/stat.
+        uint64_t nr_syscalls;
+        uint64_t nr_faults;
+        uint64_t kernel_instrs;
+        uint64_t kernel_us;
     };
 } PCB;
 
+enum
+{
+    PROC_READY = 0,
+    PROC_BLOCKED = 1,
+};
+
 extern PCB *current;
 
 bool switch_fg_pcb(int index);
+/*
+ * Terminate the current process and give its memory back.  Halts the machine
+ * when no foreground process is left; otherwise the caller must reschedule.
+ */
+void proc_exit(int status);
+/*
+ * Duplicate the current process; c is its syscall frame.  The child resumes
+ * from the same point with 0 in the return register.  Returns the child's pid,
+ * or -1 if the image could not be reopened.
+ */
+int proc_fork(const Context *c);
+/* Free the PCBs of processes that exited in earlier traps. */
+void proc_reap(void);
+/* Charge the running process for one timer tick. */
+void proc_tick(void);
+/* Give up the rest of the current time slice. */
+void proc_yield(void);
+
+/*
+ * Blocking device I/O.  A syscall that finds nothing to do calls proc_block()
+ * and returns; do_syscall() sees proc_syscall_blocked() and backs the caller up
+ * to its ecall, so the call runs again once proc_wakeup() makes it ready.
+ * proc_block() returns false on that second run: every call sleeps at most
+ * once and then completes with whatever is there, possibly nothing.
+ */
+bool proc_block(WaitQueue *wq);
+void proc_wakeup(WaitQueue *wq);
+bool proc_syscall_blocked(void);
+/*
+ * For the rest of the current syscall proc_block() returns false.  A call that
+ * has already moved data must return that progress, not restart and repeat it.
+ */
+void proc_forbid_block(void);
+
+/*
+ * Profiling.  proc_account_trap() charges a trap taken while pcb ran to it.
+ * proc_stat_render() writes the text of /proc/<pid>/stat for pid into text and
+ * returns its length, 0 once the process is gone; proc_pid_live() tells
+ * whether it still runs.
+ */
+enum
+{
+    PROC_STAT_TEXT_SIZE = 256,
+};
+
+void proc_account_trap(PCB *pcb, bool syscall, bool fault, uint64_t instrs, uint64_t us);
+bool proc_pid_live(int pid);
+size_t proc_stat_render(int pid, char text[PROC_STAT_TEXT_SIZE]);
 
 /*
  * Device code sometimes needs to attribute a shared device operation to the
@@ -44,4 +182,44 @@ bool switch_fg_pcb(int index);
 int current_pcb_index(void);
 int foreground_pcb_index(void);
 
+/*
+ * Demand paging for loaded images.  loader_page_fault() maps the image page
+ * holding vaddr and returns false if vaddr is not part of a not-yet-loaded
+ * segment.  Syscalls call the populate helpers on user pointers before the
+ * kernel touches them, because a fault taken in the kernel cannot be resumed.
+ */
+bool loader_page_fault(PCB *pcb, uintptr_t vaddr);
+void loader_populate(PCB *pcb, const void *buf, size_t len);
+void loader_populate_string(PCB *pcb, const char *str);
+/* Close the image of a PCB whose address space is going away. */
+void loader_release(PCB *pcb);
+/* Give the child of a fork its own handle on the parent's image; false on failure. */
+bool loader_fork(PCB *child, const PCB *parent);
+
+/*
+ * Copy-on-write faults.  mm_cow_fault() gives pcb a private writable copy of
+ * the page holding vaddr and returns false if that page is not shared.
+ * mm_unshare() does the same ahead of time for a buffer the kernel will write.
+ */
+bool mm_cow_fault(PCB *pcb, uintptr_t vaddr);
+void mm_unshare(PCB *pcb, const void *buf, size_t len);
+
+/*
+ * mmap() and munmap().  Anonymous areas are private to the process; file areas
+ * are read-only or private, never written back, and their pages come from the
+ * page cache so every process mapping a file shares one copy until it writes.
+ * mm_mmap() maps the open file file (see fs.h), not a descriptor, and returns
+ * the start of the new area; mm_munmap() returns 0.  Both fail with -1.
+ */
+uintptr_t mm_mmap(PCB *pcb, uintptr_t addr, size_t len, int prot, int flags, int file, size_t offset);
+int mm_munmap(PCB *pcb, uintptr_t addr, size_t len);
+/* Map the page holding vaddr if it belongs to an mmap() area and is not mapped yet. */
+bool mm_mmap_fault(PCB *pcb, uintptr_t vaddr);
+/* Whether any mmap() area overlaps [start, end); brk() must not grow into one. */
+bool mm_mmap_overlaps(const PCB *pcb, uintptr_t start, uintptr_t end);
+/* Give the child of a fork its own handles on the parent's areas; false on failure. */
+bool mm_mmap_fork(PCB *child, const PCB *parent);
+/* Forget the areas of a PCB whose address space is going away. */
+void mm_mmap_release(PCB *pcb);
+
 #endif
@@ -0,0 +1,513 @@
+#include "bcache.h"
+
+#if defined(__ISA__)
+#include <klib.h>
+#else
+#include <assert.h>
+#include <string.h>
+#endif
+
+/*
+ * Kernel buffer cache for the disk.  Every disk_read()/disk_write() byte range,
+ * whether file data, FAT sectors, or directory entries, goes through these
+ * fixed-size blocks, so re-reading an asset or re-scanning a directory costs a
+ * memcpy instead of an emulated device command.  Writes stay in the cache until
+ * bcache_sync(), an eviction, or too many dirty blocks force them out.
+ */
+
+#ifndef BCACHE_NR_BLOCKS
+#define BCACHE_NR_BLOCKS 512
+#endif
+#define BCACHE_HASH_SIZE 256u
+#define BCACHE_READAHEAD_MIN 4u
+#define BCACHE_READAHEAD_MAX 32u
+#define BCACHE_DIRTY_LIMIT (BCACHE_NR_BLOCKS / 2)
+/*
+ * Shortest uncached run handed to read_direct().  Below this a bulk read is
+ * as cheap through the bounce buffer, and the blocks may well be wanted again.
+ */
+#ifndef BCACHE_DIRECT_MIN
+#define BCACHE_DIRECT_MIN 32u
+#endif
+#define BCACHE_NONE (-1)
+
+typedef struct
+{
+    size_t blkno;
+    int hash_next;
+    /* LRU neighbours: prev is more recently used, next less recently used. */
+    int lru_prev;
+    int lru_next;
+    bool valid;
+    bool dirty;
+} BcacheEntry;
+
+static BcacheDevice dev;
+static BcacheEntry entries[BCACHE_NR_BLOCKS];
+static uint8_t blocks[BCACHE_NR_BLOCKS][BCACHE_BLOCK_SIZE] __attribute__((aligned(4)));
+static int hash_heads[BCACHE_HASH_SIZE];
+static int lru_head = BCACHE_NONE;
+static int lru_tail = BCACHE_NONE;
+static size_t nr_dirty = 0;
+/*
+ * Sequential read detection.  A read starting in the block where the previous
+ * one ended, or the block after it, grows the read-ahead window; anything else
+ * drops it back to zero.
+ */
+static size_t ra_next = SIZE_MAX;
+static size_t ra_window = 0;
+static BcacheStats stats;
+
+static size_t min_size(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+static size_t block_count(void)
+{
+    return (dev.size + BCACHE_BLOCK_SIZE - 1) / BCACHE_BLOCK_SIZE;
+}
+
+/* Bytes of the device covered by a block; only the last block can be short. */
+static size_t block_len(size_t blkno)
+{
+    return min_size(BCACHE_BLOCK_SIZE, dev.size - blkno * BCACHE_BLOCK_SIZE);
+}
+
+/* Longest run moved by one device command, bounded so a fill never evicts itself. */
+static size_t run_limit(void)
+{
+    return min_size(dev.bounce_size / BCACHE_BLOCK_SIZE, BCACHE_NR_BLOCKS / 2);
+}
+
+static size_t hash_of(size_t blkno)
+{
+    return blkno & (BCACHE_HASH_SIZE - 1);
+}
+
+static int lookup(size_t blkno)
+{
+    for (int i = hash_heads[hash_of(blkno)]; i != BCACHE_NONE; i = entries[i].hash_next)
+    {
+        if (entries[i].blkno == blkno)
+        {
+            return i;
+        }
+    }
+
+    return BCACHE_NONE;
+}
+
+static void hash_insert(int idx)
+{
+    const size_t bucket = hash_of(entries[idx].blkno);
+
+    entries[idx].hash_next = hash_heads[bucket];
+    hash_heads[bucket] = idx;
+}
+
+static void hash_remove(int idx)
+{
+    int *link = &hash_heads[hash_of(entries[idx].blkno)];
+
+    while (*link != idx)
+    {
+        assert(*link != BCACHE_NONE);
+        link = &entries[*link].hash_next;
+    }
+
+    *link = entries[idx].hash_next;
+}
+
+static void lru_unlink(int idx)
+{
+    BcacheEntry *e = &entries[idx];
+
+    if (e->lru_prev != BCACHE_NONE)
+    {
+        entries[e->lru_prev].lru_next = e->lru_next;
+    }
+    else
+    {
+        lru_head = e->lru_next;
+    }
+
+    if (e->lru_next != BCACHE_NONE)
+    {
+        entries[e->lru_next].lru_prev = e->lru_prev;
+    }
+    else
+    {
+        lru_tail = e->lru_prev;
+    }
+}
+
+static void lru_push_front(int idx)
+{
+    entries[idx].lru_prev = BCACHE_NONE;
+    entries[idx].lru_next = lru_head;
+
+    if (lru_head != BCACHE_NONE)
+    {
+        entries[lru_head].lru_prev = idx;
+    }
+
+    lru_head = idx;
+
+    if (lru_tail == BCACHE_NONE)
+    {
+        lru_tail = idx;
+    }
+}
+
+static void touch(int idx)
+{
+    if (lru_head != idx)
+    {
+        lru_unlink(idx);
+        lru_push_front(idx);
+    }
+}
+
+static void mark_dirty(int idx)
+{
+    if (!entries[idx].dirty)
+    {
+        entries[idx].dirty = true;
+        nr_dirty++;
+    }
+}
+
+static void mark_clean(int idx)
+{
+    if (entries[idx].dirty)
+    {
+        entries[idx].dirty = false;
+        nr_dirty--;
+    }
+}
+
+static void write_back(int idx)
+{
+    const size_t blkno = entries[idx].blkno;
+
+    dev.io(true, blocks[idx], blkno * BCACHE_BLOCK_SIZE, block_len(blkno));
+    stats.device_writes++;
+    mark_clean(idx);
+}
+
+/*
+ * Recycle the least recently used block for blkno.  The caller fills its data
+ * before anything else can look it up.
+ */
+static int alloc_block(size_t blkno)
+{
+    const int idx = lru_tail;
+    BcacheEntry *e = &entries[idx];
+
+    assert(idx != BCACHE_NONE);
+
+    if (e->valid)
+    {
+        if (e->dirty)
+        {
+            write_back(idx);
+        }
+
+        hash_remove(idx);
+    }
+
+    e->blkno = blkno;
+    e->valid = true;
+    e->dirty = false;
+    hash_insert(idx);
+    touch(idx);
+    return idx;
+}
+
+/*
+ * Read count uncached blocks starting at first.  A single block is read
+ * straight into its cache slot; longer runs share one device command through
+ * the bounce buffer because recycled slots are not contiguous.
+ */
+static void fill_run(size_t first, size_t count)
+{
+    const size_t offset = first * BCACHE_BLOCK_SIZE;
+
+    stats.device_reads++;
+
+    if (count == 1)
+    {
+        const int idx = alloc_block(first);
+        dev.io(false, blocks[idx], offset, block_len(first));
+        return;
+    }
+
+    const size_t len = min_size(count * BCACHE_BLOCK_SIZE, dev.size - offset);
+    dev.io(false, dev.bounce, offset, len);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const int idx = alloc_block(first + i);
+        memcpy(blocks[idx], dev.bounce + i * BCACHE_BLOCK_SIZE, block_len(first + i));
+    }
+}
+
+/*
+ * Try to read the uncached blocks from blkno on that [blkno, end) covers
+ * completely straight into out.  Returns the number of blocks read, 0 when the
+ * run is too short or the device declined.  These blocks are not cached: a
+ * read this large is a bulk load that would only flush the working set.
+ */
+static size_t read_direct_run(uint8_t *out, size_t blkno, size_t end)
+{
+    if (dev.read_direct == NULL)
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+
+    while (blkno + count < end && lookup(blkno + count) == BCACHE_NONE)
+    {
+        count++;
+    }
+
+    if (count < BCACHE_DIRECT_MIN)
+    {
+        return 0;
+    }
+
+    const size_t offset = blkno * BCACHE_BLOCK_SIZE;
+    const size_t len = min_size(count * BCACHE_BLOCK_SIZE, dev.size - offset);
+
+    if (!dev.read_direct(out, offset, len))
+    {
+        return 0;
+    }
+
+    stats.device_reads++;
+    stats.direct_blocks += count;
+    return count;
+}
+
+/*
+ * Return the slot holding blkno.  A miss also fetches the uncached blocks after
+ * it up to readahead_end in the same command; those from want_end on are
+ * read-ahead beyond what the caller asked for.
+ */
+static int get_block(size_t blkno, size_t want_end, size_t readahead_end)
+{
+    int idx = lookup(blkno);
+
+    if (idx != BCACHE_NONE)
+    {
+        stats.hits++;
+        return idx;
+    }
+
+    size_t count = 1;
+    const size_t end = min_size(readahead_end, block_count());
+    const size_t limit = run_limit();
+
+    while (blkno + count < end && count < limit && lookup(blkno + count) == BCACHE_NONE)
+    {
+        count++;
+    }
+
+    if (blkno + count > want_end)
+    {
+        stats.readahead_blocks += blkno + count - want_end;
+    }
+
+    stats.misses++;
+    fill_run(blkno, count);
+    idx = lookup(blkno);
+    assert(idx != BCACHE_NONE);
+    return idx;
+}
+
+size_t bcache_read(void *buf, size_t offset, size_t len)
+{
+    assert(offset <= dev.size && len <= dev.size - offset);
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    uint8_t *out = (uint8_t *)buf;
+    const size_t first = offset / BCACHE_BLOCK_SIZE;
+    const size_t last = (offset + len - 1) / BCACHE_BLOCK_SIZE;
+
+    if (first == ra_next || first + 1 == ra_next)
+    {
+        ra_window = ra_window == 0 ? BCACHE_READAHEAD_MIN : min_size(ra_window * 2, BCACHE_READAHEAD_MAX);
+    }
+    else
+    {
+        ra_window = 0;
+    }
+
+    size_t done = 0;
+    /* Blocks from first_whole up to whole_end lie entirely inside the request. */
+    const size_t first_whole = offset % BCACHE_BLOCK_SIZE == 0 ? first : first + 1;
+    const size_t whole_end = offset + len == dev.size ? last + 1 : (offset + len) / BCACHE_BLOCK_SIZE;
+
+    for (size_t blkno = first; blkno <= last; blkno++)
+    {
+        if (blkno >= first_whole && blkno < whole_end)
+        {
+            const size_t direct = read_direct_run(out + done, blkno, whole_end);
+
+            if (direct > 0)
+            {
+                done += min_size(direct * BCACHE_BLOCK_SIZE, dev.size - blkno * BCACHE_BLOCK_SIZE);
+                blkno += direct - 1;
+                continue;
+            }
+        }
+
+        const int idx = get_block(blkno, last + 1, last + 1 + ra_window);
+        const size_t blkoff = blkno == first ? offset % BCACHE_BLOCK_SIZE : 0;
+        const size_t chunk = min_size(len - done, block_len(blkno) - blkoff);
+
+        memcpy(out + done, blocks[idx] + blkoff, chunk);
+        done += chunk;
+    }
+
+    ra_next = last + 1;
+    return len;
+}
+
+size_t bcache_write(const void *buf, size_t offset, size_t len)
+{
+    assert(offset <= dev.size && len <= dev.size - offset);
+
+    const uint8_t *in = (const uint8_t *)buf;
+    size_t done = 0;
+
+    while (done < len)
+    {
+        const size_t cur = offset + done;
+        const size_t blkno = cur / BCACHE_BLOCK_SIZE;
+        const size_t blkoff = cur % BCACHE_BLOCK_SIZE;
+        const size_t chunk = min_size(len - done, block_len(blkno) - blkoff);
+        int idx = lookup(blkno);
+
+        if (idx == BCACHE_NONE && blkoff == 0 && chunk == block_len(blkno))
+        {
+            // The whole block is overwritten, so there is nothing to read first.
+            stats.misses++;
+            idx = alloc_block(blkno);
+        }
+        else
+        {
+            idx = get_block(blkno, blkno + 1, blkno + 1);
+        }
+
+        memcpy(blocks[idx] + blkoff, in + done, chunk);
+        mark_dirty(idx);
+        done += chunk;
+    }
+
+    if (nr_dirty > BCACHE_DIRTY_LIMIT)
+    {
+        bcache_sync();
+    }
+
+    return len;
+}
+
+void bcache_sync(void)
+{
+    static int order[BCACHE_NR_BLOCKS];
+    size_t n = 0;
+
+    // Sort dirty blocks by number so neighbours leave in one device command.
+    for (int i = 0; i < BCACHE_NR_BLOCKS; i++)
+    {
+        if (!entries[i].dirty)
+        {
+            continue;
+        }
+
+        size_t pos = n++;
+
+        while (pos > 0 && entries[order[pos - 1]].blkno > entries[i].blkno)
+        {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+
+        order[pos] = i;
+    }
+
+    const size_t limit = run_limit();
+
+    for (size_t i = 0; i < n;)
+    {
+        size_t count = 1;
+
+        while (i + count < n && count < limit &&
+               entries[order[i + count]].blkno == entries[order[i]].blkno + count)
+        {
+            count++;
+        }
+
+        if (count == 1)
+        {
+            write_back(order[i]);
+            i++;
+            continue;
+        }
+
+        const size_t first = entries[order[i]].blkno;
+        const size_t offset = first * BCACHE_BLOCK_SIZE;
+
+        for (size_t j = 0; j < count; j++)
+        {
+            memcpy(dev.bounce + j * BCACHE_BLOCK_SIZE, blocks[order[i + j]], block_len(first + j));
+            mark_clean(order[i + j]);
+        }
+
+        dev.io(true, dev.bounce, offset, min_size(count * BCACHE_BLOCK_SIZE, dev.size - offset));
+        stats.device_writes++;
+        i += count;
+    }
+
+    assert(nr_dirty == 0);
+}
+
+void bcache_get_stats(BcacheStats *out)
+{
+    *out = stats;
+}
+
+void bcache_init(const BcacheDevice *device)
+{
+    assert(device->blksz > 0 && BCACHE_BLOCK_SIZE % device->blksz == 0);
+    assert(device->size % device->blksz == 0);
+    assert(device->bounce_size >= BCACHE_BLOCK_SIZE);
+
+    dev = *device;
+    lru_head = BCACHE_NONE;
+    lru_tail = BCACHE_NONE;
+    nr_dirty = 0;
+    ra_next = SIZE_MAX;
+    ra_window = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    for (size_t i = 0; i < BCACHE_HASH_SIZE; i++)
+    {
+        hash_heads[i] = BCACHE_NONE;
+    }
+
+    for (int i = 0; i < BCACHE_NR_BLOCKS; i++)
+    {
+        entries[i].valid = false;
+        entries[i].dirty = false;
+        entries[i].hash_next = BCACHE_NONE;
+        lru_push_front(i);
+    }
+}
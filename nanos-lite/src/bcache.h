@@ -0,0 +1,49 @@
+#ifndef NANOS_BCACHE_H__
+#define NANOS_BCACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bytes per cache block; every cached range starts on this boundary. */
+#define BCACHE_BLOCK_SIZE 4096u
+
+/*
+ * Block device under the cache.  io() moves whole cache blocks: offset is a
+ * multiple of BCACHE_BLOCK_SIZE and len is a multiple of blksz, clipped at the
+ * end of the device.  buf is either one cache block or the bounce buffer, so a
+ * device that needs physical addresses can be handed either directly.
+ *
+ * read_direct() is optional.  Long uncached runs that a read covers completely
+ * are handed to it with the caller's buffer instead of passing through cache
+ * blocks; offset is block aligned and len a multiple of blksz.  Returning false
+ * falls back to the cached path.
+ */
+typedef struct
+{
+    size_t size;
+    size_t blksz;
+    uint8_t *bounce;
+    size_t bounce_size;
+    void (*io)(bool write, void *buf, size_t offset, size_t len);
+    bool (*read_direct)(void *buf, size_t offset, size_t len);
+} BcacheDevice;
+
+typedef struct
+{
+    size_t hits;
+    size_t misses;
+    size_t readahead_blocks;
+    size_t device_reads;
+    size_t device_writes;
+    size_t direct_blocks;
+} BcacheStats;
+
+void bcache_init(const BcacheDevice *dev);
+size_t bcache_read(void *buf, size_t offset, size_t len);
+size_t bcache_write(const void *buf, size_t offset, size_t len);
+/* Write every dirty block back to the device. */
+void bcache_sync(void);
+void bcache_get_stats(BcacheStats *stats);
+
+#endif
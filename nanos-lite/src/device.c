@@ -10,6 +10,9 @@
 #include <nemu.h>
 #undef NEMU_PLATFORM_CONSTANTS_ONLY
 #define NEMU_LAZY_FB_CAPTURE 1
+#define NEMU_GPU_CMDQ 1
+#define NEMU_AUDIO_MIXER 1
+#define NEMU_SERIAL_BULK 1
 #define VGACTL_REG_ADDR(reg) (VGACTL_ADDR + (reg) * sizeof(uint32_t))
 
 static inline void fb_mmio_outl(uintptr_t addr, uint32_t data)
@@ -18,6 +21,9 @@ static inline void fb_mmio_outl(uintptr_t addr, uint32_t data)
 }
 #else
 #define NEMU_LAZY_FB_CAPTURE 0
+#define NEMU_GPU_CMDQ 0
+#define NEMU_AUDIO_MIXER 0
+#define NEMU_SERIAL_BULK 0
 #endif
 
 #if defined(MULTIPROGRAM) && !defined(TIME_SHARING)
@@ -26,6 +32,52 @@ static inline void fb_mmio_outl(uintptr_t addr, uint32_t data)
 #define MULTIPROGRAM_YIELD()
 #endif
 
+#if defined(__ARCH_RISCV64_NEMU)
+/*
+ * Wait queues are paired with PLIC sources on RV64 NEMU.  The lines are
+ * level-triggered: keyboard and mouse stay high while their FIFOs hold events,
+ * audio while the stream is at most a quarter full.  A source is therefore
+ * enabled only while someone sleeps on it, and the interrupt that wakes the
+ * sleepers masks it again.  Nanos runs on hart 0, i.e. PLIC context 0.
+ */
+#define NEMU_DEVICE_IRQ 1
+
+static uint32_t irq_enabled = 0;
+static WaitQueue event_wait = {};
+static WaitQueue audio_wait = {};
+
+static inline void plic_outl(uintptr_t offset, uint32_t data)
+{
+    *(volatile uint32_t *)(PLIC_ADDR + offset) = data;
+}
+
+static void irq_source_enable(int source, bool enable)
+{
+    if (enable)
+    {
+        irq_enabled |= 1u << source;
+    }
+    else
+    {
+        irq_enabled &= ~(1u << source);
+    }
+
+    plic_outl(NEMU_PLIC_ENABLE, irq_enabled);
+}
+
+static void init_device_irq(void)
+{
+    static const int sources[] = {NEMU_IRQ_KEYBOARD, NEMU_IRQ_MOUSE, NEMU_IRQ_AUDIO};
+
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        plic_outl(NEMU_PLIC_PRIORITY + sources[i] * sizeof(uint32_t), 1);
+    }
+}
+#else
+#define NEMU_DEVICE_IRQ 0
+#endif
+
 #define NAME(key) \
     [AM_KEY_##key] = #key,
 
@@ -417,13 +469,69 @@ static size_t read_mouse_event(void *buf, size_t len)
     return copy_event_record(buf, len, event, event_len);
 }
 
+/*
+ * /dev/stdin reads the serial RX side.  A read blocks until at least one byte
+ * is there and returns early at a newline, so line-oriented REPLs see each line
+ * as soon as it arrives.  EOT (^D, or the break AM reports once the host input
+ * ends) at the start of a read is end of file, as on a terminal.
+ */
+size_t stdin_read(void *buf, size_t offset, size_t len)
+{
+    static int uart_present = -1;
+    char *out = (char *)buf;
+    size_t n = 0;
+
+    if (uart_present < 0)
+    {
+        uart_present = io_read(AM_UART_CONFIG).present;
+    }
+
+    while (uart_present && n < len)
+    {
+        // Check for -1 before narrowing, or a 0xff byte reads as "nothing waiting".
+        const int data = io_read(AM_UART_RX).data;
+
+        if (data == -1)
+        {
+            if (n > 0)
+            {
+                break;
+            }
+
+            MULTIPROGRAM_YIELD();
+            continue;
+        }
+
+        const char ch = (char)data;
+
+        if (ch == 0x04)
+        {
+            break;
+        }
+
+        out[n++] = ch;
+
+        if (ch == '\n')
+        {
+            break;
+        }
+    }
+
+    return n;
+}
+
 size_t serial_write(const void *buf, size_t offset, size_t len)
 {
     const char *buff = (const char *)buf;
+#if NEMU_SERIAL_BULK
+    // NEMU reads the user buffer itself, so a whole write() is one MMIO request.
+    putnstr(buff, len);
+#else
     for (size_t i = 0; i < len; i++)
     {
         putch(buff[i]);
     }
+#endif
 
     return len;
 }
@@ -459,6 +567,52 @@ size_t events_read(void *buf, size_t offset, size_t len)
     return n;
 }
 
+/*
+ * The blocking flavour of /dev/events behind SDL_WaitEvent(): with no record
+ * pending the reader sleeps until the keyboard or mouse interrupts.  Without
+ * device interrupts it polls exactly like /dev/events.
+ */
+size_t events_wait_read(void *buf, size_t offset, size_t len)
+{
+    const size_t n = events_read(buf, offset, len);
+
+#if NEMU_DEVICE_IRQ
+    if (n == 0 && proc_block(&event_wait))
+    {
+        irq_source_enable(NEMU_IRQ_KEYBOARD, true);
+        irq_source_enable(NEMU_IRQ_MOUSE, true);
+    }
+#endif
+
+    return n;
+}
+
+/* Called for each claimed PLIC source; wakes the processes waiting on it. */
+void device_irq(int source)
+{
+#if NEMU_DEVICE_IRQ
+    switch (source)
+    {
+    case NEMU_IRQ_KEYBOARD:
+    case NEMU_IRQ_MOUSE:
+        irq_source_enable(NEMU_IRQ_KEYBOARD, false);
+        irq_source_enable(NEMU_IRQ_MOUSE, false);
+        proc_wakeup(&event_wait);
+        break;
+
+    case NEMU_IRQ_AUDIO:
+        irq_source_enable(NEMU_IRQ_AUDIO, false);
+        proc_wakeup(&audio_wait);
+        break;
+
+    default:
+        break;
+    }
+#else
+    (void)source;
+#endif
+}
+
 size_t dispinfo_read(void *buf, size_t offset, size_t len)
 {
     /* /proc/dispinfo is regenerated on every read from the current AM GPU
@@ -561,7 +715,252 @@ size_t fb_write(const void *buf, size_t offset, size_t len)
     return len;
 }
 
-// Semantics: write `len` bytes starting at (uint8_t*)buf + offset, block until all bytes are queued.
+#if NEMU_GPU_CMDQ
+static bool gpu_fb_rect_ok(int x, int y, int w, int h)
+{
+    return x + w <= fb_screen_w && y + h <= fb_screen_h;
+}
+
+/*
+ * Bytes [*start, *start + *len) of a surface that a w x h rectangle at (x, y)
+ * touches; false for an empty rectangle.
+ */
+static bool gpu_surface_span(uint64_t base, uint32_t pitch, uint32_t bpp, int x, int y, int w, int h,
+                             uintptr_t *start, size_t *len)
+{
+    if (w <= 0 || h <= 0)
+    {
+        return false;
+    }
+
+    *start = (uintptr_t)(base + (uint64_t)y * pitch + (uint64_t)x * bpp);
+    *len = (size_t)(h - 1) * pitch + (size_t)w * bpp;
+    return true;
+}
+
+/*
+ * A memory surface must lie inside the caller's user area; NEMU would
+ * otherwise read or write whatever the kernel has mapped there.  The span
+ * offset is below 2^49, so a start below base means the address wrapped.
+ */
+static bool gpu_surface_ok(uint64_t base, uint32_t pitch, uint32_t bpp, int x, int y, int w, int h)
+{
+    const uintptr_t us = (uintptr_t)current->as.area.start;
+    const uintptr_t ue = (uintptr_t)current->as.area.end;
+    uintptr_t start;
+    size_t len;
+
+    if (!gpu_surface_span(base, pitch, bpp, x, y, w, h, &start, &len))
+    {
+        return true;
+    }
+
+    return start >= base && start >= us && start < ue && len <= ue - start;
+}
+
+static bool gpu_cmd_ok(const struct gpu_cmd *cmd)
+{
+    const bool stretch = cmd->op == AM_GPU_OP_STRETCH;
+
+    if (cmd->op < AM_GPU_OP_FILL || cmd->op > AM_GPU_OP_PAL8)
+    {
+        return false;
+    }
+
+    if (cmd->op != AM_GPU_OP_PAL8 && cmd->bpp != 1 && cmd->bpp != sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    if ((cmd->flags & (AM_GPU_CMD_DST_FB | AM_GPU_CMD_SRC_FB)) && cmd->op != AM_GPU_OP_PAL8 &&
+        cmd->bpp != sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    if ((cmd->flags & AM_GPU_CMD_DST_FB) &&
+        !gpu_fb_rect_ok(cmd->dst_x, cmd->dst_y, cmd->dst_w, cmd->dst_h))
+    {
+        return false;
+    }
+
+    if (cmd->flags & AM_GPU_CMD_SRC_FB)
+    {
+        if (cmd->op == AM_GPU_OP_PAL8 ||
+            !gpu_fb_rect_ok(cmd->src_x, cmd->src_y,
+                            stretch ? cmd->src_w : cmd->dst_w,
+                            stretch ? cmd->src_h : cmd->dst_h))
+        {
+            return false;
+        }
+    }
+
+    if (!(cmd->flags & AM_GPU_CMD_DST_FB) &&
+        !gpu_surface_ok(cmd->dst, cmd->dst_pitch, cmd->op == AM_GPU_OP_PAL8 ? sizeof(uint32_t) : cmd->bpp,
+                        cmd->dst_x, cmd->dst_y, cmd->dst_w, cmd->dst_h))
+    {
+        return false;
+    }
+
+    if (cmd->op != AM_GPU_OP_FILL && !(cmd->flags & AM_GPU_CMD_SRC_FB) &&
+        !gpu_surface_ok(cmd->src, cmd->src_pitch, cmd->op == AM_GPU_OP_PAL8 ? 1 : cmd->bpp, cmd->src_x,
+                        cmd->src_y, stretch ? cmd->src_w : cmd->dst_w, stretch ? cmd->src_h : cmd->dst_h))
+    {
+        return false;
+    }
+
+    return cmd->op != AM_GPU_OP_PAL8 || gpu_surface_ok(cmd->aux, 0, sizeof(uint32_t), 0, 0, 256, 1);
+}
+
+/*
+ * NEMU walks the caller's page tables for memory surfaces but cannot take a
+ * page fault, so fault in every page it will read and give the destination
+ * private copies of copy-on-write pages before the command is queued.
+ */
+static void gpu_cmd_populate(const struct gpu_cmd *cmd)
+{
+    uintptr_t start;
+    size_t len;
+
+    if (!(cmd->flags & AM_GPU_CMD_DST_FB) &&
+        gpu_surface_span(cmd->dst, cmd->dst_pitch, cmd->op == AM_GPU_OP_PAL8 ? sizeof(uint32_t) : cmd->bpp,
+                         cmd->dst_x, cmd->dst_y, cmd->dst_w, cmd->dst_h, &start, &len))
+    {
+        loader_populate(current, (const void *)start, len);
+        mm_unshare(current, (const void *)start, len);
+    }
+
+    const bool stretch = cmd->op == AM_GPU_OP_STRETCH;
+
+    if (cmd->op != AM_GPU_OP_FILL && !(cmd->flags & AM_GPU_CMD_SRC_FB) &&
+        gpu_surface_span(cmd->src, cmd->src_pitch, cmd->op == AM_GPU_OP_PAL8 ? 1 : cmd->bpp, cmd->src_x, cmd->src_y,
+                         stretch ? cmd->src_w : cmd->dst_w, stretch ? cmd->src_h : cmd->dst_h, &start, &len))
+    {
+        loader_populate(current, (const void *)start, len);
+    }
+
+    if (cmd->op == AM_GPU_OP_PAL8)
+    {
+        loader_populate(current, (const void *)(uintptr_t)cmd->aux, 256 * sizeof(uint32_t));
+    }
+}
+
+/*
+ * Point a framebuffer operand of a background writer at its private backing
+ * store instead, so the visible app is not disturbed.  Returns false when the
+ * writer has no backing store and the command must be dropped.
+ */
+static bool gpu_redirect_to_backing(struct gpu_cmd *cmd, int owner)
+{
+    const uint32_t fb_flags = cmd->flags & (AM_GPU_CMD_DST_FB | AM_GPU_CMD_SRC_FB);
+
+    if (fb_flags == 0)
+    {
+        return true;
+    }
+
+    if (!valid_foreground_index(owner))
+    {
+        return false;
+    }
+
+    const uint32_t pitch = (uint32_t)fb_screen_w * sizeof(uint32_t);
+
+    if (fb_flags & AM_GPU_CMD_DST_FB)
+    {
+        cmd->dst = (uintptr_t)fb_backing[owner];
+        cmd->dst_pitch = pitch;
+    }
+
+    if (fb_flags & AM_GPU_CMD_SRC_FB)
+    {
+        cmd->src = (uintptr_t)fb_backing[owner];
+        cmd->src_pitch = pitch;
+    }
+
+    cmd->flags &= ~fb_flags;
+    return true;
+}
+
+// Each write is a whole number of struct gpu_cmd records.  A short count means
+// record n was rejected; nothing from n on has run.
+size_t gpu_write(const void *buf, size_t offset, size_t len)
+{
+    (void)offset;
+    assert(fb_backing_ready);
+
+    const struct gpu_cmd *in = buf;
+    const size_t n = len / sizeof(*in);
+    const int owner = current_pcb_index();
+    const bool background = owner != foreground_pcb_index();
+    struct gpu_cmd batch[16];
+    int pending = 0;
+    bool fb_touched = false;
+    size_t done = 0;
+
+    for (; done < n; done++)
+    {
+        struct gpu_cmd cmd = in[done];
+
+        if (!gpu_cmd_ok(&cmd))
+        {
+            break;
+        }
+
+        gpu_cmd_populate(&cmd);
+
+        if (background)
+        {
+            if (!gpu_redirect_to_backing(&cmd, owner))
+            {
+                continue;
+            }
+        }
+        else if (cmd.flags & AM_GPU_CMD_DST_FB)
+        {
+            fb_touched = true;
+        }
+
+        batch[pending++] = cmd;
+
+        if (pending == LENGTH(batch))
+        {
+            io_write(AM_GPU_CMDQ, batch, pending);
+            pending = 0;
+        }
+    }
+
+    if (pending != 0)
+    {
+        io_write(AM_GPU_CMDQ, batch, pending);
+    }
+
+    if (fb_touched)
+    {
+        // Present once per write, and leave the backing store to the lazy capture.
+        io_write(AM_GPU_FBDRAW, 0, 0, NULL, 0, 0, true);
+
+        if (valid_foreground_index(owner))
+        {
+            fb_backing_stale[owner] = true;
+        }
+    }
+
+    return done * sizeof(*in);
+}
+#else
+// Without the NEMU command queue every write is refused and NDL draws in software.
+size_t gpu_write(const void *buf, size_t offset, size_t len)
+{
+    (void)buf;
+    (void)offset;
+    (void)len;
+    return 0;
+}
+#endif
+
+// Semantics: queue up to `len` bytes starting at (uint8_t*)buf + offset and return how many were taken.
+// A writer that finds the ring full sleeps until it drains to the low watermark; a short write is progress.
 // Note: offset applies to the user buffer, not the device, since a stream device has no seek position.
 size_t sb_write(const void *buf, size_t offset, size_t len)
 {
@@ -569,31 +968,38 @@ size_t sb_write(const void *buf, size_t offset, size_t len)
         return 0;
 
     const uint8_t *p = (const uint8_t *)buf + offset;
-    size_t remain = len;
+    size_t done = 0;
 
-    while (remain > 0)
+    while (done < len)
     {
-        size_t free_bytes = 0;
+        AM_AUDIO_STATUS_T st = io_read(AM_AUDIO_STATUS);
+        AM_AUDIO_CONFIG_T cfg = io_read(AM_AUDIO_CONFIG);
+        size_t used = (size_t)st.count;
+        size_t cap = (size_t)cfg.bufsize;
+        size_t free_bytes = (used >= cap) ? 0 : (cap - used);
 
         // Wait until the device ring buffer exposes some free space
-        while (1)
+        if (free_bytes == 0)
         {
-            AM_AUDIO_STATUS_T st = io_read(AM_AUDIO_STATUS);
-            AM_AUDIO_CONFIG_T cfg = io_read(AM_AUDIO_CONFIG);
-            size_t used = (size_t)st.count;
-            size_t cap = (size_t)cfg.bufsize;
-            free_bytes = (used >= cap) ? 0 : (cap - used);
+#if NEMU_DEVICE_IRQ
+            // Only a writer that got nothing out sleeps; the rest return short.
+            if (done == 0 && proc_block(&audio_wait))
+            {
+                irq_source_enable(NEMU_IRQ_AUDIO, true);
+            }
 
-            if (free_bytes > 0)
-                break;
+            break;
+#else
             MULTIPROGRAM_YIELD(); // be cooperative if a scheduler exists
+            continue;
+#endif
         }
 
         // Write at most the available free space, and no more than what remains
         size_t n = free_bytes;
 
-        if (n > remain)
-            n = remain;
+        if (n > len - done)
+            n = len - done;
 
         // Optional, enforce sample frame alignment if the device requires it
         // size_t frame_bytes = 1;  // e.g., stereo 16-bit PCM is 4 bytes per frame
@@ -602,17 +1008,14 @@ size_t sb_write(const void *buf, size_t offset, size_t len)
 
         // Push this chunk
         Area sbuf;
-        sbuf.start = (void *)p;
-        sbuf.end = (void *)(p + n);
+        sbuf.start = (void *)(p + done);
+        sbuf.end = (void *)(p + done + n);
         io_write(AM_AUDIO_PLAY, sbuf);
 
-        // Advance source pointer
-        p += n;
-        remain -= n;
+        done += n;
     }
 
-    // All requested bytes have been queued to the device
-    return len;
+    return done;
 }
 
 size_t sbctl_write(const void *buf, size_t offset, size_t len)
@@ -653,9 +1056,149 @@ size_t sbctl_read(void *buf, size_t offset, size_t len)
     return to_copy;
 }
 
+#if NEMU_AUDIO_MIXER
+/*
+ * out_freq is the caller's stream rate.  A voice more than 65536 times slower
+ * would resample with a zero 16.16 step, so NEMU refuses it.
+ */
+static bool audio_mix_cmd_ok(const struct audio_mix_cmd *cmd, uint32_t out_freq)
+{
+    if (cmd->op == AM_AUDIO_MIX_MIX)
+    {
+        return cmd->buf != 0 && cmd->len > 0;
+    }
+
+    if (cmd->op < AM_AUDIO_MIX_PLAY || cmd->op > AM_AUDIO_MIX_SET ||
+        cmd->voice >= AM_AUDIO_NR_VOICES)
+    {
+        return false;
+    }
+
+    if (cmd->op == AM_AUDIO_MIX_SET)
+    {
+        return cmd->volume <= AM_AUDIO_MAX_VOLUME;
+    }
+
+    if (cmd->op != AM_AUDIO_MIX_PLAY)
+    {
+        return true;
+    }
+
+    return cmd->buf != 0 && cmd->volume <= AM_AUDIO_MAX_VOLUME &&
+           (cmd->format == AM_AUDIO_FMT_U8 || cmd->format == AM_AUDIO_FMT_S16) &&
+           (cmd->channels == 1 || cmd->channels == 2) &&
+           cmd->freq > 0 && cmd->freq <= 192000 && ((uint64_t)cmd->freq << 16) >= out_freq;
+}
+
+/*
+ * /dev/sbmix: each write is a whole number of struct audio_mix_cmd records,
+ * and a short count means record n was rejected.  Like the stream format, the
+ * voices belong to the foreground app; they are reset when its format is
+ * restored, and commands from background apps are accepted but dropped, so
+ * their voices simply read back as finished.
+ */
+size_t sbmix_write(const void *buf, size_t offset, size_t len)
+{
+    (void)offset;
+
+    const int owner = current_pcb_index();
+
+    if (!valid_foreground_index(owner) || !audio_state[owner].configured)
+    {
+        return 0;
+    }
+
+    const struct audio_mix_cmd *in = buf;
+    const size_t n = len / sizeof(*in);
+
+    if (owner != foreground_pcb_index())
+    {
+        return n * sizeof(*in);
+    }
+
+    struct audio_mix_cmd batch[16];
+    int pending = 0;
+    size_t done = 0;
+
+    for (; done < n; done++)
+    {
+        if (!audio_mix_cmd_ok(&in[done], audio_state[owner].freq))
+        {
+            break;
+        }
+
+        /*
+         * NEMU cannot take a page fault: fault in the PCM a voice will play and
+         * the frames a MIX adds into, and unshare the latter before NEMU
+         * writes them.
+         */
+        const void *pcm = (const void *)(uintptr_t)in[done].buf;
+
+        if (in[done].op == AM_AUDIO_MIX_PLAY)
+        {
+            loader_populate(current, pcm, in[done].len);
+        }
+        else if (in[done].op == AM_AUDIO_MIX_MIX)
+        {
+            const size_t bytes = (size_t)in[done].len * audio_state[owner].channels * sizeof(int16_t);
+
+            loader_populate(current, pcm, bytes);
+            mm_unshare(current, pcm, bytes);
+        }
+
+        batch[pending++] = in[done];
+
+        if (pending == LENGTH(batch))
+        {
+            io_write(AM_AUDIO_MIXQ, batch, pending);
+            pending = 0;
+        }
+    }
+
+    if (pending != 0)
+    {
+        io_write(AM_AUDIO_MIXQ, batch, pending);
+    }
+
+    return done * sizeof(*in);
+}
+
+// Reads one uint32_t with a bit set for every voice still playing or paused.
+size_t sbmix_read(void *buf, size_t offset, size_t len)
+{
+    (void)offset;
+
+    const int owner = current_pcb_index();
+    const uint32_t active = owner == foreground_pcb_index() ? io_read(AM_AUDIO_VOICES).active : 0;
+    const size_t to_copy = len < sizeof(active) ? len : sizeof(active);
+    memcpy(buf, &active, to_copy);
+    return to_copy;
+}
+#else
+// Without the NEMU voice mixer every write is refused and SDL_mixer mixes in software.
+size_t sbmix_write(const void *buf, size_t offset, size_t len)
+{
+    (void)buf;
+    (void)offset;
+    (void)len;
+    return 0;
+}
+
+size_t sbmix_read(void *buf, size_t offset, size_t len)
+{
+    (void)buf;
+    (void)offset;
+    (void)len;
+    return 0;
+}
+#endif
+
 void init_device()
 {
     Log("Initializing devices...");
     ioe_init();
     init_fb_backing();
+#if NEMU_DEVICE_IRQ
+    init_device_irq();
+#endif
 }
@@ -1,16 +1,26 @@
 #include <common.h>
+#include <memory.h>
+#include <proc.h>
+#include "bcache.h"
+#include "pagewalk.h"
+
+#if defined(__PLATFORM_NEMU)
+#define NEMU_DISK_SGREAD 1
+#else
+#define NEMU_DISK_SGREAD 0
+#endif
 
 size_t ramdisk_read(void *buf, size_t offset, size_t len);
 size_t ramdisk_write(const void *buf, size_t offset, size_t len);
 size_t get_ramdisk_size(void);
 
 /*
- * Keep one kernel-owned DMA bounce buffer for disk I/O.  User buffers can be
- * virtual addresses that NEMU's simple disk device cannot translate, so Nanos
- * copies through this physical buffer.  A larger buffer is worthwhile for
- * ONScripter: switching images often reads hundreds of KiB from the ramdisk,
- * and each extra chunk costs several MMIO register writes plus one host-side
- * disk command.
+ * Keep one kernel-owned DMA bounce buffer for multi-block disk I/O.  The block
+ * cache fills read misses, read-ahead, and coalesced write-back runs through
+ * it, because recycled cache blocks are not physically contiguous.  A larger
+ * buffer is worthwhile for ONScripter: switching images often reads hundreds
+ * of KiB, and each extra run costs several MMIO register writes plus one
+ * host-side disk command.
  */
 #define DISK_BLOCK_BUF_SIZE (128 * 1024)
 
@@ -27,7 +37,7 @@ static AM_DISK_CONFIG_T disk_cfg;
  */
 static bool disk_present = false;
 /*
- * Kernel-owned physical bounce buffer used for all AM disk transfers.  It is
+ * Kernel-owned physical bounce buffer for multi-block AM disk transfers.  It is
  * aligned for the device contract and deliberately static so user virtual
  * buffers never have to be translated by the simple NEMU disk controller.
  */
@@ -38,11 +48,6 @@ static size_t disk_size(void)
     return (size_t)disk_cfg.blksz * (size_t)disk_cfg.blkcnt;
 }
 
-static size_t min_size(size_t a, size_t b)
-{
-    return a < b ? a : b;
-}
-
 static void check_disk_range(size_t offset, size_t len)
 {
     const size_t size = disk_size();
@@ -55,78 +60,144 @@ static void check_disk_range(size_t offset, size_t len)
     assert(len <= size - offset);
 }
 
-static void disk_transfer_blocks(bool write, size_t blkno, size_t blkcnt)
+/*
+ * Block-cache device hook.  buf is a cache block or disk_block_buf, both kernel
+ * statics, so NEMU can take the pointer as a guest physical address; syscall
+ * buffers never reach the device.
+ */
+static void disk_cache_io(bool write, void *buf, size_t offset, size_t len)
 {
-    assert(blkcnt > 0);
-    assert(blkcnt * (size_t)disk_cfg.blksz <= DISK_BLOCK_BUF_SIZE);
+    const size_t blksz = (size_t)disk_cfg.blksz;
+
+    assert(offset % blksz == 0 && len % blksz == 0 && len > 0);
+    assert(len <= DISK_BLOCK_BUF_SIZE);
 
-    /*
-     * NEMU receives this pointer as a guest physical address and translates it
-     * directly into host PMEM.  Keep it as a kernel static buffer: syscall
-     * buffers may be userspace virtual addresses, which the device cannot walk.
-     */
     io_write(AM_DISK_BLKIO,
              .write = write,
-             .buf = disk_block_buf,
-             .blkno = (int)blkno,
-             .blkcnt = (int)blkcnt);
+             .buf = buf,
+             .blkno = (int)(offset / blksz),
+             .blkcnt = (int)(len / blksz));
 }
 
-size_t disk_read(void *buf, size_t offset, size_t len)
+#if NEMU_DISK_SGREAD
+/*
+ * Segment list for one AM_DISK_SGREAD command.  Static, like disk_block_buf,
+ * so NEMU can read it at its kernel address.
+ */
+#define DISK_SG_SEGS 256
+static struct disk_sg_seg disk_sg[DISK_SG_SEGS];
+
+static void disk_sg_issue(int nseg, size_t offset, size_t len)
 {
-    if (!disk_present)
-    {
-        /* Keep old ramdisk-only images working when NEMU has no external disk
-         * device.  The filesystem layer does not need to know which backend won.
-         */
-        return ramdisk_read(buf, offset, len);
-    }
+    const size_t blksz = (size_t)disk_cfg.blksz;
 
-    check_disk_range(offset, len);
+    io_write(AM_DISK_SGREAD,
+             .segs = disk_sg,
+             .n = nseg,
+             .blkno = (int)(offset / blksz),
+             .blkcnt = (int)(len / blksz));
+}
 
-    uint8_t *out = (uint8_t *)buf;
-    size_t done = 0;
+/*
+ * Block-cache read_direct hook: DMA a long uncached run straight into the
+ * caller's buffer.  fs_read() hands user virtual addresses down unchanged, so
+ * each page is translated through the current address space and physically
+ * adjacent pages are merged into one segment.  A page that is not mapped yet,
+ * or is read-only or copy-on-write, makes the whole request fall back to the
+ * cache, which copies through the ordinary kernel path instead, so DMA never
+ * writes into a frame another process still shares.
+ */
+static bool disk_read_direct(void *buf, size_t offset, size_t len)
+{
     const size_t blksz = (size_t)disk_cfg.blksz;
+    void *root = current != NULL ? current->as.ptr : NULL;
+    uintptr_t va = (uintptr_t)buf;
+    size_t done = 0;
+    /* Bytes covered by the segments gathered so far, not yet sent. */
+    size_t pending = 0;
+    int nseg = 0;
+
+    assert(offset % blksz == 0 && len % blksz == 0);
+
+    /* Translate everything first so a hole never leaves a half-done read. */
+    for (uintptr_t page = va & ~(uintptr_t)(PGSIZE - 1); page < va + len; page += PGSIZE)
+    {
+        if (root == NULL)
+        {
+            break;
+        }
+
+        const int flags = nanos_pagewalk_get_flags(root, page);
+
+        if (flags < 0 || (flags & NANOS_PAGE_WRITE) == 0)
+        {
+            return false;
+        }
+    }
 
     while (done < len)
     {
-        const size_t cur = offset + done;
-        const size_t blkno = cur / blksz;
-        const size_t blkoff = cur % blksz;
+        const uintptr_t cur = va + done;
+        const size_t page_off = cur & (PGSIZE - 1);
+        const size_t chunk = len - done < PGSIZE - page_off ? len - done : PGSIZE - page_off;
+        const uintptr_t pa = root != NULL
+                                 ? (uintptr_t)nanos_pagewalk_lookup_page(root, cur) + page_off
+                                 : cur;
 
-        if (blkoff == 0)
+        if (nseg > 0 && disk_sg[nseg - 1].addr + disk_sg[nseg - 1].len == pa)
         {
-            /*
-             * Read as many consecutive whole blocks as the bounce buffer can hold.
-             * The AM/NEMU disk interface already supports multi-block transfers, so
-             * this cuts MMIO traffic and host fseek/fread calls for large assets.
-             */
-            const size_t max_blocks = DISK_BLOCK_BUF_SIZE / blksz;
-            const size_t needed_blocks = (len - done + blksz - 1) / blksz;
-            const size_t disk_blocks_left = (size_t)disk_cfg.blkcnt - blkno;
-            const size_t blkcnt = min_size(min_size(needed_blocks, max_blocks), disk_blocks_left);
-            const size_t chunk = min_size(len - done, blkcnt * blksz);
-
-            disk_transfer_blocks(false, blkno, blkcnt);
-            memcpy(out + done, disk_block_buf, chunk);
-            done += chunk;
-            continue;
+            disk_sg[nseg - 1].len += (uint32_t)chunk;
         }
+        else
+        {
+            if (nseg == DISK_SG_SEGS)
+            {
+                /*
+                 * The list is full.  Send the block-aligned part and carry the
+                 * partial block over as the first segment of the next command.
+                 */
+                const size_t send = pending - pending % blksz;
+                const size_t carry = pending - send;
 
-        /*
-         * The first unaligned piece must still read a whole disk block into the
-         * bounce buffer, then copy only the requested tail.  This keeps the public
-         * byte-addressed filesystem API while the AM/NEMU device remains block-based.
-         */
-        const size_t chunk = min_size(len - done, blksz - blkoff);
+                disk_sg[nseg - 1].len -= (uint32_t)carry;
+                disk_sg_issue(nseg, offset + done - pending, send);
+                nseg = 0;
+                pending = carry;
+
+                if (carry > 0)
+                {
+                    disk_sg[0].addr = disk_sg[DISK_SG_SEGS - 1].addr + disk_sg[DISK_SG_SEGS - 1].len;
+                    disk_sg[0].len = (uint32_t)carry;
+                    nseg = 1;
+                }
+            }
 
-        disk_transfer_blocks(false, blkno, 1);
-        memcpy(out + done, disk_block_buf + blkoff, chunk);
+            disk_sg[nseg].addr = (uint32_t)pa;
+            disk_sg[nseg].len = (uint32_t)chunk;
+            nseg++;
+        }
 
+        pending += chunk;
         done += chunk;
     }
 
-    return len;
+    disk_sg_issue(nseg, offset + len - pending, pending);
+    return true;
+}
+#endif
+
+size_t disk_read(void *buf, size_t offset, size_t len)
+{
+    if (!disk_present)
+    {
+        /* Keep old ramdisk-only images working when NEMU has no external disk
+         * device.  The filesystem layer does not need to know which backend won.
+         */
+        return ramdisk_read(buf, offset, len);
+    }
+
+    check_disk_range(offset, len);
+    return bcache_read(buf, offset, len);
 }
 
 size_t disk_write(const void *buf, size_t offset, size_t len)
@@ -140,35 +211,16 @@ size_t disk_write(const void *buf, size_t offset, size_t len)
     }
 
     check_disk_range(offset, len);
+    return bcache_write(buf, offset, len);
+}
 
-    const uint8_t *in = (const uint8_t *)buf;
-    size_t done = 0;
-    const size_t blksz = (size_t)disk_cfg.blksz;
-
-    while (done < len)
+/* Push cached writes to the device; the ramdisk has nothing to flush. */
+void disk_sync(void)
+{
+    if (disk_present)
     {
-        const size_t cur = offset + done;
-        const size_t blkno = cur / blksz;
-        const size_t blkoff = cur % blksz;
-        const size_t chunk = min_size(len - done, blksz - blkoff);
-
-        if (blkoff != 0 || chunk != blksz)
-        {
-            /*
-             * Preserve the bytes in this block that are outside the caller's range.
-             * Full aligned block writes can skip the read because the whole buffer
-             * is overwritten before the write command.
-             */
-            disk_transfer_blocks(false, blkno, 1);
-        }
-
-        memcpy(disk_block_buf + blkoff, in + done, chunk);
-        disk_transfer_blocks(true, blkno, 1);
-
-        done += chunk;
+        bcache_sync();
     }
-
-    return len;
 }
 
 void init_disk(void)
@@ -189,6 +241,18 @@ void init_disk(void)
      * uses larger blocks than the bounce buffer, batching would silently collapse
      * back to one partial command or fail to preserve surrounding bytes on writes.
      */
+    const BcacheDevice cache_dev = {
+        .size = disk_size(),
+        .blksz = (size_t)disk_cfg.blksz,
+        .bounce = disk_block_buf,
+        .bounce_size = DISK_BLOCK_BUF_SIZE,
+        .io = disk_cache_io,
+#if NEMU_DISK_SGREAD
+        .read_direct = disk_read_direct,
+#endif
+    };
+    bcache_init(&cache_dev);
+
     Log("disk info: block size = %d bytes, blocks = %d, size = %zu bytes",
         disk_cfg.blksz, disk_cfg.blkcnt, disk_size());
 }
@@ -1,13 +1,15 @@
 #include <fs.h>
+#include <proc.h>
 #include "fs/backend.h"
+#include "pagecache.h"
+#include "sysprof.h"
 
 #include <stddef.h>
 
 /*
- * Device-file read callback.  The offset is the descriptor's current special
- * file offset, not a backend regular-file offset.  Poll-like devices can ignore
- * it, while synthetic files such as /proc/dispinfo may use it if they later
- * grow seek-style behaviour.
+ * Device-file read callback.  The offset is the open file's current offset,
+ * not a backend regular-file offset.  Poll-like devices and
+ * /proc/dispinfo ignore it; text files read it like a regular file.
  */
 typedef size_t (*ReadFn)(void *buf, size_t offset, size_t len);
 
@@ -18,13 +20,24 @@ typedef size_t (*ReadFn)(void *buf, size_t offset, size_t len);
 typedef size_t (*WriteFn)(const void *buf, size_t offset, size_t len);
 
 // device.c
+size_t stdin_read(void *buf, size_t offset, size_t len);
 size_t serial_write(const void *buf, size_t offset, size_t len);
 size_t events_read(void *buf, size_t offset, size_t len);
+size_t events_wait_read(void *buf, size_t offset, size_t len);
 size_t dispinfo_read(void *buf, size_t offset, size_t len);
 size_t fb_write(const void *buf, size_t offset, size_t len);
 size_t sb_write(const void *buf, size_t offset, size_t len);
 size_t sbctl_write(const void *buf, size_t offset, size_t len);
 size_t sbctl_read(void *buf, size_t offset, size_t len);
+size_t gpu_write(const void *buf, size_t offset, size_t len);
+size_t sbmix_write(const void *buf, size_t offset, size_t len);
+size_t sbmix_read(void *buf, size_t offset, size_t len);
+
+// irq.c
+size_t proc_syscalls_read(void *buf, size_t offset, size_t len);
+
+// disk.c
+void disk_sync(void);
 
 typedef struct
 {
@@ -42,19 +55,32 @@ typedef struct
     ReadFn read;
     /* Callback used by fs_write() for this special descriptor. */
     WriteFn write;
+    /*
+     * Non-zero for generated text read like a regular file: reads advance the
+     * offset and seeks are not bounded by size, which stays zero.
+     */
+    int text;
 } SpecialFile;
 
 typedef enum
 {
     OPEN_NONE,
+    OPEN_SPECIAL,
     OPEN_REGULAR,
     OPEN_DIRECTORY
 } OpenKind;
 
 typedef struct
 {
-    /* Distinguishes unused, regular-file, and directory descriptor slots. */
+    /* Distinguishes unused, special, regular-file, and directory slots. */
     OpenKind kind;
+    /*
+     * Descriptors and kernel holders referring to this open file.  fs_close()
+     * drops one reference and the last one frees the slot.
+     */
+    int refs;
+    /* special_files[] index of an OPEN_SPECIAL file. */
+    int special;
     /*
      * Current logical file offset for read/write/lseek.  fs.c advances this
      * after successful backend reads or writes, mirroring POSIX descriptors.
@@ -68,29 +94,50 @@ typedef struct
     int append;
     /* Metadata snapshot used by fstat() without storing path strings. */
     FsMetadata metadata;
-    /* Backend-specific regular-file state. */
-    FsFile file;
-    /* Backend-specific directory iterator state. */
-    FsDir dir;
+
+    union
+    {
+        struct
+        {
+            /* Backend-specific regular-file state. */
+            FsFile file;
+            /* Backend-specific directory iterator state. */
+            FsDir dir;
+        };
+        /*
+         * /proc/<pid>/stat: the process named at open time and its text as
+         * rendered when a read last started at offset 0.
+         */
+        struct
+        {
+            int pid;
+            size_t len;
+            char text[PROC_STAT_TEXT_SIZE];
+        } stat;
+    };
 } OpenFile;
 
 enum
 {
-    FD_STDIN,
-    FD_STDOUT,
-    FD_STDERR,
-    FD_FB,
-    FD_EVENTS,
-    FD_DISPINFO,
-    FD_SB,
-    FD_SBCTL
+    SPECIAL_STDIN,
+    SPECIAL_STDOUT,
+    SPECIAL_STDERR,
+    SPECIAL_FB,
+    SPECIAL_EVENTS,
+    SPECIAL_DISPINFO,
+    SPECIAL_SB,
+    SPECIAL_SBCTL,
+    SPECIAL_GPU,
+    SPECIAL_SBMIX,
+    SPECIAL_EVENTS_WAIT,
+    SPECIAL_PROC_SYSCALLS,
+    SPECIAL_PROC_STAT
 };
 
 enum
 {
-    FIRST_REGULAR_FD = FD_SBCTL + 1,
-    MAX_OPEN_FILES = 128,
-    MAX_REGULAR_OPEN_FILES = MAX_OPEN_FILES - FIRST_REGULAR_FD,
+    // Shared by every process and the kernel; slot 0 is never used.
+    MAX_OPEN_FILES = 256,
 };
 
 enum
@@ -107,14 +154,20 @@ enum
 };
 
 static SpecialFile special_files[] = {
-    [FD_STDIN] = {"stdin", 0, 0, 0},
-    [FD_STDOUT] = {"stdout", 0, 0, serial_write},
-    [FD_STDERR] = {"stderr", 0, 0, serial_write},
-    [FD_FB] = {"/dev/fb", 0, 0, fb_write},
-    [FD_EVENTS] = {"/dev/events", 0, events_read, 0},
-    [FD_DISPINFO] = {"/proc/dispinfo", 0, dispinfo_read, 0},
-    [FD_SB] = {"/dev/sb", 0, 0, sb_write},
-    [FD_SBCTL] = {"/dev/sbctl", 0, sbctl_read, sbctl_write},
+    [SPECIAL_STDIN] = {"/dev/stdin", 0, stdin_read, 0},
+    [SPECIAL_STDOUT] = {"stdout", 0, 0, serial_write},
+    [SPECIAL_STDERR] = {"stderr", 0, 0, serial_write},
+    [SPECIAL_FB] = {"/dev/fb", 0, 0, fb_write},
+    [SPECIAL_EVENTS] = {"/dev/events", 0, events_read, 0},
+    [SPECIAL_DISPINFO] = {"/proc/dispinfo", 0, dispinfo_read, 0},
+    [SPECIAL_SB] = {"/dev/sb", 0, 0, sb_write},
+    [SPECIAL_SBCTL] = {"/dev/sbctl", 0, sbctl_read, sbctl_write},
+    [SPECIAL_GPU] = {"/dev/gpu", 0, 0, gpu_write},
+    [SPECIAL_SBMIX] = {"/dev/sbmix", 0, sbmix_read, sbmix_write},
+    [SPECIAL_EVENTS_WAIT] = {"/dev/events_wait", 0, events_wait_read, 0},
+    [SPECIAL_PROC_SYSCALLS] = {"/proc/syscalls", 0, proc_syscalls_read, 0, 1},
+    // Stands for every /proc/<pid>/stat, see proc_stat_pid(); fs_read() reads it.
+    [SPECIAL_PROC_STAT] = {"/proc/self/stat", 0, 0, 0, 1},
 };
 
 enum
@@ -122,13 +175,45 @@ enum
     NR_SPECIAL_FILES = sizeof(special_files) / sizeof(special_files[0])
 };
 
-static size_t special_offsets[NR_SPECIAL_FILES];
-static OpenFile open_files[MAX_REGULAR_OPEN_FILES];
+static OpenFile open_files[MAX_OPEN_FILES];
+
+/*
+ * The pid named by /proc/self/stat or /proc/<pid>/stat, or -1 if pathname is
+ * neither or the process does not exist.
+ */
+static int proc_stat_pid(const char *pathname)
+{
+    if (strncmp(pathname, "/proc/", 6) != 0)
+    {
+        return -1;
+    }
+
+    const char *p = pathname + 6;
+    int pid = 0;
+
+    if (strcmp(p, "self/stat") == 0)
+    {
+        return current != NULL ? current->pid : -1;
+    }
+
+    for (; *p >= '0' && *p <= '9' && pid < 1000000; p++)
+    {
+        pid = pid * 10 + (*p - '0');
+    }
+
+    return p != pathname + 6 && strcmp(p, "/stat") == 0 && proc_pid_live(pid) ? pid : -1;
+}
+
 /*
  * Find a special device or proc file by exact pathname.
  */
 static int find_special_file(const char *pathname)
 {
+    if (proc_stat_pid(pathname) >= 0)
+    {
+        return SPECIAL_PROC_STAT;
+    }
+
     for (int i = 0; i < NR_SPECIAL_FILES; i++)
     {
         if (strcmp(pathname, special_files[i].name) == 0)
@@ -141,32 +226,35 @@ static int find_special_file(const char *pathname)
 }
 
 /*
- * Return an allocated regular descriptor slot after validating the fd range.
+ * Return the slot of an open file, or NULL if file does not name one.
  */
-static OpenFile *open_file(int fd)
+static OpenFile *open_file(int file)
 {
-    assert(fd >= FIRST_REGULAR_FD && fd < MAX_OPEN_FILES);
+    if (file <= 0 || file >= MAX_OPEN_FILES || open_files[file].kind == OPEN_NONE)
+    {
+        return NULL;
+    }
 
-    OpenFile *open = &open_files[fd - FIRST_REGULAR_FD];
-    assert(open->kind != OPEN_NONE);
-    return open;
+    return &open_files[file];
 }
 
 /*
- * Allocate a descriptor slot for a regular file or directory.
+ * Allocate a slot holding one reference.  Slot 0 stays free so that 0 can mark
+ * an unused descriptor in a zeroed PCB.
  */
-static int allocate_fd(OpenKind kind, int readable, int writable, int append)
+static int allocate_file(OpenKind kind, int readable, int writable, int append)
 {
-    for (int i = 0; i < MAX_REGULAR_OPEN_FILES; i++)
+    for (int i = 1; i < MAX_OPEN_FILES; i++)
     {
         if (open_files[i].kind == OPEN_NONE)
         {
+            memset(&open_files[i], 0, sizeof(open_files[i]));
             open_files[i].kind = kind;
-            open_files[i].offset = 0;
+            open_files[i].refs = 1;
             open_files[i].readable = readable;
             open_files[i].writable = writable;
             open_files[i].append = append;
-            return FIRST_REGULAR_FD + i;
+            return i;
         }
     }
 
@@ -216,17 +304,17 @@ static void fill_stat_from_metadata(NanosStat *buf, const FsMetadata *metadata)
 }
 
 /*
- * Fill a project-owned syscall stat record for a special file descriptor.
+ * Fill a project-owned syscall stat record for a special file.
  */
-static void fill_stat_from_special(NanosStat *buf, int fd)
+static void fill_stat_from_special(NanosStat *buf, int special)
 {
     memset(buf, 0, sizeof(*buf));
-    buf->ino = (uint64_t)(fd + 1);
+    buf->ino = (uint64_t)(special + 1);
     buf->mode = NANOS_S_IFCHR | 0666u;
     buf->nlink = 1;
-    buf->size = (int64_t)special_files[fd].size;
+    buf->size = (int64_t)special_files[special].size;
     buf->blksize = 512;
-    buf->blocks = (int64_t)((special_files[fd].size + 511u) / 512u);
+    buf->blocks = (int64_t)((special_files[special].size + 511u) / 512u);
 }
 
 /*
@@ -238,10 +326,25 @@ void init_fs()
 
     assert(gpuConfig.present);
     assert(gpuConfig.vmemsz > 0);
-    special_files[FD_FB].size = (size_t)gpuConfig.vmemsz;
+    special_files[SPECIAL_FB].size = (size_t)gpuConfig.vmemsz;
     assert(regular_fs_backend.init() == 0);
 }
 
+/*
+ * Pages cached from a file must not outlive a change to it.  Writes
+ * go through a descriptor opened for writing, so its open and close bracket
+ * them; path operations drop the file before they touch it.
+ */
+static void forget_cached_pages(const char *pathname)
+{
+    FsMetadata metadata;
+
+    if (regular_fs_backend.lookup(pathname, &metadata) == 0)
+    {
+        pagecache_invalidate(metadata.inode);
+    }
+}
+
 /*
  * Open a special file, regular file, or directory according to POSIX flags.
  */
@@ -249,7 +352,7 @@ int fs_open(const char *pathname, int flags, int mode)
 {
     int readable;
     int writable;
-    int fd;
+    int special;
 
     (void)mode;
 
@@ -258,16 +361,29 @@ int fs_open(const char *pathname, int flags, int mode)
         return -1;
     }
 
-    fd = find_special_file(pathname);
+    special = find_special_file(pathname);
 
-    if (fd >= 0)
+    if (special >= 0)
     {
         if ((flags & FS_O_DIRECTORY) != 0)
         {
             return -1;
         }
-        special_offsets[fd] = 0;
-        return fd;
+
+        // Special files ignore the access mode; their callbacks decide.
+        const int new_file = allocate_file(OPEN_SPECIAL, 1, 1, 0);
+
+        if (new_file < 0)
+        {
+            return -1;
+        }
+        open_files[new_file].special = special;
+
+        if (special == SPECIAL_PROC_STAT)
+        {
+            open_files[new_file].stat.pid = proc_stat_pid(pathname);
+        }
+        return new_file;
     }
 
     access_from_flags(flags, &readable, &writable);
@@ -275,34 +391,34 @@ int fs_open(const char *pathname, int flags, int mode)
     if ((flags & FS_O_DIRECTORY) != 0)
     {
         FsDir dir;
-        int new_fd;
+        int new_file;
 
         if (regular_fs_backend.opendir(pathname, &dir) != 0)
         {
             return -1;
         }
-        new_fd = allocate_fd(OPEN_DIRECTORY, 1, 0, 0);
+        new_file = allocate_file(OPEN_DIRECTORY, 1, 0, 0);
 
-        if (new_fd < 0)
+        if (new_file < 0)
         {
             return -1;
         }
-        open_files[new_fd - FIRST_REGULAR_FD].dir = dir;
+        open_files[new_file].dir = dir;
 
-        if (regular_fs_backend.lookup(pathname, &open_files[new_fd - FIRST_REGULAR_FD].metadata) != 0)
+        if (regular_fs_backend.lookup(pathname, &open_files[new_file].metadata) != 0)
         {
-            open_files[new_fd - FIRST_REGULAR_FD].metadata.is_dir = 1;
-            open_files[new_fd - FIRST_REGULAR_FD].metadata.size = 0;
-            open_files[new_fd - FIRST_REGULAR_FD].metadata.inode = dir.u.fat32.first_cluster;
+            open_files[new_file].metadata.is_dir = 1;
+            open_files[new_file].metadata.size = 0;
+            open_files[new_file].metadata.inode = dir.u.fat32.first_cluster;
         }
-        return new_fd;
+        return new_file;
     }
 
     FsFile file;
 
     if (regular_fs_backend.open(pathname, &file) == 0)
     {
-        int new_fd;
+        int new_file;
 
         if ((flags & FS_O_EXCL) != 0 && (flags & FS_O_CREAT) != 0)
         {
@@ -310,6 +426,11 @@ int fs_open(const char *pathname, int flags, int mode)
             return -1;
         }
 
+        if (writable)
+        {
+            pagecache_invalidate(metadata_from_file(&file).inode);
+        }
+
         if ((flags & FS_O_TRUNC) != 0)
         {
             if (!writable || regular_fs_backend.truncate(&file, 0) != 0)
@@ -319,41 +440,41 @@ int fs_open(const char *pathname, int flags, int mode)
             }
         }
 
-        new_fd = allocate_fd(OPEN_REGULAR, readable, writable, (flags & FS_O_APPEND) != 0);
+        new_file = allocate_file(OPEN_REGULAR, readable, writable, (flags & FS_O_APPEND) != 0);
 
-        if (new_fd < 0)
+        if (new_file < 0)
         {
             regular_fs_backend.close(&file);
             return -1;
         }
-        open_files[new_fd - FIRST_REGULAR_FD].file = file;
-        open_files[new_fd - FIRST_REGULAR_FD].metadata = metadata_from_file(&file);
+        open_files[new_file].file = file;
+        open_files[new_file].metadata = metadata_from_file(&file);
 
         if ((flags & FS_O_APPEND) != 0)
         {
-            open_files[new_fd - FIRST_REGULAR_FD].offset = file.size;
+            open_files[new_file].offset = file.size;
         }
-        return new_fd;
+        return new_file;
     }
 
     if ((flags & FS_O_CREAT) != 0)
     {
-        int new_fd;
+        int new_file;
 
         if (regular_fs_backend.create(pathname, &file) != 0)
         {
             return -1;
         }
-        new_fd = allocate_fd(OPEN_REGULAR, readable, writable, (flags & FS_O_APPEND) != 0);
+        new_file = allocate_file(OPEN_REGULAR, readable, writable, (flags & FS_O_APPEND) != 0);
 
-        if (new_fd < 0)
+        if (new_file < 0)
         {
             regular_fs_backend.close(&file);
             return -1;
         }
-        open_files[new_fd - FIRST_REGULAR_FD].file = file;
-        open_files[new_fd - FIRST_REGULAR_FD].metadata = metadata_from_file(&file);
-        return new_fd;
+        open_files[new_file].file = file;
+        open_files[new_file].metadata = metadata_from_file(&file);
+        return new_file;
     }
 
 #ifdef CONFIG_TRACE_FS_OPEN_MISS
@@ -363,24 +484,47 @@ int fs_open(const char *pathname, int flags, int mode)
 }
 
 /*
- * Read up to len bytes from a descriptor and advance its offset on success.
+ * Read up to len bytes from an open file and advance its offset on success.
  */
-size_t fs_read(int fd, void *buf, size_t len)
+size_t fs_read(int file, void *buf, size_t len)
 {
-    assert(fd >= 0 && fd < MAX_OPEN_FILES);
+    OpenFile *open = open_file(file);
 
-    if (fd < FIRST_REGULAR_FD)
+    if (open == NULL)
     {
-        SpecialFile *file = &special_files[fd];
+        return (size_t)-1;
+    }
 
-        if (file->read == 0)
+    if (open->kind == OPEN_SPECIAL && open->special == SPECIAL_PROC_STAT)
+    {
+        // Like /proc/syscalls, a read from offset 0 takes a fresh snapshot.
+        if (open->offset == 0)
         {
-            return (size_t)-1;
+            open->stat.len = proc_stat_render(open->stat.pid, open->stat.text);
         }
-        return file->read(buf, special_offsets[fd], len);
+
+        const size_t ret = sysprof_copy(open->stat.text, open->stat.len, buf, open->offset, len);
+        open->offset += ret;
+        return ret;
     }
 
-    OpenFile *open = open_file(fd);
+    if (open->kind == OPEN_SPECIAL)
+    {
+        SpecialFile *special = &special_files[open->special];
+
+        if (special->read == 0)
+        {
+            return (size_t)-1;
+        }
+
+        const size_t ret = special->read(buf, open->offset, len);
+
+        if (special->text && ret != (size_t)-1)
+        {
+            open->offset += ret;
+        }
+        return ret;
+    }
 
     if (open->kind != OPEN_REGULAR || !open->readable)
     {
@@ -397,25 +541,28 @@ size_t fs_read(int fd, void *buf, size_t len)
 }
 
 /*
- * Write up to len bytes to a descriptor and advance its offset on success.
+ * Write up to len bytes to an open file and advance its offset on success.
  */
-size_t fs_write(int fd, const void *buf, size_t len)
+size_t fs_write(int file, const void *buf, size_t len)
 {
-    assert(fd >= 0 && fd < MAX_OPEN_FILES);
+    OpenFile *open = open_file(file);
 
-    if (fd < FIRST_REGULAR_FD)
+    if (open == NULL)
     {
-        SpecialFile *file = &special_files[fd];
+        return (size_t)-1;
+    }
 
-        if (file->write == 0)
+    if (open->kind == OPEN_SPECIAL)
+    {
+        SpecialFile *special = &special_files[open->special];
+
+        if (special->write == 0)
         {
             return (size_t)-1;
         }
-        return file->write(buf, special_offsets[fd], len);
+        return special->write(buf, open->offset, len);
     }
 
-    OpenFile *open = open_file(fd);
-
     if (open->kind != OPEN_REGULAR || !open->writable)
     {
         return (size_t)-1;
@@ -437,34 +584,37 @@ size_t fs_write(int fd, const void *buf, size_t len)
 }
 
 /*
- * Reposition a descriptor using SEEK_SET, SEEK_CUR, or SEEK_END.
+ * Reposition an open file using SEEK_SET, SEEK_CUR, or SEEK_END.
  */
-size_t fs_lseek(int fd, size_t offset, int whence)
+size_t fs_lseek(int file, size_t offset, int whence)
 {
-    assert(fd >= 0 && fd < MAX_OPEN_FILES);
+    OpenFile *open = open_file(file);
 
-    if (fd >= FIRST_REGULAR_FD)
+    if (open == NULL)
     {
-        OpenFile *open = open_file(fd);
+        return (size_t)-1;
+    }
 
-        if (open->kind == OPEN_DIRECTORY)
+    if (open->kind == OPEN_DIRECTORY)
+    {
+        if (whence != SEEK_SET || offset != 0)
         {
-            if (whence != SEEK_SET || offset != 0)
-            {
-                return (size_t)-1;
-            }
-            open->offset = 0;
-            open->dir.u.fat32.next_entry_index = 0;
-            return 0;
+            return (size_t)-1;
         }
+        open->offset = 0;
+        open->dir.u.fat32.next_entry_index = 0;
+        return 0;
+    }
 
+    if (open->kind == OPEN_REGULAR)
+    {
         const size_t new_offset = regular_fs_backend.lseek(&open->file, open->offset, offset, whence);
         open->offset = new_offset;
         return new_offset;
     }
 
-    const size_t old_offset = special_offsets[fd];
-    const size_t file_size = special_files[fd].size;
+    const size_t old_offset = open->offset;
+    const size_t file_size = special_files[open->special].size;
     size_t new_offset = -1;
 
     switch (whence)
@@ -483,41 +633,168 @@ size_t fs_lseek(int fd, size_t offset, int whence)
         return (size_t)-1;
     }
 
-    assert(new_offset <= file_size);
-    special_offsets[fd] = new_offset;
+    assert(special_files[open->special].text || new_offset <= file_size);
+    open->offset = new_offset;
     return new_offset;
 }
 
 /*
- * Close a regular or directory descriptor and make its slot reusable.
+ * Drop one reference and close the file with the last one.
  */
-int fs_close(int fd)
+int fs_close(int file)
 {
-    assert(fd >= 0 && fd < MAX_OPEN_FILES);
+    OpenFile *open = open_file(file);
 
-    if (fd < FIRST_REGULAR_FD)
+    if (open == NULL)
     {
-        return 0;
+        return -1;
     }
 
-    OpenFile *open = &open_files[fd - FIRST_REGULAR_FD];
-
-    if (open->kind == OPEN_NONE)
+    if (--open->refs > 0)
     {
         return 0;
     }
 
+    if (open->kind == OPEN_REGULAR && open->writable)
+    {
+        pagecache_invalidate(open->metadata.inode);
+    }
+
     const int ret = open->kind == OPEN_REGULAR ? regular_fs_backend.close(&open->file) : 0;
     memset(open, 0, sizeof(*open));
     return ret;
 }
 
+/*
+ * Copy a regular file's or directory's backend snapshot into a fresh slot.
+ */
+int fs_reopen(int file)
+{
+    const OpenFile *open = open_file(file);
+
+    if (open == NULL || (open->kind != OPEN_REGULAR && open->kind != OPEN_DIRECTORY))
+    {
+        return -1;
+    }
+
+    const int new_file = allocate_file(open->kind, open->readable, open->writable, open->append);
+
+    if (new_file < 0)
+    {
+        return -1;
+    }
+
+    OpenFile *copy = &open_files[new_file];
+    copy->metadata = open->metadata;
+    copy->file = open->file;
+    copy->dir = open->dir;
+    return new_file;
+}
+
+/*
+ * Open a read-only snapshot of a readable regular file for mmap().
+ */
+int fs_reopen_readonly(int file)
+{
+    const OpenFile *open = open_file(file);
+
+    if (open == NULL || open->kind != OPEN_REGULAR || !open->readable)
+    {
+        return -1;
+    }
+
+    const int new_file = allocate_file(OPEN_REGULAR, 1, 0, 0);
+
+    if (new_file < 0)
+    {
+        return -1;
+    }
+
+    OpenFile *copy = &open_files[new_file];
+    copy->metadata = open->metadata;
+    copy->file = open->file;
+    return new_file;
+}
+
+/*
+ * Descriptor tables.  A zeroed PCB has no descriptor open, which is why open
+ * file 0 is never handed out.
+ */
+int fs_fd_install(PCB *pcb, int file)
+{
+    for (int fd = 0; fd < MAX_FDS; fd++)
+    {
+        if (pcb->fds[fd] == 0)
+        {
+            pcb->fds[fd] = file;
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+int fs_fd_file(const PCB *pcb, int fd)
+{
+    return fd >= 0 && fd < MAX_FDS && pcb->fds[fd] != 0 ? pcb->fds[fd] : -1;
+}
+
+int fs_fd_close(PCB *pcb, int fd)
+{
+    const int file = fs_fd_file(pcb, fd);
+
+    if (file < 0)
+    {
+        return -1;
+    }
+
+    pcb->fds[fd] = 0;
+    return fs_close(file);
+}
+
+void fs_fd_stdio(PCB *pcb)
+{
+    static const char *const names[] = {"/dev/stdin", "stdout", "stderr"};
+
+    for (int i = 0; i < 3; i++)
+    {
+        const int file = fs_open(names[i], i == 0 ? FS_O_RDONLY : FS_O_WRONLY, 0);
+        const int fd = file > 0 ? fs_fd_install(pcb, file) : -1;
+
+        assert(fd == i);
+    }
+}
+
+void fs_fd_fork(PCB *child, const PCB *parent)
+{
+    for (int fd = 0; fd < MAX_FDS; fd++)
+    {
+        child->fds[fd] = parent->fds[fd];
+
+        if (child->fds[fd] != 0)
+        {
+            open_files[child->fds[fd]].refs++;
+        }
+    }
+}
+
+void fs_fd_release(PCB *pcb)
+{
+    for (int fd = 0; fd < MAX_FDS; fd++)
+    {
+        if (pcb->fds[fd] != 0)
+        {
+            fs_fd_close(pcb, fd);
+        }
+    }
+}
+
 /*
  * Fill metadata for a path.
  */
 int fs_stat(const char *pathname, NanosStat *buf)
 {
-    int fd;
+    int special;
     FsMetadata metadata;
 
     if (pathname == 0 || buf == 0)
@@ -525,11 +802,11 @@ int fs_stat(const char *pathname, NanosStat *buf)
         return -1;
     }
 
-    fd = find_special_file(pathname);
+    special = find_special_file(pathname);
 
-    if (fd >= 0)
+    if (special >= 0)
     {
-        fill_stat_from_special(buf, fd);
+        fill_stat_from_special(buf, special);
         return 0;
     }
 
@@ -543,24 +820,24 @@ int fs_stat(const char *pathname, NanosStat *buf)
 }
 
 /*
- * Fill metadata for an open descriptor.
+ * Fill metadata for an open file.
  */
-int fs_fstat(int fd, NanosStat *buf)
+int fs_fstat(int file, NanosStat *buf)
 {
-    if (fd < 0 || fd >= MAX_OPEN_FILES || buf == 0)
+    OpenFile *open = open_file(file);
+    FsMetadata metadata;
+
+    if (open == NULL || buf == 0)
     {
         return -1;
     }
 
-    if (fd < FIRST_REGULAR_FD)
+    if (open->kind == OPEN_SPECIAL)
     {
-        fill_stat_from_special(buf, fd);
+        fill_stat_from_special(buf, open->special);
         return 0;
     }
 
-    OpenFile *open = open_file(fd);
-    FsMetadata metadata;
-
     metadata = open->metadata;
 
     if (open->kind == OPEN_REGULAR)
@@ -595,22 +872,16 @@ static int fill_nanos_dirent(NanosDirent *dent, const FsDirent *entry, int64_t n
 }
 
 /*
- * Return fixed-size NanosDirent records for an open directory descriptor.
+ * Return fixed-size NanosDirent records for an open directory.
  */
-int fs_getdents(int fd, void *buf, int len)
+int fs_getdents(int file, void *buf, int len)
 {
     NanosDirent *dst = (NanosDirent *)buf;
     size_t used = 0;
     const size_t record_len = sizeof(NanosDirent);
+    OpenFile *open = open_file(file);
 
-    if (fd < FIRST_REGULAR_FD || fd >= MAX_OPEN_FILES || buf == 0 || len <= 0 || (size_t)len < record_len)
-    {
-        return -1;
-    }
-
-    OpenFile *open = open_file(fd);
-
-    if (open->kind != OPEN_DIRECTORY)
+    if (open == NULL || open->kind != OPEN_DIRECTORY || buf == 0 || len <= 0 || (size_t)len < record_len)
     {
         return -1;
     }
@@ -652,16 +923,11 @@ int fs_getdents(int fd, void *buf, int len)
 /*
  * Resize an open regular file.
  */
-int fs_ftruncate(int fd, size_t size)
+int fs_ftruncate(int file, size_t size)
 {
-    if (fd < FIRST_REGULAR_FD || fd >= MAX_OPEN_FILES)
-    {
-        return -1;
-    }
-
-    OpenFile *open = open_file(fd);
+    OpenFile *open = open_file(file);
 
-    if (open->kind != OPEN_REGULAR || !open->writable)
+    if (open == NULL || open->kind != OPEN_REGULAR || !open->writable)
     {
         return -1;
     }
@@ -675,6 +941,20 @@ int fs_ftruncate(int fd, size_t size)
     return ret;
 }
 
+/*
+ * Flush the disk block cache for fsync(fd) or sync().
+ */
+int fs_fsync(int file)
+{
+    if (file != -1 && open_file(file) == NULL)
+    {
+        return -1;
+    }
+
+    disk_sync();
+    return 0;
+}
+
 /*
  * Resize a regular file by pathname.
  */
@@ -688,6 +968,7 @@ int fs_truncate(const char *pathname, size_t size)
         return -1;
     }
 
+    pagecache_invalidate(metadata_from_file(&file).inode);
     ret = regular_fs_backend.truncate(&file, size);
     regular_fs_backend.close(&file);
     return ret;
@@ -703,6 +984,7 @@ int fs_unlink(const char *pathname)
         return -1;
     }
 
+    forget_cached_pages(pathname);
     return regular_fs_backend.unlink(pathname);
 }
 
@@ -745,5 +1027,8 @@ int fs_rename(const char *old_path, const char *new_path)
         return -1;
     }
 
+    // The moved entry gets a new identity and the replaced one goes away.
+    forget_cached_pages(old_path);
+    forget_cached_pages(new_path);
     return regular_fs_backend.rename(old_path, new_path);
 }
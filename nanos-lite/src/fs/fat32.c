@@ -185,32 +185,69 @@ static void put_le32(uint8_t *p, uint32_t value)
 }
 
 /*
- * Follow a FAT chain to a logical cluster index, using verified contiguity and
- * the last cached chain position to avoid repeatedly walking from the start.
+ * Note a FAT link that was just followed; it may extend both the contiguous
+ * prefix and the file's extent map.
  */
-static int seek_cluster(Fat32File *file, uint32_t cluster_index, uint32_t *out_cluster)
+static void remember_cluster(Fat32File *file, uint32_t cluster_index, uint32_t cluster)
 {
-    uint32_t cluster = file->first_cluster;
-    uint32_t index = 0;
+    remember_contiguous_cluster(file, cluster_index, cluster);
+    fat32_extent_add(&mounted_volume.extents, file->first_cluster, cluster_index, cluster, 1);
+}
 
-    if (!is_data_cluster(&mounted_volume, cluster))
+/*
+ * Resolve a logical cluster from the verified contiguous prefix or the file's
+ * extent map without reading the FAT.  Returns 1 when one of them covers the
+ * index, 0 when neither does, and -1 for an impossible cluster number.
+ */
+static int known_cluster(const Fat32File *file, uint32_t cluster_index, uint32_t *out_cluster)
+{
+    uint64_t cluster;
+    uint32_t mapped;
+    uint32_t run;
+
+    if (file->contiguous_cluster_count > cluster_index)
     {
-        return -1;
+        cluster = (uint64_t)file->first_cluster + cluster_index;
+    }
+    else if (fat32_extent_lookup(&mounted_volume.extents, file->first_cluster, cluster_index, &mapped, &run) == 0)
+    {
+        cluster = mapped;
+    }
+    else
+    {
+        return 0;
     }
 
-    if (file->contiguous_cluster_count > cluster_index)
+    if (cluster > UINT32_MAX || !is_data_cluster(&mounted_volume, (uint32_t)cluster))
     {
-        const uint64_t direct_cluster = (uint64_t)file->first_cluster + cluster_index;
+        return -1;
+    }
 
-        if (direct_cluster > UINT32_MAX || !is_data_cluster(&mounted_volume, (uint32_t)direct_cluster))
-        {
-            return -1;
-        }
+    *out_cluster = (uint32_t)cluster;
+    return 1;
+}
 
-        file->cached_cluster_index = cluster_index;
-        file->cached_cluster = (uint32_t)direct_cluster;
-        *out_cluster = (uint32_t)direct_cluster;
-        return 0;
+/*
+ * Pick where a chain walk towards cluster_index starts: the furthest point
+ * before it that the contiguous prefix, the extent map, or the cached position
+ * already resolves.  A file walked past its prefix gets an extent map seeded
+ * with that prefix, so the links followed now are not followed again.
+ */
+static void walk_start(Fat32File *file, uint32_t cluster_index, uint32_t *out_index, uint32_t *out_cluster)
+{
+    Fat32ExtentCache *extents = &mounted_volume.extents;
+    uint32_t mapped = fat32_extent_mapped(extents, file->first_cluster);
+    uint32_t cluster = file->first_cluster;
+    uint32_t index = 0;
+    uint32_t mapped_cluster;
+    uint32_t run;
+
+    if (mapped == 0)
+    {
+        const uint32_t prefix = file->contiguous_cluster_count > 0 ? file->contiguous_cluster_count : 1u;
+
+        fat32_extent_add(extents, file->first_cluster, 0, file->first_cluster, prefix);
+        mapped = fat32_extent_mapped(extents, file->first_cluster);
     }
 
     if (file->contiguous_cluster_count > 0)
@@ -225,6 +262,14 @@ static int seek_cluster(Fat32File *file, uint32_t cluster_index, uint32_t *out_c
         }
     }
 
+    if (mapped > index + 1u && mapped - 1u <= cluster_index &&
+        fat32_extent_lookup(extents, file->first_cluster, mapped - 1u, &mapped_cluster, &run) == 0 &&
+        is_data_cluster(&mounted_volume, mapped_cluster))
+    {
+        cluster = mapped_cluster;
+        index = mapped - 1u;
+    }
+
     /*
      * Reads commonly advance forwards.  Reusing the cached point keeps repeated
      * small reads from restarting at the first cluster every time.
@@ -235,127 +280,146 @@ static int seek_cluster(Fat32File *file, uint32_t cluster_index, uint32_t *out_c
         index = file->cached_cluster_index;
     }
 
-    while (index < cluster_index)
+    *out_index = index;
+    *out_cluster = cluster;
+}
+
+/*
+ * Follow a FAT chain to a logical cluster index.  Verified contiguity and the
+ * extent map answer most seeks directly; otherwise the walk starts from the
+ * furthest point already known.
+ */
+static int seek_cluster(Fat32File *file, uint32_t cluster_index, uint32_t *out_cluster)
+{
+    uint32_t cluster;
+    uint32_t index;
+
+    if (!is_data_cluster(&mounted_volume, file->first_cluster))
     {
-        uint32_t next_cluster;
+        return -1;
+    }
 
-        if (fat32_read_fat_entry(&mounted_volume, cluster, &next_cluster) != 0)
-        {
-            return -1;
-        }
+    const int known = known_cluster(file, cluster_index, &cluster);
 
-        if (is_unusable_chain_value(&mounted_volume, next_cluster))
+    if (known < 0)
+    {
+        return -1;
+    }
+
+    if (known == 0)
+    {
+        walk_start(file, cluster_index, &index, &cluster);
+
+        while (index < cluster_index)
         {
-            return -1;
-        }
+            uint32_t next_cluster;
+
+            if (fat32_read_fat_entry(&mounted_volume, cluster, &next_cluster) != 0)
+            {
+                return -1;
+            }
+
+            if (is_unusable_chain_value(&mounted_volume, next_cluster))
+            {
+                return -1;
+            }
 
-        cluster = next_cluster & FAT32_ENTRY_MASK;
-        index++;
-        remember_contiguous_cluster(file, index, cluster);
+            cluster = next_cluster & FAT32_ENTRY_MASK;
+            index++;
+            remember_cluster(file, index, cluster);
+        }
     }
 
-    file->cached_cluster_index = index;
+    file->cached_cluster_index = cluster_index;
     file->cached_cluster = cluster;
     *out_cluster = cluster;
     return 0;
 }
 
 /*
- * Ensure a logical cluster exists, allocating and linking new clusters as needed.
+ * Ensure a logical cluster exists, allocating and linking new clusters as
+ * needed.  last_index is the last cluster the caller is about to use; growing
+ * the chain claims everything up to it as one extent where free space allows,
+ * so a large write lands in consecutive clusters.
  */
-static int ensure_cluster(Fat32File *file, uint32_t cluster_index, uint32_t *out_cluster)
+static int ensure_cluster(Fat32File *file, uint32_t cluster_index, uint32_t last_index, uint32_t *out_cluster)
 {
     uint32_t cluster;
-    uint32_t index = 0;
+    uint32_t index;
+
+    if (last_index < cluster_index)
+    {
+        last_index = cluster_index;
+    }
 
     if (file->first_cluster == 0)
     {
-        if (fat32_alloc_cluster(&mounted_volume, 0, &cluster) != 0)
+        uint32_t count;
+
+        if (last_index == UINT32_MAX || fat32_alloc_extent(&mounted_volume, 0, last_index + 1u, &cluster, &count) != 0)
         {
             return -1;
         }
         file->first_cluster = cluster;
         file->cached_cluster_index = 0;
         file->cached_cluster = cluster;
-        file->contiguous_cluster_count = 1;
+        file->contiguous_cluster_count = count;
     }
 
-    cluster = file->first_cluster;
-
-    if (!is_data_cluster(&mounted_volume, cluster))
+    if (!is_data_cluster(&mounted_volume, file->first_cluster))
     {
         return -1;
     }
 
-    if (file->contiguous_cluster_count > cluster_index)
-    {
-        const uint64_t direct_cluster = (uint64_t)file->first_cluster + cluster_index;
-
-        if (direct_cluster > UINT32_MAX || !is_data_cluster(&mounted_volume, (uint32_t)direct_cluster))
-        {
-            return -1;
-        }
-
-        file->cached_cluster_index = cluster_index;
-        file->cached_cluster = (uint32_t)direct_cluster;
-        *out_cluster = (uint32_t)direct_cluster;
-        return 0;
-    }
-
-    if (file->contiguous_cluster_count > 0)
-    {
-        const uint32_t prefix_last_index = file->contiguous_cluster_count - 1u;
-        const uint64_t prefix_last_cluster = (uint64_t)file->first_cluster + prefix_last_index;
+    const int known = known_cluster(file, cluster_index, &cluster);
 
-        if (prefix_last_cluster <= UINT32_MAX && is_data_cluster(&mounted_volume, (uint32_t)prefix_last_cluster))
-        {
-            cluster = (uint32_t)prefix_last_cluster;
-            index = prefix_last_index;
-        }
-    }
-
-    if (file->cached_cluster != 0 && file->cached_cluster_index <= cluster_index && file->cached_cluster_index > index && is_data_cluster(&mounted_volume, file->cached_cluster))
+    if (known < 0)
     {
-        cluster = file->cached_cluster;
-        index = file->cached_cluster_index;
+        return -1;
     }
 
-    while (index < cluster_index)
+    if (known == 0)
     {
-        uint32_t next_cluster;
+        walk_start(file, cluster_index, &index, &cluster);
 
-        if (fat32_read_fat_entry(&mounted_volume, cluster, &next_cluster) != 0)
-        {
-            return -1;
-        }
-
-        if (fat32_is_end_of_chain(next_cluster))
+        while (index < cluster_index)
         {
-            uint32_t new_cluster;
+            uint32_t next_cluster;
 
-            if (fat32_alloc_cluster(&mounted_volume, cluster, &new_cluster) != 0)
+            if (fat32_read_fat_entry(&mounted_volume, cluster, &next_cluster) != 0)
             {
                 return -1;
             }
 
-            if (fat32_write_fat_entry(&mounted_volume, cluster, new_cluster) != 0)
+            if (fat32_is_end_of_chain(next_cluster))
+            {
+                uint32_t new_cluster;
+                uint32_t count;
+
+                if (fat32_alloc_extent(&mounted_volume, cluster, last_index - index, &new_cluster, &count) != 0)
+                {
+                    return -1;
+                }
+
+                if (fat32_write_fat_entry(&mounted_volume, cluster, new_cluster) != 0)
+                {
+                    (void)fat32_free_chain(&mounted_volume, new_cluster);
+                    return -1;
+                }
+                next_cluster = new_cluster;
+            }
+            else if (is_unusable_chain_value(&mounted_volume, next_cluster))
             {
-                (void)fat32_free_chain(&mounted_volume, new_cluster);
                 return -1;
             }
-            next_cluster = new_cluster;
-        }
-        else if (is_unusable_chain_value(&mounted_volume, next_cluster))
-        {
-            return -1;
-        }
 
-        cluster = next_cluster & FAT32_ENTRY_MASK;
-        index++;
-        remember_contiguous_cluster(file, index, cluster);
+            cluster = next_cluster & FAT32_ENTRY_MASK;
+            index++;
+            remember_cluster(file, index, cluster);
+        }
     }
 
-    file->cached_cluster_index = index;
+    file->cached_cluster_index = cluster_index;
     file->cached_cluster = cluster;
     *out_cluster = cluster;
     return 0;
@@ -452,16 +516,21 @@ static int build_read_run(Fat32File *file, uint32_t cluster_index, uint32_t clus
             break;
         }
 
-        if (file->contiguous_cluster_count > current_index + 1u)
+        uint32_t next_cluster;
+
+        if (known_cluster(file, current_index + 1u, &next_cluster) == 1)
         {
+            if ((uint64_t)next_cluster != (uint64_t)current_cluster + 1u)
+            {
+                break;
+            }
+
             current_index++;
-            current_cluster++;
+            current_cluster = next_cluster;
             cluster_offset = 0;
             continue;
         }
 
-        uint32_t next_cluster;
-
         if (fat32_read_fat_entry(&mounted_volume, current_cluster, &next_cluster) != 0)
         {
             break;
@@ -481,7 +550,7 @@ static int build_read_run(Fat32File *file, uint32_t cluster_index, uint32_t clus
 
         current_index++;
         current_cluster = next_cluster;
-        remember_contiguous_cluster(file, current_index, current_cluster);
+        remember_cluster(file, current_index, current_cluster);
         cluster_offset = 0;
     }
 
@@ -557,6 +626,8 @@ static size_t write_bytes(Fat32File *file, size_t offset, const void *buf, size_
         return 0;
     }
 
+    const uint32_t last_index = (uint32_t)((offset + len - 1u) / cluster_size);
+
     while (remaining > 0)
     {
         const uint32_t cluster_index = (uint32_t)(offset / cluster_size);
@@ -572,7 +643,7 @@ static size_t write_bytes(Fat32File *file, size_t offset, const void *buf, size_
             break;
         }
 
-        if (ensure_cluster(file, cluster_index, &cluster) != 0)
+        if (ensure_cluster(file, cluster_index, last_index, &cluster) != 0)
         {
             break;
         }
@@ -642,7 +713,20 @@ static size_t write_bytes(Fat32File *file, size_t offset, const void *buf, size_
 static size_t zero_fill_gap(Fat32File *file, size_t offset, size_t len)
 {
     uint8_t zero[FAT32_SECTOR_SIZE];
+    size_t cluster_size;
     size_t done = 0;
+    uint32_t cluster;
+
+    /*
+     * The gap is written a sector at a time; claim all of its clusters first so
+     * they come as one extent instead of one allocation per cluster.
+     */
+    if (len > 0 && offset + len - 1u <= UINT32_MAX && cluster_size_bytes(&mounted_volume, &cluster_size) == 0)
+    {
+        const uint32_t last_index = (uint32_t)((offset + len - 1u) / cluster_size);
+
+        (void)ensure_cluster(file, last_index, last_index, &cluster);
+    }
 
     memset(zero, 0, sizeof(zero));
     while (done < len)
@@ -937,6 +1021,7 @@ static int shrink_file(Fat32File *file, uint32_t size)
         {
             return -1;
         }
+        fat32_extent_truncate(&mounted_volume.extents, file->first_cluster, keep_clusters);
 
         if (!fat32_is_end_of_chain(first_freed))
         {
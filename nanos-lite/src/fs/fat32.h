@@ -13,6 +13,12 @@
 #define FAT32_ATTR_LONG_NAME (FAT32_ATTR_READ_ONLY | FAT32_ATTR_HIDDEN | FAT32_ATTR_SYSTEM | FAT32_ATTR_VOLUME_ID)
 #define FAT32_MAX_NAME 260u
 #define FAT32_FAT_CACHE_SIZE (128u * 1024u)
+#define FAT32_DCACHE_SETS 128u
+#define FAT32_DCACHE_WAYS 4u
+#define FAT32_DCACHE_NAME_MAX 47u
+#define FAT32_FREE_BITMAP_CLUSTERS (1u << 20)
+#define FAT32_EXTENT_MAPS 16u
+#define FAT32_EXTENT_MAP_SIZE 32u
 
 /*
  * One 32-byte FAT long-file-name slot, stored immediately before the matching
@@ -49,6 +55,75 @@ typedef struct __attribute__((packed))
     uint16_t name3[2];
 } Fat32LfnEntry;
 
+/*
+ * One remembered lookup of a name in a directory.  Positive entries keep only
+ * where the short entry lives, not its contents: writes change a file's size
+ * and first cluster in place, so a hit re-reads those 32 bytes.
+ */
+typedef struct
+{
+    /* Directory searched; zero marks a free slot since no cluster 0 exists. */
+    uint32_t parent_cluster;
+    /* Non-zero for a negative entry: the directory has no such name. */
+    uint8_t missing;
+    /* Component in lower case; longer names are never cached. */
+    char name[FAT32_DCACHE_NAME_MAX + 1u];
+    /* Absolute byte offset of the short entry for positive entries. */
+    uint64_t entry_offset;
+    /* Value of Fat32Dcache::clock at the last hit, for LRU replacement. */
+    uint32_t last_use;
+} Fat32DcacheEntry;
+
+/*
+ * Set-associative cache of (directory cluster, name) lookups, so resolving a
+ * path costs one probe per component instead of a directory scan with LFN
+ * reassembly.  Anything that adds or removes directory entries drops every
+ * entry of the directories involved.
+ */
+typedef struct
+{
+    Fat32DcacheEntry entries[FAT32_DCACHE_SETS * FAT32_DCACHE_WAYS];
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t negative_hits;
+    uint32_t misses;
+} Fat32Dcache;
+
+/* Clusters file_index .. file_index + length - 1 of a file, stored in a row. */
+typedef struct
+{
+    uint32_t file_index;
+    uint32_t cluster;
+    uint32_t length;
+} Fat32Extent;
+
+/*
+ * The extents of the first mapped_clusters clusters of one file, sorted by
+ * file_index, so a seek is a binary search instead of a FAT chain walk.  The
+ * map only ever covers a prefix of the chain; walks past its end extend it.
+ */
+typedef struct
+{
+    /* First cluster of the file; zero marks a free slot. */
+    uint32_t first_cluster;
+    uint32_t nr_extents;
+    uint32_t mapped_clusters;
+    /* Value of Fat32ExtentCache::clock at the last use, for LRU replacement. */
+    uint32_t last_use;
+    Fat32Extent extents[FAT32_EXTENT_MAP_SIZE];
+} Fat32ExtentMap;
+
+/*
+ * Extent maps of recently used fragmented files.  Maps live in the volume,
+ * keyed by first cluster, rather than in each descriptor, so every descriptor
+ * of a file sees a truncation the moment the chain is cut.
+ */
+typedef struct
+{
+    Fat32ExtentMap maps[FAT32_EXTENT_MAPS];
+    uint32_t clock;
+} Fat32ExtentCache;
+
 /*
  * Mounted FAT32 volume geometry and small caches derived from the BPB, FSInfo,
  * and FAT.  All sector counts are expressed in 512-byte sectors because this
@@ -141,6 +216,18 @@ typedef struct
      * sector while still validating the chain before treating data as contiguous.
      */
     uint8_t fat_sector_cache[FAT32_FAT_CACHE_SIZE];
+    /* Directory lookups; starts empty because mounting clears the volume. */
+    Fat32Dcache dcache;
+    /*
+     * One bit per data cluster, set while the cluster is free; bit 0 is cluster
+     * 2.  Built from the FAT at mount so allocation can find free runs without
+     * reading FAT sectors.  Volumes with more than FAT32_FREE_BITMAP_CLUSTERS
+     * clusters leave free_bitmap_valid clear and allocate by scanning the FAT.
+     */
+    uint8_t free_bitmap_valid;
+    uint64_t free_bitmap[FAT32_FREE_BITMAP_CLUSTERS / 64u];
+    /* Per-file extent maps; starts empty because mounting clears the volume. */
+    Fat32ExtentCache extents;
 } Fat32Volume;
 
 /*
@@ -220,8 +307,17 @@ int fat32_read_fat_entry(const Fat32Volume *vol, uint32_t cluster, uint32_t *nex
 int fat32_write_fat_entry(const Fat32Volume *vol, uint32_t cluster, uint32_t value);
 int fat32_load_fsinfo(Fat32Volume *vol);
 int fat32_flush_fsinfo(const Fat32Volume *vol);
+int fat32_build_free_bitmap(Fat32Volume *vol);
 int fat32_alloc_cluster(Fat32Volume *vol, uint32_t preferred_after, uint32_t *out_cluster);
+int fat32_alloc_extent(Fat32Volume *vol, uint32_t preferred_after, uint32_t want, uint32_t *out_first, uint32_t *out_count);
 int fat32_free_chain(Fat32Volume *vol, uint32_t first_cluster);
+int fat32_dcache_lookup(Fat32Dcache *cache, uint32_t parent_cluster, const char *name, uint64_t *entry_offset);
+void fat32_dcache_insert(Fat32Dcache *cache, uint32_t parent_cluster, const char *name, int found, uint64_t entry_offset);
+void fat32_dcache_invalidate_dir(Fat32Dcache *cache, uint32_t parent_cluster);
+int fat32_extent_lookup(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t file_index, uint32_t *out_cluster, uint32_t *out_run);
+uint32_t fat32_extent_mapped(Fat32ExtentCache *cache, uint32_t first_cluster);
+void fat32_extent_add(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t file_index, uint32_t cluster, uint32_t count);
+void fat32_extent_truncate(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t nr_clusters);
 int fat32_lookup_path(const Fat32Volume *vol, const char *path, Fat32DirEntry *out);
 int fat32_opendir_path(const Fat32Volume *vol, const char *path, Fat32Dir *out);
 int fat32_readdir(Fat32Volume *vol, Fat32Dir *dir, Fat32Dirent *out);
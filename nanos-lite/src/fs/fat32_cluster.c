@@ -171,6 +171,28 @@ static int zero_cluster(const Fat32Volume *vol, uint32_t cluster)
     return 0;
 }
 
+static int bitmap_test(const Fat32Volume *vol, uint32_t cluster)
+{
+    const uint32_t bit = cluster - 2u;
+
+    return (vol->free_bitmap[bit / 64u] >> (bit % 64u)) & 1u;
+}
+
+static void bitmap_set(Fat32Volume *vol, uint32_t cluster, int free)
+{
+    const uint32_t bit = cluster - 2u;
+    const uint64_t mask = (uint64_t)1 << (bit % 64u);
+
+    if (free)
+    {
+        vol->free_bitmap[bit / 64u] |= mask;
+    }
+    else
+    {
+        vol->free_bitmap[bit / 64u] &= ~mask;
+    }
+}
+
 static void mark_cluster_allocated(Fat32Volume *vol, uint32_t cluster)
 {
     if (vol->free_cluster_count != FAT32_UNKNOWN_COUNT && vol->free_cluster_count > 0)
@@ -178,6 +200,11 @@ static void mark_cluster_allocated(Fat32Volume *vol, uint32_t cluster)
         vol->free_cluster_count--;
     }
 
+    if (vol->free_bitmap_valid)
+    {
+        bitmap_set(vol, cluster, 0);
+    }
+
     const uint32_t next = cluster + 1u;
     vol->next_free_cluster = is_data_cluster(vol, next) ? next : FAT32_UNKNOWN_COUNT;
 }
@@ -189,6 +216,11 @@ static void mark_cluster_freed(Fat32Volume *vol, uint32_t cluster)
         vol->free_cluster_count++;
     }
 
+    if (vol->free_bitmap_valid)
+    {
+        bitmap_set(vol, cluster, 1);
+    }
+
     if (vol->next_free_cluster == FAT32_UNKNOWN_COUNT || cluster < vol->next_free_cluster)
     {
         vol->next_free_cluster = cluster;
@@ -415,28 +447,150 @@ int fat32_flush_fsinfo(const Fat32Volume *vol)
     return 0;
 }
 
-int fat32_alloc_cluster(Fat32Volume *vol, uint32_t preferred_after, uint32_t *out_cluster)
+/*
+ * Build the free-cluster bitmap from the active FAT.  The scan also gives the
+ * true free count, which replaces the advisory FSI_Free_Count.  A volume too
+ * large for the bitmap, or a FAT that cannot be read in full, keeps allocating
+ * by FAT scan.
+ */
+int fat32_build_free_bitmap(Fat32Volume *vol)
 {
-    uint32_t start;
+    uint32_t free_count = 0;
 
-    if (vol == 0 || out_cluster == 0)
+    if (vol == 0)
     {
         return -1;
     }
 
-    if (is_data_cluster(vol, preferred_after) && is_data_cluster(vol, preferred_after + 1u))
+    vol->free_bitmap_valid = 0;
+
+    if (vol->cluster_count == 0 || vol->cluster_count > FAT32_FREE_BITMAP_CLUSTERS)
     {
-        start = preferred_after + 1u;
+        return 0;
     }
-    else if (is_data_cluster(vol, vol->next_free_cluster))
+
+    memset(vol->free_bitmap, 0, ((size_t)vol->cluster_count + 63u) / 64u * sizeof(vol->free_bitmap[0]));
+
+    for (uint32_t cluster = 2; cluster <= vol->cluster_count + 1u; cluster++)
     {
-        start = vol->next_free_cluster;
+        uint32_t value;
+
+        if (fat32_read_fat_entry(vol, cluster, &value) != 0)
+        {
+            return 0;
+        }
+
+        if (value == 0)
+        {
+            bitmap_set(vol, cluster, 1);
+            free_count++;
+        }
     }
-    else
+
+    vol->free_bitmap_valid = 1;
+    vol->free_cluster_count = free_count;
+    return 0;
+}
+
+/*
+ * First free cluster in [from, to), or 0.  Whole words of allocated clusters
+ * are skipped at once.
+ */
+static uint32_t bitmap_find_free(const Fat32Volume *vol, uint32_t from, uint32_t to)
+{
+    uint32_t bit = from - 2u;
+    const uint32_t end = to - 2u;
+
+    while (from < to && bit < end)
     {
-        start = 2;
+        uint64_t word = vol->free_bitmap[bit / 64u] >> (bit % 64u);
+
+        if (word == 0)
+        {
+            bit = (bit / 64u + 1u) * 64u;
+            continue;
+        }
+
+        while ((word & 1u) == 0)
+        {
+            word >>= 1;
+            bit++;
+        }
+
+        return bit < end ? bit + 2u : 0;
+    }
+
+    return 0;
+}
+
+static uint32_t free_run_length(const Fat32Volume *vol, uint32_t cluster, uint32_t want)
+{
+    uint32_t count = 0;
+
+    while (count < want && is_data_cluster(vol, cluster + count) && bitmap_test(vol, cluster + count))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Choose up to want free clusters in a row, searching from start and wrapping
+ * once.  A run beginning right at start is taken whatever its length, so a
+ * growing file stays next to its tail; otherwise the first run long enough
+ * wins, or the longest seen when none is.  Returns 0 on a full volume.
+ */
+static uint32_t pick_free_run(const Fat32Volume *vol, uint32_t start, uint32_t want, uint32_t *out_count)
+{
+    const uint32_t end = vol->cluster_count + 2u;
+    uint32_t best = 0;
+    uint32_t best_count = 0;
+    uint32_t cluster = start;
+    int wrapped = 0;
+
+    for (;;)
+    {
+        const uint32_t found = bitmap_find_free(vol, cluster, wrapped ? start : end);
+
+        if (found == 0)
+        {
+            if (wrapped || start == 2)
+            {
+                break;
+            }
+
+            wrapped = 1;
+            cluster = 2;
+            continue;
+        }
+
+        const uint32_t count = free_run_length(vol, found, want);
+
+        if (count == want || found == start)
+        {
+            *out_count = count;
+            return found;
+        }
+
+        if (count > best_count)
+        {
+            best = found;
+            best_count = count;
+        }
+
+        cluster = found + count;
     }
 
+    *out_count = best_count;
+    return best;
+}
+
+/*
+ * Find one free cluster by reading FAT entries, for volumes without a bitmap.
+ */
+static int scan_fat_for_free(const Fat32Volume *vol, uint32_t start, uint32_t *out_cluster)
+{
     for (uint32_t scanned = 0; scanned < vol->cluster_count; scanned++)
     {
         const uint32_t cluster = 2u + ((start - 2u + scanned) % vol->cluster_count);
@@ -447,34 +601,98 @@ int fat32_alloc_cluster(Fat32Volume *vol, uint32_t preferred_after, uint32_t *ou
             return -1;
         }
 
-        if (value != 0)
+        if (value == 0)
         {
-            continue;
+            *out_cluster = cluster;
+            return 0;
         }
+    }
 
-        if (fat32_write_fat_entry(vol, cluster, FAT32_EOC_VALUE) != 0)
-        {
-            return -1;
-        }
+    return -1;
+}
+
+int fat32_alloc_cluster(Fat32Volume *vol, uint32_t preferred_after, uint32_t *out_cluster)
+{
+    uint32_t count;
+
+    return fat32_alloc_extent(vol, preferred_after, 1, out_cluster, &count);
+}
+
+/*
+ * Allocate up to want clusters that sit next to each other on disk, linked in
+ * order and ending in EOC, and zero them.  Fewer come back when free space has
+ * no run that long; the caller asks again for the rest.
+ */
+int fat32_alloc_extent(Fat32Volume *vol, uint32_t preferred_after, uint32_t want, uint32_t *out_first, uint32_t *out_count)
+{
+    uint32_t start;
+    uint32_t first;
+    uint32_t count = 1;
 
-        if (zero_cluster(vol, cluster) != 0)
+    if (vol == 0 || out_first == 0 || out_count == 0 || want == 0)
+    {
+        return -1;
+    }
+
+    if (is_data_cluster(vol, preferred_after) && is_data_cluster(vol, preferred_after + 1u))
+    {
+        start = preferred_after + 1u;
+    }
+    else if (is_data_cluster(vol, vol->next_free_cluster))
+    {
+        start = vol->next_free_cluster;
+    }
+    else
+    {
+        start = 2;
+    }
+
+    if (vol->free_bitmap_valid)
+    {
+        first = pick_free_run(vol, start, want, &count);
+
+        if (first == 0)
         {
-            (void)fat32_write_fat_entry(vol, cluster, 0);
             return -1;
         }
+    }
+    else if (scan_fat_for_free(vol, start, &first) != 0)
+    {
+        return -1;
+    }
 
-        mark_cluster_allocated(vol, cluster);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t cluster = first + i;
 
-        if (fat32_flush_fsinfo(vol) != 0)
+        if (fat32_write_fat_entry(vol, cluster, i + 1u < count ? cluster + 1u : FAT32_EOC_VALUE) != 0 ||
+            zero_cluster(vol, cluster) != 0)
         {
+            // Hand back everything claimed so far, including this cluster.
+            for (uint32_t undo = 0; undo <= i; undo++)
+            {
+                (void)fat32_write_fat_entry(vol, first + undo, 0);
+
+                if (undo < i)
+                {
+                    mark_cluster_freed(vol, first + undo);
+                }
+            }
+
             return -1;
         }
 
-        *out_cluster = cluster;
-        return 0;
+        mark_cluster_allocated(vol, cluster);
     }
 
-    return -1;
+    if (fat32_flush_fsinfo(vol) != 0)
+    {
+        return -1;
+    }
+
+    *out_first = first;
+    *out_count = count;
+    return 0;
 }
 
 int fat32_free_chain(Fat32Volume *vol, uint32_t first_cluster)
@@ -496,6 +714,9 @@ int fat32_free_chain(Fat32Volume *vol, uint32_t first_cluster)
         return -1;
     }
 
+    // A freed first cluster may start another file soon; its map must go now.
+    fat32_extent_truncate(&vol->extents, first_cluster, 0);
+
     for (uint32_t links = 0; links < vol->cluster_count; links++)
     {
         uint32_t next;
@@ -0,0 +1,143 @@
+#include "fat32.h"
+
+#include <string.h>
+
+/*
+ * Lower-case a component into a cache key.  Returns 0 when the name is too
+ * long to cache.
+ */
+static int make_key(const char *name, char key[FAT32_DCACHE_NAME_MAX + 1u])
+{
+    size_t len = 0;
+
+    for (; name[len] != '\0'; len++)
+    {
+        const char ch = name[len];
+
+        if (len == FAT32_DCACHE_NAME_MAX)
+        {
+            return 0;
+        }
+        key[len] = ch >= 'A' && ch <= 'Z' ? (char)(ch - 'A' + 'a') : ch;
+    }
+
+    key[len] = '\0';
+    return 1;
+}
+
+/*
+ * FNV-1a over the key, seeded with the directory cluster.
+ */
+static Fat32DcacheEntry *set_of(Fat32Dcache *cache, uint32_t parent_cluster, const char *key)
+{
+    uint32_t hash = 2166136261u ^ parent_cluster;
+
+    for (const char *p = key; *p != '\0'; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    return &cache->entries[(hash % FAT32_DCACHE_SETS) * FAT32_DCACHE_WAYS];
+}
+
+static Fat32DcacheEntry *find_entry(Fat32DcacheEntry *set, uint32_t parent_cluster, const char *key)
+{
+    for (uint32_t way = 0; way < FAT32_DCACHE_WAYS; way++)
+    {
+        if (set[way].parent_cluster == parent_cluster && strcmp(set[way].name, key) == 0)
+        {
+            return &set[way];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Look a component up in the cache.  Returns 1 with the short entry's offset
+ * for a known name, 0 for a name known to be missing, and -1 when the cache
+ * cannot tell.
+ */
+int fat32_dcache_lookup(Fat32Dcache *cache, uint32_t parent_cluster, const char *name, uint64_t *entry_offset)
+{
+    char key[FAT32_DCACHE_NAME_MAX + 1u];
+    Fat32DcacheEntry *entry;
+
+    if (parent_cluster == 0 || !make_key(name, key) ||
+        (entry = find_entry(set_of(cache, parent_cluster, key), parent_cluster, key)) == 0)
+    {
+        cache->misses++;
+        return -1;
+    }
+
+    entry->last_use = ++cache->clock;
+
+    if (entry->missing)
+    {
+        cache->negative_hits++;
+        return 0;
+    }
+
+    cache->hits++;
+    *entry_offset = entry->entry_offset;
+    return 1;
+}
+
+/*
+ * Remember the result of a directory scan, replacing the least recently used
+ * entry of the set when it is full.
+ */
+void fat32_dcache_insert(Fat32Dcache *cache, uint32_t parent_cluster, const char *name, int found, uint64_t entry_offset)
+{
+    char key[FAT32_DCACHE_NAME_MAX + 1u];
+
+    if (parent_cluster == 0 || !make_key(name, key))
+    {
+        return;
+    }
+
+    Fat32DcacheEntry *set = set_of(cache, parent_cluster, key);
+    Fat32DcacheEntry *entry = find_entry(set, parent_cluster, key);
+
+    for (uint32_t way = 0; entry == 0 && way < FAT32_DCACHE_WAYS; way++)
+    {
+        if (set[way].parent_cluster == 0)
+        {
+            entry = &set[way];
+        }
+    }
+
+    if (entry == 0)
+    {
+        entry = &set[0];
+
+        for (uint32_t way = 1; way < FAT32_DCACHE_WAYS; way++)
+        {
+            if (set[way].last_use < entry->last_use)
+            {
+                entry = &set[way];
+            }
+        }
+    }
+
+    entry->parent_cluster = parent_cluster;
+    entry->missing = found ? 0 : 1;
+    strcpy(entry->name, key);
+    entry->entry_offset = found ? entry_offset : 0;
+    entry->last_use = ++cache->clock;
+}
+
+/*
+ * Forget every name cached for one directory, positive and negative alike.
+ */
+void fat32_dcache_invalidate_dir(Fat32Dcache *cache, uint32_t parent_cluster)
+{
+    for (uint32_t i = 0; i < FAT32_DCACHE_SETS * FAT32_DCACHE_WAYS; i++)
+    {
+        if (cache->entries[i].parent_cluster == parent_cluster)
+        {
+            cache->entries[i].parent_cluster = 0;
+        }
+    }
+}
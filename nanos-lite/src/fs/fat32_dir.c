@@ -675,18 +675,58 @@ static int find_in_directory_full(const Fat32Volume *vol, uint32_t dir_cluster,
     return -1;
 }
 
+/*
+ * Fill out from a cached short-entry offset.  The slot is checked to still
+ * hold a live short entry; if not, the caller scans the directory instead.
+ */
+static int read_cached_entry(const Fat32Volume *vol, uint64_t entry_offset, Fat32DirEntry *out)
+{
+    uint8_t raw_entry[FAT32_DIR_ENTRY_SIZE];
+
+    if (entry_offset > SIZE_MAX ||
+        disk_read(raw_entry, (size_t)entry_offset, FAT32_DIR_ENTRY_SIZE) != FAT32_DIR_ENTRY_SIZE ||
+        raw_entry[0] == 0x00 || raw_entry[0] == 0xe5 || raw_entry[11] == FAT32_ATTR_LONG_NAME ||
+        (raw_entry[11] & FAT32_ATTR_VOLUME_ID) != 0)
+    {
+        return -1;
+    }
+
+    fill_dir_entry(vol, raw_entry, entry_offset, out);
+    return 0;
+}
+
 /*
  * Resolve one component in a directory when only the public entry is needed.
+ * Results, including misses, go through the volume's dentry cache.
  */
 static int find_in_directory(const Fat32Volume *vol, uint32_t dir_cluster, const char *component, Fat32DirEntry *out)
 {
+    /* Like the FAT sector cache, the dentry cache changes under a const volume. */
+    Fat32Dcache *dcache = &((Fat32Volume *)vol)->dcache;
     Fat32LocatedEntry located;
+    uint64_t entry_offset;
+
+    switch (fat32_dcache_lookup(dcache, dir_cluster, component, &entry_offset))
+    {
+    case 0:
+        return -1;
+    case 1:
+        if (read_cached_entry(vol, entry_offset, out) == 0)
+        {
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
 
     if (find_in_directory_full(vol, dir_cluster, component, &located) != 0)
     {
+        fat32_dcache_insert(dcache, dir_cluster, component, 0, 0);
         return -1;
     }
 
+    fat32_dcache_insert(dcache, dir_cluster, component, 1, located.entry.dir_entry_offset);
     *out = located.entry;
     return 0;
 }
@@ -1192,6 +1232,9 @@ static int create_entry_in_directory(Fat32Volume *vol, uint32_t parent_cluster,
         return -1;
     }
 
+    // The name may be cached as missing, and both name forms are about to change.
+    fat32_dcache_invalidate_dir(&vol->dcache, parent_cluster);
+
     needed_entries = 1u + (name_needs_lfn(name, short_name) ? lfn_entry_count_for_name(name) : 0u);
 
     if (find_free_entry_run(vol, parent_cluster, needed_entries, &start_index) != 0)
@@ -1210,6 +1253,7 @@ static int initialise_directory_cluster(Fat32Volume *vol, uint32_t dir_cluster,
     uint8_t raw_entry[FAT32_DIR_ENTRY_SIZE];
     const uint32_t parent_for_dotdot = parent_cluster == vol->root_cluster ? 0 : parent_cluster;
 
+    fat32_dcache_invalidate_dir(&vol->dcache, dir_cluster);
     fill_dot_entry(raw_entry, ".", dir_cluster);
 
     if (write_directory_slot(vol, dir_cluster, 0, raw_entry) != 0)
@@ -1274,6 +1318,14 @@ static int delete_located_entry(Fat32Volume *vol, const Fat32LocatedEntry *locat
     const uint32_t start = located->lfn_entry_count != 0 ? located->lfn_start_index : located->entry_index;
     const uint32_t end = located->entry_index;
 
+    fat32_dcache_invalidate_dir(&vol->dcache, located->parent_cluster);
+
+    // A removed directory's cluster may come back as a different directory.
+    if (free_chain && (located->entry.attr & FAT32_ATTR_DIRECTORY) != 0 && located->entry.first_cluster != 0)
+    {
+        fat32_dcache_invalidate_dir(&vol->dcache, located->entry.first_cluster);
+    }
+
     if (free_chain && located->entry.first_cluster != 0)
     {
         if (fat32_free_chain(vol, located->entry.first_cluster) != 0)
@@ -1310,7 +1362,8 @@ static int locate_path(const Fat32Volume *vol, const char *path, Fat32LocatedEnt
 }
 
 /*
- * Mount a FAT32 volume from the block device and load its FSInfo hints.
+ * Mount a FAT32 volume from the block device, load its FSInfo hints, and build
+ * the free-cluster bitmap.
  */
 int fat32_mount_from_disk(uint32_t disk_block_size, Fat32Volume *out)
 {
@@ -1331,7 +1384,12 @@ int fat32_mount_from_disk(uint32_t disk_block_size, Fat32Volume *out)
         return -1;
     }
 
-    return fat32_load_fsinfo(out);
+    if (fat32_load_fsinfo(out) != 0)
+    {
+        return -1;
+    }
+
+    return fat32_build_free_bitmap(out);
 }
 
 /*
@@ -0,0 +1,165 @@
+#include "fat32.h"
+
+#include <string.h>
+
+static Fat32ExtentMap *find_map(Fat32ExtentCache *cache, uint32_t first_cluster)
+{
+    if (first_cluster == 0)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < FAT32_EXTENT_MAPS; i++)
+    {
+        if (cache->maps[i].first_cluster == first_cluster)
+        {
+            return &cache->maps[i];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Find the cluster holding file_index in a file's extent map.  Returns 0 with
+ * the cluster and the number of clusters left in its extent, counting itself,
+ * or -1 when the map does not reach that far.
+ */
+int fat32_extent_lookup(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t file_index, uint32_t *out_cluster, uint32_t *out_run)
+{
+    Fat32ExtentMap *map = find_map(cache, first_cluster);
+
+    if (map == 0 || file_index >= map->mapped_clusters)
+    {
+        return -1;
+    }
+
+    // The extents tile [0, mapped_clusters), so some extent holds file_index.
+    uint32_t lo = 0;
+    uint32_t hi = map->nr_extents - 1u;
+
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + (hi - lo + 1u) / 2u;
+
+        if (map->extents[mid].file_index <= file_index)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1u;
+        }
+    }
+
+    const Fat32Extent *extent = &map->extents[lo];
+    const uint32_t offset = file_index - extent->file_index;
+
+    map->last_use = ++cache->clock;
+    *out_cluster = extent->cluster + offset;
+    *out_run = extent->length - offset;
+    return 0;
+}
+
+/*
+ * Number of clusters, from the start of the file, that its map resolves.
+ */
+uint32_t fat32_extent_mapped(Fat32ExtentCache *cache, uint32_t first_cluster)
+{
+    const Fat32ExtentMap *map = find_map(cache, first_cluster);
+
+    return map != 0 ? map->mapped_clusters : 0;
+}
+
+/*
+ * Record that clusters file_index .. file_index + count - 1 of a file are the
+ * physical clusters starting at cluster.  Only a run continuing the mapped
+ * prefix is kept; a run starting at index 0 creates the map, replacing the
+ * least recently used one when all are taken.  A full map stops growing.
+ */
+void fat32_extent_add(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t file_index, uint32_t cluster, uint32_t count)
+{
+    Fat32ExtentMap *map = find_map(cache, first_cluster);
+
+    if (first_cluster == 0 || count == 0)
+    {
+        return;
+    }
+
+    if (map == 0)
+    {
+        if (file_index != 0)
+        {
+            return;
+        }
+
+        map = &cache->maps[0];
+
+        for (uint32_t i = 1; i < FAT32_EXTENT_MAPS && map->first_cluster != 0; i++)
+        {
+            if (cache->maps[i].first_cluster == 0 || cache->maps[i].last_use < map->last_use)
+            {
+                map = &cache->maps[i];
+            }
+        }
+
+        memset(map, 0, sizeof(*map));
+        map->first_cluster = first_cluster;
+    }
+
+    if (file_index != map->mapped_clusters || count > UINT32_MAX - file_index)
+    {
+        return;
+    }
+
+    Fat32Extent *last = map->nr_extents > 0 ? &map->extents[map->nr_extents - 1u] : 0;
+
+    if (last != 0 && (uint64_t)last->cluster + last->length == cluster)
+    {
+        last->length += count;
+    }
+    else if (map->nr_extents < FAT32_EXTENT_MAP_SIZE)
+    {
+        last = &map->extents[map->nr_extents++];
+        last->file_index = file_index;
+        last->cluster = cluster;
+        last->length = count;
+    }
+    else
+    {
+        return;
+    }
+
+    map->mapped_clusters += count;
+    map->last_use = ++cache->clock;
+}
+
+/*
+ * Cut a file's map down to its first nr_clusters clusters after the chain was
+ * shortened; zero drops the map.
+ */
+void fat32_extent_truncate(Fat32ExtentCache *cache, uint32_t first_cluster, uint32_t nr_clusters)
+{
+    Fat32ExtentMap *map = find_map(cache, first_cluster);
+
+    if (map == 0 || nr_clusters >= map->mapped_clusters)
+    {
+        return;
+    }
+
+    if (nr_clusters == 0)
+    {
+        memset(map, 0, sizeof(*map));
+        return;
+    }
+
+    while (map->extents[map->nr_extents - 1u].file_index >= nr_clusters)
+    {
+        map->nr_extents--;
+    }
+
+    Fat32Extent *last = &map->extents[map->nr_extents - 1u];
+
+    last->length = nr_clusters - last->file_index;
+    map->mapped_clusters = nr_clusters;
+}
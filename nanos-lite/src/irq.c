@@ -1,18 +1,33 @@
 #include <common.h>
+#include <proc.h>
+#include "sysprof.h"
+#include "syscall.h"
 
 Context *schedule(Context *prev);
+void device_irq(int source);
 
 // Provided by syscall.c
 int syscall_need_resched_and_clear(void);
 Context *syscall_replacement_context_and_clear(void);
+const char *syscall_name(uintptr_t num);
 
-static Context *do_event(Event e, Context *c)
+static Context *handle_event(Event e, Context *c)
 {
+    // A trap from user mode proves satp has moved off any retired space but this one.
+    if (c->pdir != NULL)
+    {
+        mm_reap(c->pdir);
+    }
+
+    // No trap runs on the stack of a process that exited in an earlier one.
+    proc_reap();
+
     switch (e.event)
     {
     case EVENT_YIELD:
     {
         // Yield event always triggers scheduling.
+        proc_yield();
         return schedule(c);
     }
 
@@ -42,10 +57,39 @@ static Context *do_event(Event e, Context *c)
         break;
     }
 
+    case EVENT_PAGEFAULT:
+    {
+        /*
+         * Only user-mode faults can be resumed: the kernel runs with MPRV
+         * set, and returning to it with mret would drop that state.  Syscalls
+         * populate user buffers up front so the kernel never faults on them.
+         * A fault is either a not-yet-loaded image or mmap() page, or a write
+         * to a page still shared copy-on-write.
+         */
+        if (c->pdir == NULL ||
+            !(loader_page_fault(current, e.ref) || mm_mmap_fault(current, e.ref) || mm_cow_fault(current, e.ref)))
+        {
+            panic("Page fault at %p (cause %d)", (void *)e.ref, (int)e.cause);
+        }
+
+        // The context is unchanged, so the faulting instruction runs again.
+        break;
+    }
+
     case EVENT_IRQ_TIMER:
     {
         // Timer IRQs are the pre-emptive path. They do not need a syscall return
         // value, only a scheduler decision based on the interrupted context.
+        proc_tick();
+        return schedule(c);
+    }
+
+    case EVENT_IRQ_IODEV:
+    {
+        // AM has already claimed and completed the PLIC source.  The device
+        // layer wakes whoever sleeps on it, and a woken foreground process
+        // may pre-empt a background one straight away.
+        device_irq((int)e.cause);
         return schedule(c);
     }
 
@@ -59,6 +103,144 @@ static Context *do_event(Event e, Context *c)
     return c;
 }
 
+/*
+ * Every trap is profiled.  The handler's cost is counted in retired guest
+ * instructions and in microseconds, which NEMU exposes through the instret and
+ * time CSRs; other platforms only get the time, from the RTC.  The CSR keeps
+ * profiling out of the RTC reads that NEMU's idle-loop detection watches.
+ */
+#define NR_PROFILED_SYSCALLS 64
+
+_Static_assert(SYS_ring_enter < NR_PROFILED_SYSCALLS, "syscall table too small");
+
+enum
+{
+    TRAP_YIELD,
+    TRAP_PAGEFAULT,
+    TRAP_TIMER,
+    TRAP_IODEV,
+    NR_TRAP_KINDS
+};
+
+static const char *const trap_names[NR_TRAP_KINDS] = {
+    [TRAP_YIELD] = "event_yield",
+    [TRAP_PAGEFAULT] = "pagefault",
+    [TRAP_TIMER] = "irq_timer",
+    [TRAP_IODEV] = "irq_iodev",
+};
+
+static SysprofCounter syscall_prof[NR_PROFILED_SYSCALLS];
+static SysprofCounter trap_prof[NR_TRAP_KINDS];
+
+static uint64_t read_instret(void)
+{
+#if defined(__ARCH_RISCV64_NEMU)
+    uint64_t n;
+    asm volatile("csrr %0, instret" : "=r"(n));
+    return n;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t read_time_us(void)
+{
+#if defined(__ARCH_RISCV64_NEMU)
+    uint64_t us;
+    asm volatile("csrr %0, time" : "=r"(us));
+    return us;
+#else
+    return io_read(AM_TIMER_UPTIME).us;
+#endif
+}
+
+static SysprofCounter *event_counter(const Event *e, uintptr_t num)
+{
+    switch (e->event)
+    {
+    case EVENT_SYSCALL:
+        return num < NR_PROFILED_SYSCALLS ? &syscall_prof[num] : NULL;
+    case EVENT_YIELD:
+        return &trap_prof[TRAP_YIELD];
+    case EVENT_PAGEFAULT:
+        return &trap_prof[TRAP_PAGEFAULT];
+    case EVENT_IRQ_TIMER:
+        return &trap_prof[TRAP_TIMER];
+    case EVENT_IRQ_IODEV:
+        return &trap_prof[TRAP_IODEV];
+    default:
+        return NULL;
+    }
+}
+
+static Context *do_event(Event e, Context *c)
+{
+    // Charge the process that trapped, whatever runs next.  A syscall handler
+    // may change a0-a7, so the number is read first.
+    PCB *pcb = current;
+    const uintptr_t num = c->GPR1;
+    const uint64_t instr_start = read_instret();
+    const uint64_t us_start = read_time_us();
+
+    Context *next = handle_event(e, c);
+
+    const uint64_t instrs = read_instret() - instr_start;
+    const uint64_t us = read_time_us() - us_start;
+    SysprofCounter *counter = event_counter(&e, num);
+
+    if (counter != NULL)
+    {
+        sysprof_add(counter, instrs, us);
+    }
+
+    proc_account_trap(pcb, e.event == EVENT_SYSCALL, e.event == EVENT_PAGEFAULT, instrs, us);
+    return next;
+}
+
+/*
+ * /proc/syscalls: one line per syscall or trap kind taken so far.  The table
+ * is rendered when a read starts at offset 0 and later reads continue in that
+ * snapshot, so reading it in pieces gives one consistent table.
+ */
+size_t proc_syscalls_read(void *buf, size_t offset, size_t len)
+{
+    static char text[4096];
+    static size_t text_len = 0;
+
+    if (offset == 0)
+    {
+        strcpy(text, SYSPROF_HEADER);
+        text_len = strlen(text);
+
+        for (uintptr_t num = 0; num < NR_PROFILED_SYSCALLS; num++)
+        {
+            if (syscall_prof[num].calls != 0)
+            {
+                char unknown[16];
+                const char *name = syscall_name(num);
+
+                if (strcmp(name, "unknown") == 0)
+                {
+                    snprintf(unknown, sizeof(unknown), "sys_%d", (int)num);
+                    name = unknown;
+                }
+
+                text_len = sysprof_format(text, sizeof(text), text_len, name, &syscall_prof[num]);
+            }
+        }
+
+        for (int i = 0; i < NR_TRAP_KINDS; i++)
+        {
+            if (trap_prof[i].calls != 0)
+            {
+                text_len = sysprof_format(text, sizeof(text), text_len, trap_names[i], &trap_prof[i]);
+            }
+        }
+    }
+
+    return sysprof_copy(text, text_len, buf, offset, len);
+}
+
 void init_irq(void)
 {
     Log("Initializing interrupt/exception handler...");
@@ -2,6 +2,7 @@
 #include <elf.h>
 #include "debug.h"
 #include "fs.h"
+#include "pagecache.h"
 #include "pagewalk.h"
 
 #ifdef __LP64__
@@ -36,6 +37,268 @@ static uintptr_t align_up(uintptr_t x, uintptr_t a)
     return (x + a - 1) & ~(a - 1);
 }
 
+/*
+ * Pages filled per fault.  The neighbours of a touched page are usually next,
+ * so a small window trades a little memory for far fewer traps, and the run
+ * is read with one fs_read() into physically contiguous pages.
+ */
+#define LOADER_FAULT_AROUND 4
+
+static bool page_mapped(PCB *pcb, uintptr_t page_va)
+{
+    return nanos_pagewalk_lookup_page(pcb->as.ptr, page_va) != NULL;
+}
+
+static const ImageSegment *find_segment(PCB *pcb, uintptr_t vaddr)
+{
+    for (int i = 0; i < pcb->nr_segments; i++)
+    {
+        const ImageSegment *seg = &pcb->segments[i];
+
+        if (vaddr >= align_down(seg->vaddr, PGSIZE) && vaddr < align_up(seg->mem_end, PGSIZE))
+        {
+            return seg;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * A page that only read-only segments overlap has the same contents in every
+ * process running this image, so one physical copy serves them all.  The page
+ * address is the cache offset, see PAGECACHE_IMAGE_PAGE: an executable always
+ * lays out its pages alike.
+ */
+static bool page_shareable(const PCB *pcb, uintptr_t page_va)
+{
+    for (int i = 0; i < pcb->nr_segments; i++)
+    {
+        const ImageSegment *s = &pcb->segments[i];
+
+        if (s->writable && page_va < align_up(s->mem_end, PGSIZE) && page_va + PGSIZE > align_down(s->vaddr, PGSIZE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void read_image_pages(PCB *pcb, uint8_t *run_pa, uintptr_t run_va, size_t nr_pages)
+{
+    const uintptr_t run_end = run_va + nr_pages * PGSIZE;
+
+    memset(run_pa, 0, nr_pages * PGSIZE);
+
+    // ELF segments can share a page at their boundary, so copy from every one.
+    for (int i = 0; i < pcb->nr_segments; i++)
+    {
+        const ImageSegment *s = &pcb->segments[i];
+        const uintptr_t is = s->vaddr > run_va ? s->vaddr : run_va;
+        const uintptr_t ie = s->file_end < run_end ? s->file_end : run_end;
+
+        if (is < ie)
+        {
+            const size_t bytes = (size_t)(ie - is);
+
+            assert(fs_lseek(pcb->image_fd, s->offset + (size_t)(is - s->vaddr), SEEK_SET) != (size_t)-1);
+            assert(fs_read(pcb->image_fd, run_pa + (is - run_va), bytes) == bytes);
+        }
+    }
+}
+
+bool loader_page_fault(PCB *pcb, uintptr_t vaddr)
+{
+    if (pcb == NULL || pcb->nr_segments == 0)
+    {
+        return false;
+    }
+
+    const ImageSegment *seg = find_segment(pcb, vaddr);
+    uintptr_t run_va = align_down(vaddr, PGSIZE);
+
+    if (seg == NULL || page_mapped(pcb, run_va))
+    {
+        return false;
+    }
+
+    const bool shared = page_shareable(pcb, run_va);
+
+    // Extend over following unmapped pages of the same segment and kind.
+    const uintptr_t seg_end = align_up(seg->mem_end, PGSIZE);
+    size_t nr_pages = 1;
+
+    while (nr_pages < LOADER_FAULT_AROUND && run_va + nr_pages * PGSIZE < seg_end &&
+           !page_mapped(pcb, run_va + nr_pages * PGSIZE) && page_shareable(pcb, run_va + nr_pages * PGSIZE) == shared)
+    {
+        nr_pages++;
+    }
+
+    // Another process may already have read the start of the run.
+    while (shared && nr_pages > 0)
+    {
+        void *page = pagecache_get(pcb->image_id, PAGECACHE_IMAGE_PAGE | run_va);
+
+        if (page == NULL)
+        {
+            break;
+        }
+
+        map(&pcb->as, (void *)run_va, page, MMAP_READ);
+        run_va += PGSIZE;
+        nr_pages--;
+    }
+
+    if (nr_pages == 0)
+    {
+        return true;
+    }
+
+    uint8_t *run_pa = new_page(nr_pages);
+    assert(run_pa != NULL);
+    read_image_pages(pcb, run_pa, run_va, nr_pages);
+
+    for (size_t i = 0; i < nr_pages; i++)
+    {
+        void *va = (void *)(run_va + i * PGSIZE);
+        uint8_t *page = run_pa + i * PGSIZE;
+
+        if (!shared)
+        {
+            map(&pcb->as, va, page, MMAP_READ | MMAP_WRITE);
+            continue;
+        }
+
+        // A later page of the run may be cached already; keep the cached copy.
+        void *cached = i > 0 ? pagecache_get(pcb->image_id, PAGECACHE_IMAGE_PAGE | (uintptr_t)va) : NULL;
+
+        if (cached != NULL)
+        {
+            free_page(page);
+            page = cached;
+        }
+        else
+        {
+            pagecache_add(pcb->image_id, PAGECACHE_IMAGE_PAGE | (uintptr_t)va, page);
+        }
+
+        map(&pcb->as, va, page, MMAP_READ);
+    }
+
+    return true;
+}
+
+// mmap() areas are filled on demand just like the image.
+static bool has_demand_pages(const PCB *pcb)
+{
+    return pcb != NULL && (pcb->nr_segments > 0 || pcb->nr_mmaps > 0);
+}
+
+static void populate_page(PCB *pcb, uintptr_t vaddr)
+{
+    if (!loader_page_fault(pcb, vaddr))
+    {
+        mm_mmap_fault(pcb, vaddr);
+    }
+}
+
+void loader_populate(PCB *pcb, const void *buf, size_t len)
+{
+    if (!has_demand_pages(pcb) || len == 0)
+    {
+        return;
+    }
+
+    const uintptr_t first = align_down((uintptr_t)buf, PGSIZE);
+    const uintptr_t last = align_down((uintptr_t)buf + len - 1, PGSIZE);
+
+    if (last < first)
+    {
+        return;
+    }
+
+    for (uintptr_t page_va = first;; page_va += PGSIZE)
+    {
+        populate_page(pcb, page_va);
+
+        if (page_va == last)
+        {
+            return;
+        }
+    }
+}
+
+void loader_populate_string(PCB *pcb, const char *str)
+{
+    if (!has_demand_pages(pcb))
+    {
+        return;
+    }
+
+    // Fault in page by page until the terminator, never reading an absent page.
+    for (uintptr_t va = (uintptr_t)str;; va = align_down(va, PGSIZE) + PGSIZE)
+    {
+        populate_page(pcb, va);
+
+        if (!page_mapped(pcb, va))
+        {
+            return;
+        }
+
+        const char *end = (const char *)(align_down(va, PGSIZE) + PGSIZE);
+
+        for (const char *p = (const char *)va; p < end; p++)
+        {
+            if (*p == '\0')
+            {
+                return;
+            }
+        }
+    }
+}
+
+void loader_release(PCB *pcb)
+{
+    if (pcb->nr_segments > 0)
+    {
+        fs_close(pcb->image_fd);
+        pcb->nr_segments = 0;
+    }
+}
+
+bool loader_fork(PCB *child, const PCB *parent)
+{
+    child->nr_segments = 0;
+
+    if (parent->nr_segments == 0)
+    {
+        return true;
+    }
+
+    // Pages the parent never touched are still read from the file, and each
+    // PCB closes its image on its own.
+    const int fd = fs_reopen(parent->image_fd);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    child->image_fd = fd;
+    child->image_id = parent->image_id;
+    memcpy(child->segments, parent->segments, sizeof(parent->segments));
+    child->nr_segments = parent->nr_segments;
+    return true;
+}
+
+/*
+ * Record the PT_LOAD segments of filename in pcb and leave their pages
+ * unmapped; loader_page_fault() reads each page on first touch, so start-up
+ * cost follows the pages a program actually uses rather than its size, and
+ * read-only pages come from the page cache when the image already runs.  The
+ * executable stays open until the PCB loads its next image.
+ */
 static uintptr_t loader(PCB *pcb, const char *filename)
 {
     Log("Load exec filename = %s", filename);
@@ -56,6 +319,15 @@ static uintptr_t loader(PCB *pcb, const char *filename)
     assert(elfH.e_phentsize == sizeof(Elf_Phdr));
     assert(elfH.e_phnum != 0);
 
+    NanosStat st;
+    assert(fs_fstat(fd, &st) == 0);
+
+    // The previous image of an execve()d PCB is no longer reachable.
+    loader_release(pcb);
+    pcb->image_fd = fd;
+    pcb->image_id = st.ino;
+    pcb->nr_segments = 0;
+
     uintptr_t max_end = 0;
 
     for (int i = 0; i < (int)elfH.e_phnum; i++)
@@ -66,64 +338,32 @@ static uintptr_t loader(PCB *pcb, const char *filename)
         assert(fs_lseek(fd, phdrOffset, SEEK_SET) != (size_t)-1);
         assert(fs_read(fd, &phdr, elfH.e_phentsize) == elfH.e_phentsize);
 
-        if (phdr.p_type != PT_LOAD)
+        if (phdr.p_type != PT_LOAD || phdr.p_memsz == 0)
         {
             continue;
         }
 
-        uintptr_t seg_va = (uintptr_t)phdr.p_vaddr;
-        uintptr_t file_va_end = seg_va + phdr.p_filesz;
-        uintptr_t mem_va_end = seg_va + phdr.p_memsz;
+        assert(phdr.p_filesz <= phdr.p_memsz);
+        assert(pcb->nr_segments < MAX_IMAGE_SEGMENTS);
 
-        // Track the maximum end address of all loadable segments.
-        if (mem_va_end > max_end)
-        {
-            max_end = mem_va_end;
-        }
-
-        uintptr_t page_va_begin = align_down(seg_va, PGSIZE);
-        uintptr_t page_va_end = align_up(mem_va_end, PGSIZE);
+        ImageSegment *seg = &pcb->segments[pcb->nr_segments++];
+        seg->vaddr = (uintptr_t)phdr.p_vaddr;
+        seg->file_end = seg->vaddr + phdr.p_filesz;
+        seg->mem_end = seg->vaddr + phdr.p_memsz;
+        seg->offset = (size_t)phdr.p_offset;
+        seg->writable = (phdr.p_flags & PF_W) != 0;
 
-        for (uintptr_t page_va = page_va_begin; page_va < page_va_end; page_va += PGSIZE)
+        // Track the maximum end address of all loadable segments.
+        if (seg->mem_end > max_end)
         {
-            // Reuse an existing mapping if this page VA was already mapped by another segment.
-            // ELF segments can share a page at their boundary; allocating a
-            // fresh page here would lose bytes copied for the previous segment.
-            void *page_pa = nanos_pagewalk_lookup_page(pcb->as.ptr, page_va);
-
-            if (page_pa == NULL)
-            {
-                page_pa = new_page(1);
-                assert(page_pa != NULL);
-                memset(page_pa, 0, PGSIZE);
-                map(&pcb->as, (void *)page_va, page_pa, 0);
-            }
-
-            // Load file bytes that overlap with this page.
-            uintptr_t page_begin = page_va;
-            uintptr_t page_end = page_va + PGSIZE;
-
-            uintptr_t is = (page_begin > seg_va) ? page_begin : seg_va;
-            uintptr_t ie = (page_end < file_va_end) ? page_end : file_va_end;
-
-            if (is < ie)
-            {
-                size_t bytes = (size_t)(ie - is);
-                size_t inpage_off = (size_t)(is - page_begin);
-                size_t file_off = (size_t)phdr.p_offset + (size_t)(is - seg_va);
-
-                assert(fs_lseek(fd, file_off, SEEK_SET) != (size_t)-1);
-                assert(fs_read(fd, (void *)((uintptr_t)page_pa + inpage_off), bytes) == bytes);
-            }
+            max_end = seg->mem_end;
         }
     }
 
-    // Close fd.
-    assert(fs_close(fd) == 0);
-
     // Initialise max_brk to the end of loaded image, with a lower bound of user space start.
     uintptr_t us = (uintptr_t)pcb->as.area.start;
     pcb->max_brk = (max_end > us) ? max_end : us;
+    pcb->brk_start = pcb->max_brk;
 
     // Return entry point.
     return elfH.e_entry;
@@ -217,9 +457,15 @@ void context_uload(PCB *pcb, const char *filename, char *const argv[], char *con
         envp = empty_envp;
     }
 
-    // 1) Create user address space and copy kernel mappings.
+    // 1) Create user address space and copy kernel mappings.  An execve()d
+    // PCB still runs on its old space, which is freed once it is left behind;
+    // argv and envp are read from it below.
+    AddrSpace old_as = pcb->as;
     protect(&pcb->as);
 
+    // mmap() areas of the old image go with it; their pages leave with old_as.
+    mm_mmap_release(pcb);
+
     // 2) Load program image by page mapping.
     uintptr_t entry = loader(pcb, filename);
 
@@ -242,7 +488,7 @@ void context_uload(PCB *pcb, const char *filename, char *const argv[], char *con
             &pcb->as,
             (void *)(ustack_va_base + (uintptr_t)i * PGSIZE),
             (void *)((uintptr_t)ustack_pa_base + (uintptr_t)i * PGSIZE),
-            0);
+            MMAP_READ | MMAP_WRITE);
     }
 
     // 4) Build argc/argv/envp on the stack.
@@ -259,6 +505,11 @@ void context_uload(PCB *pcb, const char *filename, char *const argv[], char *con
     // 6) Set user initial SP and the ABI argument pointer.
     pcb->cp->GPRSP = args_va;
     pcb->cp->GPRx = args_va;
+
+    if (old_as.ptr != NULL)
+    {
+        mm_retire(&old_as);
+    }
 }
 
 void naive_uload(PCB *pcb, const char *filename)
@@ -1,22 +1,39 @@
 #include <memory.h>
 #include "proc.h"
+#include "pagecache.h"
+#include "palloc.h"
+#include "pagewalk.h"
 
 extern PCB *current;
 
-static void *pf = NULL;
-
 #ifndef ROUNDUP
 #define ROUNDUP(x, a) (((x) + (a) - 1) & ~((a) - 1))
 #endif
 
+void *try_new_page(size_t nr_page)
+{
+    // Physically contiguous run; each page is released with its own free_page().
+    void *p = palloc_alloc(nr_page);
+
+    // Cached executable pages nobody maps are the first to give way.
+    if (p == NULL && pagecache_shrink() > 0)
+    {
+        p = palloc_alloc(nr_page);
+    }
+
+    return p;
+}
+
 void *new_page(size_t nr_page)
 {
-    // Simple bump allocator, returns a contiguous physical memory region.
-    void *p = pf;
-    pf = (void *)((uintptr_t)pf + nr_page * PGSIZE);
+    void *p = try_new_page(nr_page);
 
-    // Optional sanity check, avoid running out of heap.
-    assert((uintptr_t)pf <= (uintptr_t)heap.end);
+    if (p == NULL)
+    {
+        PallocStats stats;
+        palloc_get_stats(&stats);
+        panic("Out of physical pages: %d requested, %d free", (int)nr_page, (int)stats.free_pages);
+    }
 
     return p;
 }
@@ -39,7 +56,128 @@ static void *pg_alloc(int n)
 
 void free_page(void *p)
 {
-    panic("not implement yet");
+    // Drops one reference; a shared page survives until its last mapping goes.
+    palloc_free(p);
+}
+
+/*
+ * Copy-on-write.  mm_fork() maps every writable page of the parent read-only
+ * into both spaces and tags it NANOS_PAGE_COW; the first write from either
+ * side faults into mm_cow_fault(), which copies the page unless the writer is
+ * already its last user.
+ */
+typedef struct
+{
+    AddrSpace *parent;
+    AddrSpace *child;
+} ForkCopy;
+
+static void share_page(void *arg, uintptr_t vaddr, void *page)
+{
+    const ForkCopy *copy = arg;
+    const int flags = nanos_pagewalk_get_flags(copy->parent->ptr, vaddr);
+
+    map(copy->child, (void *)vaddr, page, MMAP_READ);
+
+    if ((flags & (NANOS_PAGE_WRITE | NANOS_PAGE_COW)) != 0)
+    {
+        nanos_pagewalk_set_page(copy->parent->ptr, vaddr, page, NANOS_PAGE_COW);
+        nanos_pagewalk_set_page(copy->child->ptr, vaddr, page, NANOS_PAGE_COW);
+    }
+
+    palloc_ref(page);
+}
+
+void mm_fork(AddrSpace *child, AddrSpace *parent)
+{
+    ForkCopy copy = {.parent = parent, .child = child};
+
+    protect(child);
+    nanos_pagewalk_for_each(parent->ptr, (uintptr_t)parent->area.start, (uintptr_t)parent->area.end, share_page,
+                            &copy);
+}
+
+bool mm_cow_fault(PCB *pcb, uintptr_t vaddr)
+{
+    void *root = pcb->as.ptr;
+    const int flags = nanos_pagewalk_get_flags(root, vaddr);
+
+    if (flags < 0 || (flags & NANOS_PAGE_COW) == 0)
+    {
+        return false;
+    }
+
+    void *page = nanos_pagewalk_lookup_page(root, vaddr);
+
+    if (palloc_refcount(page) == 1)
+    {
+        nanos_pagewalk_set_page(root, vaddr, page, NANOS_PAGE_WRITE);
+        return true;
+    }
+
+    void *copy = new_page(1);
+    memcpy(copy, page, PGSIZE);
+    nanos_pagewalk_set_page(root, vaddr, copy, NANOS_PAGE_WRITE);
+    free_page(page);
+    return true;
+}
+
+void mm_unshare(PCB *pcb, const void *buf, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    const uintptr_t first = (uintptr_t)buf & ~(uintptr_t)(PGSIZE - 1);
+    const uintptr_t last = ((uintptr_t)buf + len - 1) & ~(uintptr_t)(PGSIZE - 1);
+
+    for (uintptr_t page_va = first; page_va >= first && page_va <= last; page_va += PGSIZE)
+    {
+        mm_cow_fault(pcb, page_va);
+    }
+}
+
+/*
+ * A process owns exactly the user pages its page table maps, so tearing an
+ * address space down is a walk over the user range followed by unprotect()
+ * for the tables.  The root may still be in satp for the rest of the trap
+ * that retired it (execve() and exit() run on the dying address space), so
+ * retired spaces wait here until mm_reap() sees a trap from another one.
+ */
+enum
+{
+    // Every retire happens in a trap that first reaps, so few ever wait.
+    MAX_RETIRED_AS = 8,
+};
+
+static AddrSpace retired_as[MAX_RETIRED_AS];
+static int nr_retired_as = 0;
+
+void mm_retire(AddrSpace *as)
+{
+    assert(as->ptr != NULL);
+    assert(nr_retired_as < MAX_RETIRED_AS);
+    retired_as[nr_retired_as++] = *as;
+    as->ptr = NULL;
+}
+
+void mm_reap(void *active_pdir)
+{
+    for (int i = 0; i < nr_retired_as;)
+    {
+        AddrSpace *as = &retired_as[i];
+
+        if (as->ptr == active_pdir)
+        {
+            i++;
+            continue;
+        }
+
+        nanos_pagewalk_unmap_range(as->ptr, (uintptr_t)as->area.start, (uintptr_t)as->area.end, free_page);
+        unprotect(as);
+        retired_as[i] = retired_as[--nr_retired_as];
+    }
 }
 
 /* The brk() system call handler. */
@@ -51,38 +189,51 @@ int mm_brk(uintptr_t brk)
         return 0;
     }
 
-    // Only grow mappings, we do not reclaim pages when brk shrinks.
-    if (brk <= current->max_brk)
-    {
-        return 0;
-    }
-
     // map() requires page-aligned VA/PA in our implementation.
     uintptr_t va_begin = ROUNDUP(current->max_brk, PGSIZE);
     uintptr_t va_end = ROUNDUP(brk, PGSIZE);
 
-    // Basic sanity: brk should stay inside this process user space.
-    uintptr_t us = (uintptr_t)current->as.area.start;
+    // Basic sanity: brk should stay inside this process user space, and
+    // above the loaded image.
     uintptr_t ue = (uintptr_t)current->as.area.end;
 
-    if (brk < us || brk > ue)
+    if (brk < current->brk_start || brk > ue)
     {
         // Return failure if user requests an invalid brk.
         return -1;
     }
 
+    if (brk <= current->max_brk)
+    {
+        // Whole pages above the new break go back to the allocator.
+        nanos_pagewalk_unmap_range(current->as.ptr, va_end, va_begin, free_page);
+        current->max_brk = brk;
+        return 0;
+    }
+
+    // The heap grows up towards the mmap() areas and stops when it meets one.
+    if (mm_mmap_overlaps(current, va_begin, va_end))
+    {
+        return -1;
+    }
+
     for (uintptr_t va = va_begin; va < va_end; va += PGSIZE)
     {
-        void *pa = new_page(1);
-        assert(pa != NULL);
+        void *pa = try_new_page(1);
+
+        // Out of memory: give back what this call mapped and leave the break.
+        if (pa == NULL)
+        {
+            nanos_pagewalk_unmap_range(current->as.ptr, va_begin, va, free_page);
+            return -1;
+        }
 
         // New heap pages must be zero-filled.
         memset(pa, 0, PGSIZE);
 
-        // prot is ignored in this AM map() implementation. Passing 0 keeps the
-        // caller-side policy simple: any mapped user heap page receives the usual
-        // readable/writable/executable Sv32 leaf flags inside map().
-        map(&current->as, (void *)va, pa, 0);
+        // AM maps every readable page executable as well, which the heap of
+        // a program that generates code at run time relies on.
+        map(&current->as, (void *)va, pa, MMAP_READ | MMAP_WRITE);
     }
 
     current->max_brk = brk;
@@ -91,8 +242,11 @@ int mm_brk(uintptr_t brk)
 
 void init_mm()
 {
-    pf = (void *)ROUNDUP(heap.start, PGSIZE);
-    Log("free physical pages starting from %p", pf);
+    PallocStats stats;
+
+    palloc_init(heap.start, heap.end);
+    palloc_get_stats(&stats);
+    Log("%d free physical pages in [%p, %p)", (int)stats.total_pages, heap.start, heap.end);
 
 #ifdef HAS_VME
     vme_init(pg_alloc, free_page);
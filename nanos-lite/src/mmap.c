@@ -0,0 +1,422 @@
+#include <proc.h>
+#include "fs.h"
+#include "pagecache.h"
+#include "pagewalk.h"
+
+/*
+ * mmap() areas sit between the heap and the user stack.  New areas are placed
+ * top-down from mmap_top(), so the heap keeps all the room above the image and
+ * brk() only fails once the two meet.
+ */
+
+// The user stack takes the top pages of the user range; keep clear of it.
+#define MMAP_STACK_GAP (1024 * 1024)
+
+// Pages filled per fault, read with one fs_read() as in the loader.
+#define MMAP_FAULT_AROUND 8
+
+static uintptr_t align_down(uintptr_t x, uintptr_t a)
+{
+    return x & ~(a - 1);
+}
+
+static uintptr_t align_up(uintptr_t x, uintptr_t a)
+{
+    return (x + a - 1) & ~(a - 1);
+}
+
+static uintptr_t mmap_top(const PCB *pcb)
+{
+    return (uintptr_t)pcb->as.area.end - MMAP_STACK_GAP;
+}
+
+static uintptr_t mmap_bottom(const PCB *pcb)
+{
+    return align_up(pcb->max_brk, PGSIZE);
+}
+
+static bool page_mapped(PCB *pcb, uintptr_t page_va)
+{
+    return nanos_pagewalk_lookup_page(pcb->as.ptr, page_va) != NULL;
+}
+
+bool mm_mmap_overlaps(const PCB *pcb, uintptr_t start, uintptr_t end)
+{
+    for (int i = 0; i < pcb->nr_mmaps; i++)
+    {
+        if (pcb->mmaps[i].start < end && start < pcb->mmaps[i].end)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool range_free(const PCB *pcb, uintptr_t start, size_t len)
+{
+    return start >= mmap_bottom(pcb) && start <= mmap_top(pcb) && len <= mmap_top(pcb) - start &&
+           !mm_mmap_overlaps(pcb, start, start + len);
+}
+
+// The highest free range of len bytes below mmap_top(), or 0 if there is none.
+static uintptr_t find_free_range(const PCB *pcb, size_t len)
+{
+    uintptr_t end = mmap_top(pcb);
+
+    while (end >= mmap_bottom(pcb) + len)
+    {
+        const uintptr_t start = end - len;
+        uintptr_t lowest = end;
+
+        for (int i = 0; i < pcb->nr_mmaps; i++)
+        {
+            const MmapArea *a = &pcb->mmaps[i];
+
+            if (a->start < end && start < a->end && a->start < lowest)
+            {
+                lowest = a->start;
+            }
+        }
+
+        if (lowest == end)
+        {
+            return start;
+        }
+
+        end = lowest;
+    }
+
+    return 0;
+}
+
+static MmapArea *find_area(PCB *pcb, uintptr_t vaddr)
+{
+    for (int i = 0; i < pcb->nr_mmaps; i++)
+    {
+        MmapArea *a = &pcb->mmaps[i];
+
+        if (vaddr >= a->start && vaddr < a->end)
+        {
+            return a;
+        }
+    }
+
+    return NULL;
+}
+
+uintptr_t mm_mmap(PCB *pcb, uintptr_t addr, size_t len, int prot, int flags, int file, size_t offset)
+{
+    const int sharing = flags & (NANOS_MAP_SHARED | NANOS_MAP_PRIVATE);
+    const bool anonymous = (flags & NANOS_MAP_ANONYMOUS) != 0;
+
+    if (len == 0 || len > mmap_top(pcb) || offset % PGSIZE != 0 ||
+        (sharing != NANOS_MAP_SHARED && sharing != NANOS_MAP_PRIVATE))
+    {
+        return (uintptr_t)-1;
+    }
+
+    // Nothing is written back to a file, and fork() copies anonymous memory.
+    if (sharing == NANOS_MAP_SHARED && (anonymous || (prot & NANOS_PROT_WRITE) != 0))
+    {
+        return (uintptr_t)-1;
+    }
+
+    len = align_up(len, PGSIZE);
+
+    MmapArea area = {.prot = prot, .fd = -1};
+
+    if (!anonymous)
+    {
+        NanosStat st;
+
+        // The area reads through its own handle, so the caller may close its descriptor.
+        area.fd = fs_reopen_readonly(file);
+
+        if (area.fd < 0)
+        {
+            return (uintptr_t)-1;
+        }
+
+        assert(fs_fstat(area.fd, &st) == 0);
+        area.file_id = st.ino;
+        area.file_size = (size_t)st.size;
+        area.offset = offset;
+    }
+
+    if ((flags & NANOS_MAP_FIXED) != 0)
+    {
+        // A fixed area replaces whatever mmap() put there before.
+        const bool placed = addr % PGSIZE == 0 && addr >= mmap_bottom(pcb) && addr <= mmap_top(pcb) &&
+                            len <= mmap_top(pcb) - addr && mm_munmap(pcb, addr, len) == 0;
+
+        area.start = placed ? addr : 0;
+    }
+    else
+    {
+        // The address is only a hint.
+        area.start = addr % PGSIZE == 0 && range_free(pcb, addr, len) ? addr : find_free_range(pcb, len);
+    }
+
+    if (area.start == 0 || pcb->nr_mmaps == MAX_MMAP_AREAS)
+    {
+        if (area.fd >= 0)
+        {
+            fs_close(area.fd);
+        }
+
+        return (uintptr_t)-1;
+    }
+
+    area.end = area.start + len;
+    pcb->mmaps[pcb->nr_mmaps++] = area;
+    return area.start;
+}
+
+/* Split a around the hole [start, end); the tail gets a handle of its own. */
+static int punch_hole(PCB *pcb, MmapArea *a, uintptr_t start, uintptr_t end)
+{
+    if (pcb->nr_mmaps == MAX_MMAP_AREAS)
+    {
+        return -1;
+    }
+
+    MmapArea tail = *a;
+
+    if (a->fd >= 0 && (tail.fd = fs_reopen(a->fd)) < 0)
+    {
+        return -1;
+    }
+
+    tail.offset += (size_t)(end - a->start);
+    tail.start = end;
+    nanos_pagewalk_unmap_range(pcb->as.ptr, start, end, free_page);
+    a->end = start;
+    pcb->mmaps[pcb->nr_mmaps++] = tail;
+    return 0;
+}
+
+int mm_munmap(PCB *pcb, uintptr_t addr, size_t len)
+{
+    const uintptr_t ue = (uintptr_t)pcb->as.area.end;
+
+    if (len == 0 || addr % PGSIZE != 0 || addr >= ue || len > ue - addr)
+    {
+        return -1;
+    }
+
+    const uintptr_t end = align_up(addr + len, PGSIZE);
+
+    for (int i = 0; i < pcb->nr_mmaps;)
+    {
+        MmapArea *a = &pcb->mmaps[i];
+
+        if (a->end <= addr || end <= a->start)
+        {
+            i++;
+            continue;
+        }
+
+        // Areas never overlap, so one that contains the hole is the only one hit.
+        if (a->start < addr && end < a->end)
+        {
+            return punch_hole(pcb, a, addr, end);
+        }
+
+        const uintptr_t cut_start = a->start > addr ? a->start : addr;
+        const uintptr_t cut_end = a->end < end ? a->end : end;
+
+        // Only pages of the area go; heap and image pages in the range stay.
+        nanos_pagewalk_unmap_range(pcb->as.ptr, cut_start, cut_end, free_page);
+
+        if (cut_start == a->start && cut_end == a->end)
+        {
+            if (a->fd >= 0)
+            {
+                fs_close(a->fd);
+            }
+
+            *a = pcb->mmaps[--pcb->nr_mmaps];
+            continue;
+        }
+
+        if (cut_start == a->start)
+        {
+            a->offset += (size_t)(cut_end - a->start);
+            a->start = cut_end;
+        }
+        else
+        {
+            a->end = cut_start;
+        }
+
+        i++;
+    }
+
+    return 0;
+}
+
+static void map_file_page(PCB *pcb, const MmapArea *a, uintptr_t va, void *page)
+{
+    map(&pcb->as, (void *)va, page, MMAP_READ);
+
+    // A writable area is private: the first write copies, see mm_cow_fault().
+    if ((a->prot & NANOS_PROT_WRITE) != 0)
+    {
+        nanos_pagewalk_set_page(pcb->as.ptr, va, page, NANOS_PAGE_COW);
+    }
+}
+
+static size_t file_pos(const MmapArea *a, uintptr_t va)
+{
+    return a->offset + (size_t)(va - a->start);
+}
+
+/*
+ * File pages come from the page cache, keyed by file offset, so every process
+ * mapping the same part of a file maps the same physical pages.
+ */
+static void file_fault(PCB *pcb, const MmapArea *a, uintptr_t run_va, size_t nr_pages)
+{
+    // Another mapping may already have read the start of the run.
+    while (nr_pages > 0)
+    {
+        void *page = pagecache_get(a->file_id, file_pos(a, run_va));
+
+        if (page == NULL)
+        {
+            break;
+        }
+
+        map_file_page(pcb, a, run_va, page);
+        run_va += PGSIZE;
+        nr_pages--;
+    }
+
+    if (nr_pages == 0)
+    {
+        return;
+    }
+
+    const size_t pos = file_pos(a, run_va);
+    const size_t run_bytes = nr_pages * PGSIZE;
+    size_t bytes = pos < a->file_size ? a->file_size - pos : 0;
+    uint8_t *run_pa = new_page(nr_pages);
+
+    if (bytes > run_bytes)
+    {
+        bytes = run_bytes;
+    }
+
+    // A file truncated behind the mapping reads as zeros, like its tail page.
+    if (bytes > 0 && fs_lseek(a->fd, pos, SEEK_SET) == pos)
+    {
+        bytes = fs_read(a->fd, run_pa, bytes);
+    }
+    else
+    {
+        bytes = 0;
+    }
+
+    if (bytes == (size_t)-1)
+    {
+        bytes = 0;
+    }
+
+    memset(run_pa + bytes, 0, run_bytes - bytes);
+
+    for (size_t i = 0; i < nr_pages; i++)
+    {
+        const uintptr_t va = run_va + i * PGSIZE;
+        uint8_t *page = run_pa + i * PGSIZE;
+        void *cached = i > 0 ? pagecache_get(a->file_id, file_pos(a, va)) : NULL;
+
+        if (cached != NULL)
+        {
+            free_page(page);
+            page = cached;
+        }
+        else
+        {
+            pagecache_add(a->file_id, file_pos(a, va), page);
+        }
+
+        map_file_page(pcb, a, va, page);
+    }
+}
+
+bool mm_mmap_fault(PCB *pcb, uintptr_t vaddr)
+{
+    if (pcb == NULL || pcb->nr_mmaps == 0)
+    {
+        return false;
+    }
+
+    const MmapArea *a = find_area(pcb, vaddr);
+    const uintptr_t run_va = align_down(vaddr, PGSIZE);
+
+    // PROT_NONE pages stay unmapped and fault for good.
+    if (a == NULL || a->prot == NANOS_PROT_NONE || page_mapped(pcb, run_va))
+    {
+        return false;
+    }
+
+    size_t nr_pages = 1;
+
+    while (nr_pages < MMAP_FAULT_AROUND && run_va + nr_pages * PGSIZE < a->end &&
+           !page_mapped(pcb, run_va + nr_pages * PGSIZE))
+    {
+        nr_pages++;
+    }
+
+    if (a->fd >= 0)
+    {
+        file_fault(pcb, a, run_va, nr_pages);
+        return true;
+    }
+
+    uint8_t *run_pa = new_page(nr_pages);
+    const int perm = (a->prot & NANOS_PROT_WRITE) != 0 ? MMAP_READ | MMAP_WRITE : MMAP_READ;
+
+    memset(run_pa, 0, nr_pages * PGSIZE);
+
+    for (size_t i = 0; i < nr_pages; i++)
+    {
+        map(&pcb->as, (void *)(run_va + i * PGSIZE), run_pa + i * PGSIZE, perm);
+    }
+
+    return true;
+}
+
+bool mm_mmap_fork(PCB *child, const PCB *parent)
+{
+    child->nr_mmaps = 0;
+
+    for (int i = 0; i < parent->nr_mmaps; i++)
+    {
+        MmapArea a = parent->mmaps[i];
+
+        if (a.fd >= 0 && (a.fd = fs_reopen(a.fd)) < 0)
+        {
+            mm_mmap_release(child);
+            return false;
+        }
+
+        child->mmaps[child->nr_mmaps++] = a;
+    }
+
+    return true;
+}
+
+void mm_mmap_release(PCB *pcb)
+{
+    for (int i = 0; i < pcb->nr_mmaps; i++)
+    {
+        if (pcb->mmaps[i].fd >= 0)
+        {
+            fs_close(pcb->mmaps[i].fd);
+        }
+    }
+
+    pcb->nr_mmaps = 0;
+}
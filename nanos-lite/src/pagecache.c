@@ -0,0 +1,197 @@
+#include "pagecache.h"
+#include "palloc.h"
+
+#include <stdbool.h>
+
+#if defined(__ISA__)
+#include <klib.h>
+#else
+#include <assert.h>
+#include <string.h>
+#endif
+
+/*
+ * Open-addressed hash table with linear probing.  Deletion shifts the rest of
+ * a probe run back instead of leaving tombstones, so lookups never slow down
+ * as executables come and go.  The table is kept at most three quarters full;
+ * past that a page only the cache still holds is evicted, found by a clock
+ * hand sweeping the table.
+ */
+
+_Static_assert((PAGECACHE_NR_ENTRIES & (PAGECACHE_NR_ENTRIES - 1)) == 0, "table size must be a power of two");
+
+#define SLOT_MASK (PAGECACHE_NR_ENTRIES - 1)
+#define MAX_PAGES (PAGECACHE_NR_ENTRIES / 4 * 3)
+
+typedef struct
+{
+    uint64_t file;
+    size_t offset;
+    // NULL marks a free slot.
+    void *page;
+} Entry;
+
+static Entry table[PAGECACHE_NR_ENTRIES];
+static size_t clock_hand = 0;
+static PagecacheStats stats;
+
+static size_t home_slot(uint64_t file, size_t offset)
+{
+    uint64_t h = file * 0x9e3779b97f4a7c15ull ^ (uint64_t)(offset / PALLOC_PAGE_SIZE) * 0xbf58476d1ce4e5b9ull;
+
+    h ^= h >> 31;
+    return (size_t)h & SLOT_MASK;
+}
+
+static Entry *find(uint64_t file, size_t offset)
+{
+    for (size_t i = home_slot(file, offset);; i = (i + 1) & SLOT_MASK)
+    {
+        Entry *e = &table[i];
+
+        if (e->page == NULL)
+        {
+            return NULL;
+        }
+
+        if (e->file == file && e->offset == offset)
+        {
+            return e;
+        }
+    }
+}
+
+static void remove_at(size_t slot)
+{
+    palloc_free(table[slot].page);
+    table[slot].page = NULL;
+    stats.pages--;
+
+    // Pull later members of the probe run into the hole when that keeps them
+    // reachable from their home slot.
+    size_t hole = slot;
+
+    for (size_t j = (slot + 1) & SLOT_MASK; table[j].page != NULL; j = (j + 1) & SLOT_MASK)
+    {
+        const size_t home = home_slot(table[j].file, table[j].offset);
+
+        if (((j - home) & SLOT_MASK) >= ((j - hole) & SLOT_MASK))
+        {
+            table[hole] = table[j];
+            table[j].page = NULL;
+            hole = j;
+        }
+    }
+}
+
+// A page whose only reference is the cache's own is mapped nowhere.
+static bool unmapped(const Entry *e)
+{
+    return palloc_refcount(e->page) == 1;
+}
+
+static bool evict_one(void)
+{
+    for (size_t n = 0; n < PAGECACHE_NR_ENTRIES; n++)
+    {
+        const size_t i = clock_hand;
+
+        clock_hand = (clock_hand + 1) & SLOT_MASK;
+
+        if (table[i].page != NULL && unmapped(&table[i]))
+        {
+            remove_at(i);
+            stats.evictions++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void pagecache_init(void)
+{
+    memset(table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    clock_hand = 0;
+}
+
+void *pagecache_get(uint64_t file, size_t offset)
+{
+    Entry *e = find(file, offset);
+
+    if (e == NULL)
+    {
+        stats.misses++;
+        return NULL;
+    }
+
+    stats.hits++;
+    palloc_ref(e->page);
+    return e->page;
+}
+
+void pagecache_add(uint64_t file, size_t offset, void *page)
+{
+    assert(page != NULL);
+
+    if (find(file, offset) != NULL || (stats.pages >= MAX_PAGES && !evict_one()))
+    {
+        return;
+    }
+
+    size_t i = home_slot(file, offset);
+
+    while (table[i].page != NULL)
+    {
+        i = (i + 1) & SLOT_MASK;
+    }
+
+    palloc_ref(page);
+    table[i] = (Entry){.file = file, .offset = offset, .page = page};
+    stats.pages++;
+}
+
+void pagecache_invalidate(uint64_t file)
+{
+    // remove_at() only refills the emptied slot and slots after it, so looking
+    // at the same slot again still visits every entry.
+    for (size_t i = 0; i < PAGECACHE_NR_ENTRIES;)
+    {
+        if (table[i].page != NULL && table[i].file == file)
+        {
+            remove_at(i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+size_t pagecache_shrink(void)
+{
+    size_t released = 0;
+
+    for (size_t i = 0; i < PAGECACHE_NR_ENTRIES;)
+    {
+        if (table[i].page != NULL && unmapped(&table[i]))
+        {
+            remove_at(i);
+            released++;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    stats.evictions += released;
+    return released;
+}
+
+void pagecache_get_stats(PagecacheStats *out)
+{
+    assert(out != NULL);
+    *out = stats;
+}
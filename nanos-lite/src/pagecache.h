@@ -0,0 +1,49 @@
+#ifndef NANOS_PAGECACHE_H__
+#define NANOS_PAGECACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read-only file pages shared between address spaces.  A page is keyed by the
+ * file it came from and an offset the caller picks inside that file; the cache
+ * holds one page reference of its own and every mapping holds another.
+ */
+
+/*
+ * Executable images are cached by page address rather than file offset, since
+ * one page may hold the ends of two segments.  This bit keeps those keys apart
+ * from the file offsets mmap() uses for the same file.
+ */
+#define PAGECACHE_IMAGE_PAGE ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+/* Entries in the table; at most this many pages stay cached. */
+#ifndef PAGECACHE_NR_ENTRIES
+#define PAGECACHE_NR_ENTRIES 2048u
+#endif
+
+typedef struct
+{
+    size_t pages;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} PagecacheStats;
+
+/* Forget every entry without touching the pages; for start-up and tests. */
+void pagecache_init(void);
+/* The cached page for (file, offset) with a reference added for the caller, or NULL. */
+void *pagecache_get(uint64_t file, size_t offset);
+/*
+ * Offer a filled page the caller holds a reference to.  The cache takes a
+ * reference of its own, evicting a page nobody maps if the table is full; when
+ * every cached page is still mapped the page is simply not cached.
+ */
+void pagecache_add(uint64_t file, size_t offset, void *page);
+/* Drop the pages of a file whose contents changed.  Existing mappings keep theirs. */
+void pagecache_invalidate(uint64_t file);
+/* Release every cached page no address space maps; returns how many went. */
+size_t pagecache_shrink(void);
+void pagecache_get_stats(PagecacheStats *stats);
+
+#endif
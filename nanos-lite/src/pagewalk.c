@@ -25,6 +25,8 @@
 #define PTE_W ((uintptr_t)1u << 2)
 #define PTE_X ((uintptr_t)1u << 3)
 #define PTE_RWX (PTE_R | PTE_W | PTE_X)
+/* First of the two RSW bits, reserved for supervisor software. */
+#define PTE_COW ((uintptr_t)1u << 8)
 #define PTE_PPN_SHIFT 10u
 
 #if NANOS_PAGEWALK_XLEN == 32
@@ -56,7 +58,7 @@ static int pte_is_leaf(NanosPte pte)
     return (pte & PTE_RWX) != 0;
 }
 
-void *nanos_pagewalk_lookup_page(void *root, uintptr_t vaddr)
+static NanosPte *lookup_leaf(void *root, uintptr_t vaddr)
 {
     assert(root != NULL);
 
@@ -78,7 +80,7 @@ void *nanos_pagewalk_lookup_page(void *root, uintptr_t vaddr)
             // AM maps user pages as 4 KiB leaves; upper-level leaves would be
             // superpages, which the Nanos loader does not create or need.
             assert(level == 0);
-            return (void *)pte_page_base(pte);
+            return &table[vpn];
         }
 
         assert(level > 0);
@@ -87,3 +89,131 @@ void *nanos_pagewalk_lookup_page(void *root, uintptr_t vaddr)
 
     return NULL;
 }
+
+void *nanos_pagewalk_lookup_page(void *root, uintptr_t vaddr)
+{
+    const NanosPte *leaf = lookup_leaf(root, vaddr);
+    return leaf != NULL ? (void *)pte_page_base(*leaf) : NULL;
+}
+
+int nanos_pagewalk_get_flags(void *root, uintptr_t vaddr)
+{
+    const NanosPte *leaf = lookup_leaf(root, vaddr);
+
+    if (leaf == NULL)
+    {
+        return -1;
+    }
+
+    return ((*leaf & PTE_W) != 0 ? NANOS_PAGE_WRITE : 0) | ((*leaf & PTE_COW) != 0 ? NANOS_PAGE_COW : 0);
+}
+
+void nanos_pagewalk_set_page(void *root, uintptr_t vaddr, void *page, int flags)
+{
+    NanosPte *leaf = lookup_leaf(root, vaddr);
+
+    assert(leaf != NULL);
+    assert(((uintptr_t)page & (PAGE_SIZE - 1u)) == 0);
+
+    NanosPte pte = *leaf & (((NanosPte)1u << PTE_PPN_SHIFT) - 1u) & ~(NanosPte)(PTE_W | PTE_COW);
+
+    if ((flags & NANOS_PAGE_WRITE) != 0)
+    {
+        pte |= PTE_W;
+    }
+
+    if ((flags & NANOS_PAGE_COW) != 0)
+    {
+        pte |= PTE_COW;
+    }
+
+    *leaf = pte | ((NanosPte)((uintptr_t)page >> PAGE_SHIFT) << PTE_PPN_SHIFT);
+}
+
+/*
+ * Visit the leaves of one table that fall in [start, end).  With unmap set the
+ * leaf is cleared before fn sees its page.
+ */
+static size_t walk_table(NanosPte *table, int level, uintptr_t base, uintptr_t start, uintptr_t end, int unmap,
+                         void (*fn)(void *arg, uintptr_t vaddr, void *page), void *arg)
+{
+    const uintptr_t span = PAGE_SIZE << ((uintptr_t)level * VPN_BITS);
+    size_t visited = 0;
+
+    for (uintptr_t vpn = 0; vpn <= VPN_MASK; vpn++)
+    {
+        const uintptr_t lo = base + vpn * span;
+
+        // lo + span - 1 cannot wrap, unlike lo + span for the top Sv32 entry.
+        if (lo + (span - 1u) < start || lo >= end)
+        {
+            continue;
+        }
+
+        const NanosPte pte = table[vpn];
+
+        if (!pte_is_valid(pte))
+        {
+            continue;
+        }
+
+        if (!pte_is_leaf(pte))
+        {
+            assert(level > 0);
+            visited += walk_table((NanosPte *)pte_page_base(pte), level - 1, lo, start, end, unmap, fn, arg);
+            continue;
+        }
+
+        assert(level == 0);
+        visited++;
+
+        if (unmap)
+        {
+            table[vpn] = 0;
+        }
+
+        if (fn != NULL)
+        {
+            fn(arg, lo, (void *)pte_page_base(pte));
+        }
+    }
+
+    return visited;
+}
+
+static size_t walk_range(void *root, uintptr_t start, uintptr_t end, int unmap,
+                         void (*fn)(void *arg, uintptr_t vaddr, void *page), void *arg)
+{
+    assert(root != NULL);
+    assert((start & (PAGE_SIZE - 1u)) == 0 && (end & (PAGE_SIZE - 1u)) == 0);
+
+    if (start >= end)
+    {
+        return 0;
+    }
+
+    return walk_table((NanosPte *)root, PAGEWALK_LEVELS - 1, 0, start, end, unmap, fn, arg);
+}
+
+typedef struct
+{
+    void (*release)(void *page);
+} ReleaseFn;
+
+static void call_release(void *arg, uintptr_t vaddr, void *page)
+{
+    (void)vaddr;
+    ((ReleaseFn *)arg)->release(page);
+}
+
+size_t nanos_pagewalk_unmap_range(void *root, uintptr_t start, uintptr_t end, void (*release)(void *page))
+{
+    ReleaseFn fn = {.release = release};
+    return walk_range(root, start, end, 1, release != NULL ? call_release : NULL, &fn);
+}
+
+void nanos_pagewalk_for_each(void *root, uintptr_t start, uintptr_t end,
+                             void (*fn)(void *arg, uintptr_t vaddr, void *page), void *arg)
+{
+    walk_range(root, start, end, 0, fn, arg);
+}
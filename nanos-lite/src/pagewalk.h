@@ -1,8 +1,36 @@
 #ifndef NANOS_PAGEWALK_H__
 #define NANOS_PAGEWALK_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 void *nanos_pagewalk_lookup_page(void *root, uintptr_t vaddr);
+/*
+ * Clear every leaf mapping in the page-aligned range [start, end) and hand
+ * each mapped page to release (when non-NULL).  Intermediate tables stay in
+ * place.  Returns the number of pages unmapped.
+ */
+size_t nanos_pagewalk_unmap_range(void *root, uintptr_t start, uintptr_t end, void (*release)(void *page));
+
+/*
+ * Access state of a leaf mapping.  NANOS_PAGE_COW is kept in a PTE bit the
+ * hardware ignores; such a page is shared read-only until its first write.
+ */
+enum
+{
+    NANOS_PAGE_WRITE = 1,
+    NANOS_PAGE_COW = 2,
+};
+
+/* Call fn for every page mapped in the page-aligned range [start, end). */
+void nanos_pagewalk_for_each(void *root, uintptr_t start, uintptr_t end,
+                             void (*fn)(void *arg, uintptr_t vaddr, void *page), void *arg);
+/* NANOS_PAGE_* flags of the page holding vaddr, or -1 if it is unmapped. */
+int nanos_pagewalk_get_flags(void *root, uintptr_t vaddr);
+/*
+ * Point an existing leaf mapping at page with the given NANOS_PAGE_* flags,
+ * keeping its other permission bits.
+ */
+void nanos_pagewalk_set_page(void *root, uintptr_t vaddr, void *page, int flags);
 
 #endif
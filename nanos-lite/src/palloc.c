@@ -0,0 +1,229 @@
+#include "palloc.h"
+
+#if defined(__ISA__)
+#include <klib.h>
+#else
+#include <assert.h>
+#include <string.h>
+#endif
+
+/*
+ * Binary buddy allocator for physical pages.  Free blocks of 2^order pages sit
+ * on one list per order, linked through the free pages themselves, and a block
+ * merges with its buddy whenever both are free.  Only the first page of a free
+ * block carries its order in page_state[]; allocated pages are marked one by
+ * one, because a multi-page run is released a page at a time when the address
+ * space that mapped it goes away.  An allocated page's state is its reference
+ * count, so copy-on-write sharing needs no table of its own.
+ */
+
+/* Largest block is 2^PALLOC_MAX_ORDER pages (4 MiB). */
+#define PALLOC_MAX_ORDER 10
+#define PAGE_FREE_HEAD 0x8000u
+#define PAGE_MAX_REFS 0x7fffu
+
+typedef struct FreeBlock
+{
+    struct FreeBlock *next;
+    struct FreeBlock *prev;
+} FreeBlock;
+
+static uint8_t *pool = NULL;
+static size_t pool_pages = 0;
+static size_t nr_free = 0;
+/* PAGE_FREE_HEAD | order, a reference count, or 0 inside a free block. */
+static uint16_t *page_state = NULL;
+static FreeBlock *free_lists[PALLOC_MAX_ORDER + 1];
+
+static FreeBlock *block_at(size_t idx)
+{
+    return (FreeBlock *)(pool + idx * PALLOC_PAGE_SIZE);
+}
+
+static void list_push(int order, size_t idx)
+{
+    FreeBlock *b = block_at(idx);
+
+    b->prev = NULL;
+    b->next = free_lists[order];
+
+    if (b->next != NULL)
+    {
+        b->next->prev = b;
+    }
+
+    free_lists[order] = b;
+    page_state[idx] = (uint16_t)(PAGE_FREE_HEAD | (unsigned)order);
+}
+
+static void list_remove(int order, size_t idx)
+{
+    FreeBlock *b = block_at(idx);
+
+    if (b->prev != NULL)
+    {
+        b->prev->next = b->next;
+    }
+    else
+    {
+        free_lists[order] = b->next;
+    }
+
+    if (b->next != NULL)
+    {
+        b->next->prev = b->prev;
+    }
+
+    page_state[idx] = 0;
+}
+
+static void free_block(size_t idx, int order)
+{
+    while (order < PALLOC_MAX_ORDER)
+    {
+        const size_t buddy = idx ^ ((size_t)1 << order);
+
+        if (buddy >= pool_pages || page_state[buddy] != (PAGE_FREE_HEAD | (unsigned)order))
+        {
+            break;
+        }
+
+        list_remove(order, buddy);
+        idx &= buddy;
+        order++;
+    }
+
+    list_push(order, idx);
+}
+
+void palloc_init(void *start, void *end)
+{
+    const uintptr_t first = ((uintptr_t)start + PALLOC_PAGE_SIZE - 1) & ~(uintptr_t)(PALLOC_PAGE_SIZE - 1);
+    const uintptr_t last = (uintptr_t)end & ~(uintptr_t)(PALLOC_PAGE_SIZE - 1);
+
+    assert(last > first);
+
+    const size_t total = (size_t)(last - first) / PALLOC_PAGE_SIZE;
+    const size_t meta_pages = (total * sizeof(*page_state) + PALLOC_PAGE_SIZE - 1) / PALLOC_PAGE_SIZE;
+
+    assert(total > meta_pages);
+
+    page_state = (uint16_t *)first;
+    pool = (uint8_t *)(first + meta_pages * PALLOC_PAGE_SIZE);
+    pool_pages = total - meta_pages;
+    nr_free = pool_pages;
+    memset(page_state, 0, pool_pages * sizeof(*page_state));
+    memset(free_lists, 0, sizeof(free_lists));
+
+    // Carve the pool into the largest naturally aligned blocks that fit.
+    for (size_t idx = 0; idx < pool_pages;)
+    {
+        int order = PALLOC_MAX_ORDER;
+
+        while ((idx & (((size_t)1 << order) - 1)) != 0 || idx + ((size_t)1 << order) > pool_pages)
+        {
+            order--;
+        }
+
+        free_block(idx, order);
+        idx += (size_t)1 << order;
+    }
+}
+
+void *palloc_alloc(size_t nr_pages)
+{
+    if (nr_pages == 0 || nr_pages > ((size_t)1 << PALLOC_MAX_ORDER))
+    {
+        return NULL;
+    }
+
+    int order = 0;
+
+    while (((size_t)1 << order) < nr_pages)
+    {
+        order++;
+    }
+
+    int avail = order;
+
+    while (avail <= PALLOC_MAX_ORDER && free_lists[avail] == NULL)
+    {
+        avail++;
+    }
+
+    if (avail > PALLOC_MAX_ORDER)
+    {
+        return NULL;
+    }
+
+    const size_t idx = (size_t)((uint8_t *)free_lists[avail] - pool) / PALLOC_PAGE_SIZE;
+    list_remove(avail, idx);
+
+    // Split down to the requested order, keeping the lower half each time.
+    while (avail > order)
+    {
+        avail--;
+        list_push(avail, idx + ((size_t)1 << avail));
+    }
+
+    for (size_t i = 0; i < nr_pages; i++)
+    {
+        page_state[idx + i] = 1;
+    }
+
+    // A run that is not a power of two gives its tail back straight away.
+    for (size_t i = nr_pages; i < ((size_t)1 << order); i++)
+    {
+        free_block(idx + i, 0);
+    }
+
+    nr_free -= nr_pages;
+    return block_at(idx);
+}
+
+static size_t page_index(const void *page)
+{
+    const uintptr_t p = (uintptr_t)page;
+
+    assert(p >= (uintptr_t)pool && p < (uintptr_t)pool + pool_pages * PALLOC_PAGE_SIZE);
+    assert(p % PALLOC_PAGE_SIZE == 0);
+
+    const size_t idx = (size_t)(p - (uintptr_t)pool) / PALLOC_PAGE_SIZE;
+
+    // Catches double frees and pointers into the middle of a free block.
+    assert(page_state[idx] != 0 && (page_state[idx] & PAGE_FREE_HEAD) == 0);
+    return idx;
+}
+
+void palloc_ref(void *page)
+{
+    const size_t idx = page_index(page);
+
+    assert(page_state[idx] < PAGE_MAX_REFS);
+    page_state[idx]++;
+}
+
+unsigned palloc_refcount(const void *page)
+{
+    return page_state[page_index(page)];
+}
+
+void palloc_free(void *page)
+{
+    const size_t idx = page_index(page);
+
+    if (--page_state[idx] != 0)
+    {
+        return;
+    }
+
+    free_block(idx, 0);
+    nr_free++;
+}
+
+void palloc_get_stats(PallocStats *stats)
+{
+    assert(stats != NULL);
+    stats->total_pages = pool_pages;
+    stats->free_pages = nr_free;
+}
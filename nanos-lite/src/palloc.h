@@ -0,0 +1,37 @@
+#ifndef NANOS_PALLOC_H__
+#define NANOS_PALLOC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Allocation unit; matches the 4 KiB pages of Sv32 and Sv39. */
+#define PALLOC_PAGE_SIZE 4096u
+
+typedef struct
+{
+    size_t total_pages;
+    size_t free_pages;
+} PallocStats;
+
+/*
+ * Manage the physical pages in [start, end).  The per-page state table is
+ * carved from the front of the range, so fewer pages than the range holds are
+ * handed out.
+ */
+void palloc_init(void *start, void *end);
+/*
+ * Return nr_pages physically contiguous pages, or NULL if no such run is free.
+ * Every page of the run is owned separately and goes back with its own
+ * palloc_free(), so a caller may map a run and later unmap it page by page.
+ */
+void *palloc_alloc(size_t nr_pages);
+/*
+ * Pages start with one reference.  palloc_ref() adds a sharer and
+ * palloc_free() drops one, returning the page once the last is gone.
+ */
+void palloc_ref(void *page);
+unsigned palloc_refcount(const void *page);
+void palloc_free(void *page);
+void palloc_get_stats(PallocStats *stats);
+
+#endif
@@ -1,54 +1,181 @@
+#include <fs.h>
 #include <proc.h>
 
 enum
 {
+    // Timer ticks a process may run before a ready peer of its class gets a turn.
+    TIME_SLICE_TICKS = 2,
+    // Foreground slices between two background turns.
     FOREGROUND_QUANTA = 5,
 };
 
+/* Scheduling classes, highest first.  A dormant process is never picked. */
+enum
+{
+    PRIO_DORMANT = 0,
+    PRIO_BACKGROUND = 1,
+    PRIO_FOREGROUND = 2,
+};
+
 void context_uload(PCB *pcb, const char *filename, char *const argv[], char *const envp[]);
 void device_capture_foreground_before_switch(void);
 void device_note_foreground_switch(void);
 void device_restore_foreground_on_schedule(void);
+void disk_sync(void);
 
-static PCB pcb[MAX_NR_PROC] __attribute__((used)) = {};
+/*
+ * Every live process in creation order, which is also the round-robin order
+ * of schedule().  PCBs come from the page allocator, so the number of
+ * processes is bounded by memory rather than by a table.
+ */
+static PCB *proc_list = NULL;
+/* Exited PCBs whose kernel stacks proc_reap() has not freed yet. */
+static PCB *dead_list = NULL;
 static PCB pcb_boot = {};
+/* Runs when every process is blocked. */
+static PCB pcb_idle = {};
 PCB *current = NULL;
-static PCB *fg_pcb = &pcb[0];
+static int fg_slot = 0;
+static int next_pid = 1;
 /* The foreground app normally runs continuously.  If the optional background
  * slot is loaded, this small budget lets it make progress without giving it
  * ownership of foreground-only devices such as /dev/fb and /dev/sb.
  */
 static int foreground_budget = FOREGROUND_QUANTA;
+/* The running background slice was granted from the budget, not from idle time. */
+static bool background_turn = false;
 
 void switch_boot_pcb() { current = &pcb_boot; }
 
-static bool pcb_runnable(PCB *pcb)
+static bool is_user_pcb(const PCB *pcb)
+{
+    return pcb != NULL && pcb != &pcb_boot && pcb != &pcb_idle;
+}
+
+// Not exited; the process may still be blocked.
+static bool pcb_live(const PCB *pcb)
 {
     return pcb != NULL && pcb->cp != NULL;
 }
 
-// Translate PCB pointers to process-table slots without exposing pcb[] itself.
-static int pcb_index_of(PCB *target)
+static bool pcb_ready(const PCB *pcb)
+{
+    return pcb_live(pcb) && pcb->state == PROC_READY;
+}
+
+static int pcb_priority(const PCB *pcb)
+{
+    if (pcb->slot == fg_slot)
+    {
+        return PRIO_FOREGROUND;
+    }
+
+    return pcb->slot == HELLO_PROC ? PRIO_BACKGROUND : PRIO_DORMANT;
+}
+
+/* A new PCB of slot at the tail of the process list, or NULL when memory runs out. */
+static PCB *pcb_alloc(int slot)
+{
+    PCB *pcb = try_new_page(STACK_SIZE / PGSIZE);
+
+    if (pcb == NULL)
+    {
+        return NULL;
+    }
+
+    memset(pcb, 0, sizeof(*pcb));
+    pcb->pid = next_pid++;
+    pcb->slot = slot;
+
+    PCB **tail = &proc_list;
+
+    while (*tail != NULL)
+    {
+        tail = &(*tail)->next;
+    }
+
+    *tail = pcb;
+    return pcb;
+}
+
+static void pcb_unlink(PCB *pcb)
+{
+    for (PCB **link = &proc_list; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == pcb)
+        {
+            *link = pcb->next;
+            pcb->next = NULL;
+            return;
+        }
+    }
+
+    panic("PCB %p is not on the process list", pcb);
+}
+
+static void pcb_free(PCB *pcb)
+{
+    for (int i = 0; i < STACK_SIZE / PGSIZE; i++)
+    {
+        free_page(pcb->stack + i * PGSIZE);
+    }
+}
+
+/*
+ * The live process of slot that follows after in list order, wrapping round
+ * to after itself; NULL if the slot has none.
+ */
+static PCB *next_in_slot(PCB *after, int slot)
+{
+    for (PCB *p = after != NULL ? after->next : NULL; p != NULL; p = p->next)
+    {
+        if (p->slot == slot && pcb_live(p))
+        {
+            return p;
+        }
+    }
+
+    for (PCB *p = proc_list; p != NULL; p = p->next)
+    {
+        if (p->slot == slot && pcb_live(p))
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/* Same walk over the ready processes of one scheduling class. */
+static PCB *next_ready(PCB *after, int prio)
 {
-    for (int i = 0; i < MAX_NR_PROC; i++)
+    for (PCB *p = after != NULL ? after->next : NULL; p != NULL; p = p->next)
     {
-        if (target == &pcb[i])
+        if (pcb_ready(p) && pcb_priority(p) == prio)
         {
-            return i;
+            return p;
         }
     }
 
-    return -1;
+    for (PCB *p = proc_list; p != NULL; p = p->next)
+    {
+        if (pcb_ready(p) && pcb_priority(p) == prio)
+        {
+            return p;
+        }
+    }
+
+    return NULL;
 }
 
 int current_pcb_index(void)
 {
-    return pcb_index_of(current);
+    return is_user_pcb(current) ? current->slot : -1;
 }
 
 int foreground_pcb_index(void)
 {
-    return pcb_index_of(fg_pcb);
+    return fg_slot;
 }
 
 bool switch_fg_pcb(int index)
@@ -60,13 +187,11 @@ bool switch_fg_pcb(int index)
      */
     assert(index >= 0 && index < NR_FOREGROUND_PROC);
 
-    PCB *next = &pcb[index];
-    assert(pcb_runnable(next));
-
-    if (fg_pcb != next)
+    // Every process of the slot may have exited; a blocked one still counts.
+    if (fg_slot != index && next_in_slot(NULL, index) != NULL)
     {
         /*
-         * Snapshot the old foreground display before changing fg_pcb.  The device
+         * Snapshot the old foreground display before changing fg_slot.  The device
          * layer identifies the old owner through foreground_pcb_index(), so this
          * ordering is what lets lazy framebuffer backing preserve the outgoing
          * app's last physical frame.
@@ -76,16 +201,231 @@ bool switch_fg_pcb(int index)
          * syscall while handling the hotkey.
          */
         device_capture_foreground_before_switch();
-        fg_pcb = next;
+        fg_slot = index;
         foreground_budget = FOREGROUND_QUANTA;
+        background_turn = false;
         device_note_foreground_switch();
-        Log("Switch foreground to pcb[%d]", index);
+        Log("Switch foreground to slot %d", index);
         return true;
     }
 
     return false;
 }
 
+void proc_exit(int status)
+{
+    PCB *dead = current;
+
+    assert(is_user_pcb(dead));
+    fs_fd_release(dead);
+    loader_release(dead);
+    mm_mmap_release(dead);
+
+    if (dead->as.ptr != NULL)
+    {
+        mm_retire(&dead->as);
+    }
+
+    // This trap still runs on the dead PCB's stack, so it is freed later.
+    dead->cp = NULL;
+    pcb_unlink(dead);
+    dead->next = dead_list;
+    dead_list = dead;
+
+    // schedule() must not save the dying trap frame back into the PCB.
+    current = NULL;
+
+    for (int i = 0; i < NR_FOREGROUND_PROC && next_in_slot(NULL, fg_slot) == NULL; i++)
+    {
+        if (next_in_slot(NULL, i) != NULL)
+        {
+            switch_fg_pcb(i);
+        }
+    }
+
+    if (next_in_slot(NULL, fg_slot) == NULL)
+    {
+        // Cached disk writes would be lost with the machine.
+        disk_sync();
+        halt(status);
+    }
+
+    Log("pid %d exited with status %d", dead->pid, status);
+}
+
+void proc_reap(void)
+{
+    while (dead_list != NULL)
+    {
+        PCB *dead = dead_list;
+        dead_list = dead->next;
+        pcb_free(dead);
+    }
+}
+
+void proc_tick(void)
+{
+    if (is_user_pcb(current) && current->slice > 0)
+    {
+        current->slice--;
+    }
+}
+
+void proc_yield(void)
+{
+    if (is_user_pcb(current))
+    {
+        current->slice = 0;
+    }
+}
+
+bool proc_block(WaitQueue *wq)
+{
+    assert(is_user_pcb(current));
+
+    if (current->woken)
+    {
+        current->woken = false;
+        return false;
+    }
+
+    PCB **tail = &wq->head;
+
+    while (*tail != NULL)
+    {
+        tail = &(*tail)->wait_next;
+    }
+
+    current->state = PROC_BLOCKED;
+    current->wait_next = NULL;
+    *tail = current;
+    return true;
+}
+
+void proc_wakeup(WaitQueue *wq)
+{
+    while (wq->head != NULL)
+    {
+        PCB *p = wq->head;
+        wq->head = p->wait_next;
+        p->wait_next = NULL;
+        p->state = PROC_READY;
+        p->woken = true;
+    }
+}
+
+void proc_forbid_block(void)
+{
+    assert(is_user_pcb(current));
+    current->woken = true;
+}
+
+bool proc_syscall_blocked(void)
+{
+    if (!is_user_pcb(current))
+    {
+        return false;
+    }
+
+    if (current->state == PROC_BLOCKED)
+    {
+        return true;
+    }
+
+    // A wakeup only excuses the restarted call, not the next one.
+    current->woken = false;
+    return false;
+}
+
+void proc_account_trap(PCB *pcb, bool syscall, bool fault, uint64_t instrs, uint64_t us)
+{
+    if (!is_user_pcb(pcb))
+    {
+        return;
+    }
+
+    pcb->nr_syscalls += syscall ? 1 : 0;
+    pcb->nr_faults += fault ? 1 : 0;
+    pcb->kernel_instrs += instrs;
+    pcb->kernel_us += us;
+}
+
+static PCB *find_pid(int pid)
+{
+    for (PCB *p = proc_list; p != NULL; p = p->next)
+    {
+        if (p->pid == pid && pcb_live(p))
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+bool proc_pid_live(int pid)
+{
+    return find_pid(pid) != NULL;
+}
+
+size_t proc_stat_render(int pid, char text[PROC_STAT_TEXT_SIZE])
+{
+    const PCB *p = find_pid(pid);
+
+    if (p == NULL)
+    {
+        return 0;
+    }
+
+    const int text_len = snprintf(text, PROC_STAT_TEXT_SIZE,
+                                  "PID:%d\nSLOT:%d\nSTATE:%s\nSYSCALLS:%llu\nFAULTS:%llu\n"
+                                  "KERNEL_INSTRS:%llu\nKERNEL_US:%llu\nBRK:%p\nMMAPS:%d\n",
+                                  p->pid, p->slot, p->state == PROC_BLOCKED ? "blocked" : "ready",
+                                  (unsigned long long)p->nr_syscalls, (unsigned long long)p->nr_faults,
+                                  (unsigned long long)p->kernel_instrs, (unsigned long long)p->kernel_us,
+                                  (void *)p->max_brk, p->nr_mmaps);
+
+    assert(text_len >= 0 && text_len < PROC_STAT_TEXT_SIZE);
+    return (size_t)text_len;
+}
+
+int proc_fork(const Context *c)
+{
+    PCB *parent = current;
+    PCB *child = pcb_alloc(parent->slot);
+
+    if (child == NULL)
+    {
+        return -1;
+    }
+
+    if (!loader_fork(child, parent) || !mm_mmap_fork(child, parent))
+    {
+        loader_release(child);
+        pcb_unlink(child);
+        pcb_free(child);
+        return -1;
+    }
+
+    // Descriptors share the parent's open files, offsets included.
+    fs_fd_fork(child, parent);
+
+    // Only page tables are copied; the pages themselves are shared until written.
+    mm_fork(&child->as, &parent->as);
+    child->max_brk = parent->max_brk;
+    child->brk_start = parent->brk_start;
+
+    // A fresh user frame supplies the child's own kernel stack and satp; the
+    // registers, including sp, are the parent's at the ecall.
+    Area kstack = (Area){.start = child->stack, .end = child + 1};
+    Context *cp = ucontext(&child->as, kstack, (void *)c->mepc);
+    memcpy(cp->gpr, c->gpr, sizeof(cp->gpr));
+    cp->GPRx = 0;
+    child->cp = cp;
+
+    return child->pid;
+}
+
 void context_kload(PCB *pcb, void (*entry)(void *), void *arg)
 {
     // Build an Area that describes this PCB's kernel stack range.
@@ -115,6 +455,36 @@ void hello_fun(void *arg)
     }
 }
 
+/*
+ * Interrupts are enabled in kernel threads, so wfi parks the CPU until a timer
+ * tick or a device wakes a process up.
+ */
+static void idle_loop(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+#if defined(__riscv)
+        asm volatile("wfi");
+#endif
+    }
+}
+
+/* Start a program in a new process of slot, with the console as fds 0-2. */
+static void uload_app(int slot, const char *filename, char *const argv[], char *const envp[])
+{
+    PCB *pcb = pcb_alloc(slot);
+
+    if (pcb == NULL)
+    {
+        panic("No memory for the PCB of %s", filename);
+    }
+
+    fs_fd_stdio(pcb);
+    context_uload(pcb, filename, argv, envp);
+}
+
 void init_proc()
 {
     Log("Initializing processes...");
@@ -126,16 +496,17 @@ void init_proc()
     static char *const argv_onscripter[] = {"/bin/onscripter", "-r", "/share/games/ons", NULL};
     // static char *const argv_nslider[] = { "/bin/nslider", NULL };
     // static char *const argv_hello[] = { "/bin/hello", NULL };
-    context_uload(&pcb[0], "/bin/fceux", argv_fceux, envp_empty);
-    context_uload(&pcb[1], "/bin/onscripter", argv_onscripter, envp_empty);
-    context_uload(&pcb[2], "/bin/pal", argv_pal, envp_empty);
-    // context_uload(&pcb[2], "/bin/nslider", argv_nslider, envp_empty);
-    // context_uload(&pcb[3], "/bin/hello", argv_hello, envp_empty);
-    fg_pcb = &pcb[0];
+    uload_app(0, "/bin/fceux", argv_fceux, envp_empty);
+    uload_app(1, "/bin/onscripter", argv_onscripter, envp_empty);
+    uload_app(2, "/bin/pal", argv_pal, envp_empty);
+    // uload_app(2, "/bin/nslider", argv_nslider, envp_empty);
+    // uload_app(HELLO_PROC, "/bin/hello", argv_hello, envp_empty);
+    context_kload(&pcb_idle, idle_loop, NULL);
+    fg_slot = 0;
     foreground_budget = FOREGROUND_QUANTA;
 
     // Initialize current to the boot PCB,
-    // so the first schedule() call switches to pcb[0].
+    // so the first schedule() call switches to slot 0.
     switch_boot_pcb();
 
     // void naive_uload(PCB *pcb, const char *filename);
@@ -144,40 +515,67 @@ void init_proc()
 
 Context *schedule(Context *prev)
 {
+    PCB *prev_pcb = current;
+
     // Save the context of the currently running PCB.
     if (current != NULL)
     {
         current->cp = prev;
     }
 
-    // Pick the next runnable PCB.
-    // First switch: from boot PCB to the selected foreground process.
-    if (current == &pcb_boot)
+    /*
+     * Processes of the foreground slot form the high class and take turns in
+     * time slices.  The optional background slot runs whenever the whole
+     * foreground is blocked, and also gets one slice every FOREGROUND_QUANTA
+     * foreground slices so a busy app cannot starve it.  Other foreground
+     * slots remain dormant until selected, so their framebuffer/audio state can
+     * be restored as a simple foreground switch instead of a true compositor.
+     * The first switch comes from the boot PCB, whose empty list link makes the
+     * search start at the head.
+     */
+    PCB *fg = next_ready(prev_pcb, PRIO_FOREGROUND);
+    PCB *bg = next_ready(prev_pcb, PRIO_BACKGROUND);
+    PCB *next = NULL;
+
+    const int prev_prio = is_user_pcb(prev_pcb) ? pcb_priority(prev_pcb) : PRIO_DORMANT;
+    // A woken foreground process cuts short a background slice that only ran for want of work.
+    const bool preempted = prev_prio == PRIO_BACKGROUND && fg != NULL && !background_turn;
+
+    if (prev_prio != PRIO_DORMANT && pcb_ready(prev_pcb) && prev_pcb->slice > 0 && !preempted)
     {
-        // First entry into user space: keep boot as a fake previous owner so the
-        // scheduler has somewhere to save the boot trap context.
-        current = fg_pcb;
+        next = prev_pcb;
     }
-    else if (current == fg_pcb)
+    else
     {
-        /* Only the optional background slot is time-shared here.  Other foreground
-         * apps remain dormant until selected, so their framebuffer/audio state can
-         * be restored as a simple foreground switch instead of a true compositor.
-         */
-        if (pcb_runnable(&pcb[HELLO_PROC]) && foreground_budget-- <= 0)
+        background_turn = false;
+
+        if (fg != NULL && (bg == NULL || foreground_budget > 0))
+        {
+            if (bg != NULL)
+            {
+                foreground_budget--;
+            }
+
+            next = fg;
+        }
+        else if (bg != NULL)
         {
             foreground_budget = FOREGROUND_QUANTA;
-            current = &pcb[HELLO_PROC];
+            background_turn = fg != NULL;
+            next = bg;
         }
-    }
-    else
-    {
-        current = fg_pcb;
+        else
+        {
+            // Nothing is ready; interrupts end the wait.
+            next = &pcb_idle;
+        }
+
+        next->slice = TIME_SLICE_TICKS;
     }
 
-    assert(pcb_runnable(current));
+    current = next;
 
-    if (current == fg_pcb)
+    if (is_user_pcb(current) && current->slot == fg_slot)
     {
         // Shared foreground devices are restored only when the selected foreground
         // PCB is about to run. This avoids restoring audio/video while another PCB
@@ -0,0 +1,58 @@
+#include "ring.h"
+
+intptr_t iovec_run(const NanosIovec *iov, int iovcnt, IovecOp op, void *arg)
+{
+    size_t total = 0;
+
+    for (int i = 0; i < iovcnt; i++)
+    {
+        const size_t n = op(arg, &iov[i], total == 0);
+
+        if (n == (size_t)-1)
+        {
+            return total > 0 ? (intptr_t)total : -1;
+        }
+
+        total += n;
+
+        if (n < iov[i].len)
+        {
+            break;
+        }
+    }
+
+    return (intptr_t)total;
+}
+
+bool ring_valid(const NanosRing *ring)
+{
+    return ring != NULL && ring->sqes != 0 && ring->cqes != 0 && ring->entries != 0 &&
+           ring->entries <= NANOS_RING_MAX_ENTRIES && (ring->entries & (ring->entries - 1)) == 0;
+}
+
+intptr_t ring_run(NanosRing *ring, const NanosSqe *sqes, NanosCqe *cqes, RingOp op, void *arg)
+{
+    // The indices run freely, so masking finds the slot after any wrap.
+    const uint32_t mask = ring->entries - 1;
+    intptr_t done = 0;
+
+    while (ring->sq_head != ring->sq_tail && ring->cq_tail - ring->cq_head < ring->entries)
+    {
+        const NanosSqe *sqe = &sqes[ring->sq_head & mask];
+        int64_t res;
+
+        if (!op(arg, sqe, done == 0, &res))
+        {
+            break;
+        }
+
+        NanosCqe *cqe = &cqes[ring->cq_tail & mask];
+        cqe->user_data = sqe->user_data;
+        cqe->res = res;
+        ring->cq_tail++;
+        ring->sq_head++;
+        done++;
+    }
+
+    return done;
+}
@@ -0,0 +1,31 @@
+#ifndef NANOS_RING_H__
+#define NANOS_RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nanos_syscall_abi.h>
+
+/*
+ * The queue walks behind readv()/writev() and SYS_ring_enter, without the
+ * kernel state around them.  The callbacks do the I/O; first is true until
+ * something has been transferred or completed, so only then may they sleep.
+ */
+
+/* Move one piece; fewer bytes than it holds ends the vector, -1 fails it. */
+typedef size_t (*IovecOp)(void *arg, const NanosIovec *piece, bool first);
+/* Run one request into *res; false leaves it queued for a restarted call. */
+typedef bool (*RingOp)(void *arg, const NanosSqe *sqe, bool first, int64_t *res);
+
+/* Bytes moved, or -1 when the first piece failed. */
+intptr_t iovec_run(const NanosIovec *iov, int iovcnt, IovecOp op, void *arg);
+/* A power-of-two size within NANOS_RING_MAX_ENTRIES and both arrays set. */
+bool ring_valid(const NanosRing *ring);
+/*
+ * Run requests from sq_head until the submission ring is empty or the
+ * completion ring is full; returns how many ran.
+ */
+intptr_t ring_run(NanosRing *ring, const NanosSqe *sqes, NanosCqe *cqes, RingOp op, void *arg);
+
+#endif
@@ -4,8 +4,10 @@
 #include <inttypes.h>
 #include "memory.h"
 #include "proc.h"
+#include "ring.h"
 
 void context_uload(PCB *pcb, const char *filename, char *const argv[], char *const envp[]);
+size_t serial_write(const void *buf, size_t offset, size_t len);
 extern PCB *current;
 
 static volatile int need_resched = 0;
@@ -37,6 +39,162 @@ static uint64_t monotonic_us(void)
     return io_read(AM_TIMER_UPTIME).us;
 }
 
+/*
+ * Demand-paged image pages must be present before the kernel dereferences a
+ * user pointer; see loader_page_fault().
+ */
+static void user_buffer(const void *buf, size_t len)
+{
+    if (buf != NULL)
+    {
+        loader_populate(current, buf, len);
+    }
+}
+
+/* A buffer the kernel writes must also stop sharing copy-on-write pages. */
+static void user_output(void *buf, size_t len)
+{
+    if (buf != NULL)
+    {
+        loader_populate(current, buf, len);
+        mm_unshare(current, buf, len);
+    }
+}
+
+static void user_string(const char *str)
+{
+    if (str != NULL)
+    {
+        loader_populate_string(current, str);
+    }
+}
+
+/* Populate a NULL-terminated argv/envp vector and every string in it. */
+static void user_vector(char *const *vec)
+{
+    for (; vec != NULL; vec++)
+    {
+        user_buffer(vec, sizeof(*vec));
+
+        if (*vec == NULL)
+        {
+            return;
+        }
+
+        user_string(*vec);
+    }
+}
+
+// fs.c fails with -1 on the file of a descriptor the caller does not have.
+static size_t write_fd(int fd, const void *buf, size_t len)
+{
+    user_buffer(buf, len);
+    return fs_write(fs_fd_file(current, fd), buf, len);
+}
+
+static size_t read_fd(int fd, void *buf, size_t len)
+{
+    user_output(buf, len);
+    return fs_read(fs_fd_file(current, fd), buf, len);
+}
+
+typedef struct
+{
+    bool write;
+    int fd;
+} VectorTransfer;
+
+static size_t vector_piece(void *arg, const NanosIovec *piece, bool first)
+{
+    const VectorTransfer *t = arg;
+    void *base = (void *)piece->base;
+
+    if (!first)
+    {
+        proc_forbid_block();
+    }
+
+    return t->write ? write_fd(t->fd, base, piece->len) : read_fd(t->fd, base, piece->len);
+}
+
+/*
+ * readv() and writev(): the pieces move in order until one comes up short.
+ * Only the first piece may put the caller to sleep, because a restart would
+ * repeat the pieces before it.
+ */
+static intptr_t transfer_vector(bool write, int fd, const NanosIovec *iov, int iovcnt)
+{
+    if (iov == NULL || iovcnt < 0 || iovcnt > NANOS_IOV_MAX)
+    {
+        return -1;
+    }
+
+    user_buffer(iov, (size_t)iovcnt * sizeof(*iov));
+
+    VectorTransfer t = {.write = write, .fd = fd};
+    return iovec_run(iov, iovcnt, vector_piece, &t);
+}
+
+static int64_t ring_op(const NanosSqe *sqe)
+{
+    if (sqe->opcode == NANOS_RING_NOP)
+    {
+        return 0;
+    }
+
+    if (sqe->opcode != NANOS_RING_READ && sqe->opcode != NANOS_RING_WRITE)
+    {
+        return -1;
+    }
+
+    if (sqe->off >= 0 && fs_lseek(fs_fd_file(current, sqe->fd), (size_t)sqe->off, SEEK_SET) != (size_t)sqe->off)
+    {
+        return -1;
+    }
+
+    void *buf = (void *)(uintptr_t)sqe->addr;
+    const size_t n = sqe->opcode == NANOS_RING_WRITE ? write_fd(sqe->fd, buf, (size_t)sqe->len)
+                                                     : read_fd(sqe->fd, buf, (size_t)sqe->len);
+
+    return n == (size_t)-1 ? -1 : (int64_t)n;
+}
+
+static bool ring_request(void *arg, const NanosSqe *sqe, bool first, int64_t *res)
+{
+    (void)arg;
+
+    if (!first)
+    {
+        proc_forbid_block();
+    }
+
+    *res = ring_op(sqe);
+    return current->state != PROC_BLOCKED;
+}
+
+/*
+ * Run queued requests until the submission ring is empty or the completion
+ * ring is full, and return how many ran.  A request that has to wait is left
+ * queued, so the restarted call picks it up again; as with readv() only the
+ * first request of a call may wait.
+ */
+static intptr_t ring_enter(NanosRing *ring)
+{
+    user_output(ring, sizeof(*ring));
+
+    if (!ring_valid(ring))
+    {
+        return -1;
+    }
+
+    const NanosSqe *sqes = (const NanosSqe *)(uintptr_t)ring->sqes;
+    NanosCqe *cqes = (NanosCqe *)(uintptr_t)ring->cqes;
+
+    user_buffer(sqes, ring->entries * sizeof(*sqes));
+    user_output(cqes, ring->entries * sizeof(*cqes));
+    return ring_run(ring, sqes, cqes, ring_request, NULL);
+}
+
 // Called by do_event() to test and clear the reschedule request.
 int syscall_need_resched_and_clear(void)
 {
@@ -67,8 +225,8 @@ Context *syscall_replacement_context_and_clear(void)
     return current->cp;
 }
 
-#ifdef STRACE
-static const char *syscall_name(uintptr_t num)
+// Also names the rows of /proc/syscalls.
+const char *syscall_name(uintptr_t num)
 {
     /* Keep unknown IDs printable so the panic path still has context. */
     switch (num)
@@ -93,6 +251,10 @@ static const char *syscall_name(uintptr_t num)
         return "fstat";
     case SYS_execve:
         return "execve";
+    case SYS_fork:
+        return "fork";
+    case SYS_getpid:
+        return "getpid";
     case SYS_unlink:
         return "unlink";
     case SYS_gettimeofday:
@@ -113,11 +275,24 @@ static const char *syscall_name(uintptr_t num)
         return "ftruncate";
     case SYS_clock_gettime:
         return "clock_gettime";
+    case SYS_fsync:
+        return "fsync";
+    case SYS_mmap:
+        return "mmap";
+    case SYS_munmap:
+        return "munmap";
+    case SYS_readv:
+        return "readv";
+    case SYS_writev:
+        return "writev";
+    case SYS_ring_enter:
+        return "ring_enter";
     default:
         return "unknown";
     }
 }
 
+#ifdef STRACE
 static void strace_log(uintptr_t num, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t ret)
 {
     /* Print one Linux-strace-like line after the syscall has produced GPRx. */
@@ -178,6 +353,12 @@ static void strace_log(uintptr_t num, uintptr_t arg1, uintptr_t arg2, uintptr_t
     case SYS_clock_gettime:
         Log("strace: clock_gettime(%d, 0x%08" PRIxPTR ") = %d", (int)arg1, arg2, (int)ret);
         break;
+    case SYS_fsync:
+        Log("strace: fsync(%d) = %d", (int)arg1, (int)ret);
+        break;
+    case SYS_munmap:
+        Log("strace: munmap(0x%08" PRIxPTR ", %zu) = %d", arg1, (size_t)arg2, (int)ret);
+        break;
     case SYS_yield:
         Log("strace: yield() = %d", (int)ret);
         break;
@@ -205,12 +386,14 @@ void do_syscall(Context *c)
     case SYS_exit:
     {
 #ifdef STRACE
-        /* SYS_exit halts before the common return-value trace can run. */
+        /* SYS_exit never returns, so it has no common return-value trace. */
         Log("strace: exit(%d)", (int)arg1);
 #endif
 
-        halt(arg1);
-        break;
+        // Halts with the last foreground process; otherwise another one runs.
+        proc_exit((int)arg1);
+        need_resched = 1;
+        return;
     }
 
     case SYS_yield:
@@ -218,6 +401,7 @@ void do_syscall(Context *c)
         // yield();
 
         // Do not trigger another trap here, just request rescheduling.
+        proc_yield();
         need_resched = 1;
         c->GPRx = 0;
         break;
@@ -225,24 +409,20 @@ void do_syscall(Context *c)
 
     case SYS_write:
     {
-        const int fd = (int)arg1;
-        const char *buf = (char *)arg2;
-        const size_t count = (size_t)arg3;
-
-        if (fd == 1 || fd == 2)
-        {
-            for (size_t i = 0; i < count; i++)
-            {
-                putch(buf[i]);
-            }
+        c->GPRx = write_fd((int)arg1, (const void *)arg2, (size_t)arg3);
+        break;
+    }
 
-            c->GPRx = count;
-        }
-        else
-        {
-            c->GPRx = fs_write(fd, buf, count);
-        }
+    case SYS_readv:
+    case SYS_writev:
+    {
+        c->GPRx = (uintptr_t)transfer_vector(num == SYS_writev, (int)arg1, (const NanosIovec *)arg2, (int)arg3);
+        break;
+    }
 
+    case SYS_ring_enter:
+    {
+        c->GPRx = (uintptr_t)ring_enter((NanosRing *)arg1);
         break;
     }
 
@@ -256,79 +436,132 @@ void do_syscall(Context *c)
 
     case SYS_open:
     {
-        c->GPRx = fs_open((char *)arg1, (int)arg2, (int)arg3);
+        user_string((const char *)arg1);
+
+        const int file = fs_open((char *)arg1, (int)arg2, (int)arg3);
+        const int fd = file >= 0 ? fs_fd_install(current, file) : -1;
+
+        if (file >= 0 && fd < 0)
+        {
+            fs_close(file);
+        }
+
+        c->GPRx = (uintptr_t)fd;
         break;
     }
 
     case SYS_read:
     {
-        c->GPRx = fs_read((int)arg1, (void *)arg2, (size_t)arg3);
+        c->GPRx = read_fd((int)arg1, (void *)arg2, (size_t)arg3);
         break;
     }
 
     case SYS_close:
     {
-        c->GPRx = fs_close((int)arg1);
+        c->GPRx = fs_fd_close(current, (int)arg1);
         break;
     }
 
     case SYS_lseek:
     {
-        c->GPRx = fs_lseek((int)arg1, (size_t)arg2, (int)arg3);
+        c->GPRx = fs_lseek(fs_fd_file(current, (int)arg1), (size_t)arg2, (int)arg3);
         break;
     }
 
     case SYS_fstat:
     {
-        c->GPRx = fs_fstat((int)arg1, (NanosStat *)arg2);
+        user_output((void *)arg2, sizeof(NanosStat));
+        c->GPRx = fs_fstat(fs_fd_file(current, (int)arg1), (NanosStat *)arg2);
         break;
     }
 
     case SYS_unlink:
     {
+        user_string((const char *)arg1);
         c->GPRx = fs_unlink((const char *)arg1);
         break;
     }
 
     case SYS_stat:
     {
+        user_string((const char *)arg1);
+        user_output((void *)arg2, sizeof(NanosStat));
         c->GPRx = fs_stat((const char *)arg1, (NanosStat *)arg2);
         break;
     }
 
     case SYS_getdents:
     {
-        c->GPRx = fs_getdents((int)arg1, (void *)arg2, (int)arg3);
+        user_output((void *)arg2, (size_t)arg3);
+        c->GPRx = fs_getdents(fs_fd_file(current, (int)arg1), (void *)arg2, (int)arg3);
         break;
     }
 
     case SYS_mkdir:
     {
+        user_string((const char *)arg1);
         c->GPRx = fs_mkdir((const char *)arg1, (int)arg2);
         break;
     }
 
     case SYS_rmdir:
     {
+        user_string((const char *)arg1);
         c->GPRx = fs_rmdir((const char *)arg1);
         break;
     }
 
     case SYS_rename:
     {
+        user_string((const char *)arg1);
+        user_string((const char *)arg2);
         c->GPRx = fs_rename((const char *)arg1, (const char *)arg2);
         break;
     }
 
     case SYS_truncate:
     {
+        user_string((const char *)arg1);
         c->GPRx = fs_truncate((const char *)arg1, (size_t)arg2);
         break;
     }
 
     case SYS_ftruncate:
     {
-        c->GPRx = fs_ftruncate((int)arg1, (size_t)arg2);
+        c->GPRx = fs_ftruncate(fs_fd_file(current, (int)arg1), (size_t)arg2);
+        break;
+    }
+
+    case SYS_fsync:
+    {
+        // fd -1 is sync(), which names no file.
+        const int file = (int)arg1 == -1 ? -1 : fs_fd_file(current, (int)arg1);
+
+        c->GPRx = (int)arg1 != -1 && file < 0 ? (uintptr_t)-1 : (uintptr_t)fs_fsync(file);
+        break;
+    }
+
+    case SYS_mmap:
+    {
+        // The six mmap() arguments arrive in one record.
+        const NanosMmapArgs *args = (const NanosMmapArgs *)arg1;
+
+        user_buffer(args, sizeof(*args));
+
+        if (args == NULL || args->offset < 0)
+        {
+            c->GPRx = (uintptr_t)-1;
+            break;
+        }
+
+        c->GPRx = mm_mmap(current, (uintptr_t)args->addr, (size_t)args->length, args->prot, args->flags,
+                          fs_fd_file(current, args->fd), (size_t)args->offset);
+        break;
+    }
+
+    case SYS_munmap:
+    {
+        c->GPRx = (uintptr_t)mm_munmap(current, arg1, (size_t)arg2);
         break;
     }
 
@@ -337,6 +570,8 @@ void do_syscall(Context *c)
         time_t *out = (time_t *)arg1;
         const time_t seconds = (time_t)(realtime_us() / 1000000);
 
+        user_output(out, sizeof(*out));
+
         if (out)
         {
             *out = seconds;
@@ -356,6 +591,8 @@ void do_syscall(Context *c)
         NanosTms *tms = (NanosTms *)arg1;
         const uint64_t uptimeUs = monotonic_us();
 
+        user_output(tms, sizeof(*tms));
+
         if (tms)
         {
             /*
@@ -379,6 +616,9 @@ void do_syscall(Context *c)
         struct timezone *tz = (struct timezone *)arg2;
         const uint64_t nowUs = realtime_us();
 
+        user_output(tv, sizeof(*tv));
+        user_output(tz, sizeof(*tz));
+
         if (tv)
         {
             tv->tv_sec = (time_t)(nowUs / 1000000);
@@ -421,18 +661,36 @@ void do_syscall(Context *c)
             break;
         }
 
+        user_output(tp, sizeof(*tp));
         tp->tv_sec = (time_t)(us / 1000000);
         tp->tv_nsec = (long)((us % 1000000) * 1000);
         c->GPRx = 0;
         break;
     }
 
+    case SYS_fork:
+    {
+        c->GPRx = (uintptr_t)proc_fork(c);
+        break;
+    }
+
+    case SYS_getpid:
+    {
+        c->GPRx = (uintptr_t)current->pid;
+        break;
+    }
+
     case SYS_execve:
     {
         const char *filename = (const char *)arg1;
         char *const *argv = (char *const *)arg2;
         char *const *envp = (char *const *)arg3;
 
+        // The strings are read again after the new image replaces this one.
+        user_string(filename);
+        user_vector(argv);
+        user_vector(envp);
+
         // Check existence, execvp will probe multiple candidates
         // Nanos-lite reports a small errno-like negative value here, but success
         // follows Unix execve semantics: the caller's image disappears and does
@@ -468,6 +726,19 @@ void do_syscall(Context *c)
     }
     }
 
+    /*
+     * A device with nothing to offer put the caller to sleep.  Back the frame
+     * up to the ecall with its first argument back in a0, so the whole call
+     * runs again once the process is woken.
+     */
+    if (proc_syscall_blocked())
+    {
+        c->GPR2 = arg1;
+        c->mepc -= sizeof(uint32_t);
+        need_resched = 1;
+        return;
+    }
+
 #ifdef STRACE
     /* Normal syscalls trace here so return values are always included. */
     strace_log(num, arg1, arg2, arg3, c->GPRx);
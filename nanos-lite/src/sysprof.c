@@ -0,0 +1,85 @@
+#include "sysprof.h"
+
+#if defined(__ISA__)
+#include <klib.h>
+#else
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+size_t sysprof_bucket(uint64_t instrs)
+{
+    size_t k = 0;
+
+    while (instrs > 1 && k < SYSPROF_NR_BUCKETS - 1)
+    {
+        instrs >>= 1;
+        k++;
+    }
+
+    return k;
+}
+
+void sysprof_add(SysprofCounter *c, uint64_t instrs, uint64_t us)
+{
+    assert(c != NULL);
+    c->calls++;
+    c->instrs += instrs;
+    c->us += us;
+    c->hist[sysprof_bucket(instrs)]++;
+
+    if (instrs > c->max_instrs)
+    {
+        c->max_instrs = instrs;
+    }
+}
+
+size_t sysprof_format(char *buf, size_t size, size_t used, const char *name, const SysprofCounter *c)
+{
+    assert(buf != NULL && used < size);
+
+    size_t n = used;
+    int ret = snprintf(buf + n, size - n, "%s %llu %llu %llu %llu", name, (unsigned long long)c->calls,
+                       (unsigned long long)c->instrs, (unsigned long long)c->us,
+                       (unsigned long long)c->max_instrs);
+
+    for (size_t k = 0; k < SYSPROF_NR_BUCKETS && ret >= 0 && (size_t)ret < size - n; k++)
+    {
+        if (c->hist[k] != 0)
+        {
+            n += (size_t)ret;
+            ret = snprintf(buf + n, size - n, " %u:%llu", (unsigned)k, (unsigned long long)c->hist[k]);
+        }
+    }
+
+    if (ret >= 0 && (size_t)ret < size - n)
+    {
+        n += (size_t)ret;
+        ret = snprintf(buf + n, size - n, "\n");
+    }
+
+    if (ret < 0 || (size_t)ret >= size - n)
+    {
+        buf[used] = '\0';
+        return used;
+    }
+
+    return n + (size_t)ret;
+}
+
+size_t sysprof_copy(const char *text, size_t text_len, void *buf, size_t offset, size_t len)
+{
+    if (offset >= text_len)
+    {
+        return 0;
+    }
+
+    if (len > text_len - offset)
+    {
+        len = text_len - offset;
+    }
+
+    memcpy(buf, text + offset, len);
+    return len;
+}
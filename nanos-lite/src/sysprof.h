@@ -0,0 +1,38 @@
+#ifndef NANOS_SYSPROF_H__
+#define NANOS_SYSPROF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Trap profiling counters.  Each trap is measured in guest instructions, read
+ * from the instret CSR, and in microseconds of the RTC.  Instruction counts go
+ * into a log2 histogram: bucket k counts traps of [2^k, 2^(k+1)) instructions,
+ * bucket 0 also takes zero, and the last bucket takes everything above it.
+ */
+#define SYSPROF_NR_BUCKETS 24u
+
+/* Column names for the lines sysprof_format() writes. */
+#define SYSPROF_HEADER "# name calls instrs us max_instrs log2(instrs):count...\n"
+
+typedef struct
+{
+    uint64_t calls;
+    uint64_t instrs;
+    uint64_t us;
+    uint64_t max_instrs;
+    uint64_t hist[SYSPROF_NR_BUCKETS];
+} SysprofCounter;
+
+size_t sysprof_bucket(uint64_t instrs);
+void sysprof_add(SysprofCounter *c, uint64_t instrs, uint64_t us);
+/*
+ * Append one line for c to the string of used bytes in buf[size].  Only buckets
+ * that counted something are listed.  A line that does not fit is dropped
+ * whole; returns the new used length.
+ */
+size_t sysprof_format(char *buf, size_t size, size_t used, const char *name, const SysprofCounter *c);
+/* Copy the part of text at offset into buf, like a read() of a regular file. */
+size_t sysprof_copy(const char *text, size_t text_len, void *buf, size_t offset, size_t len);
+
+#endif
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/fs/fat32.h"
+
+static Fat32Dcache cache;
+
+/*
+ * Test that positive and negative entries come back and names match without
+ * regard to case, like FAT directory lookups.
+ */
+static void test_remembers_hits_and_misses(void)
+{
+    uint64_t offset = 0;
+
+    memset(&cache, 0, sizeof(cache));
+    assert(fat32_dcache_lookup(&cache, 2, "ALPHA.TXT", &offset) == -1);
+
+    fat32_dcache_insert(&cache, 2, "ALPHA.TXT", 1, 0x4020);
+    fat32_dcache_insert(&cache, 2, "missing.txt", 0, 0);
+    assert(fat32_dcache_lookup(&cache, 2, "alpha.txt", &offset) == 1);
+    assert(offset == 0x4020);
+    assert(fat32_dcache_lookup(&cache, 2, "Missing.TXT", &offset) == 0);
+    assert(fat32_dcache_lookup(&cache, 3, "alpha.txt", &offset) == -1);
+
+    // A later scan that finds the name replaces the negative entry.
+    fat32_dcache_insert(&cache, 2, "missing.txt", 1, 0x4040);
+    assert(fat32_dcache_lookup(&cache, 2, "missing.txt", &offset) == 1);
+    assert(offset == 0x4040);
+    assert(cache.hits == 2 && cache.negative_hits == 1 && cache.misses == 2);
+}
+
+/*
+ * Test that names too long for a slot and cluster 0 bypass the cache.
+ */
+static void test_skips_uncacheable_names(void)
+{
+    char long_name[FAT32_DCACHE_NAME_MAX + 2u];
+    uint64_t offset = 0;
+
+    memset(&cache, 0, sizeof(cache));
+    memset(long_name, 'a', sizeof(long_name) - 1u);
+    long_name[sizeof(long_name) - 1u] = '\0';
+
+    fat32_dcache_insert(&cache, 2, long_name, 1, 0x4000);
+    assert(fat32_dcache_lookup(&cache, 2, long_name, &offset) == -1);
+
+    long_name[FAT32_DCACHE_NAME_MAX] = '\0';
+    fat32_dcache_insert(&cache, 2, long_name, 1, 0x4000);
+    assert(fat32_dcache_lookup(&cache, 2, long_name, &offset) == 1);
+
+    fat32_dcache_insert(&cache, 0, "a", 1, 0x4000);
+    assert(fat32_dcache_lookup(&cache, 0, "a", &offset) == -1);
+}
+
+/*
+ * Test that invalidating a directory drops its names and no others.
+ */
+static void test_invalidate_drops_one_directory(void)
+{
+    char name[16];
+    uint64_t offset = 0;
+
+    memset(&cache, 0, sizeof(cache));
+    for (unsigned i = 0; i < 64; i++)
+    {
+        snprintf(name, sizeof(name), "file%u", i);
+        fat32_dcache_insert(&cache, 2 + i % 2, name, i % 3 != 0, 0x8000 + i * 32u);
+    }
+
+    fat32_dcache_invalidate_dir(&cache, 2);
+    for (unsigned i = 0; i < 64; i++)
+    {
+        snprintf(name, sizeof(name), "file%u", i);
+        const int ret = fat32_dcache_lookup(&cache, 2 + i % 2, name, &offset);
+
+        assert(i % 2 == 0 ? ret == -1 : ret == (i % 3 != 0));
+    }
+}
+
+/*
+ * Test that a full set evicts its least recently used entry: a name looked up
+ * between inserts survives a stream of new names that pushes out the rest.
+ */
+static void test_full_set_evicts_least_recently_used(void)
+{
+    char name[16];
+    uint64_t offset = 0;
+
+    memset(&cache, 0, sizeof(cache));
+    fat32_dcache_insert(&cache, 2, "keep", 1, 0x100);
+    fat32_dcache_insert(&cache, 2, "drop", 1, 0x200);
+
+    for (unsigned i = 0; i < 16u * FAT32_DCACHE_SETS * FAT32_DCACHE_WAYS; i++)
+    {
+        snprintf(name, sizeof(name), "n%u", i);
+        fat32_dcache_insert(&cache, 2, name, 1, i);
+        assert(fat32_dcache_lookup(&cache, 2, "keep", &offset) == 1);
+    }
+
+    assert(offset == 0x100);
+    assert(fat32_dcache_lookup(&cache, 2, "drop", &offset) == -1);
+}
+
+int main(void)
+{
+    test_remembers_hits_and_misses();
+    test_skips_uncacheable_names();
+    test_invalidate_drops_one_directory();
+    test_full_set_evicts_least_recently_used();
+    puts("fat32_dcache tests passed");
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/fs/fat32.h"
+
+static Fat32ExtentCache cache;
+
+/*
+ * Test that consecutive clusters merge into one extent and that a lookup finds
+ * the right extent of a fragmented chain.
+ */
+static void test_maps_fragmented_chain(void)
+{
+    uint32_t cluster = 0;
+    uint32_t run = 0;
+
+    memset(&cache, 0, sizeof(cache));
+    assert(fat32_extent_lookup(&cache, 100, 0, &cluster, &run) == -1);
+
+    // Chain 100..103, 200..201, 150: three extents, seven clusters.
+    fat32_extent_add(&cache, 100, 0, 100, 2);
+    fat32_extent_add(&cache, 100, 2, 102, 1);
+    fat32_extent_add(&cache, 100, 3, 103, 1);
+    fat32_extent_add(&cache, 100, 4, 200, 1);
+    fat32_extent_add(&cache, 100, 5, 201, 1);
+    fat32_extent_add(&cache, 100, 6, 150, 1);
+    assert(fat32_extent_mapped(&cache, 100) == 7);
+    assert(cache.maps[0].nr_extents == 3);
+
+    assert(fat32_extent_lookup(&cache, 100, 1, &cluster, &run) == 0);
+    assert(cluster == 101 && run == 3);
+    assert(fat32_extent_lookup(&cache, 100, 4, &cluster, &run) == 0);
+    assert(cluster == 200 && run == 2);
+    assert(fat32_extent_lookup(&cache, 100, 6, &cluster, &run) == 0);
+    assert(cluster == 150 && run == 1);
+    assert(fat32_extent_lookup(&cache, 100, 7, &cluster, &run) == -1);
+}
+
+/*
+ * Test that only runs continuing the mapped prefix are recorded and that a
+ * full map stops growing instead of dropping what it knows.
+ */
+static void test_keeps_prefix_only(void)
+{
+    uint32_t cluster;
+    uint32_t run;
+
+    memset(&cache, 0, sizeof(cache));
+    fat32_extent_add(&cache, 40, 3, 43, 1);
+    assert(fat32_extent_mapped(&cache, 40) == 0);
+
+    fat32_extent_add(&cache, 40, 0, 40, 1);
+    fat32_extent_add(&cache, 40, 2, 90, 1);
+    assert(fat32_extent_mapped(&cache, 40) == 1);
+
+    for (uint32_t i = 1; i < FAT32_EXTENT_MAP_SIZE + 4u; i++)
+    {
+        fat32_extent_add(&cache, 40, i, 1000u + 2u * i, 1);
+    }
+
+    assert(fat32_extent_mapped(&cache, 40) == FAT32_EXTENT_MAP_SIZE);
+    assert(fat32_extent_lookup(&cache, 40, FAT32_EXTENT_MAP_SIZE - 1u, &cluster, &run) == 0);
+    assert(cluster == 1000u + 2u * (FAT32_EXTENT_MAP_SIZE - 1u));
+}
+
+/*
+ * Test that truncation cuts inside an extent and that zero drops the map.
+ */
+static void test_truncate(void)
+{
+    uint32_t cluster;
+    uint32_t run;
+
+    memset(&cache, 0, sizeof(cache));
+    fat32_extent_add(&cache, 10, 0, 10, 4);
+    fat32_extent_add(&cache, 10, 4, 30, 4);
+    fat32_extent_truncate(&cache, 10, 6);
+    assert(fat32_extent_mapped(&cache, 10) == 6);
+    assert(fat32_extent_lookup(&cache, 10, 5, &cluster, &run) == 0);
+    assert(cluster == 31 && run == 1);
+
+    fat32_extent_truncate(&cache, 10, 3);
+    assert(cache.maps[0].nr_extents == 1);
+    assert(fat32_extent_lookup(&cache, 10, 3, &cluster, &run) == -1);
+
+    // New clusters after the cut extend the map again.
+    fat32_extent_add(&cache, 10, 3, 60, 1);
+    assert(fat32_extent_lookup(&cache, 10, 3, &cluster, &run) == 0 && cluster == 60);
+
+    fat32_extent_truncate(&cache, 10, 0);
+    assert(fat32_extent_mapped(&cache, 10) == 0);
+}
+
+/*
+ * Test that a new file takes the map used least recently once all are taken.
+ */
+static void test_replaces_least_recently_used(void)
+{
+    uint32_t cluster;
+    uint32_t run;
+
+    memset(&cache, 0, sizeof(cache));
+    for (uint32_t i = 0; i < FAT32_EXTENT_MAPS; i++)
+    {
+        fat32_extent_add(&cache, 100u * (i + 1u), 0, 100u * (i + 1u), 1);
+    }
+
+    // Touch every file but the second.
+    for (uint32_t i = 0; i < FAT32_EXTENT_MAPS; i++)
+    {
+        assert(i == 1 || fat32_extent_lookup(&cache, 100u * (i + 1u), 0, &cluster, &run) == 0);
+    }
+
+    fat32_extent_add(&cache, 5000, 0, 5000, 1);
+    assert(fat32_extent_mapped(&cache, 200) == 0);
+    assert(fat32_extent_mapped(&cache, 5000) == 1);
+    assert(fat32_extent_mapped(&cache, 100) == 1);
+}
+
+int main(void)
+{
+    test_maps_fragmented_chain();
+    test_keeps_prefix_only();
+    test_truncate();
+    test_replaces_least_recently_used();
+    puts("fat32_extent tests passed");
+    return 0;
+}
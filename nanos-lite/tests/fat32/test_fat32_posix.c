@@ -401,6 +401,54 @@ static void test_rename_replaces_existing_regular_file(void)
     fat32_test_disk_close();
 }
 
+/*
+ * Test that cached lookups, including cached misses, follow creates, writes,
+ * unlinks, and a directory cluster coming back as a new directory.
+ */
+static void test_dentry_cache_follows_directory_changes(void)
+{
+    const Fat32Volume *vol;
+    Fat32DirEntry entry;
+    Fat32File file;
+    const uint8_t data[] = {'d', 'a', 't', 'a'};
+    uint32_t old_cluster;
+
+    build_posix_image();
+    reopen_backend_image();
+    vol = fat32_backend_volume();
+
+    assert(fat32_lookup_path(vol, "/DIR/late.txt", &entry) == -1);
+    assert(fat32_lookup_path(vol, "/DIR/LATE.TXT", &entry) == -1);
+    assert(vol->dcache.negative_hits >= 1);
+
+    assert(fat32_backend_create("/DIR/late.txt", &file) == 0);
+    assert(fat32_lookup_path(vol, "/DIR/late.txt", &entry) == 0);
+    assert(entry.size == 0);
+    assert(fat32_backend_write(&file, 0, data, sizeof(data)) == sizeof(data));
+    assert(fat32_backend_close(&file) == 0);
+    assert(fat32_lookup_path(vol, "/DIR/late.txt", &entry) == 0);
+    assert(entry.size == sizeof(data));
+    assert(vol->dcache.hits >= 2);
+
+    assert(fat32_backend_unlink("/DIR/late.txt") == 0);
+    assert(fat32_lookup_path(vol, "/DIR/late.txt", &entry) == -1);
+
+    assert(fat32_backend_mkdir("/DIR/old") == 0);
+    assert(fat32_backend_create("/DIR/old/child.txt", &file) == 0);
+    assert(fat32_backend_close(&file) == 0);
+    assert(fat32_lookup_path(vol, "/DIR/old/child.txt", &entry) == 0);
+    assert(fat32_lookup_path(vol, "/DIR/old", &entry) == 0);
+    old_cluster = entry.first_cluster;
+    assert(fat32_backend_unlink("/DIR/old/child.txt") == 0);
+    assert(fat32_backend_rmdir("/DIR/old") == 0);
+
+    assert(fat32_backend_mkdir("/DIR/new") == 0);
+    assert(fat32_lookup_path(vol, "/DIR/new", &entry) == 0);
+    assert(entry.first_cluster == old_cluster);
+    assert(fat32_lookup_path(vol, "/DIR/new/child.txt", &entry) == -1);
+    fat32_test_disk_close();
+}
+
 /*
  * Run all POSIX-like FAT32 backend behaviour tests.
  */
@@ -414,6 +462,7 @@ int main(void)
     test_truncate_shrinks_and_extends_with_zero_fill();
     test_rename_regular_file_preserves_data();
     test_rename_replaces_existing_regular_file();
+    test_dentry_cache_follows_directory_changes();
     puts("fat32_posix tests passed");
     return 0;
 }
@@ -545,6 +545,146 @@ static void test_backend_opens_read_only_file_but_refuses_write(void)
     fat32_test_disk_close();
 }
 
+static void test_alloc_extent_links_consecutive_clusters(void)
+{
+    Fat32Volume vol;
+    FsInfoSnapshot before;
+    FsInfoSnapshot after;
+    uint32_t first;
+    uint32_t count;
+    uint32_t tail;
+
+    build_write_image();
+    before = read_fsinfo_sector(1);
+    fat32_test_disk_open(WRITE_IMAGE);
+    assert(fat32_mount_from_disk(512, &vol) == 0);
+    assert(vol.free_bitmap_valid == 1);
+    assert(vol.free_cluster_count == before.free_count);
+
+    assert(fat32_alloc_extent(&vol, 0, 8, &first, &count) == 0);
+    assert(count == 8);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t next;
+
+        assert(fat32_read_fat_entry(&vol, first + i, &next) == 0);
+        assert(i + 1u < count ? next == first + i + 1u : fat32_is_end_of_chain(next));
+    }
+
+    // Growing the chain continues right after its tail.
+    assert(fat32_alloc_extent(&vol, first + 7u, 4, &tail, &count) == 0);
+    assert(tail == first + 8u && count == 4);
+    fat32_test_disk_close();
+
+    after = read_fsinfo_sector(1);
+    assert(after.free_count == before.free_count - 12u);
+
+    // The bitmap built by the next mount agrees with what was written.
+    fat32_test_disk_open(WRITE_IMAGE);
+    assert(fat32_mount_from_disk(512, &vol) == 0);
+    assert(vol.free_cluster_count == after.free_count);
+    assert(fat32_free_chain(&vol, tail) == 0);
+    assert(fat32_alloc_extent(&vol, first + 7u, 2, &tail, &count) == 0);
+    assert(tail == first + 8u && count == 2);
+    fat32_test_disk_close();
+}
+
+static const Fat32ExtentMap *extent_map_of(uint32_t first_cluster)
+{
+    const Fat32Volume *vol = fat32_backend_volume();
+
+    for (uint32_t i = 0; i < FAT32_EXTENT_MAPS; i++)
+    {
+        if (vol->extents.maps[i].first_cluster == first_cluster)
+        {
+            return &vol->extents.maps[i];
+        }
+    }
+
+    return 0;
+}
+
+static void test_backend_seeks_fragmented_file_through_extent_map(void)
+{
+    Fat32File a;
+    Fat32File b;
+    const Fat32ExtentMap *map;
+    uint8_t chunk[FAT32_SECTOR_SIZE];
+    const uint32_t order[] = {7, 2, 5, 0, 6};
+
+    build_write_image();
+    reopen_backend_image();
+    assert(fat32_backend_create("/A.BIN", &a) == 0);
+    assert(fat32_backend_create("/B.BIN", &b) == 0);
+
+    // Alternating appends leave every cluster of A in an extent of its own.
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        memset(chunk, (int)(0x10u + i), sizeof(chunk));
+        assert(fat32_backend_write(&a, i * sizeof(chunk), chunk, sizeof(chunk)) == sizeof(chunk));
+        memset(chunk, (int)(0x80u + i), sizeof(chunk));
+        assert(fat32_backend_write(&b, i * sizeof(chunk), chunk, sizeof(chunk)) == sizeof(chunk));
+    }
+
+    assert(fat32_backend_close(&a) == 0);
+    assert(fat32_backend_close(&b) == 0);
+    assert(fat32_backend_open("/A.BIN", &a) == 0);
+    assert(a.contiguous_cluster_count == 1);
+
+    for (uint32_t i = 0; i < sizeof(order) / sizeof(order[0]); i++)
+    {
+        uint8_t buf[4];
+
+        assert(fat32_backend_read(&a, order[i] * sizeof(chunk) + 100u, buf, sizeof(buf)) == sizeof(buf));
+        assert(buf[0] == 0x10u + order[i] && buf[3] == 0x10u + order[i]);
+    }
+
+    map = extent_map_of(a.first_cluster);
+    assert(map != 0);
+    assert(map->mapped_clusters == 8 && map->nr_extents == 8);
+
+    // Truncating through another descriptor cuts the shared map at once.
+    assert(fat32_backend_open("/A.BIN", &b) == 0);
+    assert(fat32_backend_truncate(&b, 3u * sizeof(chunk)) == 0);
+    assert(map->mapped_clusters == 3);
+    assert(fat32_backend_close(&b) == 0);
+    assert(fat32_backend_close(&a) == 0);
+    fat32_test_disk_close();
+}
+
+static void test_backend_large_write_allocates_one_extent(void)
+{
+    Fat32File file;
+    static uint8_t data[16u * FAT32_SECTOR_SIZE];
+    uint8_t buf[sizeof(data)];
+
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t)(i * 7u);
+    }
+
+    build_write_image();
+    reopen_backend_image();
+    assert(fat32_backend_create("/LARGE.BIN", &file) == 0);
+    assert(fat32_backend_write(&file, 0, data, sizeof(data)) == sizeof(data));
+    assert(file.contiguous_cluster_count == 16);
+    assert(count_chain(fat32_backend_volume(), file.first_cluster) == 16);
+
+    for (uint32_t i = 0; i + 1u < 16u; i++)
+    {
+        uint32_t next;
+
+        assert(fat32_read_fat_entry(fat32_backend_volume(), file.first_cluster + i, &next) == 0);
+        assert(next == file.first_cluster + i + 1u);
+    }
+
+    assert(fat32_backend_read(&file, 0, buf, sizeof(buf)) == sizeof(buf));
+    assert(memcmp(buf, data, sizeof(data)) == 0);
+    assert(fat32_backend_close(&file) == 0);
+    fat32_test_disk_close();
+}
+
 int main(void)
 {
     test_fat_entry_write_updates_all_mirrored_fats();
@@ -559,6 +699,9 @@ int main(void)
     test_backend_extends_empty_file_with_zero_gap();
     test_backend_truncates_existing_file_to_zero();
     test_backend_opens_read_only_file_but_refuses_write();
+    test_alloc_extent_links_consecutive_clusters();
+    test_backend_seeks_fragmented_file_through_extent_map();
+    test_backend_large_write_allocates_one_extent();
     puts("fat32_write tests passed");
     return 0;
 }
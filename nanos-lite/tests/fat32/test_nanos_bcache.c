@@ -0,0 +1,258 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/bcache.h"
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            printf("check failed at line %d: %s\n", __LINE__, #cond); \
+            return 1;                                                 \
+        }                                                             \
+    } while (0)
+
+/* 20.5 cache blocks, so the last block is short. */
+#define DISK_SIZE (20u * BCACHE_BLOCK_SIZE + 2048u)
+#define DEV_BLKSZ 512u
+#define BOUNCE_SIZE (4u * BCACHE_BLOCK_SIZE)
+
+static uint8_t disk[DISK_SIZE];
+static uint8_t bounce[BOUNCE_SIZE];
+static size_t io_reads;
+static size_t io_writes;
+static size_t direct_reads;
+static bool direct_accept;
+
+static void fake_io(bool write, void *buf, size_t offset, size_t len)
+{
+    if (offset % BCACHE_BLOCK_SIZE != 0 || len % DEV_BLKSZ != 0 || len == 0 ||
+        offset + len > DISK_SIZE || len > BOUNCE_SIZE)
+    {
+        printf("bad device transfer offset=%zu len=%zu\n", offset, len);
+        abort();
+    }
+
+    if (write)
+    {
+        memcpy(disk + offset, buf, len);
+        io_writes++;
+    }
+    else
+    {
+        memcpy(buf, disk + offset, len);
+        io_reads++;
+    }
+}
+
+static bool fake_read_direct(void *buf, size_t offset, size_t len)
+{
+    if (offset % BCACHE_BLOCK_SIZE != 0 || len % DEV_BLKSZ != 0 || len == 0 ||
+        offset + len > DISK_SIZE)
+    {
+        printf("bad direct transfer offset=%zu len=%zu\n", offset, len);
+        abort();
+    }
+
+    if (!direct_accept)
+    {
+        return false;
+    }
+
+    memcpy(buf, disk + offset, len);
+    direct_reads++;
+    return true;
+}
+
+static void reset(void)
+{
+    for (size_t i = 0; i < DISK_SIZE; i++)
+    {
+        disk[i] = (uint8_t)(i * 7u + (i >> 12));
+    }
+
+    const BcacheDevice dev = {
+        .size = DISK_SIZE,
+        .blksz = DEV_BLKSZ,
+        .bounce = bounce,
+        .bounce_size = BOUNCE_SIZE,
+        .io = fake_io,
+        .read_direct = fake_read_direct,
+    };
+    bcache_init(&dev);
+    io_reads = 0;
+    io_writes = 0;
+    direct_reads = 0;
+    direct_accept = true;
+}
+
+static int test_reread_hits_cache(void)
+{
+    uint8_t buf[6000];
+
+    reset();
+    CHECK(bcache_read(buf, 1000, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, disk + 1000, sizeof(buf)) == 0);
+    const size_t reads = io_reads;
+
+    memset(buf, 0, sizeof(buf));
+    CHECK(bcache_read(buf, 1000, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, disk + 1000, sizeof(buf)) == 0);
+    CHECK(io_reads == reads);
+    return 0;
+}
+
+static int test_sequential_reads_prefetch(void)
+{
+    uint8_t buf[1024];
+    BcacheStats stats;
+
+    reset();
+    for (size_t off = 0; off < 12u * BCACHE_BLOCK_SIZE; off += sizeof(buf))
+    {
+        CHECK(bcache_read(buf, off, sizeof(buf)) == sizeof(buf));
+        CHECK(memcmp(buf, disk + off, sizeof(buf)) == 0);
+    }
+
+    bcache_get_stats(&stats);
+    CHECK(stats.readahead_blocks > 0);
+    // One device command per bounce-buffer run instead of one per block.
+    CHECK(io_reads < 12);
+    return 0;
+}
+
+static int test_tail_block_is_short(void)
+{
+    uint8_t buf[3000];
+
+    reset();
+    CHECK(bcache_read(buf, DISK_SIZE - sizeof(buf), sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, disk + DISK_SIZE - sizeof(buf), sizeof(buf)) == 0);
+    return 0;
+}
+
+static int test_write_back_on_sync(void)
+{
+    uint8_t data[5000];
+    uint8_t buf[5000];
+
+    reset();
+    memset(data, 0x5a, sizeof(data));
+    CHECK(bcache_write(data, 3 * BCACHE_BLOCK_SIZE + 100, sizeof(data)) == sizeof(data));
+    CHECK(io_writes == 0);
+    CHECK(disk[3 * BCACHE_BLOCK_SIZE + 100] != 0x5a);
+
+    // Reads see the cached write before it reaches the device.
+    CHECK(bcache_read(buf, 3 * BCACHE_BLOCK_SIZE + 100, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, data, sizeof(buf)) == 0);
+
+    const uint8_t before = disk[3 * BCACHE_BLOCK_SIZE + 99];
+    bcache_sync();
+    // Both touched blocks are adjacent, so they leave in one command.
+    CHECK(io_writes == 1);
+    CHECK(memcmp(disk + 3 * BCACHE_BLOCK_SIZE + 100, data, sizeof(data)) == 0);
+    CHECK(disk[3 * BCACHE_BLOCK_SIZE + 99] == before);
+
+    bcache_sync();
+    CHECK(io_writes == 1);
+    return 0;
+}
+
+static int test_whole_block_write_skips_read(void)
+{
+    uint8_t data[BCACHE_BLOCK_SIZE];
+
+    reset();
+    memset(data, 0xa5, sizeof(data));
+    CHECK(bcache_write(data, 5 * BCACHE_BLOCK_SIZE, sizeof(data)) == sizeof(data));
+    CHECK(io_reads == 0);
+    bcache_sync();
+    CHECK(memcmp(disk + 5 * BCACHE_BLOCK_SIZE, data, sizeof(data)) == 0);
+    return 0;
+}
+
+static int test_eviction_writes_dirty_blocks(void)
+{
+    uint8_t data[BCACHE_BLOCK_SIZE];
+    uint8_t buf[64];
+
+    reset();
+    memset(data, 0x3c, sizeof(data));
+    CHECK(bcache_write(data, 0, sizeof(data)) == sizeof(data));
+
+    // The test cache holds fewer blocks than the disk, so a full scan evicts block 0.
+    for (size_t blk = 1; blk < 20; blk++)
+    {
+        CHECK(bcache_read(buf, blk * BCACHE_BLOCK_SIZE + 7, sizeof(buf)) == sizeof(buf));
+    }
+
+    CHECK(memcmp(disk, data, sizeof(data)) == 0);
+    CHECK(bcache_read(buf, 0, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, data, sizeof(buf)) == 0);
+    return 0;
+}
+
+static int test_large_read_bypasses_cache(void)
+{
+    static uint8_t buf[DISK_SIZE];
+    BcacheStats stats;
+
+    reset();
+    // Block 2 is cached, so the direct run starts after it.
+    CHECK(bcache_read(buf, 2 * BCACHE_BLOCK_SIZE + 10, 10) == 10);
+    const size_t reads = io_reads;
+
+    CHECK(bcache_read(buf, 2 * BCACHE_BLOCK_SIZE + 100, 12 * BCACHE_BLOCK_SIZE) == 12 * BCACHE_BLOCK_SIZE);
+    CHECK(memcmp(buf, disk + 2 * BCACHE_BLOCK_SIZE + 100, 12 * BCACHE_BLOCK_SIZE) == 0);
+    CHECK(direct_reads == 1);
+    // Only the partial last block goes through the cache.
+    CHECK(io_reads == reads + 1);
+    bcache_get_stats(&stats);
+    CHECK(stats.direct_blocks == 11);
+
+    // Dirty cached data wins over the device copy.
+    memset(buf, 0x77, 16);
+    CHECK(bcache_write(buf, 8 * BCACHE_BLOCK_SIZE, 16) == 16);
+    CHECK(bcache_read(buf, 0, DISK_SIZE) == DISK_SIZE);
+    CHECK(buf[8 * BCACHE_BLOCK_SIZE] == 0x77);
+    CHECK(memcmp(buf + 8 * BCACHE_BLOCK_SIZE + 16, disk + 8 * BCACHE_BLOCK_SIZE + 16, BCACHE_BLOCK_SIZE - 16) == 0);
+    CHECK(memcmp(buf + 9 * BCACHE_BLOCK_SIZE, disk + 9 * BCACHE_BLOCK_SIZE, DISK_SIZE - 9 * BCACHE_BLOCK_SIZE) == 0);
+    return 0;
+}
+
+static int test_declined_direct_read_uses_cache(void)
+{
+    static uint8_t buf[8u * BCACHE_BLOCK_SIZE];
+    BcacheStats stats;
+
+    reset();
+    direct_accept = false;
+    CHECK(bcache_read(buf, BCACHE_BLOCK_SIZE, sizeof(buf)) == sizeof(buf));
+    CHECK(memcmp(buf, disk + BCACHE_BLOCK_SIZE, sizeof(buf)) == 0);
+    bcache_get_stats(&stats);
+    CHECK(stats.direct_blocks == 0);
+    CHECK(io_reads > 0);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_reread_hits_cache() != 0 ||
+        test_sequential_reads_prefetch() != 0 ||
+        test_tail_block_is_short() != 0 ||
+        test_write_back_on_sync() != 0 ||
+        test_whole_block_write_skips_read() != 0 ||
+        test_eviction_writes_dirty_blocks() != 0 ||
+        test_large_read_bypasses_cache() != 0 ||
+        test_declined_direct_read_uses_cache() != 0)
+    {
+        return 1;
+    }
+
+    puts("nanos bcache tests passed");
+    return 0;
+}
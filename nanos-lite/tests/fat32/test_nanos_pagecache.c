@@ -0,0 +1,169 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/pagecache.h"
+#include "../../src/palloc.h"
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            printf("check failed at line %d: %s\n", __LINE__, #cond); \
+            return 1;                                                 \
+        }                                                             \
+    } while (0)
+
+/* One state page plus 64 pool pages. */
+#define REGION_PAGES 65u
+/* The test table holds 16 slots, so 12 pages at most. */
+#define MAX_CACHED 12u
+
+static uint8_t *region;
+
+static void reset(void)
+{
+    palloc_init(region, region + REGION_PAGES * PALLOC_PAGE_SIZE);
+    pagecache_init();
+}
+
+static size_t free_pages(void)
+{
+    PallocStats stats;
+    palloc_get_stats(&stats);
+    return stats.free_pages;
+}
+
+static size_t cached_pages(void)
+{
+    PagecacheStats stats;
+    pagecache_get_stats(&stats);
+    return stats.pages;
+}
+
+static int test_mappers_share_one_page(void)
+{
+    reset();
+
+    uint8_t *page = palloc_alloc(1);
+    memset(page, 0x5a, PALLOC_PAGE_SIZE);
+    CHECK(pagecache_get(7, 0x1000) == NULL);
+    pagecache_add(7, 0x1000, page);
+    CHECK(palloc_refcount(page) == 2);
+
+    // A second process maps the same page instead of reading its own.
+    CHECK(pagecache_get(7, 0x1000) == page);
+    CHECK(palloc_refcount(page) == 3);
+    CHECK(pagecache_get(8, 0x1000) == NULL);
+    CHECK(pagecache_get(7, 0x2000) == NULL);
+
+    // Both mappings go away; the cache keeps the page for the next exec.
+    palloc_free(page);
+    palloc_free(page);
+    CHECK(palloc_refcount(page) == 1);
+    CHECK(pagecache_get(7, 0x1000) == page);
+    palloc_free(page);
+    return 0;
+}
+
+static int test_shrink_spares_mapped_pages(void)
+{
+    reset();
+
+    uint8_t *mapped = palloc_alloc(1);
+    uint8_t *idle = palloc_alloc(1);
+    pagecache_add(1, 0, mapped);
+    pagecache_add(1, PALLOC_PAGE_SIZE, idle);
+    palloc_free(idle);
+
+    const size_t before = free_pages();
+    CHECK(pagecache_shrink() == 1);
+    CHECK(free_pages() == before + 1);
+    CHECK(pagecache_get(1, PALLOC_PAGE_SIZE) == NULL);
+    CHECK(pagecache_get(1, 0) == mapped);
+    CHECK(palloc_refcount(mapped) == 3);
+    return 0;
+}
+
+static int test_invalidate_drops_one_file(void)
+{
+    uint8_t *pages[6];
+
+    reset();
+    for (size_t i = 0; i < 6; i++)
+    {
+        pages[i] = palloc_alloc(1);
+        pagecache_add(i % 2 == 0 ? 3 : 4, i * PALLOC_PAGE_SIZE, pages[i]);
+        palloc_free(pages[i]);
+    }
+
+    CHECK(cached_pages() == 6);
+    pagecache_invalidate(3);
+    CHECK(cached_pages() == 3);
+
+    for (size_t i = 0; i < 6; i++)
+    {
+        void *got = pagecache_get(i % 2 == 0 ? 3 : 4, i * PALLOC_PAGE_SIZE);
+        CHECK(i % 2 == 0 ? got == NULL : got == pages[i]);
+    }
+
+    return 0;
+}
+
+static int test_full_table_evicts_unmapped(void)
+{
+    uint8_t *pages[MAX_CACHED + 1];
+
+    reset();
+    // Keep every cached page mapped: a newcomer is not cached at all.
+    for (size_t i = 0; i < MAX_CACHED; i++)
+    {
+        pages[i] = palloc_alloc(1);
+        pagecache_add(9, i * PALLOC_PAGE_SIZE, pages[i]);
+    }
+
+    pages[MAX_CACHED] = palloc_alloc(1);
+    pagecache_add(9, MAX_CACHED * PALLOC_PAGE_SIZE, pages[MAX_CACHED]);
+    CHECK(cached_pages() == MAX_CACHED);
+    CHECK(palloc_refcount(pages[MAX_CACHED]) == 1);
+
+    // Once one page is unmapped it makes room.
+    palloc_free(pages[5]);
+    pagecache_add(9, MAX_CACHED * PALLOC_PAGE_SIZE, pages[MAX_CACHED]);
+    CHECK(cached_pages() == MAX_CACHED);
+    CHECK(pagecache_get(9, 5 * PALLOC_PAGE_SIZE) == NULL);
+    CHECK(pagecache_get(9, MAX_CACHED * PALLOC_PAGE_SIZE) == pages[MAX_CACHED]);
+
+    // Every remaining entry is still reachable after the probe runs moved.
+    for (size_t i = 0; i < MAX_CACHED; i++)
+    {
+        CHECK(i == 5 || pagecache_get(9, i * PALLOC_PAGE_SIZE) == pages[i]);
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    if (posix_memalign((void **)&region, PALLOC_PAGE_SIZE, REGION_PAGES * PALLOC_PAGE_SIZE) != 0)
+    {
+        puts("posix_memalign failed");
+        return 1;
+    }
+
+    if (test_mappers_share_one_page() != 0 ||
+        test_shrink_spares_mapped_pages() != 0 ||
+        test_invalidate_drops_one_file() != 0 ||
+        test_full_table_evicts_unmapped() != 0)
+    {
+        return 1;
+    }
+
+    free(region);
+    puts("nanos pagecache tests passed");
+    return 0;
+}
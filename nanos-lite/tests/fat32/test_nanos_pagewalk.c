@@ -82,10 +82,118 @@ static int test_sv39_lookup_returns_null_for_missing_mapping(void)
     return 0;
 }
 
+static void *released[4];
+static size_t nr_released;
+
+static void record_release(void *page)
+{
+    if (nr_released < 4)
+    {
+        released[nr_released] = page;
+    }
+
+    nr_released++;
+}
+
+static int test_sv39_unmap_range_releases_only_pages_inside(void)
+{
+    uint64_t *root = alloc_page();
+    uint64_t *level1 = alloc_page();
+    uint64_t *level0 = alloc_page();
+    void *leaves[3] = {alloc_page(), alloc_page(), alloc_page()};
+    const uintptr_t va = 0x40049000u;
+    const size_t vpn2 = (va >> 30) & 0x1ffu;
+    const size_t vpn1 = (va >> 21) & 0x1ffu;
+    const size_t vpn0 = (va >> 12) & 0x1ffu;
+    const uint64_t leaf_flags = PTE_V | PTE_R | PTE_W | PTE_X | PTE_U | PTE_A | PTE_D;
+
+    root[vpn2] = make_pte(level1, PTE_V);
+    level1[vpn1] = make_pte(level0, PTE_V);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        level0[vpn0 + i] = make_pte(leaves[i], leaf_flags);
+    }
+
+    nr_released = 0;
+    CHECK(nanos_pagewalk_unmap_range(root, va + PAGE_SIZE, 0x80000000u, record_release) == 2);
+    CHECK(nr_released == 2);
+    CHECK(released[0] == leaves[1] && released[1] == leaves[2]);
+    CHECK(nanos_pagewalk_lookup_page(root, va) == leaves[0]);
+    CHECK(nanos_pagewalk_lookup_page(root, va + PAGE_SIZE) == NULL);
+    CHECK(root[vpn2] != 0 && level1[vpn1] != 0);
+
+    CHECK(nanos_pagewalk_unmap_range(root, va + PAGE_SIZE, 0x80000000u, record_release) == 0);
+    CHECK(nanos_pagewalk_unmap_range(root, 0x40000000u, 0x80000000u, NULL) == 1);
+    CHECK(nanos_pagewalk_lookup_page(root, va) == NULL);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        free(leaves[i]);
+    }
+
+    free(level0);
+    free(level1);
+    free(root);
+    return 0;
+}
+
+static size_t nr_visited;
+
+static void count_visit(void *arg, uintptr_t vaddr, void *page)
+{
+    (void)page;
+    *(uintptr_t *)arg = vaddr;
+    nr_visited++;
+}
+
+static int test_sv39_cow_flags_round_trip(void)
+{
+    uint64_t *root = alloc_page();
+    uint64_t *level1 = alloc_page();
+    uint64_t *level0 = alloc_page();
+    void *leaf = alloc_page();
+    void *copy = alloc_page();
+    const uintptr_t va = 0x40049000u;
+    const size_t vpn2 = (va >> 30) & 0x1ffu;
+    const size_t vpn1 = (va >> 21) & 0x1ffu;
+    const size_t vpn0 = (va >> 12) & 0x1ffu;
+    uintptr_t seen = 0;
+
+    root[vpn2] = make_pte(level1, PTE_V);
+    level1[vpn1] = make_pte(level0, PTE_V);
+    level0[vpn0] = make_pte(leaf, PTE_V | PTE_R | PTE_W | PTE_X | PTE_U | PTE_A | PTE_D);
+
+    CHECK(nanos_pagewalk_get_flags(root, va) == NANOS_PAGE_WRITE);
+    CHECK(nanos_pagewalk_get_flags(root, va + PAGE_SIZE) == -1);
+
+    nanos_pagewalk_set_page(root, va, leaf, NANOS_PAGE_COW);
+    CHECK(nanos_pagewalk_get_flags(root, va) == NANOS_PAGE_COW);
+    CHECK((level0[vpn0] & PTE_W) == 0);
+    CHECK((level0[vpn0] & (PTE_U | PTE_X)) == (PTE_U | PTE_X));
+
+    nanos_pagewalk_set_page(root, va + 5, copy, NANOS_PAGE_WRITE);
+    CHECK(nanos_pagewalk_get_flags(root, va) == NANOS_PAGE_WRITE);
+    CHECK(nanos_pagewalk_lookup_page(root, va) == copy);
+
+    nr_visited = 0;
+    nanos_pagewalk_for_each(root, 0x40000000u, 0x80000000u, count_visit, &seen);
+    CHECK(nr_visited == 1 && seen == va);
+
+    free(copy);
+    free(leaf);
+    free(level0);
+    free(level1);
+    free(root);
+    return 0;
+}
+
 int main(void)
 {
     if (test_sv39_lookup_returns_leaf_physical_page() != 0 ||
-        test_sv39_lookup_returns_null_for_missing_mapping() != 0)
+        test_sv39_lookup_returns_null_for_missing_mapping() != 0 ||
+        test_sv39_unmap_range_releases_only_pages_inside() != 0 ||
+        test_sv39_cow_flags_round_trip() != 0)
     {
         return 1;
     }
@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/palloc.h"
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            printf("check failed at line %d: %s\n", __LINE__, #cond); \
+            return 1;                                                 \
+        }                                                             \
+    } while (0)
+
+/* One state page plus 70 pool pages: blocks of 64, 4 and 2 pages. */
+#define REGION_PAGES 71u
+#define POOL_PAGES (REGION_PAGES - 1u)
+
+static uint8_t *region;
+
+static void reset(void)
+{
+    palloc_init(region, region + REGION_PAGES * PALLOC_PAGE_SIZE);
+}
+
+static size_t free_pages(void)
+{
+    PallocStats stats;
+    palloc_get_stats(&stats);
+    return stats.free_pages;
+}
+
+static int test_pool_excludes_state_table(void)
+{
+    PallocStats stats;
+
+    reset();
+    palloc_get_stats(&stats);
+    CHECK(stats.total_pages == POOL_PAGES);
+    CHECK(stats.free_pages == POOL_PAGES);
+
+    uint8_t *p = palloc_alloc(1);
+    CHECK(p >= region + PALLOC_PAGE_SIZE);
+    CHECK(((uintptr_t)p % PALLOC_PAGE_SIZE) == 0);
+    return 0;
+}
+
+static int test_freed_pages_are_reused(void)
+{
+    reset();
+
+    void *a = palloc_alloc(1);
+    void *b = palloc_alloc(1);
+    CHECK(a != NULL && b != NULL && a != b);
+    palloc_free(a);
+    CHECK(palloc_alloc(1) == a);
+    CHECK(free_pages() == POOL_PAGES - 2);
+    return 0;
+}
+
+static int test_odd_run_returns_its_tail(void)
+{
+    reset();
+
+    uint8_t *run = palloc_alloc(3);
+    CHECK(run != NULL);
+    CHECK(free_pages() == POOL_PAGES - 3);
+    memset(run, 0xab, 3u * PALLOC_PAGE_SIZE);
+
+    // The fourth page of the order-2 block is free for the next request.
+    CHECK(palloc_alloc(1) == run + 3u * PALLOC_PAGE_SIZE);
+
+    // Pages of a run go back individually.
+    palloc_free(run + PALLOC_PAGE_SIZE);
+    CHECK(palloc_alloc(1) == run + PALLOC_PAGE_SIZE);
+    return 0;
+}
+
+static int test_buddies_merge_after_free(void)
+{
+    void *pages[POOL_PAGES];
+
+    reset();
+    for (size_t i = 0; i < POOL_PAGES; i++)
+    {
+        pages[i] = palloc_alloc(1);
+        CHECK(pages[i] != NULL);
+    }
+
+    CHECK(palloc_alloc(1) == NULL);
+    CHECK(free_pages() == 0);
+
+    // Free in an order that leaves every buddy pair split until the end.
+    for (size_t i = 0; i < POOL_PAGES; i += 2)
+    {
+        palloc_free(pages[i]);
+    }
+
+    CHECK(palloc_alloc(2) == NULL);
+
+    for (size_t i = 1; i < POOL_PAGES; i += 2)
+    {
+        palloc_free(pages[i]);
+    }
+
+    CHECK(free_pages() == POOL_PAGES);
+    CHECK(palloc_alloc(64) != NULL);
+    CHECK(palloc_alloc(4) != NULL);
+    CHECK(palloc_alloc(2) != NULL);
+    CHECK(palloc_alloc(1) == NULL);
+    return 0;
+}
+
+static int test_shared_page_outlives_first_free(void)
+{
+    reset();
+
+    uint8_t *page = palloc_alloc(1);
+    CHECK(palloc_refcount(page) == 1);
+    palloc_ref(page);
+    CHECK(palloc_refcount(page) == 2);
+
+    palloc_free(page);
+    CHECK(palloc_refcount(page) == 1);
+    CHECK(free_pages() == POOL_PAGES - 1);
+
+    palloc_free(page);
+    CHECK(free_pages() == POOL_PAGES);
+    return 0;
+}
+
+static int test_oversized_requests_fail(void)
+{
+    reset();
+    CHECK(palloc_alloc(0) == NULL);
+    CHECK(palloc_alloc(65) == NULL);
+    CHECK(palloc_alloc(4096) == NULL);
+    CHECK(free_pages() == POOL_PAGES);
+    return 0;
+}
+
+int main(void)
+{
+    if (posix_memalign((void **)&region, PALLOC_PAGE_SIZE, REGION_PAGES * PALLOC_PAGE_SIZE) != 0)
+    {
+        puts("posix_memalign failed");
+        return 1;
+    }
+
+    if (test_pool_excludes_state_table() != 0 ||
+        test_freed_pages_are_reused() != 0 ||
+        test_odd_run_returns_its_tail() != 0 ||
+        test_buddies_merge_after_free() != 0 ||
+        test_shared_page_outlives_first_free() != 0 ||
+        test_oversized_requests_fail() != 0)
+    {
+        return 1;
+    }
+
+    free(region);
+    puts("nanos palloc tests passed");
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -5,6 +6,7 @@
 #include <sys/stat.h>
 
 #include "nanos_abi.h"
+#include "ring.h"
 
 #define CHECK(cond)                                                \
     do                                                             \
@@ -111,9 +113,197 @@ static int test_dirent_translation_packs_newlib_dirents(void)
     return 0;
 }
 
+/*
+ * Check the vector and ring records field by field.  Programs and the kernel
+ * share these layouts through memory, so a reordered or resized field would
+ * silently hand the kernel garbage.
+ */
+static int test_vector_and_ring_layouts(void)
+{
+    CHECK(offsetof(NanosIovec, base) == 0);
+    CHECK(offsetof(NanosIovec, len) == sizeof(uintptr_t));
+    CHECK(sizeof(NanosIovec) == 2 * sizeof(uintptr_t));
+
+    CHECK(offsetof(NanosSqe, opcode) == 0);
+    CHECK(offsetof(NanosSqe, fd) == 4);
+    CHECK(offsetof(NanosSqe, addr) == 8);
+    CHECK(offsetof(NanosSqe, len) == 16);
+    CHECK(offsetof(NanosSqe, off) == 24);
+    CHECK(offsetof(NanosSqe, user_data) == 32);
+    CHECK(sizeof(NanosSqe) == 40);
+
+    CHECK(offsetof(NanosCqe, user_data) == 0);
+    CHECK(offsetof(NanosCqe, res) == 8);
+    CHECK(sizeof(NanosCqe) == 16);
+
+    CHECK(offsetof(NanosRing, sq_head) == 0);
+    CHECK(offsetof(NanosRing, sq_tail) == 4);
+    CHECK(offsetof(NanosRing, cq_head) == 8);
+    CHECK(offsetof(NanosRing, cq_tail) == 12);
+    CHECK(offsetof(NanosRing, entries) == 16);
+    CHECK(offsetof(NanosRing, sqes) == 24);
+    CHECK(offsetof(NanosRing, cqes) == 32);
+    CHECK(sizeof(NanosRing) == 40);
+    return 0;
+}
+
+typedef struct
+{
+    int calls;
+    int firsts;
+    // The call that must wait, or -1.
+    int wait_at;
+    // Bytes each vector piece moves, or -1 for a failure.
+    const long *moved;
+} FakeIo;
+
+static bool fake_ring_op(void *arg, const NanosSqe *sqe, bool first, int64_t *res)
+{
+    FakeIo *io = arg;
+
+    io->firsts += first;
+
+    if (io->calls++ == io->wait_at)
+    {
+        return false;
+    }
+
+    *res = (int64_t)sqe->user_data * 10;
+    return true;
+}
+
+static size_t fake_vector_op(void *arg, const NanosIovec *piece, bool first)
+{
+    FakeIo *io = arg;
+
+    (void)piece;
+    io->firsts += first;
+    return (size_t)io->moved[io->calls++];
+}
+
+static void ring_setup(NanosRing *ring, NanosSqe *sqes, NanosCqe *cqes, uint32_t entries, uint32_t start)
+{
+    memset(sqes, 0, entries * sizeof(*sqes));
+    memset(cqes, 0, entries * sizeof(*cqes));
+    *ring = (NanosRing){
+        .sq_head = start,
+        .sq_tail = start,
+        .cq_head = start,
+        .cq_tail = start,
+        .entries = entries,
+        .sqes = (uintptr_t)sqes,
+        .cqes = (uintptr_t)cqes,
+    };
+}
+
+static void ring_queue(NanosRing *ring, NanosSqe *sqes, uint64_t user_data)
+{
+    sqes[ring->sq_tail & (ring->entries - 1)] = (NanosSqe){.opcode = NANOS_RING_NOP, .user_data = user_data};
+    ring->sq_tail++;
+}
+
+/*
+ * Check that only power-of-two rings with both arrays pass, and that requests
+ * queued across the 32-bit index wrap complete in order into the right slots.
+ */
+static int test_ring_indices_wrap(void)
+{
+    NanosSqe sqes[4];
+    NanosCqe cqes[4];
+    NanosRing ring;
+    FakeIo io = {.wait_at = -1};
+
+    ring_setup(&ring, sqes, cqes, 4, UINT32_MAX - 1);
+    CHECK(ring_valid(&ring));
+    ring.entries = 3;
+    CHECK(!ring_valid(&ring));
+    ring.entries = NANOS_RING_MAX_ENTRIES * 2;
+    CHECK(!ring_valid(&ring));
+    ring.entries = 4;
+    ring.cqes = 0;
+    CHECK(!ring_valid(&ring));
+    ring.cqes = (uintptr_t)cqes;
+
+    for (uint64_t i = 1; i <= 3; i++)
+    {
+        ring_queue(&ring, sqes, i);
+    }
+
+    CHECK(ring_run(&ring, sqes, cqes, fake_ring_op, &io) == 3);
+    CHECK(io.firsts == 1);
+    CHECK(ring.sq_head == 1 && ring.sq_tail == 1 && ring.cq_tail == 1);
+    CHECK(cqes[2].user_data == 1 && cqes[2].res == 10);
+    CHECK(cqes[3].user_data == 2 && cqes[3].res == 20);
+    CHECK(cqes[0].user_data == 3 && cqes[0].res == 30);
+    return 0;
+}
+
+/*
+ * Check that a full completion ring stops the walk with the rest still
+ * queued, that consuming completions lets it go on, and that a request which
+ * has to wait stays queued for the restarted call.
+ */
+static int test_ring_stops_when_completions_full(void)
+{
+    NanosSqe sqes[4];
+    NanosCqe cqes[4];
+    NanosRing ring;
+    FakeIo io = {.wait_at = -1};
+
+    ring_setup(&ring, sqes, cqes, 4, 0);
+    ring.cq_tail = 2;
+
+    for (uint64_t i = 1; i <= 4; i++)
+    {
+        ring_queue(&ring, sqes, i);
+    }
+
+    CHECK(ring_run(&ring, sqes, cqes, fake_ring_op, &io) == 2);
+    CHECK(ring.sq_head == 2 && ring.cq_tail == 4);
+    CHECK(ring_run(&ring, sqes, cqes, fake_ring_op, &io) == 0);
+    CHECK(io.calls == 2);
+
+    ring.cq_head += 2;
+    io = (FakeIo){.wait_at = 1};
+    CHECK(ring_run(&ring, sqes, cqes, fake_ring_op, &io) == 1);
+    CHECK(ring.sq_head == 3 && ring.cq_tail == 5);
+    CHECK(cqes[0].user_data == 3);
+
+    io = (FakeIo){.wait_at = -1};
+    CHECK(ring_run(&ring, sqes, cqes, fake_ring_op, &io) == 1);
+    CHECK(ring.sq_head == ring.sq_tail && cqes[1].user_data == 4);
+    return 0;
+}
+
+/*
+ * Check that a vector stops at the first short piece, that only the pieces
+ * before anything moved may sleep, and that a failure after some bytes
+ * reports those bytes instead of -1.
+ */
+static int test_vector_stops_at_short_piece(void)
+{
+    const NanosIovec iov[4] = {{.len = 0}, {.len = 4}, {.len = 4}, {.len = 4}};
+    const long short_piece[] = {0, 4, 2};
+    const long late_failure[] = {0, 4, -1};
+    const long first_failure[] = {0, -1};
+    FakeIo io = {.moved = short_piece};
+
+    CHECK(iovec_run(iov, 4, fake_vector_op, &io) == 6);
+    CHECK(io.calls == 3 && io.firsts == 2);
+
+    io = (FakeIo){.moved = late_failure};
+    CHECK(iovec_run(iov, 4, fake_vector_op, &io) == 4);
+
+    io = (FakeIo){.moved = first_failure};
+    CHECK(iovec_run(iov, 4, fake_vector_op, &io) == -1);
+    return 0;
+}
+
 int main(void)
 {
-    if (test_stat_translation_fills_newlib_stat() != 0 || test_dirent_translation_packs_newlib_dirents() != 0)
+    if (test_stat_translation_fills_newlib_stat() != 0 || test_dirent_translation_packs_newlib_dirents() != 0 ||
+        test_vector_and_ring_layouts() != 0 || test_ring_indices_wrap() != 0 ||
+        test_ring_stops_when_completions_full() != 0 || test_vector_stops_at_short_piece() != 0)
     {
         return 1;
     }
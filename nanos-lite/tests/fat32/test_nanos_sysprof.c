@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/sysprof.h"
+
+#define CHECK(cond)                                                   \
+    do                                                                \
+    {                                                                 \
+        if (!(cond))                                                  \
+        {                                                             \
+            printf("check failed at line %d: %s\n", __LINE__, #cond); \
+            return 1;                                                 \
+        }                                                             \
+    } while (0)
+
+static int test_buckets_are_log2(void)
+{
+    CHECK(sysprof_bucket(0) == 0);
+    CHECK(sysprof_bucket(1) == 0);
+    CHECK(sysprof_bucket(2) == 1);
+    CHECK(sysprof_bucket(3) == 1);
+    CHECK(sysprof_bucket(4) == 2);
+    CHECK(sysprof_bucket(1023) == 9);
+    CHECK(sysprof_bucket(1024) == 10);
+    // Everything past the histogram lands in the last bucket.
+    CHECK(sysprof_bucket(UINT64_MAX) == SYSPROF_NR_BUCKETS - 1);
+    return 0;
+}
+
+static int test_add_accumulates(void)
+{
+    SysprofCounter c = {0};
+
+    sysprof_add(&c, 100, 3);
+    sysprof_add(&c, 120, 4);
+    sysprof_add(&c, 5000, 40);
+    CHECK(c.calls == 3);
+    CHECK(c.instrs == 5220);
+    CHECK(c.us == 47);
+    CHECK(c.max_instrs == 5000);
+    CHECK(c.hist[6] == 2);
+    CHECK(c.hist[12] == 1);
+    return 0;
+}
+
+static int test_format_lists_used_buckets(void)
+{
+    SysprofCounter c = {0};
+    char buf[128];
+
+    sysprof_add(&c, 100, 3);
+    sysprof_add(&c, 5000, 40);
+
+    size_t n = sysprof_format(buf, sizeof(buf), 0, "read", &c);
+    CHECK(strcmp(buf, "read 2 5100 43 5000 6:1 12:1\n") == 0);
+    CHECK(n == strlen(buf));
+
+    n = sysprof_format(buf, sizeof(buf), n, "write", &(SysprofCounter){0});
+    CHECK(strcmp(buf, "read 2 5100 43 5000 6:1 12:1\nwrite 0 0 0 0\n") == 0);
+    CHECK(n == strlen(buf));
+    return 0;
+}
+
+static int test_format_drops_a_line_that_does_not_fit(void)
+{
+    SysprofCounter c = {0};
+    char buf[40];
+
+    for (uint64_t i = 1; i < ((uint64_t)1 << 20); i <<= 1)
+    {
+        sysprof_add(&c, i, 0);
+    }
+
+    size_t n = sysprof_format(buf, sizeof(buf), 0, "a", &(SysprofCounter){0});
+    CHECK(n == 10);
+    CHECK(sysprof_format(buf, sizeof(buf), n, "mmap", &c) == n);
+    CHECK(strcmp(buf, "a 0 0 0 0\n") == 0);
+    return 0;
+}
+
+static int test_copy_reads_like_a_file(void)
+{
+    const char text[] = "0123456789";
+    char buf[8];
+
+    CHECK(sysprof_copy(text, 10, buf, 0, 4) == 4 && memcmp(buf, "0123", 4) == 0);
+    CHECK(sysprof_copy(text, 10, buf, 8, 4) == 2 && memcmp(buf, "89", 2) == 0);
+    CHECK(sysprof_copy(text, 10, buf, 10, 4) == 0);
+    CHECK(sysprof_copy(text, 10, buf, 20, 4) == 0);
+    return 0;
+}
+
+int main(void)
+{
+    if (test_buckets_are_log2() != 0 ||
+        test_add_accumulates() != 0 ||
+        test_format_lists_used_buckets() != 0 ||
+        test_format_drops_a_line_that_does_not_fit() != 0 ||
+        test_copy_reads_like_a_file() != 0)
+    {
+        return 1;
+    }
+
+    puts("nanos sysprof tests passed");
+    return 0;
+}
@@ -3,6 +3,7 @@
 #define SDL_realloc realloc
 
 #include <limits.h>
+#include <sys/mman.h>
 
 #define SDL_STBIMAGE_IMPLEMENTATION
 #include "SDL_stbimage.h"
@@ -117,6 +118,22 @@ SDL_Surface *IMG_Load(const char *filename)
 
     rewind(fp);
 
+    /*
+   * Decode straight from a mapping of the file when the OS offers one.  The
+   * pages come from the kernel page cache, so the file is never copied into a
+   * heap buffer, and the mapping is gone as soon as the surface is built.
+   */
+    void *map = size > 0 && size <= INT_MAX ? mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fileno(fp), 0)
+                                            : MAP_FAILED;
+
+    if (map != MAP_FAILED)
+    {
+        fclose(fp);
+        SDL_Surface *surface = STBIMG_LoadFromMemory(map, (int)size);
+        munmap(map, (size_t)size);
+        return surface;
+    }
+
     // 3. Allocate temporary buffer
     unsigned char *buf = (unsigned char *)malloc((size_t)size);
 
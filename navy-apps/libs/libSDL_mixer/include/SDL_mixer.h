@@ -49,6 +49,7 @@ extern "C"
     char *Mix_GetError();
     void Mix_CloseAudio();
     int Mix_Volume(int channel, int volume);
+    int Mix_SetPanning(int channel, Uint8 left, Uint8 right);
     int Mix_PlayingMusic();
     int Mix_PlayChannel(int channel, Mix_Chunk *chunk, int loops);
     Mix_Music *Mix_LoadMUS_RW(SDL_RWops *src);
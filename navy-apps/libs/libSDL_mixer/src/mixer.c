@@ -1,3 +1,4 @@
+#include <NDL.h>
 #include <SDL_mixer.h>
 #include <vorbis.h>
 
@@ -34,6 +35,9 @@ typedef struct
     int paused;
     int loops_left;
     int volume;
+    Uint8 pan_left;
+    Uint8 pan_right;
+    int hw; // playing on the NEMU voice with the same index
     uint32_t frame_pos;
     uint32_t rate_accum;
 } MixerChannel;
@@ -52,6 +56,16 @@ static void (*music_finished_hook)(void) = NULL;
 
 static char mixer_error[128] = "";
 
+/*
+ * Host voice backend.  On an S16 device the first NDL_AUDIO_NR_VOICES channels
+ * play on NEMU voices through /dev/sbmix: PLAY hands the chunk's PCM to the
+ * host, and each callback ends with one MIX that resamples and adds every
+ * voice into the stream on the host instead of running mix_channel_frame()
+ * per sample in guest code.  Channels beyond the voice count, and every
+ * channel when the kernel refuses the device, keep the software path below.
+ */
+static int hw_mixer = 0;
+
 static void set_error(const char *message)
 {
     if (message == NULL)
@@ -213,6 +227,55 @@ static int advance_source_frame(uint32_t *accum, int source_freq)
     return steps;
 }
 
+static int hw_voice_volume(const MixerChannel *slot)
+{
+    return (slot->volume * slot->chunk->volume) / MIX_MAX_VOLUME;
+}
+
+static void hw_voice_cmd(int channel, uint32_t op)
+{
+    const MixerChannel *slot = &mix_channels[channel];
+    NDL_AudioMixCmd cmd = {
+        .op = op,
+        .voice = (uint16_t)channel,
+    };
+
+    if (op == NDL_AUDIO_SET)
+    {
+        cmd.volume = (uint16_t)hw_voice_volume(slot);
+        cmd.pan_l = slot->pan_left;
+        cmd.pan_r = slot->pan_right;
+    }
+
+    NDL_AudioMixSubmit(&cmd, 1);
+}
+
+static int hw_play_channel(int channel)
+{
+    MixerChannel *slot = &mix_channels[channel];
+    const Mix_Chunk *chunk = slot->chunk;
+
+    if (!hw_mixer || channel >= NDL_AUDIO_NR_VOICES)
+        return 0;
+
+    const NDL_AudioMixCmd cmd = {
+        .op = NDL_AUDIO_PLAY,
+        .voice = (uint16_t)channel,
+        .volume = (uint16_t)hw_voice_volume(slot),
+        .buf = (uintptr_t)chunk->abuf,
+        .len = chunk->alen,
+        .freq = (uint32_t)chunk->frequency,
+        .format = chunk->format == AUDIO_U8 ? NDL_AUDIO_FMT_U8 : NDL_AUDIO_FMT_S16,
+        .channels = chunk->channels,
+        .pan_l = slot->pan_left,
+        .pan_r = slot->pan_right,
+        .loops = slot->loops_left,
+    };
+
+    slot->hw = NDL_AudioMixSubmit(&cmd, 1) == 1;
+    return slot->hw;
+}
+
 static void finish_channel(int channel, int call_hook)
 {
     if (channel < 0 || channel >= mix_channel_count)
@@ -223,6 +286,12 @@ static void finish_channel(int channel, int call_hook)
     if (!slot->playing)
         return;
 
+    if (slot->hw)
+    {
+        hw_voice_cmd(channel, NDL_AUDIO_STOP);
+        slot->hw = 0;
+    }
+
     slot->playing = 0;
     slot->paused = 0;
     slot->chunk = NULL;
@@ -349,7 +418,7 @@ static void mix_channel_frame(int channel, uint8_t *frame)
     MixerChannel *slot = &mix_channels[channel];
     int16_t samples[MAX_OUTPUT_CHANNELS] = {0};
 
-    if (!slot->playing || slot->paused || slot->chunk == NULL)
+    if (!slot->playing || slot->paused || slot->chunk == NULL || slot->hw)
         return;
 
     Mix_Chunk *chunk = slot->chunk;
@@ -383,12 +452,47 @@ static void mix_channel_frame(int channel, uint8_t *frame)
     int effective_volume = (slot->volume * chunk->volume) / MIX_MAX_VOLUME;
     for (int c = 0; c < device.channels; c++)
     {
-        mix_sample(frame, c, samples[c], effective_volume);
+        int volume = effective_volume;
+
+        if (device.channels == 2)
+            volume = volume * (c == 0 ? slot->pan_left : slot->pan_right) / 255;
+        mix_sample(frame, c, samples[c], volume);
     }
 
     slot->frame_pos += advance_source_frame(&slot->rate_accum, chunk->frequency);
 }
 
+static void mix_hw_voices(uint8_t *stream, int frames)
+{
+    int voices = 0;
+
+    for (int c = 0; c < mix_channel_count; c++)
+    {
+        voices += mix_channels[c].hw;
+    }
+
+    if (voices == 0)
+        return;
+
+    const NDL_AudioMixCmd cmd = {
+        .op = NDL_AUDIO_MIX,
+        .buf = (uintptr_t)stream,
+        .len = (uint32_t)frames,
+    };
+    NDL_AudioMixSubmit(&cmd, 1);
+
+    // A voice that ran out of loops, or was reset with the stream, is done.
+    const uint32_t active = NDL_AudioVoices();
+    for (int c = 0; c < mix_channel_count; c++)
+    {
+        if (mix_channels[c].hw && !(active & (1u << c)))
+        {
+            mix_channels[c].hw = 0;
+            finish_channel(c, 1);
+        }
+    }
+}
+
 static void mixer_callback(void *userdata, uint8_t *stream, int len)
 {
     (void)userdata;
@@ -418,6 +522,8 @@ static void mixer_callback(void *userdata, uint8_t *stream, int len)
             mix_channel_frame(c, frame);
         }
     }
+
+    mix_hw_voices(stream, frames);
 }
 
 static void stop_all_channels(int call_hook)
@@ -460,6 +566,8 @@ static int allocate_channels_locked(int numchans)
     for (int i = copy; i < numchans; i++)
     {
         next[i].volume = MIX_MAX_VOLUME;
+        next[i].pan_left = 255;
+        next[i].pan_right = 255;
     }
 
     for (int i = numchans; i < mix_channel_count; i++)
@@ -920,6 +1028,7 @@ int Mix_OpenAudio(int frequency, uint16_t format, int channels, int chunksize)
 
     device.size = device.samples * device.channels * device_bytes_per_sample;
     audio_opened = 1;
+    hw_mixer = device.format == AUDIO_S16SYS;
 
     if (mix_channel_count == 0 && allocate_channels_locked(DEFAULT_CHANNELS) < 0)
     {
@@ -945,6 +1054,7 @@ void Mix_CloseAudio()
 
     SDL_CloseAudio();
     audio_opened = 0;
+    hw_mixer = 0;
     device_bytes_per_sample = 0;
     memset(&device, 0, sizeof(device));
 
@@ -1066,6 +1176,9 @@ int Mix_Volume(int channel, int volume)
             for (int i = 0; i < mix_channel_count; i++)
             {
                 mix_channels[i].volume = volume;
+
+                if (mix_channels[i].hw)
+                    hw_voice_cmd(i, NDL_AUDIO_SET);
             }
         }
         SDL_UnlockAudio();
@@ -1081,7 +1194,12 @@ int Mix_Volume(int channel, int volume)
     int previous = mix_channels[channel].volume;
 
     if (volume >= 0)
+    {
         mix_channels[channel].volume = volume;
+
+        if (mix_channels[channel].hw)
+            hw_voice_cmd(channel, NDL_AUDIO_SET);
+    }
     SDL_UnlockAudio();
     return previous;
 }
@@ -1137,11 +1255,21 @@ int Mix_PlayChannel(int channel, Mix_Chunk *chunk, int loops)
     slot->loops_left = loops;
     slot->frame_pos = 0;
     slot->rate_accum = 0;
+    hw_play_channel(chosen);
 
     SDL_UnlockAudio();
     return chosen;
 }
 
+static void pause_channel(int channel)
+{
+    MixerChannel *slot = &mix_channels[channel];
+
+    if (slot->hw && !slot->paused)
+        hw_voice_cmd(channel, NDL_AUDIO_PAUSE);
+    slot->paused = 1;
+}
+
 void Mix_Pause(int channel)
 {
     SDL_LockAudio();
@@ -1151,16 +1279,36 @@ void Mix_Pause(int channel)
         for (int i = 0; i < mix_channel_count; i++)
         {
             if (mix_channels[i].playing)
-                mix_channels[i].paused = 1;
+                pause_channel(i);
         }
     }
     else if (channel >= 0 && channel < mix_channel_count)
     {
-        mix_channels[channel].paused = 1;
+        pause_channel(channel);
     }
     SDL_UnlockAudio();
 }
 
+int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
+{
+    SDL_LockAudio();
+
+    if (channel < 0 || channel >= mix_channel_count)
+    {
+        SDL_UnlockAudio();
+        set_error("Invalid mixer channel");
+        return 0;
+    }
+
+    mix_channels[channel].pan_left = left;
+    mix_channels[channel].pan_right = right;
+
+    if (mix_channels[channel].hw)
+        hw_voice_cmd(channel, NDL_AUDIO_SET);
+    SDL_UnlockAudio();
+    return 1;
+}
+
 void Mix_ChannelFinished(void (*channel_finished)(int channel))
 {
     channel_finished_hook = channel_finished;
@@ -2,6 +2,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct BitmapHeader
 {
@@ -20,6 +22,22 @@ struct BitmapHeader
     uint32_t clrused, clrimportant;
 } __attribute__((packed));
 
+/*
+ * Turn one bottom-up BGR(A) row into 0x00RRGGBB pixels.  Walking right to left
+ * lets src and dst be the same buffer: each pixel is read before its wider
+ * output overwrites it.
+ */
+static void convert_row(uint32_t *dst, const uint8_t *src, int w, int depth)
+{
+    for (int j = w - 1; j >= 0; j--)
+    {
+        uint8_t b = src[depth * j];
+        uint8_t g = src[depth * j + 1];
+        uint8_t r = src[depth * j + 2];
+        dst[j] = (r << 16) | (g << 8) | b;
+    }
+}
+
 void *BMP_Load(const char *filename, int *width, int *height)
 {
     FILE *fp = fopen(filename, "r");
@@ -42,19 +60,35 @@ void *BMP_Load(const char *filename, int *width, int *height)
     int depth = (hdr.bitcount == 32 ? 4 : 3);
 
     int line_off = (depth == 4 ? w * 4 : (w * 3 + 3) & ~0x3);
-    for (int i = 0; i < h; i++)
+    size_t map_len = (size_t)hdr.offset + (size_t)h * line_off;
+
+    // Convert from a mapping of the file when possible, saving a copy per row.
+    struct stat st;
+    uint8_t *map = MAP_FAILED;
+
+    if (fstat(fileno(fp), &st) == 0 && (size_t)st.st_size >= map_len)
+        map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+
+    if (map != MAP_FAILED)
+    {
+        for (int i = 0; i < h; i++)
+        {
+            convert_row(&pixels[w * i], map + hdr.offset + (size_t)(h - 1 - i) * line_off, w, depth);
+        }
+    }
+    else
     {
-        fseek(fp, hdr.offset + (h - 1 - i) * line_off, SEEK_SET);
-        int nread = fread(&pixels[w * i], depth, w, fp);
-        for (int j = w - 1; j >= 0; j--)
+        for (int i = 0; i < h; i++)
         {
-            uint8_t b = *(((uint8_t *)&pixels[w * i]) + depth * j);
-            uint8_t g = *(((uint8_t *)&pixels[w * i]) + depth * j + 1);
-            uint8_t r = *(((uint8_t *)&pixels[w * i]) + depth * j + 2);
-            pixels[w * i + j] = (r << 16) | (g << 8) | b;
+            fseek(fp, hdr.offset + (h - 1 - i) * line_off, SEEK_SET);
+            fread(&pixels[w * i], depth, w, fp);
+            convert_row(&pixels[w * i], (const uint8_t *)&pixels[w * i], w, depth);
         }
     }
 
+    if (map != MAP_FAILED)
+        munmap(map, map_len);
+
     fclose(fp);
 
     if (width)
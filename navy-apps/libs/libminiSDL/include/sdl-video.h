@@ -8,6 +8,7 @@
 #define SDL_PREALLOC 0x10
 #define SDL_FULLSCREEN 0x20
 #define SDL_RESIZABLE 0x40
+#define SDL_SRCCOLORKEY 0x1000
 
 #define DEFAULT_RMASK 0x00ff0000
 #define DEFAULT_GMASK 0x0000ff00
@@ -57,6 +58,8 @@ typedef struct
      */
     int pitch;
     uint8_t *pixels;
+    /* Source pixels equal to this value are skipped while SDL_SRCCOLORKEY is set. */
+    uint32_t colorkey;
 } SDL_Surface;
 
 struct SDL_RWops;
@@ -69,6 +72,7 @@ SDL_Surface *SDL_SetVideoMode(int width, int height, int bpp, uint32_t flags);
 void SDL_FreeSurface(SDL_Surface *s);
 void SDL_BlitSurface(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect);
 void SDL_FillRect(SDL_Surface *dst, SDL_Rect *dstrect, uint32_t color);
+int SDL_SetColorKey(SDL_Surface *s, uint32_t flag, uint32_t key);
 void SDL_UpdateRect(SDL_Surface *s, int x, int y, int w, int h);
 void SDL_SoftStretch(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect);
 void SDL_SoftStretchUpdate(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect);
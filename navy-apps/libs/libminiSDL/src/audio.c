@@ -721,6 +721,12 @@ void CallbackHelper(void)
     g_in_audio_cb = 0;
 }
 
+/* An unpaused callback needs SDL_PumpAudio() to keep feeding /dev/sb. */
+bool SDL_AudioActive(void)
+{
+    return !g_paused && g_spec.callback != NULL;
+}
+
 void SDL_PumpAudio(void)
 {
     if (!g_in_audio_cb)
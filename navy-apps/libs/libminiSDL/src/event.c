@@ -204,14 +204,18 @@ static int lookupKeycode(const char *name)
     return -1;
 }
 
-/* Read every raw NDL input record and enqueue translated SDL events. */
-static void pumpInputEvents(void)
+/*
+ * Read every raw NDL input record and enqueue translated SDL events.  With
+ * wait set, the first read sleeps until input arrives.
+ */
+static void pumpInputEvents(bool wait)
 {
     char buf[64];
 
     while (true)
     {
-        const int n = NDL_PollEvent(buf, sizeof(buf));
+        const int n = wait ? NDL_WaitEvent(buf, sizeof(buf)) : NDL_PollEvent(buf, sizeof(buf));
+        wait = false;
 
         if (n <= 0)
         {
@@ -342,7 +346,7 @@ void SDL_PumpEvents(void)
    * point for timers and audio because games call it frequently and all three
    * services remain serialised on the main thread.
    */
-    pumpInputEvents();
+    pumpInputEvents(false);
     SDL_CheckTimers();
 
     SDL_PumpAudio();
@@ -356,13 +360,20 @@ int SDL_PollEvent(SDL_Event *ev)
 
 int SDL_WaitEvent(SDL_Event *event)
 {
+    bool SDL_TimersActive(void);
+    bool SDL_AudioActive(void);
+
     /*
-   * The Navy environment does not provide a blocking SDL wait primitive.  The
-   * busy wait still calls SDL_PollEvent(), so timers and audio continue to be
-   * pumped while the application waits for input.
+   * Timers and audio are pumped by SDL_PollEvent(), so while either is live
+   * the wait keeps polling.  Otherwise nothing but input can end it, and the
+   * process sleeps in the kernel until a key or the mouse wakes it.
    */
     while (!SDL_PollEvent(event))
-    { /* busy-wait */
+    {
+        if (!SDL_TimersActive() && !SDL_AudioActive())
+        {
+            pumpInputEvents(true);
+        }
     }
     return 1;
 }
@@ -419,7 +430,7 @@ int SDL_PeepEvents(SDL_Event *ev, int numevents, int action, uint32_t mask)
 
 uint8_t *SDL_GetKeyState(int *numkeys)
 {
-    pumpInputEvents();
+    pumpInputEvents(false);
 
     // Return size of our array
 
@@ -434,7 +445,7 @@ uint8_t *SDL_GetKeyState(int *numkeys)
 
 uint8_t SDL_GetMouseState(int *x, int *y)
 {
-    pumpInputEvents();
+    pumpInputEvents(false);
 
     if (x)
         *x = mouseX;
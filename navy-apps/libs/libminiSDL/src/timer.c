@@ -110,6 +110,18 @@ void SDL_CheckTimers(void)
     }
 }
 
+/* Whether SDL_CheckTimers() still has work, i.e. event waits must keep polling. */
+bool SDL_TimersActive(void)
+{
+    for (int i = 0; i < MAX_TIMERS; i++)
+    {
+        if (timers[i].active)
+            return true;
+    }
+
+    return false;
+}
+
 uint32_t SDL_GetTicks()
 {
     /*
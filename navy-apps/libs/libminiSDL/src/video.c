@@ -237,6 +237,102 @@ static void build_palette_argb_lut(const SDL_Palette *palette, uint32_t lut[256]
     }
 }
 
+/*
+ * Rectangles at least this large are handed to NEMU's 2D command queue
+ * through NDL_GpuSubmit().  Below it the syscall costs more than the emulated
+ * pixel loop it would replace.  Every caller keeps its software loop as the
+ * fallback for small rectangles and for kernels without /dev/gpu.
+ */
+#define SDL_GPU_MIN_PIXELS 256
+
+static int gpu_worthwhile(const SDL_Surface *s, int w, int h)
+{
+    const int bpp = s->format->BytesPerPixel;
+    return (bpp == 1 || bpp == 4) && (long)w * (long)h >= SDL_GPU_MIN_PIXELS;
+}
+
+static void gpu_set_dst(NDL_GpuCmd *cmd, const SDL_Surface *s, int x, int y, int w, int h)
+{
+    cmd->dst = (uintptr_t)s->pixels;
+    cmd->dst_pitch = (uint32_t)s->pitch;
+    cmd->dst_x = (uint16_t)x;
+    cmd->dst_y = (uint16_t)y;
+    cmd->dst_w = (uint16_t)w;
+    cmd->dst_h = (uint16_t)h;
+}
+
+static void gpu_set_src(NDL_GpuCmd *cmd, const SDL_Surface *s, int x, int y, int w, int h)
+{
+    cmd->src = (uintptr_t)s->pixels;
+    cmd->src_pitch = (uint32_t)s->pitch;
+    cmd->src_x = (uint16_t)x;
+    cmd->src_y = (uint16_t)y;
+    cmd->src_w = (uint16_t)w;
+    cmd->src_h = (uint16_t)h;
+}
+
+static void gpu_set_canvas_dst(NDL_GpuCmd *cmd, int x, int y, int w, int h)
+{
+    cmd->flags |= NDL_GPU_DST_FB;
+    cmd->dst_x = (uint16_t)x;
+    cmd->dst_y = (uint16_t)y;
+    cmd->dst_w = (uint16_t)w;
+    cmd->dst_h = (uint16_t)h;
+}
+
+static int gpu_submit(const NDL_GpuCmd *cmds, int n)
+{
+    return NDL_GpuSubmit(cmds, n) == n;
+}
+
+static int gpu_submit_with_audio_pump(const NDL_GpuCmd *cmds, int n)
+{
+    pump_audio_near_video_update();
+    const int ok = gpu_submit(cmds, n);
+    pump_audio_near_video_update();
+    return ok;
+}
+
+int SDL_SetColorKey(SDL_Surface *s, uint32_t flag, uint32_t key)
+{
+    assert(s);
+
+    if (flag & SDL_SRCCOLORKEY)
+    {
+        s->flags |= SDL_SRCCOLORKEY;
+        s->colorkey = key;
+    }
+    else
+    {
+        s->flags &= ~(uint32_t)SDL_SRCCOLORKEY;
+    }
+
+    return 0;
+}
+
+static void blit_colorkey_row(uint8_t *dst, const uint8_t *src, int w, int bpp, uint32_t key)
+{
+    if (bpp == 1)
+    {
+        for (int i = 0; i < w; i++)
+        {
+            if (src[i] != (uint8_t)key)
+                dst[i] = src[i];
+        }
+        return;
+    }
+
+    assert(bpp == 4);
+    for (int i = 0; i < w; i++)
+    {
+        uint32_t pixel;
+        memcpy(&pixel, src + (size_t)i * 4, sizeof(pixel));
+
+        if (pixel != key)
+            memcpy(dst + (size_t)i * 4, &pixel, sizeof(pixel));
+    }
+}
+
 // Performs a fast blit from the source surface to the destination surface.
 //
 // Copy from https://wiki.libsdl.org/SDL2/SDL_BlitSurface
@@ -339,7 +435,24 @@ void SDL_BlitSurface(SDL_Surface *src, SDL_Rect *srcrect,
         dstrect->h = h;
     }
 
-    /* 6) The actual memcpy loop */
+    /* 6) Hand large blits to the host; the rectangle is clipped already. */
+    const int keyed = (src->flags & SDL_SRCCOLORKEY) != 0;
+
+    if (gpu_worthwhile(dst, w, h) && !(keyed && src == dst))
+    {
+        NDL_GpuCmd cmd = {
+            .op = keyed ? NDL_GPU_COLORKEY : NDL_GPU_COPY,
+            .color = src->colorkey,
+            .bpp = dst->format->BytesPerPixel,
+        };
+        gpu_set_dst(&cmd, dst, dst_x, dst_y, w, h);
+        gpu_set_src(&cmd, src, src_x, src_y, w, h);
+
+        if (gpu_submit(&cmd, 1))
+            return;
+    }
+
+    /* 7) The actual memcpy loop */
     const uint8_t bpp = src->format->BytesPerPixel;
     const int pitchS = src->pitch;
     const int pitchD = dst->pitch;
@@ -367,7 +480,11 @@ void SDL_BlitSurface(SDL_Surface *src, SDL_Rect *srcrect,
     {
         uint8_t *rowS = pixelsS + (src_y + row) * pitchS + src_x * bpp;
         uint8_t *rowD = pixelsD + (dst_y + row) * pitchD + dst_x * bpp;
-        memmove(rowD, rowS, (size_t)w * bpp);
+
+        if (keyed)
+            blit_colorkey_row(rowD, rowS, w, bpp, src->colorkey);
+        else
+            memmove(rowD, rowS, (size_t)w * bpp);
     }
 }
 
@@ -432,6 +549,19 @@ void SDL_FillRect(SDL_Surface *dst, SDL_Rect *dstrect, uint32_t color)
         return;
     }
 
+    if (gpu_worthwhile(dst, fill_w, fill_h))
+    {
+        NDL_GpuCmd cmd = {
+            .op = NDL_GPU_FILL,
+            .color = color,
+            .bpp = dst->format->BytesPerPixel,
+        };
+        gpu_set_dst(&cmd, dst, fill_x, fill_y, fill_w, fill_h);
+
+        if (gpu_submit(&cmd, 1))
+            return;
+    }
+
     // 4) get format info
     const int bpp = dst->format->BytesPerPixel;
 
@@ -568,6 +698,17 @@ void SDL_UpdateRect(SDL_Surface *s, int x, int y, int w, int h)
         const int pitch = s->pitch;
         uint8_t *src = (uint8_t *)s->pixels + y * pitch + x * bpp;
 
+        if (gpu_worthwhile(s, w, h))
+        {
+            // The host reads the pitched rows in place; no repacking pass.
+            NDL_GpuCmd cmd = {.op = NDL_GPU_COPY, .bpp = 4};
+            gpu_set_canvas_dst(&cmd, x, y, w, h);
+            gpu_set_src(&cmd, s, x, y, w, h);
+
+            if (gpu_submit_with_audio_pump(&cmd, 1))
+                return;
+        }
+
         if (x == 0 && bpp > 0 && pitch == w * bpp)
         {
             draw_rect_with_audio_pump((uint32_t *)src, x, y, w, h);
@@ -611,15 +752,25 @@ void SDL_UpdateRect(SDL_Surface *s, int x, int y, int w, int h)
             return;
         }
 
+        uint32_t palette_argb[256];
+        build_palette_argb_lut(s->format->palette, palette_argb);
+
+        if (gpu_worthwhile(s, w, h))
+        {
+            NDL_GpuCmd cmd = {.op = NDL_GPU_PAL8, .aux = (uintptr_t)palette_argb, .bpp = 1};
+            gpu_set_canvas_dst(&cmd, x, y, w, h);
+            gpu_set_src(&cmd, s, x, y, w, h);
+
+            if (gpu_submit_with_audio_pump(&cmd, 1))
+                return;
+        }
+
         uint32_t *buf = ensure_update_argb_buffer(pixels);
         if (buf == NULL)
         {
             return;
         }
 
-        uint32_t palette_argb[256];
-        build_palette_argb_lut(s->format->palette, palette_argb);
-
         /*
        * NDL_DrawRect() consumes 32-bit ARGB pixels, while PAL keeps its real
        * screen as an 8-bit indexed surface.  Reuse one conversion buffer and
@@ -945,6 +1096,30 @@ void SDL_SoftStretch(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_
         return;
     }
 
+    /*
+     * The host uses the same floor mapping, but maps the whole source rectangle
+     * onto the whole destination rectangle, so it only takes unclipped stretches.
+     */
+    if (clip_x0 == dst_x && clip_y0 == dst_y && clip_x1 == dst_x + dst_w &&
+        clip_y1 == dst_y + dst_h && src != dst && gpu_worthwhile(dst, dst_w, dst_h))
+    {
+        NDL_GpuCmd cmd = {.op = NDL_GPU_STRETCH, .bpp = (uint32_t)bpp};
+        gpu_set_dst(&cmd, dst, dst_x, dst_y, dst_w, dst_h);
+        gpu_set_src(&cmd, src, src_x, src_y, src_w, src_h);
+
+        if (gpu_submit(&cmd, 1))
+        {
+            if (dstrect != NULL)
+            {
+                dstrect->x = clip_x0;
+                dstrect->y = clip_y0;
+                dstrect->w = (uint16_t)dst_w;
+                dstrect->h = (uint16_t)dst_h;
+            }
+            return;
+        }
+    }
+
     /*
    * Scale with integer error accumulators instead of doing one division for
    * every destination pixel.  For a 320x200 -> 800x600 PAL frame this removes
@@ -1095,6 +1270,34 @@ void SDL_SoftStretchUpdate(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst
     uint32_t palette_argb[256];
     build_palette_argb_lut(dst->format->palette, palette_argb);
 
+    if (out_w == dst_w && out_h == dst_h && src != dst && gpu_worthwhile(dst, out_w, out_h))
+    {
+        /*
+         * Same two outputs as the loop below, produced on the host: stretch
+         * into the indexed surface, then expand that rectangle to the canvas.
+         */
+        NDL_GpuCmd cmds[2] = {
+            {.op = NDL_GPU_STRETCH, .bpp = 1},
+            {.op = NDL_GPU_PAL8, .aux = (uintptr_t)palette_argb, .bpp = 1},
+        };
+        gpu_set_dst(&cmds[0], dst, dst_x, dst_y, dst_w, dst_h);
+        gpu_set_src(&cmds[0], src, src_x, src_y, src_w, src_h);
+        gpu_set_canvas_dst(&cmds[1], dst_x, dst_y, dst_w, dst_h);
+        gpu_set_src(&cmds[1], dst, dst_x, dst_y, dst_w, dst_h);
+
+        if (gpu_submit_with_audio_pump(cmds, 2))
+        {
+            if (dstrect != NULL)
+            {
+                dstrect->x = clip_x0;
+                dstrect->y = clip_y0;
+                dstrect->w = (uint16_t)out_w;
+                dstrect->h = (uint16_t)out_h;
+            }
+            return;
+        }
+    }
+
     /*
    * PAL normally does SDL_SoftStretch() into an 8-bit hardware surface and then
    * SDL_UpdateRect(), which reads the same 800x600 indexed pixels back to build
@@ -7,6 +7,11 @@
 #include <time.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <NDL.h>
+
+#ifndef __ISA_NATIVE__
+#include <nanos_ring.h>
+#endif
 
 #ifndef CLOCK_MONOTONIC
 #define CLOCK_MONOTONIC ((clockid_t)4)
@@ -21,10 +26,30 @@ static int canvas_x = 0, canvas_y = 0;
 
 // For keyboard.
 static int eventsFd = -1;
+static int eventsWaitFd = -1;
 
 // For framebuffer.
 static int fbFd = -1;
 
+#ifndef __ISA_NATIVE__
+// Row writes of one NDL_DrawRect(), handed to the kernel in a single trap.
+#define FB_RING_ENTRIES 256
+static NanosSqe fbSqes[FB_RING_ENTRIES];
+static NanosCqe fbCqes[FB_RING_ENTRIES];
+static NanosRing fbRing;
+#endif
+
+// For the 2D command queue.  A kernel that has never accepted a command has
+// no queue at all, so gpuUsable is cleared on its first refusal.
+static int gpuFd = -1;
+static int gpuUsable = 1;
+static int gpuAccepted = 0;
+
+// For the host voice mixer, refused the same way as the command queue.
+static int sbmixFd = -1;
+static int sbmixUsable = 1;
+static int sbmixAccepted = 0;
+
 static void clear_full_framebuffer(int width, int height)
 {
     assert(fbFd >= 0);
@@ -92,6 +117,27 @@ int NDL_PollEvent(char *buf, int len)
     return readLen > 0 ? readLen : 0;
 }
 
+int NDL_WaitEvent(char *buf, int len)
+{
+    /*
+   * Same records as NDL_PollEvent(), but the kernel puts the caller to sleep
+   * until the keyboard or mouse has one.  The wait may still end empty-handed,
+   * so callers loop.  A kernel without the blocking device is only polled.
+   */
+    if (eventsWaitFd == -1)
+    {
+        eventsWaitFd = open("/dev/events_wait", 0);
+    }
+
+    if (eventsWaitFd < 0)
+    {
+        return NDL_PollEvent(buf, len);
+    }
+
+    const int readLen = read(eventsWaitFd, buf, len);
+    return readLen > 0 ? readLen : 0;
+}
+
 void NDL_OpenCanvas(int *w, int *h)
 {
     // Ensure not NULL.
@@ -205,6 +251,22 @@ void NDL_TranslateMouse(int *x, int *y)
     }
 }
 
+#ifndef __ISA_NATIVE__
+// Run every queued row write; each must go through whole, as write() must below.
+static void flush_fb_ring(void)
+{
+    while (fbRing.sq_head != fbRing.sq_tail)
+    {
+        assert(nanos_ring_enter(&fbRing) > 0);
+
+        for (NanosCqe *cqe; (cqe = nanos_ring_peek_cqe(&fbRing)) != NULL; nanos_ring_cqe_seen(&fbRing))
+        {
+            assert(cqe->res >= 0 && (uint64_t)cqe->res == cqe->user_data);
+        }
+    }
+}
+#endif
+
 void NDL_DrawRect(uint32_t *pixels, int x, int y, int w, int h)
 {
     assert(fbFd >= 0);
@@ -229,6 +291,36 @@ void NDL_DrawRect(uint32_t *pixels, int x, int y, int w, int h)
         return;
     }
 
+#ifndef __ISA_NATIVE__
+    /*
+   * A narrower rectangle is one strided write per row.  Queue them all on the
+   * syscall ring so the whole rectangle costs one trap instead of two per row.
+   */
+    if (fbRing.entries == 0)
+    {
+        nanos_ring_init(&fbRing, fbSqes, fbCqes, FB_RING_ENTRIES);
+    }
+
+    for (int row = 0; row < h; ++row)
+    {
+        NanosSqe *sqe = nanos_ring_next_sqe(&fbRing);
+
+        if (sqe == NULL)
+        {
+            flush_fb_ring();
+            sqe = nanos_ring_next_sqe(&fbRing);
+        }
+
+        sqe->opcode = NANOS_RING_WRITE;
+        sqe->fd = fbFd;
+        sqe->addr = (uintptr_t)(pixels + row * w);
+        sqe->len = (uint64_t)w * sizeof(uint32_t);
+        sqe->off = ((int64_t)(canvas_y + y + row) * screen_w + (canvas_x + x)) * (int64_t)sizeof(uint32_t);
+        sqe->user_data = sqe->len;
+    }
+
+    flush_fb_ring();
+#else
     for (int row = 0; row < h; ++row)
     {
         const off_t offset = ((off_t)(canvas_y + y + row) * screen_w + (canvas_x + x)) * sizeof(uint32_t);
@@ -239,6 +331,7 @@ void NDL_DrawRect(uint32_t *pixels, int x, int y, int w, int h)
         // Write data.
         assert(write(fbFd, pixels + row * w, w * sizeof(uint32_t)) == w * sizeof(uint32_t));
     }
+#endif
 }
 
 void NDL_OpenAudio(int freq, int channels, int samples)
@@ -287,22 +380,29 @@ void NDL_CloseAudio()
         close(sbctlFd);
         sbctlFd = -1;
     }
+
+    if (sbmixFd >= 0)
+    {
+        close(sbmixFd);
+        sbmixFd = -1;
+    }
 }
 
 int NDL_PlayAudio(void *buf, int len)
 {
     assert(sbFd >= 0);
     /*
-   * /dev/sb write is blocking until all bytes are accepted.  Looping here keeps
-   * miniSDL's audio pump simple: once it has queried enough free space, it can
-   * treat a short write as progress rather than rebuilding the callback buffer.
+   * /dev/sb takes what fits and sleeps while the device ring is full, so a
+   * write may come back short or even empty.  Looping here keeps miniSDL's
+   * audio pump simple: once it has queried enough free space, it can treat a
+   * short write as progress rather than rebuilding the callback buffer.
    */
     int written = 0;
     while (written < len)
     {
         ssize_t w = write(sbFd, (uint8_t *)buf + written, len - written);
 
-        if (w <= 0)
+        if (w < 0)
             return written; // should not happen, but be safe
         written += (int)w;
     }
@@ -332,6 +432,121 @@ int NDL_QueryAudio()
     return free_bytes;
 }
 
+int NDL_GpuSubmit(const NDL_GpuCmd *cmds, int n)
+{
+    /*
+   * Canvas coordinates are moved to physical framebuffer coordinates here, as
+   * NDL_DrawRect() does.  Under NWM the canvas is a window-manager buffer that
+   * /dev/gpu cannot reach, so every command is refused and miniSDL falls back
+   * to its software loops.
+   */
+    if (!gpuUsable || n <= 0 || fbdev == 5)
+    {
+        return 0;
+    }
+
+    if (gpuFd < 0)
+    {
+        gpuFd = open("/dev/gpu", O_WRONLY | O_CLOEXEC);
+
+        if (gpuFd < 0)
+        {
+            gpuUsable = 0;
+            return 0;
+        }
+    }
+
+    NDL_GpuCmd batch[16];
+    int done = 0;
+
+    while (done < n)
+    {
+        int count = n - done;
+
+        if (count > (int)(sizeof(batch) / sizeof(batch[0])))
+            count = (int)(sizeof(batch) / sizeof(batch[0]));
+
+        for (int i = 0; i < count; i++)
+        {
+            batch[i] = cmds[done + i];
+
+            if (batch[i].flags & NDL_GPU_DST_FB)
+            {
+                assert(fbFd >= 0);
+                batch[i].dst_x += canvas_x;
+                batch[i].dst_y += canvas_y;
+            }
+
+            if (batch[i].flags & NDL_GPU_SRC_FB)
+            {
+                assert(fbFd >= 0);
+                batch[i].src_x += canvas_x;
+                batch[i].src_y += canvas_y;
+            }
+        }
+
+        const ssize_t w = write(gpuFd, batch, (size_t)count * sizeof(batch[0]));
+        const int accepted = w > 0 ? (int)(w / (ssize_t)sizeof(batch[0])) : 0;
+        done += accepted;
+        gpuAccepted |= accepted > 0;
+
+        if (accepted < count)
+        {
+            gpuUsable = gpuAccepted;
+            break;
+        }
+    }
+
+    return done;
+}
+
+int NDL_AudioMixSubmit(const NDL_AudioMixCmd *cmds, int n)
+{
+    /*
+   * Voices keep pointing at the caller's PCM, and MIX adds into the caller's
+   * buffer, so records go to the kernel unchanged.  A kernel without the
+   * mixer refuses the first batch and SDL_mixer keeps mixing in software.
+   */
+    if (!sbmixUsable || n <= 0)
+    {
+        return 0;
+    }
+
+    if (sbmixFd < 0)
+    {
+        sbmixFd = open("/dev/sbmix", O_RDWR | O_CLOEXEC);
+
+        if (sbmixFd < 0)
+        {
+            sbmixUsable = 0;
+            return 0;
+        }
+    }
+
+    const ssize_t w = write(sbmixFd, cmds, (size_t)n * sizeof(cmds[0]));
+    const int accepted = w > 0 ? (int)(w / (ssize_t)sizeof(cmds[0])) : 0;
+    sbmixAccepted |= accepted > 0;
+
+    if (accepted < n)
+    {
+        sbmixUsable = sbmixAccepted;
+    }
+
+    return accepted;
+}
+
+uint32_t NDL_AudioVoices()
+{
+    uint32_t active = 0;
+
+    if (sbmixFd < 0 || read(sbmixFd, &active, sizeof(active)) < (ssize_t)sizeof(active))
+    {
+        return 0;
+    }
+
+    return active;
+}
+
 int NDL_Init(uint32_t flags)
 {
     if (getenv("NWM_APP"))
@@ -368,4 +583,14 @@ void NDL_Quit()
     {
         assert(close(sbctlFd) == 0);
     }
+
+    if (gpuFd >= 0)
+    {
+        assert(close(gpuFd) == 0);
+    }
+
+    if (sbmixFd >= 0)
+    {
+        assert(close(sbmixFd) == 0);
+    }
 }
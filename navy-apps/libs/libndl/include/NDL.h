@@ -8,17 +8,84 @@ extern "C"
 {
 #endif
 
+    /*
+     * One /dev/gpu record; the layout is AM's struct gpu_cmd.  Surfaces are a
+     * pointer plus pitch in bytes, or the app canvas with NDL_GPU_DST_FB /
+     * NDL_GPU_SRC_FB (canvas-relative coordinates).  Rectangles must already
+     * be clipped.  Only COPY may overlap; only STRETCH reads src_w/src_h.
+     */
+    enum
+    {
+        NDL_GPU_FILL = 1,
+        NDL_GPU_COPY = 2,
+        NDL_GPU_COLORKEY = 3,
+        NDL_GPU_STRETCH = 4,
+        NDL_GPU_PAL8 = 5,
+    };
+
+#define NDL_GPU_BILINEAR 0x1u
+#define NDL_GPU_DST_FB 0x2u
+#define NDL_GPU_SRC_FB 0x4u
+
+    typedef struct
+    {
+        uint32_t op, flags;
+        uint64_t dst, src, aux; // aux: PAL8 palette, 256 ARGB words
+        uint32_t dst_pitch, src_pitch;
+        uint16_t dst_x, dst_y, dst_w, dst_h;
+        uint16_t src_x, src_y, src_w, src_h;
+        uint32_t color; // FILL colour or COLORKEY key
+        uint32_t bpp;   // bytes per pixel, 1 or 4; PAL8 is 1 -> 4
+    } NDL_GpuCmd;
+
+    /*
+     * One /dev/sbmix record; the layout is AM's struct audio_mix_cmd.  PLAY
+     * starts voice `voice` on PCM that must stay allocated until the voice is
+     * stopped or NDL_AudioVoices() reports it finished.  MIX adds `len` frames
+     * of every playing voice into an S16 buffer in the opened audio format.
+     */
+    enum
+    {
+        NDL_AUDIO_PLAY = 1,
+        NDL_AUDIO_STOP = 2,
+        NDL_AUDIO_PAUSE = 3,
+        NDL_AUDIO_RESUME = 4,
+        NDL_AUDIO_SET = 5,
+        NDL_AUDIO_MIX = 6,
+    };
+
+#define NDL_AUDIO_FMT_U8 1u
+#define NDL_AUDIO_FMT_S16 2u
+#define NDL_AUDIO_NR_VOICES 16
+#define NDL_AUDIO_MAX_VOLUME 128
+
+    typedef struct
+    {
+        uint32_t op;
+        uint16_t voice, volume;   // volume 0..128
+        uint64_t buf;             // PLAY: PCM; MIX: S16 frames to add into
+        uint32_t len;             // PLAY: bytes; MIX: output frames
+        uint32_t freq;            // PLAY: source rate in Hz
+        uint8_t format, channels; // PLAY: NDL_AUDIO_FMT_*, 1 or 2
+        uint8_t pan_l, pan_r;     // 0..255 per side
+        int32_t loops;            // PLAY: extra passes, -1 forever
+    } NDL_AudioMixCmd;
+
     int NDL_Init(uint32_t flags);
     void NDL_Quit();
     uint32_t NDL_GetTicks();
     void NDL_OpenCanvas(int *w, int *h);
     void NDL_TranslateMouse(int *x, int *y);
     int NDL_PollEvent(char *buf, int len);
+    int NDL_WaitEvent(char *buf, int len);
     void NDL_DrawRect(uint32_t *pixels, int x, int y, int w, int h);
     void NDL_OpenAudio(int freq, int channels, int samples);
     void NDL_CloseAudio();
     int NDL_PlayAudio(void *buf, int len);
     int NDL_QueryAudio();
+    int NDL_GpuSubmit(const NDL_GpuCmd *cmds, int n);
+    int NDL_AudioMixSubmit(const NDL_AudioMixCmd *cmds, int n);
+    uint32_t NDL_AudioVoices();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,67 @@
+#ifndef NAVY_NANOS_RING_H
+#define NAVY_NANOS_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../src/nanos_syscall_abi.h"
+
+/*
+ * Batched syscalls for Navy programs on Nanos-lite; see NanosRing for the
+ * protocol.  Queue requests with nanos_ring_next_sqe(), run them all with one
+ * nanos_ring_enter() trap, then read completions with nanos_ring_peek_cqe()
+ * and nanos_ring_cqe_seen().
+ */
+
+static inline void nanos_ring_init(NanosRing *ring, NanosSqe *sqes, NanosCqe *cqes, uint32_t entries)
+{
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    ring->entries = entries;
+    ring->reserved = 0;
+    ring->sqes = (uintptr_t)sqes;
+    ring->cqes = (uintptr_t)cqes;
+}
+
+/* Claim the next submission slot, or NULL while the ring is full. */
+static inline NanosSqe *nanos_ring_next_sqe(NanosRing *ring)
+{
+    if (ring->sq_tail - ring->sq_head == ring->entries)
+    {
+        return NULL;
+    }
+
+    NanosSqe *sqe = (NanosSqe *)(uintptr_t)ring->sqes + (ring->sq_tail & (ring->entries - 1));
+    ring->sq_tail++;
+    return sqe;
+}
+
+/* The oldest completion not yet consumed, or NULL. */
+static inline NanosCqe *nanos_ring_peek_cqe(NanosRing *ring)
+{
+    if (ring->cq_head == ring->cq_tail)
+    {
+        return NULL;
+    }
+
+    return (NanosCqe *)(uintptr_t)ring->cqes + (ring->cq_head & (ring->entries - 1));
+}
+
+static inline void nanos_ring_cqe_seen(NanosRing *ring)
+{
+    ring->cq_head++;
+}
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Run the queued requests; returns how many ran, or -1 for a malformed ring. */
+int nanos_ring_enter(NanosRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef NAVY_SYS_UIO_H
+#define NAVY_SYS_UIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Newlib leaves <sys/uio.h> to the OS, like <sys/mman.h>. */
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+
+#define IOV_MAX 1024
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef NANOS_SYSCALL_ABI_H
 #define NANOS_SYSCALL_ABI_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /*
@@ -81,4 +82,107 @@ typedef struct
     char name[NANOS_NAME_MAX + 1];
 } NanosDirent;
 
+/*
+ * mmap() protection and mapping flags.  They carry the Linux values, which is
+ * also what libos's <sys/mman.h> defines, so libos passes them through.
+ */
+enum
+{
+    NANOS_PROT_NONE = 0x0,
+    NANOS_PROT_READ = 0x1,
+    NANOS_PROT_WRITE = 0x2,
+    NANOS_PROT_EXEC = 0x4,
+};
+
+enum
+{
+    NANOS_MAP_SHARED = 0x01,
+    NANOS_MAP_PRIVATE = 0x02,
+    NANOS_MAP_FIXED = 0x10,
+    NANOS_MAP_ANONYMOUS = 0x20,
+};
+
+/*
+ * mmap() takes six arguments but a syscall carries three, so libos passes a
+ * pointer to this record instead.  fd is ignored for anonymous mappings.
+ */
+typedef struct
+{
+    uint64_t addr;
+    uint64_t length;
+    int64_t offset;
+    int32_t prot;
+    int32_t flags;
+    int32_t fd;
+    int32_t reserved;
+} NanosMmapArgs;
+
+/*
+ * One piece of a readv()/writev() call.  Kernel and programs always share a
+ * word size, so the record is laid out like struct iovec and libos passes the
+ * caller's array through unchanged.
+ */
+typedef struct
+{
+    uintptr_t base;
+    size_t len;
+} NanosIovec;
+
+enum
+{
+    NANOS_IOV_MAX = 1024
+};
+
+/*
+ * Batched syscalls.  A program owns a submission and a completion array of
+ * the same power-of-two size and queues requests at sq_tail; one SYS_ring_enter
+ * trap runs them in order, advancing sq_head and posting one completion per
+ * request at cq_tail.  The kernel stops early when the completion array is
+ * full, so the program consumes completions by advancing cq_head.  The four
+ * indices run freely and wrap through entries - 1.
+ */
+enum
+{
+    NANOS_RING_NOP = 0,
+    NANOS_RING_READ = 1,
+    NANOS_RING_WRITE = 2,
+};
+
+enum
+{
+    NANOS_RING_MAX_ENTRIES = 4096
+};
+
+typedef struct
+{
+    uint8_t opcode;
+    uint8_t reserved[3];
+    int32_t fd;
+    uint64_t addr;
+    uint64_t len;
+    // File position to seek to first, or -1 to go on from the current one.
+    int64_t off;
+    // Copied to the completion untouched.
+    uint64_t user_data;
+} NanosSqe;
+
+typedef struct
+{
+    uint64_t user_data;
+    // Bytes transferred, or -1.
+    int64_t res;
+} NanosCqe;
+
+typedef struct
+{
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    uint32_t entries;
+    uint32_t reserved;
+    uint64_t sqes;
+    uint64_t cqes;
+} NanosRing;
+
 #endif
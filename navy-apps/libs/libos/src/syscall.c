@@ -1,5 +1,7 @@
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <assert.h>
@@ -7,6 +9,7 @@
 #include <errno.h>
 #include "syscall.h"
 #include "nanos_abi.h"
+#include "nanos_ring.h"
 
 #ifndef CLOCK_REALTIME
 #define CLOCK_REALTIME ((clockid_t)1)
@@ -298,20 +301,21 @@ int _kill(int pid, int sig)
 
 pid_t _getpid()
 {
-    _exit(-SYS_getpid);
-    return 1;
+    return _syscall_(SYS_getpid, 0, 0, 0);
 }
 
+/*
+ * The child shares the parent's pages copy-on-write, so vfork() needs no
+ * separate path.
+ */
 pid_t _fork()
 {
-    assert(0);
-    return -1;
+    return syscall_ret_errno(_syscall_(SYS_fork, 0, 0, 0), ENOMEM);
 }
 
 pid_t vfork()
 {
-    assert(0);
-    return -1;
+    return _fork();
 }
 
 int _link(const char *d, const char *n)
@@ -360,6 +364,19 @@ int ftruncate(int fd, off_t length)
     return syscall_ret_errno(_syscall_(SYS_ftruncate, (intptr_t)fd, (intptr_t)length, 0), EBADF);
 }
 
+/*
+ * Write the kernel's cached disk blocks back to the device.
+ */
+int fsync(int fd)
+{
+    return syscall_ret_errno(_syscall_(SYS_fsync, (intptr_t)fd, 0, 0), EBADF);
+}
+
+void sync(void)
+{
+    _syscall_(SYS_fsync, -1, 0, 0);
+}
+
 /*
  * Provide the BSD/newlib getdents hook used by readdir().
  */
@@ -399,6 +416,65 @@ int getdents(int fd, void *buf, int count)
     return packed;
 }
 
+_Static_assert(PROT_READ == NANOS_PROT_READ && PROT_WRITE == NANOS_PROT_WRITE && PROT_EXEC == NANOS_PROT_EXEC,
+               "mmap() protection bits must match the Nanos ABI");
+_Static_assert(MAP_SHARED == NANOS_MAP_SHARED && MAP_PRIVATE == NANOS_MAP_PRIVATE && MAP_FIXED == NANOS_MAP_FIXED &&
+                   MAP_ANONYMOUS == NANOS_MAP_ANONYMOUS,
+               "mmap() flags must match the Nanos ABI");
+
+/*
+ * Map a file or anonymous memory.  The syscall ABI carries three arguments,
+ * so the six of mmap() travel in one NanosMmapArgs record.
+ */
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    NanosMmapArgs args = {
+        .addr = (uintptr_t)addr,
+        .length = length,
+        .offset = offset,
+        .prot = prot,
+        .flags = flags,
+        .fd = fd,
+    };
+    const intptr_t ret = _syscall_(SYS_mmap, (intptr_t)&args, 0, 0);
+
+    if (ret == -1)
+    {
+        // Nanos-lite answers plain -1; a file mapping mostly fails on its fd.
+        errno = (flags & MAP_ANONYMOUS) != 0 ? ENOMEM : EBADF;
+        return MAP_FAILED;
+    }
+
+    return (void *)ret;
+}
+
+int munmap(void *addr, size_t length)
+{
+    return syscall_ret_errno(_syscall_(SYS_munmap, (intptr_t)addr, (intptr_t)length, 0), EINVAL);
+}
+
+_Static_assert(sizeof(struct iovec) == sizeof(NanosIovec) && offsetof(struct iovec, iov_len) == offsetof(NanosIovec, len),
+               "struct iovec must match the Nanos ABI");
+
+/*
+ * Gather and scatter I/O.  One trap moves every piece, so callers such as
+ * NDL can hand over many small buffers at once.
+ */
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    return syscall_ret_errno(_syscall_(SYS_readv, (intptr_t)fd, (intptr_t)iov, (intptr_t)iovcnt), EINVAL);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    return syscall_ret_errno(_syscall_(SYS_writev, (intptr_t)fd, (intptr_t)iov, (intptr_t)iovcnt), EINVAL);
+}
+
+int nanos_ring_enter(NanosRing *ring)
+{
+    return syscall_ret_errno(_syscall_(SYS_ring_enter, (intptr_t)ring, 0, 0), EINVAL);
+}
+
 pid_t _wait(int *status)
 {
     assert(0);
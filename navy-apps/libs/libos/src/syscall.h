@@ -30,7 +30,13 @@ enum
     SYS_rename,
     SYS_truncate,
     SYS_ftruncate,
-    SYS_clock_gettime
+    SYS_clock_gettime,
+    SYS_fsync,
+    SYS_mmap,
+    SYS_munmap,
+    SYS_readv,
+    SYS_writev,
+    SYS_ring_enter
 };
 
 #endif
@@ -4,6 +4,13 @@
 #include <common.h>
 
 void cpu_exec(uint64_t n);
+/*
+ * Abandon the current guest instruction after it has raised a synchronous trap
+ * from inside a memory access, resuming cpu_exec() at the new cpu.pc.  Only
+ * possible while cpu_exec() is running, e.g. not for monitor memory reads.
+ */
+bool cpu_exec_can_abort(void);
+void cpu_exec_abort_instr(void) __attribute__((noreturn));
 
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
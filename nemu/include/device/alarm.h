@@ -21,4 +21,13 @@
 typedef void (*alarm_handler_t)();
 void add_alarm_handle(alarm_handler_t h);
 
+/*
+ * Sleep the host for at most `max_us`, waking early for the next host event
+ * poll or armed CLINT comparator, then run the device update that was due.
+ */
+void device_idle(uint64_t max_us);
+
+/* Cut a device_idle() sleep short; safe to call from host I/O threads. */
+void device_wakeup(void);
+
 #endif
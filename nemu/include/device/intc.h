@@ -0,0 +1,31 @@
+#ifndef __DEVICE_INTC_H__
+#define __DEVICE_INTC_H__
+
+#include <common.h>
+
+/*
+ * Interrupt controllers.  Devices only drive PLIC source levels; the ISA reads
+ * the per-hart MSIP/MTIP/MEIP lines back when it evaluates mip.  Whenever a
+ * line may have risen, the controllers set cpu.INTR so the CPU loop leaves its
+ * fast path and asks the ISA to re-evaluate.
+ */
+
+/* CLINT software-interrupt line of `hart`. */
+bool clint_msip(int hart);
+
+/* CLINT timer-interrupt line of `hart`: mtime >= mtimecmp, latched at the last tick. */
+bool clint_mtip(int hart);
+
+/* Re-evaluate the timer comparators against the current host time. */
+void clint_tick(uint64_t now_us);
+
+/* Host time in microseconds at which the earliest armed comparator fires. */
+uint64_t clint_next_deadline_us(void);
+
+/* PLIC external-interrupt line of the M-mode context belonging to `hart`. */
+bool plic_meip(int hart);
+
+/* Drive the level of PLIC source `src`. */
+void dev_set_irq(int src, bool level);
+
+#endif
@@ -6,6 +6,20 @@
 typedef void (*io_callback_t)(uint32_t, int, bool);
 uint8_t *new_space(int size);
 
+/*
+ * How much of a map's traffic needs its callback.  CALLBACK maps call back on
+ * every access.  WRITE_NOTIFY maps read as plain memory and call back only
+ * after a store, so the handler can note what changed.  PASSIVE maps have no
+ * callback and are plain memory both ways.  The MMIO bus serves the plain
+ * accesses itself, which keeps them cheap for the JIT's store/load helpers.
+ */
+typedef enum
+{
+    MAP_CALLBACK,
+    MAP_WRITE_NOTIFY,
+    MAP_PASSIVE,
+} map_kind_t;
+
 typedef struct
 {
     const char *name;
@@ -14,6 +28,7 @@ typedef struct
     paddr_t high;
     void *space;
     io_callback_t callback;
+    map_kind_t kind;
 } IOMap;
 
 static inline bool map_inside(IOMap *map, paddr_t addr)
@@ -40,6 +55,8 @@ void add_pio_map(const char *name, ioaddr_t addr,
                  void *space, uint32_t len, io_callback_t callback);
 void add_mmio_map(const char *name, paddr_t addr,
                   void *space, uint32_t len, io_callback_t callback);
+void add_mmio_map_notify(const char *name, paddr_t addr,
+                         void *space, uint32_t len, io_callback_t on_write);
 
 word_t map_read(paddr_t addr, int len, IOMap *map);
 void map_write(paddr_t addr, int len, word_t data, IOMap *map);
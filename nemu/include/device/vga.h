@@ -0,0 +1,31 @@
+#ifndef __DEVICE_VGA_H__
+#define __DEVICE_VGA_H__
+
+#include <common.h>
+
+/*
+ * The framebuffer is a fast range next to PMEM.  paddr.c and the RV64 JIT
+ * store helper commit framebuffer accesses here directly instead of looking up
+ * the MMIO map, and vga.c derives per-scanline dirty state from the store
+ * address.  With DTRACE the fast range is empty so every access is logged by
+ * map_read()/map_write() as before.
+ */
+
+/* Bytes of guest-visible framebuffer; 0 until init_vga() has run. */
+extern uint32_t vga_vmem_size;
+
+static inline bool in_vmem_range(paddr_t addr, int len)
+{
+#if defined(CONFIG_HAS_VGA) && !defined(CONFIG_DTRACE)
+    const paddr_t offset = addr - (paddr_t)CONFIG_FB_ADDR;
+    return len > 0 && offset < vga_vmem_size && (uint32_t)len <= vga_vmem_size - (uint32_t)offset;
+#else
+    return false;
+#endif
+}
+
+/* Only valid for ranges accepted by in_vmem_range(). */
+word_t vga_vmem_read(paddr_t addr, int len);
+void vga_vmem_write(paddr_t addr, int len, word_t data);
+
+#endif
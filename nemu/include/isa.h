@@ -48,6 +48,14 @@ enum
 int isa_mmu_check(vaddr_t vaddr, int len, int type);
 #endif
 paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type);
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+/*
+ * Deliver the page fault for a failed translation and abandon the instruction.
+ * Returns only when no instruction is executing, leaving the caller to report
+ * the failure itself.
+ */
+void isa_mmu_fault(vaddr_t vaddr, int type);
+#endif
 
 // interrupt/exception
 vaddr_t isa_raise_intr(word_t NO, vaddr_t epc);
@@ -10,6 +10,16 @@ uint8_t *guest_to_host(paddr_t paddr);
 /* convert the host virtual address in NEMU to guest physical address in the guest program */
 paddr_t host_to_guest(uint8_t *haddr);
 
+/*
+ * Device access to a guest buffer by virtual address.  Each call translates
+ * addr through the current MMU and returns the host pointer and length of the
+ * PMEM run it starts, at most wanted bytes and never past its page; false when
+ * the page is unmapped, lacks the permission, or lies outside PMEM.  The write
+ * form also reports the physical address, for JIT invalidation.
+ */
+bool guest_read_chunk(vaddr_t addr, size_t wanted, uint8_t **host, size_t *len);
+bool guest_write_chunk(vaddr_t addr, size_t wanted, uint8_t **host, size_t *len, paddr_t *paddr);
+
 static inline bool in_pmem(paddr_t addr)
 {
     return (addr >= CONFIG_MBASE) && (addr < (paddr_t)CONFIG_MBASE + CONFIG_MSIZE);
@@ -7,7 +7,11 @@
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
 #include <isa-jit.h>
 #endif
+#ifdef CONFIG_RV64_SMP
+#include <isa-hart.h>
+#endif
 #include <locale.h>
+#include <setjmp.h>
 
 /* The assembly code of instructions executed is only output to the screen
  * when the number of instructions executed is less than this value.
@@ -29,8 +33,19 @@ static uint64_t g_timer = 0; // unit: us
 static bool g_print_step = false;
 const rtlreg_t rzero = 0;
 rtlreg_t tmp_reg[6];
+/*
+ * Landing point for instructions abandoned by cpu_exec_abort_instr().  The
+ * device counter lives here rather than on execute()'s stack so a run of
+ * faulting instructions cannot keep resetting it and starve device updates.
+ */
+static jmp_buf abort_env;
+static bool abort_armed = false;
+#ifdef CONFIG_DEVICE
+static uint32_t device_update_counter = 0;
+#endif
 
 void device_update();
+void serial_flush();
 #if !defined(CONFIG_ISA_riscv32) && !defined(CONFIG_ISA_riscv64)
 void fetch_decode(Decode *s, vaddr_t pc);
 #endif
@@ -279,28 +294,9 @@ static inline bool can_jit_exec()
 #endif
 }
 
-/* Simulate how the CPU works. */
-void cpu_exec(uint64_t n)
+static void execute(uint64_t n)
 {
-    g_print_step = n < MAX_INSTR_TO_PRINT;
-
-    switch (nemu_state.state)
-    {
-    case NEMU_END:
-    case NEMU_ABORT:
-    case NEMU_QUIT:
-        printf("Program execution has ended. To restart the program, exit NEMU and run again.\n");
-        return;
-    default:
-        nemu_state.state = NEMU_RUNNING;
-    }
-
-    uint64_t timer_start = get_time();
-
     Decode s;
-#ifdef CONFIG_DEVICE
-    uint32_t device_update_counter = 0;
-#endif
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
     const bool jit_exec = can_jit_exec();
 #endif
@@ -323,6 +319,16 @@ void cpu_exec(uint64_t n)
             uint32_t device_budget = UINT32_MAX;
 #ifdef CONFIG_DEVICE
             device_budget = DEVICE_UPDATE_CHECK_INTERVAL - device_update_counter;
+#endif
+#ifdef CONFIG_RV64_SMP
+            /*
+             * With several harts running, the batch must also end at the hart
+             * slice boundary so isa_hart_account() can rotate on time.
+             */
+            if (device_budget > isa_hart_budget())
+            {
+                device_budget = isa_hart_budget();
+            }
 #endif
             jit_done = isa_jit_exec(n, device_budget, &executed);
         }
@@ -369,11 +375,72 @@ void cpu_exec(uint64_t n)
         {
             cpu.pc = isa_raise_intr(intr, cpu.pc);
         }
+
+        IFDEF(CONFIG_RV64_SMP, isa_hart_account(executed));
+    }
+}
+
+bool cpu_exec_can_abort(void)
+{
+    return abort_armed;
+}
+
+void cpu_exec_abort_instr(void)
+{
+    Assert(abort_armed, "cpu_exec_abort_instr() outside cpu_exec()");
+    longjmp(abort_env, 1);
+}
+
+/* Simulate how the CPU works. */
+void cpu_exec(uint64_t n)
+{
+    g_print_step = n < MAX_INSTR_TO_PRINT;
+
+    switch (nemu_state.state)
+    {
+    case NEMU_END:
+    case NEMU_ABORT:
+    case NEMU_QUIT:
+        printf("Program execution has ended. To restart the program, exit NEMU and run again.\n");
+        return;
+    default:
+        nemu_state.state = NEMU_RUNNING;
+    }
+
+    uint64_t timer_start = get_time();
+    const uint64_t instr_start = g_nr_guest_instr;
+#ifdef CONFIG_DEVICE
+    device_update_counter = 0;
+#endif
+
+    /*
+     * A trapping memory access deep inside an instruction, for example a page
+     * fault in a load helper called from translated code, has already
+     * redirected cpu.pc to the trap vector.  It unwinds to here; the abandoned
+     * instruction counts as retired and execution resumes at the handler.
+     * Instructions the JIT retired earlier in the same block go uncounted.
+     */
+    if (setjmp(abort_env) != 0)
+    {
+        g_nr_guest_instr++;
+    }
+
+    abort_armed = true;
+    const uint64_t done = g_nr_guest_instr - instr_start;
+
+    if (done < n && nemu_state.state == NEMU_RUNNING)
+    {
+        execute(n - done);
     }
 
+    abort_armed = false;
+
     uint64_t timer_end = get_time();
     g_timer += timer_end - timer_start;
 
+    /* Guest console output must reach the host before NEMU reports why it stopped. */
+    IFDEF(CONFIG_HAS_SERIAL, serial_flush());
+
     switch (nemu_state.state)
     {
     case NEMU_RUNNING:
@@ -3,10 +3,21 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <device/map.h>
 #include <isa.h>
 #include <memory/paddr.h>
 #include <utils.h>
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+#include <isa-jit.h>
+#endif
+#ifdef CONFIG_HAS_PLIC
+#include <device/intc.h>
+#endif
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
 
 enum
 {
@@ -19,33 +30,58 @@ enum
     reg_bulk_src,  // Guest pointer for bulk stream-buffer append
     reg_bulk_len,  // Number of bytes to append from reg_bulk_src
     reg_bulk_cmd,  // Write AUDIO_BULK_CMD_APPEND to commit the append
-    nr_reg
+    reg_mix_cmds_lo = NEMU_AUDIO_MIX_CMDS_LO, // Guest pointer to mixer commands
+    reg_mix_cmds_hi = NEMU_AUDIO_MIX_CMDS_HI,
+    reg_mix_count = NEMU_AUDIO_MIX_COUNT,       // Number of mixer commands
+    reg_mix_doorbell = NEMU_AUDIO_MIX_DOORBELL, // Write NEMU_AUDIO_MIX_RUN to run them
+    reg_voice_active = NEMU_AUDIO_VOICE_ACTIVE, // Read one bit per live voice
+    nr_reg = NEMU_AUDIO_NR_REGS
 };
 
+_Static_assert(reg_bulk_cmd + 1 == reg_mix_cmds_lo,
+               "The mixer registers must follow the stream registers");
+
 #define MIN(a, b) (((a) > (b)) ? (b) : (a))
-#define AUDIO_PAGE_SIZE 4096u
-#define AUDIO_PAGE_MASK (AUDIO_PAGE_SIZE - 1u)
 #define AUDIO_BULK_CMD_APPEND 1u
 #define AUDIO_STATS_INTERVAL_US 5000000ull
+#define AUDIO_SB_MASK (CONFIG_SB_SIZE - 1u)
+
+_Static_assert((CONFIG_SB_SIZE & (CONFIG_SB_SIZE - 1)) == 0,
+               "The audio stream buffer size must be a power of two");
 
 #ifndef CONFIG_AUDIO_DUMMY
 static SDL_AudioSpec spec = {0};
 static bool audio_opened = false;
 #endif
 
+static bool audio_started = false;
 static uint8_t *sbuf = NULL;
 static uint32_t *audio_base = NULL;
 
-static uint32_t audio_count = 0;
-static uint32_t sbufReadIndex = 0;
+/*
+ * The stream buffer is a single-producer/single-consumer ring.  The CPU thread
+ * copies guest samples in and advances sbuf_tail; the SDL callback copies them
+ * out and advances sbuf_head.  Both are free-running byte counters, so the
+ * occupancy is tail - head and neither side ever writes a value the other owns.
+ * A release store after the bytes move and an acquire load of the other index
+ * are all the synchronisation the ring needs; no SDL audio lock is taken.
+ */
+static _Atomic uint32_t sbuf_head = 0;
+static _Atomic uint32_t sbuf_tail = 0;
+static uint32_t audio_bytes_per_sec = 0;
+
+/*
+ * Counters bumped by the SDL callback are atomics so the CPU thread can read
+ * and reset them for the periodic report without a lock.
+ */
 static bool audio_stats_enabled = false;
 static uint64_t audio_stats_last_us = 0;
 static uint64_t audio_stats_appends = 0;
 static uint64_t audio_stats_append_bytes = 0;
-static uint64_t audio_stats_callbacks = 0;
-static uint64_t audio_stats_played_bytes = 0;
-static uint64_t audio_stats_underrun_callbacks = 0;
-static uint64_t audio_stats_underrun_bytes = 0;
+static _Atomic uint64_t audio_stats_callbacks = 0;
+static _Atomic uint64_t audio_stats_played_bytes = 0;
+static _Atomic uint64_t audio_stats_underrun_callbacks = 0;
+static _Atomic uint64_t audio_stats_underrun_bytes = 0;
 static uint32_t audio_stats_max_count = 0;
 
 static bool audio_env_flag_enabled(const char *name)
@@ -54,14 +90,29 @@ static bool audio_env_flag_enabled(const char *name)
     return env != NULL && env[0] != '\0' && strcmp(env, "0") != 0;
 }
 
+/* Bytes queued for the host; only meaningful on the CPU (producer) thread. */
+static uint32_t audio_ring_count(void)
+{
+    const uint32_t tail = atomic_load_explicit(&sbuf_tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&sbuf_head, memory_order_acquire);
+    return tail - head;
+}
+
 static void audio_note_count(void)
 {
-    if (audio_count > audio_stats_max_count)
+    const uint32_t count = audio_ring_count();
+
+    if (count > audio_stats_max_count)
     {
-        audio_stats_max_count = audio_count;
+        audio_stats_max_count = count;
     }
 }
 
+static uint64_t audio_stats_take(_Atomic uint64_t *counter)
+{
+    return atomic_exchange_explicit(counter, 0, memory_order_relaxed);
+}
+
 static void audio_stats_maybe_print(void)
 {
     if (!audio_stats_enabled)
@@ -84,59 +135,33 @@ static void audio_stats_maybe_print(void)
         return;
     }
 
+    const uint32_t count = audio_ring_count();
     const double seconds = (double)elapsed / 1000000.0;
     const double append_kib = (double)audio_stats_append_bytes / 1024.0;
-    const double played_kib = (double)audio_stats_played_bytes / 1024.0;
-    const double underrun_kib = (double)audio_stats_underrun_bytes / 1024.0;
+    const double played_kib = (double)audio_stats_take(&audio_stats_played_bytes) / 1024.0;
+    const double underrun_kib = (double)audio_stats_take(&audio_stats_underrun_bytes) / 1024.0;
+    /* Queued bytes are the latency a new sample sees before it is played. */
+    const double max_latency_ms = audio_bytes_per_sec == 0
+                                      ? 0.0
+                                      : (double)audio_stats_max_count * 1000.0 / audio_bytes_per_sec;
     printf("[audio] elapsed=%.3f s appends=%" PRIu64 " append=%.1f KiB "
            "callbacks=%" PRIu64 " played=%.1f KiB underruns=%" PRIu64
-           " underrun=%.1f KiB count=%u max_count=%u\n",
+           " underrun=%.1f KiB count=%u max_count=%u max_latency=%.1f ms\n",
            seconds, audio_stats_appends, append_kib,
-           audio_stats_callbacks, played_kib,
-           audio_stats_underrun_callbacks, underrun_kib,
-           audio_count, audio_stats_max_count);
+           audio_stats_take(&audio_stats_callbacks), played_kib,
+           audio_stats_take(&audio_stats_underrun_callbacks), underrun_kib,
+           count, audio_stats_max_count, max_latency_ms);
     fflush(stdout);
 
     audio_stats_last_us = now;
     audio_stats_appends = 0;
     audio_stats_append_bytes = 0;
-    audio_stats_callbacks = 0;
-    audio_stats_played_bytes = 0;
-    audio_stats_underrun_callbacks = 0;
-    audio_stats_underrun_bytes = 0;
-    audio_stats_max_count = audio_count;
+    audio_stats_max_count = count;
 }
 
 static void publish_audio_count(void)
 {
-    audio_base[reg_count] = audio_count;
-}
-
-static void lock_audio_counter(void)
-{
-#ifndef CONFIG_AUDIO_DUMMY
-    /*
-     * The SDL callback and the guest MMIO handler are the two writers of the
-     * occupancy counter.  Lock only after the host device is open: before that,
-     * SDL has no callback thread and SDL_LockAudio() would only add host-side
-     * work to the init path.
-     */
-
-    if (audio_opened)
-    {
-        SDL_LockAudio();
-    }
-#endif
-}
-
-static void unlock_audio_counter(void)
-{
-#ifndef CONFIG_AUDIO_DUMMY
-    if (audio_opened)
-    {
-        SDL_UnlockAudio();
-    }
-#endif
+    audio_base[reg_count] = audio_ring_count();
 }
 
 /*
@@ -161,10 +186,11 @@ static void close_audio_if_open(void)
 #endif
 }
 
+/* Only called with the host stream closed, so the callback cannot race it. */
 static void reset_audio_stream(void)
 {
-    sbufReadIndex = 0;
-    audio_count = 0;
+    atomic_store_explicit(&sbuf_head, 0, memory_order_relaxed);
+    atomic_store_explicit(&sbuf_tail, 0, memory_order_relaxed);
     audio_note_count();
     publish_audio_count();
 #ifndef CONFIG_AUDIO_DUMMY
@@ -182,99 +208,76 @@ static void sdlAudioCallback(void *userdata, Uint8 *stream, int len)
     SDL_memset(stream, spec.silence, len);
 
     // Determine how many bytes we can copy from the audio buffer.
-    const uint32_t currentSizeOfData = audio_count;
-    const uint32_t filledBytes = MIN((uint32_t)len, currentSizeOfData);
+    const uint32_t head = atomic_load_explicit(&sbuf_head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&sbuf_tail, memory_order_acquire);
+    const uint32_t filledBytes = MIN((uint32_t)len, tail - head);
     const uint32_t missingBytes = (uint32_t)len - filledBytes;
 
     /*
-     * Copy at most to the physical end of the ring before wrapping.  The old
-     * endIndex comparison could not distinguish "no wrap" from "wrapped
-     * exactly back to the same index"; with a full-buffer callback and a
-     * non-zero read index, that would try to copy past the end of sbuf.
+     * Copy at most to the physical end of the ring before wrapping.  The
+     * free-running indices cannot confuse "empty" with "full", so a
+     * full-buffer callback from a non-zero offset wraps like any other.
      */
-    const uint32_t firstHalfLen = MIN(filledBytes, CONFIG_SB_SIZE - sbufReadIndex);
+    const uint32_t readIndex = head & AUDIO_SB_MASK;
+    const uint32_t firstHalfLen = MIN(filledBytes, CONFIG_SB_SIZE - readIndex);
     const uint32_t secondHalfLen = filledBytes - firstHalfLen;
-    const uint32_t endIndex = (sbufReadIndex + filledBytes) % CONFIG_SB_SIZE;
-
-    // printf("Len%d datasize: %d\n", len, (int)filledBytes);
-
-    Assert(sbufReadIndex < CONFIG_SB_SIZE && endIndex < CONFIG_SB_SIZE, "Index error");
 
     // Copy data from the circular buffer into the stream.
-    SDL_memcpy(stream, sbuf + sbufReadIndex, firstHalfLen);
+    SDL_memcpy(stream, sbuf + readIndex, firstHalfLen);
     SDL_memcpy(stream + firstHalfLen, sbuf, secondHalfLen);
 
-    // Update the read index and the count of audio data.
-    sbufReadIndex = endIndex;
-    audio_count -= filledBytes;
-    audio_stats_callbacks++;
-    audio_stats_played_bytes += filledBytes;
+    // Hand the consumed bytes back to the producer only after they are copied.
+    atomic_store_explicit(&sbuf_head, head + filledBytes, memory_order_release);
+    atomic_fetch_add_explicit(&audio_stats_callbacks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&audio_stats_played_bytes, filledBytes, memory_order_relaxed);
 
     if (missingBytes > 0)
     {
-        audio_stats_underrun_callbacks++;
-        audio_stats_underrun_bytes += missingBytes;
+        atomic_fetch_add_explicit(&audio_stats_underrun_callbacks, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&audio_stats_underrun_bytes, missingBytes, memory_order_relaxed);
     }
-    audio_note_count();
-    publish_audio_count();
 }
 #endif
 
-#ifndef CONFIG_AUDIO_DUMMY
-static bool audio_guest_read_chunk(vaddr_t addr, size_t wanted, uint8_t **host,
-                                   size_t *len)
+static void audio_guest_read(vaddr_t addr, void *buf, size_t len)
 {
-    if (wanted == 0)
+    size_t done = 0;
+
+    while (done < len)
     {
-        return false;
+        uint8_t *host = NULL;
+        size_t chunk = 0;
+        const vaddr_t cur = addr + (vaddr_t)done;
+        Assert(guest_read_chunk(cur, len - done, &host, &chunk),
+               "audio: cannot translate source vaddr=" FMT_WORD, (word_t)cur);
+        memcpy((uint8_t *)buf + done, host, chunk);
+        done += chunk;
     }
+}
 
-    paddr_t paddr = 0;
-    const int mmu = isa_mmu_check(addr, 1, MEM_TYPE_READ);
+static void audio_guest_write(vaddr_t addr, const void *buf, size_t len)
+{
+    size_t done = 0;
 
-    if (mmu == MMU_DIRECT)
-    {
-        paddr = (paddr_t)addr;
-    }
-    else if (mmu == MMU_TRANSLATE)
+    while (done < len)
     {
-        const paddr_t ret = isa_mmu_translate(addr, 1, MEM_TYPE_READ);
-
-        if ((ret & (paddr_t)AUDIO_PAGE_MASK) != MEM_RET_OK)
+        uint8_t *host = NULL;
+        size_t chunk = 0;
+        paddr_t paddr = 0;
+        const vaddr_t cur = addr + (vaddr_t)done;
+        Assert(guest_write_chunk(cur, len - done, &host, &chunk, &paddr),
+               "audio: cannot translate destination vaddr=" FMT_WORD, (word_t)cur);
+        memcpy(host, (const uint8_t *)buf + done, chunk);
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+        // Mixed samples land in PMEM behind paddr_write(), like VGA captures.
+        if (unlikely(isa_jit_invalidation_active))
         {
-            return false;
+            isa_jit_invalidate_paddr(paddr, (int)chunk);
         }
-        
-        paddr = (ret & ~(paddr_t)AUDIO_PAGE_MASK) | (paddr_t)(addr & AUDIO_PAGE_MASK);
-    }
-    else
-    {
-        return false;
-    }
-
-    if (!in_pmem(paddr))
-    {
-        return false;
-    }
-
-    size_t chunk = AUDIO_PAGE_SIZE - (size_t)(addr & AUDIO_PAGE_MASK);
-    const paddr_t pmem_end = (paddr_t)CONFIG_MBASE + (paddr_t)CONFIG_MSIZE;
-
-    if ((paddr_t)(paddr + chunk) > pmem_end)
-    {
-        chunk = (size_t)(pmem_end - paddr);
-    }
-
-    if (chunk > wanted)
-    {
-        chunk = wanted;
+#endif
+        done += chunk;
     }
-
-    *host = guest_to_host(paddr);
-    *len = chunk;
-    return chunk > 0;
 }
-#endif
 
 static void append_audio_bytes(vaddr_t src, uint32_t len)
 {
@@ -289,32 +292,31 @@ static void append_audio_bytes(vaddr_t src, uint32_t len)
            len, CONFIG_SB_SIZE);
     audio_stats_appends++;
     audio_stats_append_bytes += len;
-    audio_count = 0;
     publish_audio_count();
 #else
     /*
-     * The count register is a delta-commit interface.  NEMU, not AM, owns the
-     * live count because the host callback can consume bytes between two guest
-     * instructions.  Copy the whole guest chunk and publish the new count while
-     * the SDL audio lock is held, so producer and consumer never resurrect a
-     * stale occupancy value.
+     * NEMU, not AM, owns the live count because the host callback can consume
+     * bytes between two guest instructions.  The whole guest chunk is copied
+     * behind the tail first and committed with one release store, so the
+     * callback sees either none or all of it and the count read back by the
+     * guest is always tail - head.
      */
-    lock_audio_counter();
-    Assert(audio_count <= CONFIG_SB_SIZE,
+    const uint32_t tail = atomic_load_explicit(&sbuf_tail, memory_order_relaxed);
+    const uint32_t count = audio_ring_count();
+    Assert(count <= CONFIG_SB_SIZE,
            "Audio stream buffer count is invalid: count=%u size=%u",
-           audio_count, CONFIG_SB_SIZE);
-    Assert(len <= CONFIG_SB_SIZE - audio_count,
+           count, CONFIG_SB_SIZE);
+    Assert(len <= CONFIG_SB_SIZE - count,
            "Audio stream buffer overflow: count=%u append=%u size=%u",
-           audio_count, len, CONFIG_SB_SIZE);
+           count, len, CONFIG_SB_SIZE);
 
-    uint32_t writeIndex = (sbufReadIndex + audio_count) % CONFIG_SB_SIZE;
+    uint32_t writeIndex = tail & AUDIO_SB_MASK;
     size_t done = 0;
     while (done < len)
     {
         uint8_t *host = NULL;
         size_t src_chunk = 0;
-        Assert(audio_guest_read_chunk(src + (vaddr_t)done, (size_t)len - done,
-                                      &host, &src_chunk),
+        Assert(guest_read_chunk(src + (vaddr_t)done, (size_t)len - done, &host, &src_chunk),
                "audio: cannot translate bulk source vaddr=" FMT_WORD,
                (word_t)(src + (vaddr_t)done));
 
@@ -325,21 +327,399 @@ static void append_audio_bytes(vaddr_t src, uint32_t len)
             dst_chunk = src_chunk;
         }
         memcpy(sbuf + writeIndex, host, dst_chunk);
-        writeIndex = (writeIndex + dst_chunk) % CONFIG_SB_SIZE;
+        writeIndex = (writeIndex + dst_chunk) & AUDIO_SB_MASK;
         done += dst_chunk;
     }
 
-    audio_count += len;
+    atomic_store_explicit(&sbuf_tail, tail + len, memory_order_release);
     audio_stats_appends++;
     audio_stats_append_bytes += len;
     audio_note_count();
     publish_audio_count();
-    unlock_audio_counter();
 #endif
 
     audio_stats_maybe_print();
 }
 
+/*
+ * Hardware voices.  A voice keeps a guest pointer to its PCM and a 48.16
+ * fixed-point read position in source frames; it only advances when the guest
+ * asks for output with NEMU_AUDIO_OP_MIX, so the guest still paces playback
+ * through the stream buffer and no guest memory is touched off the CPU thread.
+ *
+ * Mixing runs in AUDIO_MIX_FRAMES passes over an int32 accumulator.  Each
+ * voice stages a contiguous run of source frames, already widened to int32
+ * left/right arrays, and the resampling loop is a linear interpolation over
+ * host arrays only.  Those loops are branch-free and left to the compiler's
+ * vectoriser; there are no hand-written intrinsics since NEMU builds on
+ * several host architectures.
+ */
+#define AUDIO_MIX_FRAMES 512u
+#define AUDIO_VOICE_STAGE 1024u
+#define AUDIO_MIX_BATCH 16u
+#define AUDIO_FRAC_BITS 16
+#define AUDIO_FRAC_ONE (1ull << AUDIO_FRAC_BITS)
+#define AUDIO_GAIN_BITS 15
+
+typedef struct
+{
+    bool active;
+    bool paused;
+    vaddr_t buf;
+    uint32_t frames;
+    uint32_t freq;
+    uint8_t format;
+    uint8_t channels;
+    int32_t loops;
+    int32_t gain_l; // Q15, volume and pan combined
+    int32_t gain_r;
+    int32_t gain_mono;
+    uint64_t pos;
+} AudioVoice;
+
+typedef struct
+{
+    uint32_t op;
+    uint16_t voice;
+    uint16_t volume;
+    uint64_t buf;
+    uint32_t len;
+    uint32_t freq;
+    uint8_t format;
+    uint8_t channels;
+    uint8_t pan_l;
+    uint8_t pan_r;
+    int32_t loops;
+} AudioMixCmd;
+
+_Static_assert(sizeof(AudioMixCmd) == NEMU_AUDIO_CMD_SIZE, "AudioMixCmd size mismatch");
+_Static_assert(offsetof(AudioMixCmd, buf) == NEMU_AUDIO_CMD_BUF, "AudioMixCmd layout mismatch");
+_Static_assert(offsetof(AudioMixCmd, format) == NEMU_AUDIO_CMD_FORMAT, "AudioMixCmd layout mismatch");
+_Static_assert(offsetof(AudioMixCmd, loops) == NEMU_AUDIO_CMD_LOOPS, "AudioMixCmd layout mismatch");
+
+static AudioVoice voices[NEMU_AUDIO_NR_VOICES];
+static uint32_t audio_out_freq = 0;
+static uint32_t audio_out_channels = 0;
+
+static int32_t mix_acc[AUDIO_MIX_FRAMES * 2];
+static int16_t mix_io[AUDIO_MIX_FRAMES * 2];
+static int16_t stage_raw[(AUDIO_VOICE_STAGE + 1) * 2];
+static int32_t stage_l[AUDIO_VOICE_STAGE + 1];
+static int32_t stage_r[AUDIO_VOICE_STAGE + 1];
+
+static uint32_t voice_frame_bytes(const AudioVoice *v)
+{
+    return (v->format == NEMU_AUDIO_FMT_U8 ? 1u : 2u) * v->channels;
+}
+
+static void publish_voice_active(void)
+{
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < NEMU_AUDIO_NR_VOICES; i++)
+    {
+        mask |= (uint32_t)voices[i].active << i;
+    }
+
+    audio_base[reg_voice_active] = mask;
+}
+
+static void reset_voices(void)
+{
+    memset(voices, 0, sizeof(voices));
+    publish_voice_active();
+}
+
+static void voice_set_gain(AudioVoice *v, uint32_t volume, uint32_t pan_l, uint32_t pan_r)
+{
+    /* volume * pan / (128 * 255) in Q15; a full-scale voice adds samples unchanged. */
+    const uint64_t scale = NEMU_AUDIO_MAX_VOLUME * 255u;
+    v->gain_l = (int32_t)(((uint64_t)volume * pan_l << AUDIO_GAIN_BITS) / scale);
+    v->gain_r = (int32_t)(((uint64_t)volume * pan_r << AUDIO_GAIN_BITS) / scale);
+    v->gain_mono = (int32_t)(((uint64_t)volume << AUDIO_GAIN_BITS) / NEMU_AUDIO_MAX_VOLUME);
+}
+
+/*
+ * Read source frames [first, first + count) into stage_l/stage_r, plus one
+ * neighbour frame for the interpolation: the next frame, the first frame when
+ * the voice loops, or the last frame repeated.
+ */
+static void voice_stage(const AudioVoice *v, uint32_t first, uint32_t count)
+{
+    const uint32_t frame_bytes = voice_frame_bytes(v);
+    uint8_t *raw = (uint8_t *)stage_raw;
+    audio_guest_read(v->buf + (vaddr_t)first * frame_bytes, raw, (size_t)count * frame_bytes);
+
+    if (first + count < v->frames)
+    {
+        audio_guest_read(v->buf + (vaddr_t)(first + count) * frame_bytes,
+                         raw + (size_t)count * frame_bytes, frame_bytes);
+    }
+    else if (v->loops != 0)
+    {
+        audio_guest_read(v->buf, raw + (size_t)count * frame_bytes, frame_bytes);
+    }
+    else
+    {
+        memcpy(raw + (size_t)count * frame_bytes, raw + (size_t)(count - 1) * frame_bytes,
+               frame_bytes);
+    }
+
+    const uint32_t n = count + 1;
+
+    if (v->format == NEMU_AUDIO_FMT_U8)
+    {
+        const uint8_t *src = raw;
+        const uint32_t ch = v->channels;
+        const uint32_t right = ch - 1;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            stage_l[i] = ((int32_t)src[i * ch] - 128) << 8;
+            stage_r[i] = ((int32_t)src[i * ch + right] - 128) << 8;
+        }
+    }
+    else if (v->channels == 2)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            stage_l[i] = stage_raw[2 * i];
+            stage_r[i] = stage_raw[2 * i + 1];
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            stage_l[i] = stage_raw[i];
+            stage_r[i] = stage_raw[i];
+        }
+    }
+}
+
+/* Add n output frames of one voice into mix_acc. */
+static void voice_mix(AudioVoice *v, uint32_t n)
+{
+    const uint64_t step = ((uint64_t)v->freq << AUDIO_FRAC_BITS) / audio_out_freq;
+    const uint64_t end = (uint64_t)v->frames << AUDIO_FRAC_BITS;
+    const uint64_t stage_span = (uint64_t)(AUDIO_VOICE_STAGE - 1) << AUDIO_FRAC_BITS;
+    uint32_t done = 0;
+
+    while (done < n)
+    {
+        if (v->pos >= end)
+        {
+            if (v->loops == 0)
+            {
+                v->active = false;
+                return;
+            }
+
+            if (v->loops > 0)
+            {
+                v->loops--;
+            }
+
+            v->pos -= end;
+            continue;
+        }
+
+        /* Output frames before the source runs out, and before the stage fills. */
+        const uint32_t first = (uint32_t)(v->pos >> AUDIO_FRAC_BITS);
+        const uint32_t frac0 = (uint32_t)(v->pos & (AUDIO_FRAC_ONE - 1));
+        uint64_t k = (end - v->pos + step - 1) / step;
+        const uint64_t fit = (stage_span - frac0 - 1) / step + 1;
+
+        if (k > fit)
+        {
+            k = fit;
+        }
+
+        if (k > n - done)
+        {
+            k = n - done;
+        }
+
+        const uint32_t last = (uint32_t)((v->pos + (k - 1) * step) >> AUDIO_FRAC_BITS);
+        voice_stage(v, first, last - first + 1);
+
+        int32_t *acc = mix_acc + (size_t)done * audio_out_channels;
+        if (audio_out_channels == 2)
+        {
+            const int32_t gl = v->gain_l;
+            const int32_t gr = v->gain_r;
+            for (uint32_t j = 0; j < (uint32_t)k; j++)
+            {
+                const uint32_t p = frac0 + (uint32_t)(j * step);
+                const uint32_t i = p >> AUDIO_FRAC_BITS;
+                const int32_t f = (int32_t)((p & (AUDIO_FRAC_ONE - 1)) >> 1);
+                const int32_t l = stage_l[i] + (((stage_l[i + 1] - stage_l[i]) * f) >> 15);
+                const int32_t r = stage_r[i] + (((stage_r[i + 1] - stage_r[i]) * f) >> 15);
+                acc[2 * j] += (l * gl) >> AUDIO_GAIN_BITS;
+                acc[2 * j + 1] += (r * gr) >> AUDIO_GAIN_BITS;
+            }
+        }
+        else
+        {
+            const int32_t gm = v->gain_mono;
+            for (uint32_t j = 0; j < (uint32_t)k; j++)
+            {
+                const uint32_t p = frac0 + (uint32_t)(j * step);
+                const uint32_t i = p >> AUDIO_FRAC_BITS;
+                const int32_t f = (int32_t)((p & (AUDIO_FRAC_ONE - 1)) >> 1);
+                const int32_t l = stage_l[i] + (((stage_l[i + 1] - stage_l[i]) * f) >> 15);
+                const int32_t r = stage_r[i] + (((stage_r[i + 1] - stage_r[i]) * f) >> 15);
+                acc[j] += (((l + r) >> 1) * gm) >> AUDIO_GAIN_BITS;
+            }
+        }
+
+        v->pos += k * step;
+        done += (uint32_t)k;
+    }
+}
+
+static void audio_mix_into_guest(vaddr_t dst, uint32_t frames)
+{
+    Assert(audio_started, "audio: mix before the stream is initialised");
+    const uint32_t ch = audio_out_channels;
+    Assert(ch == 1 || ch == 2, "audio: cannot mix voices into %u channels", ch);
+
+    for (uint32_t base = 0; base < frames; base += AUDIO_MIX_FRAMES)
+    {
+        const uint32_t n = MIN(frames - base, AUDIO_MIX_FRAMES);
+        const size_t bytes = (size_t)n * ch * sizeof(int16_t);
+        const vaddr_t cur = dst + (vaddr_t)((size_t)base * ch * sizeof(int16_t));
+        audio_guest_read(cur, mix_io, bytes);
+
+        for (uint32_t i = 0; i < n * ch; i++)
+        {
+            mix_acc[i] = mix_io[i];
+        }
+
+        for (uint32_t i = 0; i < NEMU_AUDIO_NR_VOICES; i++)
+        {
+            if (voices[i].active && !voices[i].paused)
+            {
+                voice_mix(&voices[i], n);
+            }
+        }
+
+        for (uint32_t i = 0; i < n * ch; i++)
+        {
+            const int32_t x = mix_acc[i];
+            mix_io[i] = (int16_t)(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+        }
+
+        audio_guest_write(cur, mix_io, bytes);
+    }
+}
+
+static void audio_run_mix_cmd(const AudioMixCmd *cmd)
+{
+    if (cmd->op == NEMU_AUDIO_OP_MIX)
+    {
+        audio_mix_into_guest((vaddr_t)cmd->buf, cmd->len);
+        return;
+    }
+
+    Assert(cmd->voice < NEMU_AUDIO_NR_VOICES, "audio: invalid voice %u", cmd->voice);
+    AudioVoice *v = &voices[cmd->voice];
+
+    switch (cmd->op)
+    {
+    case NEMU_AUDIO_OP_PLAY:
+    {
+        Assert((cmd->format == NEMU_AUDIO_FMT_U8 || cmd->format == NEMU_AUDIO_FMT_S16) &&
+                   (cmd->channels == 1 || cmd->channels == 2),
+               "audio: unsupported voice format %u/%u", cmd->format, cmd->channels);
+        Assert(cmd->volume <= NEMU_AUDIO_MAX_VOLUME, "audio: voice volume %u out of range",
+               cmd->volume);
+        /*
+         * The stage must hold every source frame one output frame can span,
+         * and the resampling step must not round down to zero.
+         */
+        Assert(((uint64_t)cmd->freq << AUDIO_FRAC_BITS) >= audio_out_freq &&
+                   (uint64_t)cmd->freq < (uint64_t)audio_out_freq * (AUDIO_VOICE_STAGE / 2),
+               "audio: voice rate %u Hz cannot be resampled to %u Hz", cmd->freq, audio_out_freq);
+
+        *v = (AudioVoice){
+            .buf = (vaddr_t)cmd->buf,
+            .freq = cmd->freq,
+            .format = cmd->format,
+            .channels = cmd->channels,
+            .loops = cmd->loops,
+        };
+        v->frames = cmd->len / voice_frame_bytes(v);
+        v->active = v->frames > 0;
+        voice_set_gain(v, cmd->volume, cmd->pan_l, cmd->pan_r);
+        break;
+    }
+
+    case NEMU_AUDIO_OP_STOP:
+    {
+        v->active = false;
+        break;
+    }
+
+    case NEMU_AUDIO_OP_PAUSE:
+    {
+        v->paused = true;
+        break;
+    }
+
+    case NEMU_AUDIO_OP_RESUME:
+    {
+        v->paused = false;
+        break;
+    }
+
+    case NEMU_AUDIO_OP_SET:
+    {
+        Assert(cmd->volume <= NEMU_AUDIO_MAX_VOLUME, "audio: voice volume %u out of range",
+               cmd->volume);
+        voice_set_gain(v, cmd->volume, cmd->pan_l, cmd->pan_r);
+        break;
+    }
+
+    default:
+    {
+        Assert(false, "audio: unsupported mixer command %u", cmd->op);
+        break;
+    }
+    }
+}
+
+static void audio_run_mix_cmds(vaddr_t cmds, uint32_t count)
+{
+    AudioMixCmd batch[AUDIO_MIX_BATCH];
+
+    for (uint32_t done = 0; done < count;)
+    {
+        const uint32_t n = MIN(count - done, AUDIO_MIX_BATCH);
+        audio_guest_read(cmds + (vaddr_t)done * sizeof(AudioMixCmd), batch, n * sizeof(AudioMixCmd));
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            audio_run_mix_cmd(&batch[i]);
+        }
+
+        done += n;
+    }
+
+    publish_voice_active();
+}
+
+#ifdef CONFIG_HAS_PLIC
+/*
+ * Low-watermark line: high while a started stream is at most a quarter full.
+ * It is only evaluated on the CPU thread, after guest appends and from
+ * device_update(); the SDL callback only advances sbuf_head.
+ */
+void audio_update_irq()
+{
+    dev_set_irq(NEMU_IRQ_AUDIO, audio_started && audio_ring_count() <= CONFIG_SB_SIZE / 4);
+}
+#endif
+
 static void audio_io_handler(uint32_t offset, int len, bool is_write)
 {
     const int reg = offset / sizeof(uint32_t);
@@ -372,7 +752,26 @@ static void audio_io_handler(uint32_t offset, int len, bool is_write)
 
             case reg_bulk_src:
             case reg_bulk_len:
+            case reg_mix_cmds_lo:
+            case reg_mix_cmds_hi:
+            case reg_mix_count:
+            case reg_voice_active:
+            {
+                break;
+            }
+
+            case reg_mix_doorbell:
             {
+                /*
+                 * One doorbell runs a whole batch of voice commands, so a
+                 * mixer callback costs a handful of MMIO exits instead of a
+                 * guest loop over every sample of every voice.
+                 */
+                Assert(val == NEMU_AUDIO_MIX_RUN, "Unsupported audio mixer command: %u", val);
+                const vaddr_t cmds = (vaddr_t)(((uint64_t)audio_base[reg_mix_cmds_hi] << 32) |
+                                               audio_base[reg_mix_cmds_lo]);
+                audio_run_mix_cmds(cmds, audio_base[reg_mix_count]);
+                audio_base[reg_mix_doorbell] = 0;
                 break;
             }
 
@@ -388,26 +787,26 @@ static void audio_io_handler(uint32_t offset, int len, bool is_write)
                 Assert(val <= CONFIG_SB_SIZE,
                     "Dummy audio append is larger than the stream buffer: append=%u size=%u",
                     val, CONFIG_SB_SIZE);
-                audio_count = 0;
                 publish_audio_count();
     #else
                 /*
                     * AM writes a delta: the number of bytes just copied into the
-                    * stream buffer.  Keeping the real occupancy in audio_count
-                    * avoids a race where the SDL callback drains bytes between a
-                    * guest count read and a later guest count write.  The mapped
-                    * register cell is only the public view returned to reads.
+                    * stream buffer behind the tail.  Advancing the tail instead
+                    * of storing an absolute count avoids a race where the SDL
+                    * callback drains bytes between a guest count read and a
+                    * later guest count write.  The mapped register cell is only
+                    * the public view returned to reads.
                     */
-                lock_audio_counter();
-                Assert(audio_count <= CONFIG_SB_SIZE,
+                const uint32_t count = audio_ring_count();
+                Assert(count <= CONFIG_SB_SIZE,
                     "Audio stream buffer count is invalid: count=%u size=%u",
-                    audio_count, CONFIG_SB_SIZE);
-                Assert(val <= CONFIG_SB_SIZE - audio_count,
+                    count, CONFIG_SB_SIZE);
+                Assert(val <= CONFIG_SB_SIZE - count,
                     "Audio stream buffer overflow: count=%u append=%u size=%u",
-                    audio_count, val, CONFIG_SB_SIZE);
-                audio_count += val;
+                    count, val, CONFIG_SB_SIZE);
+                atomic_fetch_add_explicit(&sbuf_tail, val, memory_order_release);
+                audio_note_count();
                 publish_audio_count();
-                unlock_audio_counter();
     #endif
                 break;
             }
@@ -436,6 +835,11 @@ static void audio_io_handler(uint32_t offset, int len, bool is_write)
 
                 close_audio_if_open();
                 reset_audio_stream();
+                reset_voices();
+                audio_started = true;
+                audio_bytes_per_sec = audio_base[reg_freq] * audio_base[reg_channels] * sizeof(int16_t);
+                audio_out_freq = audio_base[reg_freq];
+                audio_out_channels = audio_base[reg_channels];
 
     #ifndef CONFIG_AUDIO_DUMMY
                 spec.freq = audio_base[reg_freq];
@@ -478,6 +882,7 @@ static void audio_io_handler(uint32_t offset, int len, bool is_write)
             }
             }
 
+            IFDEF(CONFIG_HAS_PLIC, audio_update_irq());
             return;
         }
 
@@ -491,9 +896,7 @@ static void audio_io_handler(uint32_t offset, int len, bool is_write)
 
         case reg_count:
         {
-            lock_audio_counter();
             publish_audio_count();
-            unlock_audio_counter();
             break;
         }
 
@@ -533,6 +936,7 @@ void init_audio()
     // In AM, it will run as: init -> config -> ctrl.
     audio_base[reg_sbuf_size] = CONFIG_SB_SIZE;
     reset_audio_stream();
+    reset_voices();
 
 #ifndef CONFIG_AUDIO_DUMMY
     // Init subsystem in here before open device.
@@ -0,0 +1,135 @@
+#include <common.h>
+#include <utils.h>
+#include <isa.h>
+#include <isa-hart.h>
+#include <device/map.h>
+#include <device/intc.h>
+
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+
+/*
+ * Core-local interruptor.  mtime is host uptime in microseconds, the same clock
+ * the RTC reports, so NEMU_CLINT_TIMEBASE_HZ is fixed at 1 MHz.  Comparators
+ * are checked by clint_tick() from the device loop and on every mtimecmp write;
+ * MTIP is latched between those points, which is well inside one timer period.
+ */
+
+#define CLINT_MAX_HARTS NEMU_PLIC_MAX_CONTEXT
+#define CLINT_MTIMECMP_NONE UINT64_MAX
+
+static uint8_t *clint_base = NULL;
+static bool clint_mtip_line[CLINT_MAX_HARTS];
+
+static uint32_t *clint_msip_reg(int hart)
+{
+    return (uint32_t *)(clint_base + NEMU_CLINT_MSIP) + hart;
+}
+
+static uint64_t *clint_mtimecmp_reg(int hart)
+{
+    return (uint64_t *)(clint_base + NEMU_CLINT_MTIMECMP) + hart;
+}
+
+bool clint_msip(int hart)
+{
+    return (*clint_msip_reg(hart) & 1u) != 0;
+}
+
+bool clint_mtip(int hart)
+{
+    return clint_mtip_line[hart];
+}
+
+static void clint_update_mtip(int hart, uint64_t now_us)
+{
+    const bool level = now_us >= *clint_mtimecmp_reg(hart);
+
+    if (level && !clint_mtip_line[hart])
+    {
+        cpu.INTR = true;
+    }
+
+    clint_mtip_line[hart] = level;
+}
+
+void clint_tick(uint64_t now_us)
+{
+    for (int hart = 0; hart < isa_hart_count(); hart++)
+    {
+        clint_update_mtip(hart, now_us);
+    }
+}
+
+uint64_t clint_next_deadline_us()
+{
+    uint64_t deadline = CLINT_MTIMECMP_NONE;
+
+    for (int hart = 0; hart < isa_hart_count(); hart++)
+    {
+        const uint64_t cmp = *clint_mtimecmp_reg(hart);
+
+        if (isa_hart_running(hart) && cmp < deadline)
+        {
+            deadline = cmp;
+        }
+    }
+
+    return deadline;
+}
+
+static void clint_io_handler(uint32_t offset, int len, bool is_write)
+{
+    const uint32_t harts = (uint32_t)isa_hart_count();
+
+    if (offset >= NEMU_CLINT_MTIME)
+    {
+        /* mtime is read-only here: guests schedule with mtimecmp, not by rewinding the clock. */
+        *(uint64_t *)(clint_base + NEMU_CLINT_MTIME) = get_time();
+        return;
+    }
+
+    if (!is_write)
+    {
+        return;
+    }
+
+    if (offset >= NEMU_CLINT_MTIMECMP)
+    {
+        const uint32_t hart = (offset - NEMU_CLINT_MTIMECMP) / sizeof(uint64_t);
+
+        if (hart < harts)
+        {
+            clint_update_mtip(hart, get_time());
+        }
+        return;
+    }
+
+    const uint32_t hart = (offset - NEMU_CLINT_MSIP) / sizeof(uint32_t);
+
+    if (hart < harts)
+    {
+        *clint_msip_reg(hart) &= 1u;
+        if (clint_msip(hart))
+        {
+            cpu.INTR = true;
+        }
+    }
+}
+
+void init_clint()
+{
+    assert(isa_hart_count() <= CLINT_MAX_HARTS);
+
+    clint_base = new_space(NEMU_CLINT_MMIO_SIZE);
+    memset(clint_base, 0, NEMU_CLINT_MMIO_SIZE);
+    memset(clint_mtip_line, 0, sizeof(clint_mtip_line));
+
+    for (int hart = 0; hart < CLINT_MAX_HARTS; hart++)
+    {
+        *clint_mtimecmp_reg(hart) = CLINT_MTIMECMP_NONE;
+    }
+
+    add_mmio_map("clint", CONFIG_CLINT_MMIO, clint_base, NEMU_CLINT_MMIO_SIZE, clint_io_handler);
+}
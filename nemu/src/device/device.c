@@ -1,19 +1,28 @@
 #include <common.h>
 #include <utils.h>
 #include <device/alarm.h>
+#include <device/intc.h>
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
+#include <pthread.h>
 #endif
 
 void init_map();
 void init_serial();
+void serial_update();
 void init_timer();
 void init_vga();
 void init_i8042();
 void init_mouse();
 void init_audio();
 void init_disk();
+void init_virtio_blk();
+void virtio_blk_poll();
 void init_sdcard();
+void init_hartctl();
+void init_clint();
+void init_plic();
+void audio_update_irq();
 void init_alarm();
 
 void vga_translate_mouse_position(int *, int *);
@@ -23,98 +32,307 @@ void send_mouse_button(uint8_t, bool, int, int);
 void send_mouse_wheel(int, int);
 void vga_update_screen();
 
-void device_update()
+#ifndef CONFIG_TARGET_AM
+enum
 {
-    static uint64_t last = 0;
-    uint64_t now = get_time();
-    /*
-   * The CPU loop may execute a small batch of guest instructions before asking
-   * devices to poll host state.  This time gate keeps SDL and timer work close
-   * to TIMER_HZ while still allowing the interpreter/JIT loop to avoid a host
-   * syscall after every single guest instruction.
-   */
+    HOST_EVENT_QUIT,
+    HOST_EVENT_KEY,
+    HOST_EVENT_MOUSE_MOTION,
+    HOST_EVENT_MOUSE_BUTTON,
+    HOST_EVENT_MOUSE_WHEEL,
+};
 
-    if (now - last < 1000000 / TIMER_HZ)
-    {
-        return;
-    }
-    last = now;
+/*
+ * SDL events reduced to the fields the emulated devices consume.  Mouse
+ * positions are already translated into guest framebuffer coordinates, so a
+ * record can be produced on the thread that owns the renderer and consumed on
+ * the CPU thread without touching SDL again.
+ */
+typedef struct
+{
+    uint8_t type;
+    uint8_t code;
+    bool down;
+    int32_t x;
+    int32_t y;
+    uint32_t state;
+} HostEvent;
 
-    IFDEF(CONFIG_HAS_VGA, vga_update_screen());
+static bool host_event_from_sdl(const SDL_Event *event, HostEvent *out)
+{
+    memset(out, 0, sizeof(*out));
 
-#ifndef CONFIG_TARGET_AM
-    SDL_Event event;
-    while (SDL_PollEvent(&event))
+    switch (event->type)
     {
-        switch (event.type)
-        {
-        case SDL_QUIT:
-            nemu_state.state = NEMU_QUIT;
-            break;
+    case SDL_QUIT:
+        out->type = HOST_EVENT_QUIT;
+        return true;
 #ifdef CONFIG_HAS_KEYBOARD
-        // If a key was pressed
-        case SDL_KEYDOWN:
-        case SDL_KEYUP:
-        {
-            uint8_t k = event.key.keysym.scancode;
-            bool is_keydown = (event.key.type == SDL_KEYDOWN);
-            send_key(k, is_keydown);
-            break;
-        }
+    // If a key was pressed
+    case SDL_KEYDOWN:
+    case SDL_KEYUP:
+        out->type = HOST_EVENT_KEY;
+        out->code = event->key.keysym.scancode;
+        out->down = (event->key.type == SDL_KEYDOWN);
+        return true;
 #endif
 #ifdef CONFIG_HAS_MOUSE
-        case SDL_MOUSEMOTION:
-        {
-            int x = event.motion.x;
-            int y = event.motion.y;
+    case SDL_MOUSEMOTION:
+    {
+        int x = event->motion.x;
+        int y = event->motion.y;
 #ifdef CONFIG_HAS_VGA
-            /*
+        /*
          * SDL reports window coordinates.  The guest sees framebuffer
          * coordinates, which may differ when the visible window is scaled, so
          * translate before the event is queued in the emulated mouse device.
          */
-            vga_translate_mouse_position(&x, &y);
+        vga_translate_mouse_position(&x, &y);
 #endif
-            send_mouse_motion(x, y, event.motion.state);
-            break;
-        }
-        case SDL_MOUSEBUTTONDOWN:
-        case SDL_MOUSEBUTTONUP:
-        {
-            int x = event.button.x;
-            int y = event.button.y;
+        out->type = HOST_EVENT_MOUSE_MOTION;
+        out->x = x;
+        out->y = y;
+        out->state = event->motion.state;
+        return true;
+    }
+    case SDL_MOUSEBUTTONDOWN:
+    case SDL_MOUSEBUTTONUP:
+    {
+        int x = event->button.x;
+        int y = event->button.y;
 #ifdef CONFIG_HAS_VGA
-            /*
+        /*
          * Button events carry the pointer position at the time of the click.
          * Translate the position with the same rule as motion events so Navy's
          * /dev/events stream never mixes host-window and guest-screen axes.
          */
-            vga_translate_mouse_position(&x, &y);
+        vga_translate_mouse_position(&x, &y);
 #endif
-            send_mouse_button(event.button.button,
-                              event.button.type == SDL_MOUSEBUTTONDOWN,
-                              x, y);
-            break;
-        }
-        case SDL_MOUSEWHEEL:
-            /*
+        out->type = HOST_EVENT_MOUSE_BUTTON;
+        out->code = event->button.button;
+        out->down = (event->button.type == SDL_MOUSEBUTTONDOWN);
+        out->x = x;
+        out->y = y;
+        return true;
+    }
+    case SDL_MOUSEWHEEL:
+        /*
          * SDL2 wheel events do not carry a reliable cursor position.  The mouse
          * device therefore reuses the last translated motion/button position so
          * the downstream /dev/events record still has coordinates in guest space.
          */
-            send_mouse_wheel(event.wheel.x, event.wheel.y);
-            break;
+        out->type = HOST_EVENT_MOUSE_WHEEL;
+        out->x = event->wheel.x;
+        out->y = event->wheel.y;
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+static void host_event_dispatch(const HostEvent *event)
+{
+    switch (event->type)
+    {
+    case HOST_EVENT_QUIT:
+        nemu_state.state = NEMU_QUIT;
+        break;
+#ifdef CONFIG_HAS_KEYBOARD
+    case HOST_EVENT_KEY:
+        send_key(event->code, event->down);
+        break;
+#endif
+#ifdef CONFIG_HAS_MOUSE
+    case HOST_EVENT_MOUSE_MOTION:
+        send_mouse_motion(event->x, event->y, event->state);
+        break;
+    case HOST_EVENT_MOUSE_BUTTON:
+        send_mouse_button(event->code, event->down, event->x, event->y);
+        break;
+    case HOST_EVENT_MOUSE_WHEEL:
+        send_mouse_wheel(event->x, event->y);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+#endif
+
+#ifdef CONFIG_VGA_RENDER_THREAD
+#include <stdatomic.h>
+
+#define HOST_EVENT_QUEUE_SIZE 256u
+#define HOST_EVENT_QUEUE_MASK (HOST_EVENT_QUEUE_SIZE - 1u)
+
+/*
+ * Single-producer/single-consumer ring between the VGA display thread, which
+ * owns the SDL window and therefore the event pump, and the CPU thread, which
+ * owns every emulated device.  head is written only by the consumer and tail
+ * only by the producer, so release/acquire on the indices is all the
+ * synchronisation the slots need.
+ */
+static HostEvent host_event_queue[HOST_EVENT_QUEUE_SIZE];
+static _Atomic uint32_t host_event_head = 0;
+static _Atomic uint32_t host_event_tail = 0;
+
+bool device_queue_sdl_event(const SDL_Event *event)
+{
+    HostEvent host_event;
+
+    if (!host_event_from_sdl(event, &host_event))
+        return true;
+
+    const uint32_t tail = atomic_load_explicit(&host_event_tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&host_event_head, memory_order_acquire);
+
+    if (tail - head >= HOST_EVENT_QUEUE_SIZE)
+    {
+        /*
+         * The guest has not reached a device_update() for a whole queue worth
+         * of input.  Dropping is preferable to blocking the display thread:
+         * the keyboard and mouse devices have bounded queues of their own and
+         * would discard the overflow anyway.
+         */
+        return false;
+    }
+
+    host_event_queue[tail & HOST_EVENT_QUEUE_MASK] = host_event;
+    atomic_store_explicit(&host_event_tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void drain_host_events()
+{
+    uint32_t head = atomic_load_explicit(&host_event_head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&host_event_tail, memory_order_acquire);
+
+    while (head != tail)
+    {
+        host_event_dispatch(&host_event_queue[head & HOST_EVENT_QUEUE_MASK]);
+        head++;
+    }
+
+    atomic_store_explicit(&host_event_head, head, memory_order_release);
+}
 #endif
-        default:
-            break;
+
+static uint64_t device_last_update = 0;
+
+void device_update()
+{
+    uint64_t now = get_time();
+
+    /* Comparators and I/O completions are checked on every batch, not at TIMER_HZ. */
+    IFDEF(CONFIG_HAS_CLINT, clint_tick(now));
+    IFDEF(CONFIG_HAS_VIRTIO_BLK, virtio_blk_poll());
+
+    /*
+   * The CPU loop may execute a small batch of guest instructions before asking
+   * devices to poll host state.  This time gate keeps SDL and timer work close
+   * to TIMER_HZ while still allowing the interpreter/JIT loop to avoid a host
+   * syscall after every single guest instruction.
+   */
+
+    if (now - device_last_update < 1000000 / TIMER_HZ)
+    {
+        return;
+    }
+    device_last_update = now;
+
+    IFDEF(CONFIG_HAS_SERIAL, serial_update());
+    IFDEF(CONFIG_HAS_VGA, vga_update_screen());
+#if defined(CONFIG_HAS_AUDIO) && defined(CONFIG_HAS_PLIC)
+    audio_update_irq();
+#endif
+
+#if defined(CONFIG_VGA_RENDER_THREAD)
+    /*
+     * The display thread pumps SDL and has already translated the events;
+     * only the device-side delivery is left for the CPU thread.
+     */
+    drain_host_events();
+#elif !defined(CONFIG_TARGET_AM)
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        HostEvent host_event;
+
+        if (host_event_from_sdl(&event, &host_event))
+        {
+            host_event_dispatch(&host_event);
         }
     }
 #endif
 }
 
+#ifndef CONFIG_TARGET_AM
+/* Host I/O threads kick an idle CPU thread so a completion is not left waiting for the next poll. */
+static pthread_mutex_t device_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t device_idle_cond = PTHREAD_COND_INITIALIZER;
+static bool device_idle_kicked = false;
+
+void device_idle(uint64_t max_us)
+{
+    /*
+     * Nothing the guest can observe changes before the next host event poll or
+     * comparator deadline, so sleeping until the earlier of the two is
+     * indistinguishable from spinning, except for the host core it frees.
+     */
+    const uint64_t now = get_time();
+    uint64_t wake = device_last_update + 1000000 / TIMER_HZ;
+
+    if (wake > now && max_us < wake - now)
+    {
+        wake = now + max_us;
+    }
+
+#ifdef CONFIG_HAS_CLINT
+    const uint64_t deadline = clint_next_deadline_us();
+
+    if (deadline < wake)
+    {
+        wake = deadline;
+    }
+#endif
+
+    if (wake > now)
+    {
+        const uint64_t wake_host = get_real_time_us() + (wake - now);
+        const struct timespec deadline = {
+            .tv_sec = (time_t)(wake_host / 1000000),
+            .tv_nsec = (long)(wake_host % 1000000) * 1000,
+        };
+
+        pthread_mutex_lock(&device_idle_lock);
+        while (!device_idle_kicked &&
+               pthread_cond_timedwait(&device_idle_cond, &device_idle_lock, &deadline) == 0)
+        {
+        }
+        device_idle_kicked = false;
+        pthread_mutex_unlock(&device_idle_lock);
+    }
+
+    device_update();
+}
+
+void device_wakeup()
+{
+    pthread_mutex_lock(&device_idle_lock);
+    device_idle_kicked = true;
+    pthread_cond_signal(&device_idle_cond);
+    pthread_mutex_unlock(&device_idle_lock);
+}
+#endif
+
 void sdl_clear_event_queue()
 {
-#ifndef CONFIG_TARGET_AM
+#if defined(CONFIG_VGA_RENDER_THREAD)
+    atomic_store_explicit(&host_event_head,
+                          atomic_load_explicit(&host_event_tail, memory_order_acquire),
+                          memory_order_release);
+#elif !defined(CONFIG_TARGET_AM)
     SDL_Event event;
     while (SDL_PollEvent(&event))
         ;
@@ -133,7 +351,13 @@ void init_device()
     IFDEF(CONFIG_HAS_MOUSE, init_mouse());
     IFDEF(CONFIG_HAS_AUDIO, init_audio());
     IFDEF(CONFIG_HAS_DISK, init_disk());
+    IFDEF(CONFIG_HAS_VIRTIO_BLK, init_virtio_blk());
     IFDEF(CONFIG_HAS_SDCARD, init_sdcard());
+    IFDEF(CONFIG_HAS_HARTCTL, init_hartctl());
+    IFDEF(CONFIG_HAS_CLINT, init_clint());
+    IFDEF(CONFIG_HAS_PLIC, init_plic());
 
-    IFNDEF(CONFIG_TARGET_AM, init_alarm());
+#if !defined(CONFIG_TARGET_AM) && !defined(CONFIG_HAS_CLINT)
+    init_alarm();
+#endif
 }
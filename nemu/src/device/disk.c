@@ -4,6 +4,12 @@
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
 #include <isa-jit.h>
 #endif
+#ifdef CONFIG_HAS_PLIC
+#include <device/intc.h>
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+#endif
 
 #include <errno.h>
 #include <stdio.h>
@@ -13,6 +19,8 @@
 
 #define DISK_BLKSZ 512u
 #define DISK_CMD_GO 1u
+#define DISK_CMD_SGREAD 2u
+#define DISK_SG_MAX 1024u
 #define DISK_PATH_BUFSZ 4096
 #define DISK_SOURCE_BUFSZ 64
 #define PMEM_BASE CONFIG_MBASE
@@ -28,9 +36,23 @@ enum
     reg_blkno,
     reg_io_blkcnt,
     reg_cmd,
+    reg_irq, // 1 after a command completes; the guest writes 0 to acknowledge.
+    reg_sg,       // SGREAD: physical address of the DiskSgSeg array
+    reg_sg_count, // SGREAD: number of segments
     nr_reg,
 };
 
+/*
+ * One SGREAD segment.  The blocks of a request are streamed through the
+ * segments in order, so a Nanos read can land directly in the physical pages
+ * behind a user buffer instead of a kernel bounce buffer.
+ */
+typedef struct
+{
+    uint32_t addr;
+    uint32_t len;
+} DiskSgSeg;
+
 static uint32_t *disk_base = NULL;
 static FILE *disk_img = NULL;
 static uint8_t *disk_map = NULL;
@@ -204,10 +226,8 @@ static uint8_t *guest_buffer_to_host(uint32_t guest_addr, size_t bytes, paddr_t
     return guest_to_host(paddr);
 }
 
-static void read_blocks(uint8_t *buf, uint32_t blkno, uint32_t blkcnt)
+static void read_bytes(uint8_t *buf, size_t offset, size_t bytes)
 {
-    const size_t bytes = (size_t)blkcnt * DISK_BLKSZ;
-    const size_t offset = (size_t)blkno * DISK_BLKSZ;
     const size_t available = offset < disk_img_size
                                  ? (bytes < disk_img_size - offset ? bytes : disk_img_size - offset)
                                  : 0;
@@ -225,8 +245,8 @@ static void read_blocks(uint8_t *buf, uint32_t blkno, uint32_t blkcnt)
 
             size_t got = fread(buf, 1, available, disk_img);
             Assert(got == available,
-                   "disk: read failed at block %u count %u: %s",
-                   blkno, blkcnt, strerror(errno));
+                   "disk: read failed at offset %zu size %zu: %s",
+                   offset, bytes, strerror(errno));
             clearerr(disk_img);
         }
     }
@@ -243,6 +263,27 @@ static void read_blocks(uint8_t *buf, uint32_t blkno, uint32_t blkcnt)
     }
 }
 
+static void read_blocks(uint8_t *buf, uint32_t blkno, uint32_t blkcnt)
+{
+    read_bytes(buf, (size_t)blkno * DISK_BLKSZ, (size_t)blkcnt * DISK_BLKSZ);
+}
+
+/*
+ * Disk reads are DMA into guest PMEM, bypassing paddr_write(). If the guest
+ * loads code from the ramdisk, translated blocks covering that destination
+ * range must be invalidated just like ordinary self-modifying stores.
+ */
+static void invalidate_dma_range(paddr_t paddr, size_t bytes)
+{
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+    if (unlikely(isa_jit_invalidation_active))
+    {
+        Assert(bytes <= INT32_MAX, "disk: DMA read is too large for JIT invalidation");
+        isa_jit_invalidate_paddr(paddr, (int)bytes);
+    }
+#endif
+}
+
 static void write_blocks(const uint8_t *buf, uint32_t blkno, uint32_t blkcnt)
 {
     const size_t bytes = (size_t)blkcnt * DISK_BLKSZ;
@@ -301,25 +342,51 @@ static void do_blkio(void)
     else
     {
         read_blocks(buf, blkno, blkcnt);
-#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
-        /*
-        * Disk reads are DMA into guest PMEM, bypassing paddr_write(). If the guest
-        * loads code from the ramdisk, translated blocks covering that destination
-        * range must be invalidated just like ordinary self-modifying stores. The
-        * physical address returned by guest_buffer_to_host() is reused here so the
-        * JIT sees the same PMEM byte interval that the DMA copy just replaced.
-        */
-        if (unlikely(isa_jit_invalidation_active))
-        {
-            Assert(bytes <= INT32_MAX, "disk: DMA read is too large for JIT invalidation");
-            isa_jit_invalidate_paddr(dma_paddr, (int)bytes);
-        }
-#endif
+        invalidate_dma_range(dma_paddr, bytes);
     }
 
     disk_base[reg_ready] = 1;
 }
 
+static void do_sgread(void)
+{
+    Assert(disk_img != NULL, "disk: guest requested I/O but no image is present");
+
+    const uint32_t blkno = disk_base[reg_blkno];
+    const uint32_t blkcnt = disk_base[reg_io_blkcnt];
+    const uint32_t nseg = disk_base[reg_sg_count];
+    const size_t bytes = (size_t)blkcnt * DISK_BLKSZ;
+
+    Assert(blkcnt > 0, "disk: block count must be positive");
+    Assert(blkno <= disk_blkcnt && blkcnt <= disk_blkcnt - blkno,
+           "disk: block range [%u, %u) exceeds block count %u",
+           blkno, blkno + blkcnt, disk_blkcnt);
+    Assert(nseg > 0 && nseg <= DISK_SG_MAX, "disk: %u scatter-gather segments", nseg);
+
+    disk_base[reg_ready] = 0;
+    paddr_t list_paddr = 0;
+    const DiskSgSeg *segs = (const DiskSgSeg *)guest_buffer_to_host(disk_base[reg_sg],
+                                                                    nseg * sizeof(DiskSgSeg), &list_paddr);
+    size_t offset = (size_t)blkno * DISK_BLKSZ;
+    size_t done = 0;
+
+    for (uint32_t i = 0; i < nseg; i++)
+    {
+        const DiskSgSeg seg = segs[i];
+        Assert(seg.len <= bytes - done, "disk: scatter-gather segments exceed %zu bytes", bytes);
+
+        paddr_t paddr = 0;
+        uint8_t *buf = guest_buffer_to_host(seg.addr, seg.len, &paddr);
+        read_bytes(buf, offset, seg.len);
+        invalidate_dma_range(paddr, seg.len);
+        offset += seg.len;
+        done += seg.len;
+    }
+
+    Assert(done == bytes, "disk: scatter-gather segments cover %zu of %zu bytes", done, bytes);
+    disk_base[reg_ready] = 1;
+}
+
 static void disk_io_handler(uint32_t offset, int len, bool is_write)
 {
     Assert(offset % sizeof(uint32_t) == 0 && len == sizeof(uint32_t),
@@ -330,10 +397,24 @@ static void disk_io_handler(uint32_t offset, int len, bool is_write)
 
     if (is_write && reg == reg_cmd)
     {
-        Assert(disk_base[reg_cmd] == DISK_CMD_GO,
+        Assert(disk_base[reg_cmd] == DISK_CMD_GO || disk_base[reg_cmd] == DISK_CMD_SGREAD,
                "disk: unsupported command %u", disk_base[reg_cmd]);
-        do_blkio();
+        if (disk_base[reg_cmd] == DISK_CMD_GO)
+        {
+            do_blkio();
+        }
+        else
+        {
+            do_sgread();
+        }
         disk_base[reg_cmd] = 0;
+        disk_base[reg_irq] = 1;
+    }
+
+    if (is_write && (reg == reg_cmd || reg == reg_irq))
+    {
+        disk_base[reg_irq] = disk_base[reg_irq] != 0;
+        IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_DISK, disk_base[reg_irq]));
     }
 }
 
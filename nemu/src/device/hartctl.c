@@ -0,0 +1,58 @@
+#include <common.h>
+#include <device/map.h>
+#include <isa-hart.h>
+
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+
+static uint32_t *hartctl_base = NULL;
+
+static uint32_t hartctl_reg(uint32_t offset)
+{
+    return hartctl_base[offset / sizeof(uint32_t)];
+}
+
+static uint64_t hartctl_reg64(uint32_t low_offset)
+{
+    return (uint64_t)hartctl_reg(low_offset) |
+           ((uint64_t)hartctl_reg(low_offset + sizeof(uint32_t)) << 32);
+}
+
+static void hartctl_io_handler(uint32_t offset, int len, bool is_write)
+{
+    assert(offset < NEMU_HARTCTL_MMIO_SIZE);
+    assert(offset + len <= NEMU_HARTCTL_MMIO_SIZE);
+
+    const int id = (int)hartctl_reg(NEMU_HARTCTL_HARTID);
+
+    if (offset != NEMU_HARTCTL_CMD)
+        return;
+
+    if (!is_write)
+    {
+        hartctl_base[NEMU_HARTCTL_CMD / sizeof(uint32_t)] = isa_hart_running(id);
+        return;
+    }
+
+    if (hartctl_reg(NEMU_HARTCTL_CMD) != NEMU_HARTCTL_CMD_START)
+        return;
+
+    /*
+     * A start request for a running or nonexistent hart is ignored rather
+     * than treated as fatal; the guest sees the outcome by reading CMD back.
+     */
+    if (!isa_hart_start(id, (vaddr_t)hartctl_reg64(NEMU_HARTCTL_START_PC_LO),
+                        (word_t)hartctl_reg64(NEMU_HARTCTL_OPAQUE_LO)))
+    {
+        Log("hartctl: ignored start request for hart %d", id);
+    }
+}
+
+void init_hartctl()
+{
+    hartctl_base = (uint32_t *)new_space(NEMU_HARTCTL_MMIO_SIZE);
+    hartctl_base[NEMU_HARTCTL_NR_HARTS / sizeof(uint32_t)] = (uint32_t)isa_hart_count();
+    add_mmio_map("hartctl", CONFIG_HARTCTL_MMIO, hartctl_base, NEMU_HARTCTL_MMIO_SIZE,
+                 hartctl_io_handler);
+}
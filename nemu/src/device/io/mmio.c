@@ -1,24 +1,128 @@
 #include <device/map.h>
+#include <memory/host.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
 
 #define NR_MAP 16
 
+/*
+ * MMIO decoding is a two-level table over the 32-bit physical window.  Each
+ * first-level slot covers 4 MiB and is allocated only where a device lives;
+ * its second level holds one slot per 4 KiB page naming the map that owns the
+ * page.  A page shared by several small register blocks (0xa0000000 holds most
+ * of them) points at a split table with one slot per 4-byte granule instead.
+ * A lookup is two or three array loads however the guest interleaves the
+ * framebuffer, audio buffer and control registers.
+ */
+#define MMIO_WINDOW_BITS 32
+#define MMIO_L1_SHIFT 22
+#define MMIO_L1_SIZE (1u << (MMIO_WINDOW_BITS - MMIO_L1_SHIFT))
+#define MMIO_L2_SIZE (1u << (MMIO_L1_SHIFT - PAGE_SHIFT))
+#define MMIO_GRANULE 4u
+#define MMIO_SPLIT_SIZE (PAGE_SIZE / MMIO_GRANULE)
+#define MMIO_SPLIT_MAX 16
+#define MMIO_SLOT_SPLIT 0x80u
+
+/* 0: no device; 1..NR_MAP: map index + 1; MMIO_SLOT_SPLIT | n: split table n. */
+typedef uint8_t mmio_slot_t;
+
+_Static_assert(NR_MAP < MMIO_SLOT_SPLIT && MMIO_SPLIT_MAX <= MMIO_SLOT_SPLIT,
+               "MMIO slot encoding overflows");
+
 static IOMap maps[NR_MAP] = {};
 static int nr_map = 0;
-static IOMap *last_map = NULL;
+static mmio_slot_t *mmio_l1[MMIO_L1_SIZE];
+static mmio_slot_t mmio_split[MMIO_SPLIT_MAX][MMIO_SPLIT_SIZE];
+static int nr_split = 0;
 
-static IOMap *fetch_mmio_map(paddr_t addr)
+static mmio_slot_t *mmio_page_slot(paddr_t page)
 {
-    if (last_map != NULL && map_inside(last_map, addr))
+    mmio_slot_t **l2 = &mmio_l1[page >> MMIO_L1_SHIFT];
+
+    if (*l2 == NULL)
     {
-        difftest_skip_ref();
-        return last_map;
+        *l2 = calloc(MMIO_L2_SIZE, sizeof(mmio_slot_t));
+        assert(*l2 != NULL);
     }
 
-    int mapid = find_mapid_by_addr(maps, nr_map, addr);
+    return &(*l2)[(page >> PAGE_SHIFT) & (MMIO_L2_SIZE - 1u)];
+}
+
+/* Point the granules of `page` covered by maps[id] at that map. */
+static void mmio_split_fill(mmio_slot_t *split, paddr_t page, int id)
+{
+    const paddr_t low = maps[id].low > page ? maps[id].low : page;
+    const paddr_t high = maps[id].high < page + PAGE_SIZE - 1u ? maps[id].high : page + PAGE_SIZE - 1u;
+
+    Assert(low % MMIO_GRANULE == 0 && (high + 1u) % MMIO_GRANULE == 0,
+           "MMIO map '%s' shares a page but is not %u-byte aligned", maps[id].name, MMIO_GRANULE);
+
+    for (paddr_t addr = low; addr <= high; addr += MMIO_GRANULE)
+    {
+        split[(addr & PAGE_MASK) / MMIO_GRANULE] = (mmio_slot_t)(id + 1);
+    }
+}
+
+static void mmio_table_install(int id)
+{
+    const paddr_t low = maps[id].low;
+    const paddr_t high = maps[id].high;
+
+    for (paddr_t page = low & ~(paddr_t)PAGE_MASK;; page += PAGE_SIZE)
+    {
+        mmio_slot_t *slot = mmio_page_slot(page);
+
+        if (*slot == 0)
+        {
+            /*
+             * A lone map owns the whole page slot even when it covers only
+             * part of it; fetch_mmio_map() still checks the exact bounds.
+             */
+            *slot = (mmio_slot_t)(id + 1);
+        }
+        else
+        {
+            if ((*slot & MMIO_SLOT_SPLIT) == 0)
+            {
+                assert(nr_split < MMIO_SPLIT_MAX);
+                const int owner = *slot - 1;
+
+                *slot = (mmio_slot_t)(MMIO_SLOT_SPLIT | nr_split);
+                mmio_split_fill(mmio_split[nr_split++], page, owner);
+            }
+            mmio_split_fill(mmio_split[*slot & ~MMIO_SLOT_SPLIT], page, id);
+        }
 
-    last_map = mapid == -1 ? NULL : &maps[mapid];
-    return last_map;
+        if (high - page < PAGE_SIZE)
+            break;
+    }
+}
+
+static IOMap *fetch_mmio_map(paddr_t addr)
+{
+    if ((uint64_t)addr >> MMIO_WINDOW_BITS)
+        return NULL;
+
+    const mmio_slot_t *l2 = mmio_l1[addr >> MMIO_L1_SHIFT];
+
+    if (l2 == NULL)
+        return NULL;
+
+    mmio_slot_t slot = l2[(addr >> PAGE_SHIFT) & (MMIO_L2_SIZE - 1u)];
+
+    if (slot & MMIO_SLOT_SPLIT)
+        slot = mmio_split[slot & ~MMIO_SLOT_SPLIT][(addr & PAGE_MASK) / MMIO_GRANULE];
+
+    if (slot == 0)
+        return NULL;
+
+    IOMap *map = &maps[slot - 1];
+
+    if (!map_inside(map, addr))
+        return NULL;
+
+    difftest_skip_ref();
+    return map;
 }
 
 static void report_mmio_overlap(const char *name1, paddr_t l1, paddr_t r1,
@@ -29,9 +133,8 @@ static void report_mmio_overlap(const char *name1, paddr_t l1, paddr_t r1,
           name1, l1, r1, name2, l2, r2);
 }
 
-/* device interface */
-void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len,
-                  io_callback_t callback)
+static void add_mmio_map_kind(const char *name, paddr_t addr, void *space, uint32_t len,
+                              io_callback_t callback, map_kind_t kind)
 {
     assert(nr_map < NR_MAP);
     assert(len > 0);
@@ -39,6 +142,9 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len,
     const paddr_t left = addr;
     const paddr_t right = addr + len - 1u;
     assert(right >= left);
+    Assert(((uint64_t)right >> MMIO_WINDOW_BITS) == 0,
+           "MMIO region %s@[" FMT_PADDR ", " FMT_PADDR "] is outside the decoded window",
+           name, left, right);
 
     const paddr_t pmem_left = (paddr_t)CONFIG_MBASE;
     const paddr_t pmem_right = (paddr_t)CONFIG_MBASE + CONFIG_MSIZE;
@@ -69,22 +175,66 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len,
         .high = addr + len - 1,
         .space = space,
         .callback = callback,
+        .kind = kind,
     };
 
     Log("Add mmio map '%s' at [" FMT_PADDR ", " FMT_PADDR "]",
         maps[nr_map].name, maps[nr_map].low, maps[nr_map].high);
 
+    mmio_table_install(nr_map);
     nr_map++;
-    last_map = NULL;
+}
+
+/* device interface */
+void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len,
+                  io_callback_t callback)
+{
+    add_mmio_map_kind(name, addr, space, len, callback,
+                      callback != NULL ? MAP_CALLBACK : MAP_PASSIVE);
+}
+
+void add_mmio_map_notify(const char *name, paddr_t addr, void *space, uint32_t len,
+                         io_callback_t on_write)
+{
+    assert(on_write != NULL);
+    add_mmio_map_kind(name, addr, space, len, on_write, MAP_WRITE_NOTIFY);
+}
+
+/* Whether [addr, addr + len) lies in `map` and needs no callback before the access. */
+static bool mmio_plain_access(IOMap *map, paddr_t addr, int len, bool is_write)
+{
+#ifdef CONFIG_DTRACE
+    /* Tracing logs from map_read()/map_write(), so nothing may bypass them. */
+    return false;
+#else
+    return map != NULL && addr + (paddr_t)len - 1u <= map->high &&
+           (map->kind == MAP_PASSIVE || (map->kind == MAP_WRITE_NOTIFY && !is_write));
+#endif
 }
 
 /* bus interface */
 word_t mmio_read(paddr_t addr, int len)
 {
-    return map_read(addr, len, fetch_mmio_map(addr));
+    IOMap *map = fetch_mmio_map(addr);
+
+    if (mmio_plain_access(map, addr, len, false))
+    {
+        return host_read((uint8_t *)map->space + (addr - map->low), len);
+    }
+
+    return map_read(addr, len, map);
 }
 
 void mmio_write(paddr_t addr, int len, word_t data)
 {
-    map_write(addr, len, data, fetch_mmio_map(addr));
+    IOMap *map = fetch_mmio_map(addr);
+
+    if (mmio_plain_access(map, addr, len, true))
+    {
+        host_write((uint8_t *)map->space + (addr - map->low), len, data);
+        return;
+    }
+
+    /* WRITE_NOTIFY stores land here too: map_write() calls back after the store. */
+    map_write(addr, len, data, map);
 }
@@ -15,6 +15,12 @@
 
 #include <device/map.h>
 #include <utils.h>
+#ifdef CONFIG_HAS_PLIC
+#include <device/intc.h>
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+#endif
 
 #define KEYDOWN_MASK 0x8000
 
@@ -62,6 +68,7 @@ static void key_enqueue(uint32_t am_scancode)
     key_queue[key_r] = am_scancode;
     key_r = (key_r + 1) % KEY_QUEUE_LEN;
     Assert(key_r != key_f, "key queue overflow!");
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_KEYBOARD, true));
 }
 
 static uint32_t key_dequeue()
@@ -73,6 +80,8 @@ static uint32_t key_dequeue()
         key = key_queue[key_f];
         key_f = (key_f + 1) % KEY_QUEUE_LEN;
     }
+    /* The line stays high until the guest has drained every queued scancode. */
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_KEYBOARD, key_f != key_r));
     return key;
 }
 
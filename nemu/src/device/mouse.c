@@ -1,5 +1,11 @@
 #include <device/map.h>
 #include <utils.h>
+#ifdef CONFIG_HAS_PLIC
+#include <device/intc.h>
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+#endif
 #include <stdlib.h>
 #include <string.h>
 
@@ -138,6 +144,7 @@ static void mouse_enqueue(MouseEvent event)
     mouse_queue[mouse_r] = event;
     mouse_r = (mouse_r + 1) % MOUSE_QUEUE_LEN;
     mouse_count++;
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_MOUSE, true));
 }
 
 static MouseEvent mouse_dequeue(void)
@@ -150,6 +157,7 @@ static MouseEvent mouse_dequeue(void)
     MouseEvent event = mouse_queue[mouse_f];
     mouse_f = (mouse_f + 1) % MOUSE_QUEUE_LEN;
     mouse_count--;
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_MOUSE, mouse_count != 0));
     return event;
 }
 
@@ -0,0 +1,149 @@
+#include <common.h>
+#include <isa.h>
+#include <isa-hart.h>
+#include <device/map.h>
+#include <device/intc.h>
+
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+
+/*
+ * Platform-level interrupt controller with one M-mode context per hart.  Every
+ * NEMU source is level-triggered: a device drives its line with dev_set_irq()
+ * and keeps it high until the guest has consumed the condition.  A claimed
+ * source stays masked until the claim is completed, so a handler that has not
+ * yet drained the device is not re-entered for the same line.
+ */
+
+_Static_assert(NEMU_IRQ_NR <= 32, "PLIC pending/enable words hold 32 sources");
+
+static uint8_t *plic_base = NULL;
+static bool plic_level[NEMU_IRQ_NR];
+static bool plic_claimed[NEMU_IRQ_NR];
+
+static uint32_t *plic_reg(uint32_t offset)
+{
+    return (uint32_t *)(plic_base + offset);
+}
+
+static uint32_t plic_priority(int src)
+{
+    return *plic_reg(NEMU_PLIC_PRIORITY + src * sizeof(uint32_t)) & 0x7u;
+}
+
+static uint32_t plic_enable(int ctx)
+{
+    return *plic_reg(NEMU_PLIC_ENABLE + ctx * NEMU_PLIC_ENABLE_STRIDE);
+}
+
+static uint32_t *plic_context_reg(int ctx, uint32_t reg)
+{
+    return plic_reg(NEMU_PLIC_CONTEXT + ctx * NEMU_PLIC_CONTEXT_STRIDE + reg);
+}
+
+static bool plic_pending(int src)
+{
+    return plic_level[src] && !plic_claimed[src];
+}
+
+/* Highest-priority source that context `ctx` would take now, or 0. */
+static int plic_best(int ctx)
+{
+    const uint32_t enable = plic_enable(ctx);
+    const uint32_t threshold = *plic_context_reg(ctx, NEMU_PLIC_THRESHOLD);
+    uint32_t best_priority = threshold;
+    int best = 0;
+
+    for (int src = 1; src < NEMU_IRQ_NR; src++)
+    {
+        if (plic_pending(src) && (enable & (1u << src)) && plic_priority(src) > best_priority)
+        {
+            best_priority = plic_priority(src);
+            best = src;
+        }
+    }
+
+    return best;
+}
+
+bool plic_meip(int hart)
+{
+    return plic_best(hart) != 0;
+}
+
+void dev_set_irq(int src, bool level)
+{
+    assert(src > 0 && src < NEMU_IRQ_NR);
+
+    if (level && !plic_level[src] && !plic_claimed[src])
+    {
+        cpu.INTR = true;
+    }
+
+    plic_level[src] = level;
+}
+
+static void plic_io_handler(uint32_t offset, int len, bool is_write)
+{
+    if (offset >= NEMU_PLIC_CONTEXT)
+    {
+        const int ctx = (offset - NEMU_PLIC_CONTEXT) / NEMU_PLIC_CONTEXT_STRIDE;
+        const uint32_t reg = (offset - NEMU_PLIC_CONTEXT) % NEMU_PLIC_CONTEXT_STRIDE;
+
+        if (ctx >= isa_hart_count() || reg != NEMU_PLIC_CLAIM)
+        {
+            /* A threshold write may unmask a waiting source. */
+            cpu.INTR = cpu.INTR || is_write;
+            return;
+        }
+
+        uint32_t *claim = plic_context_reg(ctx, NEMU_PLIC_CLAIM);
+
+        if (!is_write)
+        {
+            *claim = plic_best(ctx);
+            if (*claim != 0)
+            {
+                plic_claimed[*claim] = true;
+            }
+            return;
+        }
+
+        /* Completion re-arms the gateway; a line that is still high fires again. */
+        if (*claim > 0 && *claim < NEMU_IRQ_NR && plic_claimed[*claim])
+        {
+            plic_claimed[*claim] = false;
+            cpu.INTR = cpu.INTR || plic_level[*claim];
+        }
+        return;
+    }
+
+    if (offset >= NEMU_PLIC_PENDING && offset < NEMU_PLIC_ENABLE)
+    {
+        uint32_t pending = 0;
+
+        for (int src = 1; src < NEMU_IRQ_NR; src++)
+        {
+            pending |= (uint32_t)plic_pending(src) << src;
+        }
+
+        *plic_reg(NEMU_PLIC_PENDING) = pending;
+        return;
+    }
+
+    /* Priority and enable writes may unmask a waiting source. */
+    cpu.INTR = cpu.INTR || is_write;
+}
+
+void init_plic()
+{
+    assert(isa_hart_count() <= NEMU_PLIC_MAX_CONTEXT);
+
+    plic_base = new_space(NEMU_PLIC_MMIO_SIZE);
+    memset(plic_base, 0, NEMU_PLIC_MMIO_SIZE);
+    memset(plic_level, 0, sizeof(plic_level));
+    memset(plic_claimed, 0, sizeof(plic_claimed));
+
+    add_mmio_map("plic", CONFIG_PLIC_MMIO, plic_base, NEMU_PLIC_MMIO_SIZE, plic_io_handler);
+}
@@ -1,45 +1,424 @@
+/* posix_openpt() and friends for the "pty" output backend. */
+#define _XOPEN_SOURCE 700
 #include <utils.h>
 #include <device/map.h>
+#include <device/intc.h>
+#include <isa.h>
+#include <memory/paddr.h>
+#ifndef CONFIG_TARGET_AM
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
 
 /* http://en.wikibooks.org/wiki/Serial_Programming/8250_UART_Programming */
 // NOTE: this is compatible to 16550
 
-#define CH_OFFSET 0
+#define SERIAL_TX_FIFO_SIZE 4096u
+#define SERIAL_RX_FIFO_SIZE 1024u
 
 static uint8_t *serial_base = NULL;
+static uint32_t *serial_bulk_base = NULL;
+
+#ifndef CONFIG_TARGET_AM
+/*
+ * Transmit FIFO.  Guest bytes collect here and reach the host with one write()
+ * when the FIFO fills, on every device poll and when NEMU stops, instead of
+ * one unbuffered stderr write per byte.  A terminal sink is also flushed at
+ * each newline so an interactive console still sees whole lines promptly.
+ */
+static char tx_fifo[SERIAL_TX_FIFO_SIZE];
+static uint32_t tx_len = 0;
+static int tx_fd = STDERR_FILENO;
+static bool tx_line_flush = false;
+static int pty_fd = -1;
+#endif
+
+/*
+ * Receive FIFO.  Without a host input source it simply stays empty, so
+ * polling guests see LSR.DR clear instead of a read panic.
+ */
+static uint8_t rx_fifo[SERIAL_RX_FIFO_SIZE];
+static uint32_t rx_head = 0;
+static uint32_t rx_count = 0;
+static bool rx_eof = false;
+
+#if defined(CONFIG_SERIAL_INPUT_FIFO) && !defined(CONFIG_TARGET_AM)
+static int rx_fd = -1;
+// rx_fd is our shared, blocking stdin: poll() it before every read().
+static bool rx_shared = false;
+static struct termios rx_saved_termios;
+static bool rx_restore_termios = false;
+#endif
+
+void serial_flush()
+{
+#ifndef CONFIG_TARGET_AM
+    uint32_t done = 0;
+
+    while (done < tx_len)
+    {
+        const ssize_t n = write(tx_fd, tx_fifo + done, tx_len - done);
+
+        if (n > 0)
+        {
+            done += (uint32_t)n;
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        /*
+         * A sink someone else made non-blocking (stderr shares its open file
+         * with the terminal) must not lose output; wait until it drains.
+         */
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && tx_fd != pty_fd)
+        {
+            struct pollfd pfd = {.fd = tx_fd, .events = POLLOUT};
+
+            if (poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+            {
+                continue;
+            }
+        }
+
+        // A pty with no reader: drop the output rather than stall the guest.
+        break;
+    }
+
+    tx_len = 0;
+#endif
+}
+
+static void serial_write_bytes(const char *buf, size_t len)
+{
+#ifdef CONFIG_TARGET_AM
+    for (size_t i = 0; i < len; i++)
+    {
+        putch(buf[i]);
+    }
+#else
+    bool newline = false;
+
+    while (len > 0)
+    {
+        size_t n = SERIAL_TX_FIFO_SIZE - tx_len;
+
+        if (n > len)
+        {
+            n = len;
+        }
+
+        memcpy(tx_fifo + tx_len, buf, n);
+        newline |= memchr(buf, '\n', n) != NULL;
+        tx_len += (uint32_t)n;
+        buf += n;
+        len -= n;
+
+        if (tx_len == SERIAL_TX_FIFO_SIZE)
+        {
+            serial_flush();
+        }
+    }
+
+    if (newline && tx_line_flush)
+    {
+        serial_flush();
+    }
+#endif
+}
 
 static void serial_putc(char ch)
 {
-    /*
-   * Serial output is NEMU's simplest host-visible device: guest byte writes are
-   * forwarded immediately, with no transmit FIFO or line-status register model.
-   */
-    MUXDEF(CONFIG_TARGET_AM, putch(ch), putc(ch, stderr));
+    serial_write_bytes(&ch, 1);
+}
+
+static void serial_bulk_write(vaddr_t src, uint32_t len)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        uint8_t *host = NULL;
+        size_t chunk = 0;
+        const vaddr_t cur = src + (vaddr_t)done;
+        Assert(guest_read_chunk(cur, len - done, &host, &chunk),
+               "serial: cannot translate bulk source vaddr=" FMT_WORD, (word_t)cur);
+        serial_write_bytes((const char *)host, chunk);
+        done += chunk;
+    }
+}
+
+static void serial_rx_poll()
+{
+#if defined(CONFIG_SERIAL_INPUT_FIFO) && !defined(CONFIG_TARGET_AM)
+    while (rx_fd >= 0 && !rx_eof && rx_count < SERIAL_RX_FIFO_SIZE)
+    {
+        if (rx_shared)
+        {
+            struct pollfd pfd = {.fd = rx_fd, .events = POLLIN};
+
+            if (poll(&pfd, 1, 0) <= 0)
+            {
+                break;
+            }
+        }
+
+        const uint32_t tail = (rx_head + rx_count) % SERIAL_RX_FIFO_SIZE;
+        uint32_t room = SERIAL_RX_FIFO_SIZE - rx_count;
+
+        if (room > SERIAL_RX_FIFO_SIZE - tail)
+        {
+            room = SERIAL_RX_FIFO_SIZE - tail;
+        }
+
+        const ssize_t n = read(rx_fd, rx_fifo + tail, room);
+
+        if (n > 0)
+        {
+            rx_count += (uint32_t)n;
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        // EIO is a pty whose last reader hung up; it may come back.
+        rx_eof = n == 0;
+        break;
+    }
+#endif
+}
+
+static uint8_t serial_lsr()
+{
+    uint8_t lsr = NEMU_SERIAL_LSR_THRE | NEMU_SERIAL_LSR_TEMT;
+
+    if (rx_count > 0)
+    {
+        lsr |= NEMU_SERIAL_LSR_DR;
+    }
+    else if (rx_eof)
+    {
+        lsr |= NEMU_SERIAL_LSR_BI;
+    }
+
+    return lsr;
+}
+
+static bool serial_rx_irq_pending()
+{
+    return (serial_base[NEMU_SERIAL_IER] & NEMU_SERIAL_IER_RDI) != 0 && (rx_count > 0 || rx_eof);
+}
+
+static void serial_update_irq()
+{
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_SERIAL, serial_rx_irq_pending()));
+}
+
+void serial_update()
+{
+    serial_flush();
+    serial_rx_poll();
+    serial_update_irq();
 }
 
 static void serial_io_handler(uint32_t offset, int len, bool is_write)
 {
     assert(len == 1);
+
+    if (is_write)
+    {
+        switch (offset)
+        {
+        /* We bind the serial port with the host console in NEMU. */
+        case NEMU_SERIAL_THR:
+            serial_putc(serial_base[NEMU_SERIAL_THR]);
+            break;
+        case NEMU_SERIAL_IER:
+            serial_base[NEMU_SERIAL_IER] &= 0x0f;
+            serial_update_irq();
+            break;
+        default:
+            // FCR, LCR, MCR and SCR only hold what the guest stored.
+            break;
+        }
+        return;
+    }
+
     switch (offset)
     {
-    /* We bind the serial port with the host stderr in NEMU. */
-    case CH_OFFSET:
-        if (is_write)
-            serial_putc(serial_base[0]);
-        else
-            panic("do not support read");
+    case NEMU_SERIAL_RBR:
+        if (rx_count == 0)
+        {
+            serial_rx_poll();
+        }
+
+        serial_base[NEMU_SERIAL_RBR] = 0;
+        if (rx_count > 0)
+        {
+            serial_base[NEMU_SERIAL_RBR] = rx_fifo[rx_head];
+            rx_head = (rx_head + 1) % SERIAL_RX_FIFO_SIZE;
+            rx_count--;
+        }
+        serial_update_irq();
+        break;
+    case NEMU_SERIAL_IIR:
+        serial_base[NEMU_SERIAL_IIR] = NEMU_SERIAL_IIR_FIFO |
+                                       (serial_rx_irq_pending() ? NEMU_SERIAL_IIR_RDI : NEMU_SERIAL_IIR_NONE);
+        break;
+    case NEMU_SERIAL_LSR:
+        // A guest spinning on LSR.DR should not wait for the next device poll.
+        if (rx_count == 0)
+        {
+            serial_rx_poll();
+        }
+
+        serial_base[NEMU_SERIAL_LSR] = serial_lsr();
         break;
     default:
-        panic("do not support offset = %d", offset);
+        break;
+    }
+}
+
+static void serial_bulk_io_handler(uint32_t offset, int len, bool is_write)
+{
+    Assert(len == 4 && offset % 4 == 0 && offset < NEMU_SERIAL_BULK_MMIO_SIZE,
+           "serial: unsupported bulk register access offset=%u len=%d", offset, len);
+
+    if (!is_write || offset != NEMU_SERIAL_BULK_CMD)
+    {
+        return;
+    }
+
+    const uint32_t cmd = serial_bulk_base[NEMU_SERIAL_BULK_CMD / 4];
+    Assert(cmd == NEMU_SERIAL_BULK_CMD_WRITE, "serial: unsupported bulk command %u", cmd);
+    const vaddr_t src = (vaddr_t)(((uint64_t)serial_bulk_base[NEMU_SERIAL_BULK_SRC_HI / 4] << 32) |
+                                  serial_bulk_base[NEMU_SERIAL_BULK_SRC_LO / 4]);
+    serial_bulk_write(src, serial_bulk_base[NEMU_SERIAL_BULK_LEN / 4]);
+    serial_bulk_base[NEMU_SERIAL_BULK_CMD / 4] = 0;
+}
+
+#ifndef CONFIG_TARGET_AM
+static int serial_open_pty()
+{
+    if (pty_fd < 0)
+    {
+        pty_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        Assert(pty_fd >= 0 && grantpt(pty_fd) == 0 && unlockpt(pty_fd) == 0,
+               "serial: cannot open a pty: %s", strerror(errno));
+        Log("serial: console on %s", ptsname(pty_fd));
+    }
+
+    return pty_fd;
+}
+
+static void serial_open_output()
+{
+    const char *path = CONFIG_SERIAL_OUTPUT;
+
+    if (path[0] == '\0')
+    {
+        tx_fd = STDERR_FILENO;
+    }
+    else if (strcmp(path, "pty") == 0)
+    {
+        tx_fd = serial_open_pty();
     }
+    else
+    {
+        tx_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        Assert(tx_fd >= 0, "serial: cannot open %s: %s", path, strerror(errno));
+    }
+
+    tx_line_flush = isatty(tx_fd);
+    atexit(serial_flush);
 }
+#endif
+
+#if defined(CONFIG_SERIAL_INPUT_FIFO) && !defined(CONFIG_TARGET_AM)
+static void serial_restore_input()
+{
+    if (rx_restore_termios)
+    {
+        tcsetattr(rx_fd, TCSANOW, &rx_saved_termios);
+    }
+}
+
+static void serial_open_input()
+{
+    const char *path = CONFIG_SERIAL_INPUT;
+
+    if (strcmp(path, "pty") == 0)
+    {
+        rx_fd = serial_open_pty();
+        return;
+    }
+
+    if (strcmp(path, "stdin") == 0)
+    {
+        /*
+         * O_NONBLOCK would land on the open file stdin shares with stdout,
+         * stderr and the sdb prompt, so leave it blocking and poll instead.
+         */
+        rx_fd = STDIN_FILENO;
+        rx_shared = true;
+
+        // Hand keystrokes to the guest as they are typed; the guest echoes.
+        if (isatty(rx_fd) && tcgetattr(rx_fd, &rx_saved_termios) == 0)
+        {
+            struct termios raw = rx_saved_termios;
+            raw.c_lflag &= ~(ICANON | ECHO);
+            rx_restore_termios = tcsetattr(rx_fd, TCSANOW, &raw) == 0;
+            atexit(serial_restore_input);
+        }
+        return;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        Assert(mkfifo(path, 0644) == 0, "serial: cannot create %s: %s", path, strerror(errno));
+        Assert(stat(path, &st) == 0, "serial: cannot stat %s", path);
+    }
+
+    // Holding the write end of a named pipe ourselves means writers may come and go.
+    rx_fd = open(path, (S_ISFIFO(st.st_mode) ? O_RDWR : O_RDONLY) | O_NONBLOCK | O_CLOEXEC);
+    Assert(rx_fd >= 0, "serial: cannot open %s: %s", path, strerror(errno));
+    Log("serial: input from %s", path);
+}
+#endif
 
 void init_serial()
 {
-    serial_base = new_space(8);
+    serial_base = new_space(NEMU_SERIAL_NR_PORTS);
 #ifdef CONFIG_HAS_PORT_IO
-    add_pio_map("serial", CONFIG_SERIAL_PORT, serial_base, 8, serial_io_handler);
+    add_pio_map("serial", CONFIG_SERIAL_PORT, serial_base, NEMU_SERIAL_NR_PORTS, serial_io_handler);
 #else
-    add_mmio_map("serial", CONFIG_SERIAL_MMIO, serial_base, 8, serial_io_handler);
+    add_mmio_map("serial", CONFIG_SERIAL_MMIO, serial_base, NEMU_SERIAL_NR_PORTS, serial_io_handler);
+#endif
+
+    serial_bulk_base = (uint32_t *)new_space(NEMU_SERIAL_BULK_MMIO_SIZE);
+    add_mmio_map("serial-bulk", CONFIG_SERIAL_BULK_MMIO, serial_bulk_base,
+                 NEMU_SERIAL_BULK_MMIO_SIZE, serial_bulk_io_handler);
+
+#ifndef CONFIG_TARGET_AM
+    serial_open_output();
+#endif
+#if defined(CONFIG_SERIAL_INPUT_FIFO) && !defined(CONFIG_TARGET_AM)
+    serial_open_input();
 #endif
 }
@@ -1,6 +1,7 @@
 #include <device/map.h>
 #include <device/alarm.h>
 #include <utils.h>
+#include <isa.h>
 
 static uint32_t *rtc_port_base = NULL;
 
@@ -28,6 +29,44 @@ static void publish_realtime()
     publish_u64(RTC_EPOCH_US_LO, us);
 }
 
+#ifdef CONFIG_RTC_IDLE_POLL
+/*
+ * A read that follows the previous one within RTC_POLL_GAP_US looks like a
+ * wait loop; after RTC_POLL_STREAK of them in a row, each further read idles
+ * the host for up to RTC_POLL_SLEEP_US.  The gap is measured from the end of
+ * the previous read, so a loop keeps its streak across sleeps, while any real
+ * work between reads resets it.  A pending interrupt is never slept through.
+ */
+#define RTC_POLL_GAP_US 20
+#define RTC_POLL_STREAK 64
+#define RTC_POLL_SLEEP_US 500
+
+static uint64_t rtc_poll_last = 0;
+static uint32_t rtc_poll_streak = 0;
+
+static uint64_t rtc_poll_uptime()
+{
+    uint64_t now = get_time();
+
+    if (now - rtc_poll_last > RTC_POLL_GAP_US)
+    {
+        rtc_poll_streak = 0;
+    }
+    else if (rtc_poll_streak < RTC_POLL_STREAK)
+    {
+        rtc_poll_streak++;
+    }
+    else if (!cpu.INTR)
+    {
+        device_idle(RTC_POLL_SLEEP_US);
+        now = get_time();
+    }
+
+    rtc_poll_last = now;
+    return now;
+}
+#endif
+
 static void rtc_io_handler(uint32_t offset, int len, bool is_write)
 {
     assert(offset < RTC_MMIO_SIZE);
@@ -43,7 +82,7 @@ static void rtc_io_handler(uint32_t offset, int len, bool is_write)
          * low word is read so guests that read low then high observe one coherent
          * 64-bit microsecond timestamp.
          */
-        publish_u64(RTC_UPTIME_US_LO, get_time());
+        publish_u64(RTC_UPTIME_US_LO, MUXDEF(CONFIG_RTC_IDLE_POLL, rtc_poll_uptime(), get_time()));
     }
     else if (offset == RTC_EPOCH_SEC_LO || offset == RTC_EPOCH_US_LO)
     {
@@ -56,7 +95,7 @@ static void rtc_io_handler(uint32_t offset, int len, bool is_write)
     }
 }
 
-#ifndef CONFIG_TARGET_AM
+#if !defined(CONFIG_TARGET_AM) && !defined(CONFIG_HAS_CLINT)
 static void timer_intr()
 {
     if (nemu_state.state == NEMU_RUNNING)
@@ -80,5 +119,8 @@ void init_timer()
 #else
     add_mmio_map("rtc", CONFIG_RTC_MMIO, rtc_port_base, RTC_MMIO_SIZE, rtc_io_handler);
 #endif
-    IFNDEF(CONFIG_TARGET_AM, add_alarm_handle(timer_intr));
+#if !defined(CONFIG_TARGET_AM) && !defined(CONFIG_HAS_CLINT)
+    /* With a CLINT the guest programs mtimecmp itself; no host signal is needed. */
+    add_alarm_handle(timer_intr);
+#endif
 }
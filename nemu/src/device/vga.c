@@ -1,11 +1,14 @@
 #include <common.h>
 #include <device/map.h>
+#include <device/vga.h>
 #include <isa.h>
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
 #include <isa-jit.h>
 #endif
+#include <memory/host.h>
 #include <memory/paddr.h>
 #include <utils.h>
+#include <stddef.h>
 
 #define NEMU_PLATFORM_CONSTANTS_ONLY
 #include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
@@ -13,9 +16,7 @@
 
 #define SCREEN_W (MUXDEF(CONFIG_VGA_SIZE_800x600, 800, 400))
 #define SCREEN_H (MUXDEF(CONFIG_VGA_SIZE_800x600, 600, 300))
-#define VGACTL_NR_REGS 8u
-#define VGA_PAGE_SIZE 4096u
-#define VGA_PAGE_MASK (VGA_PAGE_SIZE - 1u)
+#define VGACTL_NR_REGS NEMU_VGACTL_NR_REGS
 
 static uint32_t screen_width()
 {
@@ -33,12 +34,24 @@ static uint32_t screen_size()
 }
 
 static void *vmem = NULL;
+uint32_t vga_vmem_size = 0;
 static uint32_t *vgactl_port_base = NULL;
+
+/*
+ * Dirty state is one bit per scanline plus a shared column span.  Rows that
+ * were not written since the last SYNC are never copied or uploaded, so a
+ * frame that touches a status line and a sprite far below it no longer pays
+ * for every row in between.  dirty_y0/dirty_y1 bound the set rows so the scan
+ * at SYNC time does not walk the whole bitmap.
+ */
+#define VGA_DIRTY_WORDS ((NEMU_MAX_SCREEN_H + 63) / 64)
+
 static bool vmem_dirty = false;
 static int dirty_x0 = 0;
 static int dirty_y0 = 0;
 static int dirty_x1 = 0;
 static int dirty_y1 = 0;
+static uint64_t dirty_rows[VGA_DIRTY_WORDS];
 
 static void mark_vmem_dirty_rect(int x0, int y0, int x1, int y1);
 
@@ -211,105 +224,6 @@ static void vga_fps_count_blit(uint64_t bytes)
 }
 #endif
 
-static bool vga_guest_read_chunk(vaddr_t addr, size_t wanted, uint8_t **host,
-                                 size_t *len)
-{
-    if (wanted == 0)
-        return false;
-
-    paddr_t paddr = 0;
-    const int mmu = isa_mmu_check(addr, 1, MEM_TYPE_READ);
-
-    if (mmu == MMU_DIRECT)
-    {
-        paddr = (paddr_t)addr;
-    }
-    else if (mmu == MMU_TRANSLATE)
-    {
-        const paddr_t ret = isa_mmu_translate(addr, 1, MEM_TYPE_READ);
-
-        if ((ret & (paddr_t)VGA_PAGE_MASK) != MEM_RET_OK)
-        {
-            return false;
-        }
-        paddr = (ret & ~(paddr_t)VGA_PAGE_MASK) | (paddr_t)(addr & VGA_PAGE_MASK);
-    }
-    else
-    {
-        return false;
-    }
-
-    if (!in_pmem(paddr))
-        return false;
-
-    size_t chunk = VGA_PAGE_SIZE - (size_t)(addr & VGA_PAGE_MASK);
-    const paddr_t pmem_end = (paddr_t)CONFIG_MBASE + (paddr_t)CONFIG_MSIZE;
-
-    if ((paddr_t)(paddr + chunk) > pmem_end)
-    {
-        chunk = (size_t)(pmem_end - paddr);
-    }
-
-    if (chunk > wanted)
-    {
-        chunk = wanted;
-    }
-
-    *host = guest_to_host(paddr);
-    *len = chunk;
-    return chunk > 0;
-}
-
-static bool vga_guest_write_chunk(vaddr_t addr, size_t wanted, uint8_t **host,
-                                  size_t *len, paddr_t *paddr_out)
-{
-    if (wanted == 0)
-        return false;
-
-    paddr_t paddr = 0;
-    const int mmu = isa_mmu_check(addr, 1, MEM_TYPE_WRITE);
-
-    if (mmu == MMU_DIRECT)
-    {
-        paddr = (paddr_t)addr;
-    }
-    else if (mmu == MMU_TRANSLATE)
-    {
-        const paddr_t ret = isa_mmu_translate(addr, 1, MEM_TYPE_WRITE);
-
-        if ((ret & (paddr_t)VGA_PAGE_MASK) != MEM_RET_OK)
-        {
-            return false;
-        }
-        paddr = (ret & ~(paddr_t)VGA_PAGE_MASK) | (paddr_t)(addr & VGA_PAGE_MASK);
-    }
-    else
-    {
-        return false;
-    }
-
-    if (!in_pmem(paddr))
-        return false;
-
-    size_t chunk = VGA_PAGE_SIZE - (size_t)(addr & VGA_PAGE_MASK);
-    const paddr_t pmem_end = (paddr_t)CONFIG_MBASE + (paddr_t)CONFIG_MSIZE;
-
-    if ((paddr_t)(paddr + chunk) > pmem_end)
-    {
-        chunk = (size_t)(pmem_end - paddr);
-    }
-
-    if (chunk > wanted)
-    {
-        chunk = wanted;
-    }
-
-    *host = guest_to_host(paddr);
-    *len = chunk;
-    *paddr_out = paddr;
-    return chunk > 0;
-}
-
 static void vga_blit_from_guest(vaddr_t src, int x, int y, int w, int h)
 {
     if (src == 0 || w <= 0 || h <= 0)
@@ -341,7 +255,7 @@ static void vga_blit_from_guest(vaddr_t src, int x, int y, int w, int h)
             size_t chunk = 0;
             const vaddr_t cur = row_src + (vaddr_t)done;
             const size_t remain = row_bytes - done;
-            Assert(vga_guest_read_chunk(cur, remain, &host, &chunk),
+            Assert(guest_read_chunk(cur, remain, &host, &chunk),
                    "vga: cannot translate blit source vaddr=" FMT_WORD,
                    (word_t)cur);
             memcpy(dst + done, host, chunk);
@@ -353,29 +267,35 @@ static void vga_blit_from_guest(vaddr_t src, int x, int y, int w, int h)
     vga_fps_count_blit((uint64_t)row_bytes * (uint64_t)h);
 }
 
-static void vga_capture_to_guest(vaddr_t dst)
+static void vga_guest_read(vaddr_t addr, void *buf, size_t len)
 {
-    Assert(dst != 0, "vga: null capture destination");
+    size_t done = 0;
 
-    /*
-     * Capture is deliberately host-side: NEMU already owns the authoritative
-     * hidden framebuffer, so copying it here avoids a guest loop that would spend
-     * one instruction stream on a full-screen memcpy whenever nanos-lite switches
-     * away from a stale foreground app.
-     */
+    while (done < len)
+    {
+        uint8_t *host = NULL;
+        size_t chunk = 0;
+        const vaddr_t cur = addr + (vaddr_t)done;
+        Assert(guest_read_chunk(cur, len - done, &host, &chunk),
+               "vga: cannot translate source vaddr=" FMT_WORD, (word_t)cur);
+        memcpy((uint8_t *)buf + done, host, chunk);
+        done += chunk;
+    }
+}
+
+static void vga_guest_write(vaddr_t addr, const void *buf, size_t len)
+{
     size_t done = 0;
-    const size_t bytes = screen_size();
-    while (done < bytes)
+
+    while (done < len)
     {
         uint8_t *host = NULL;
         size_t chunk = 0;
         paddr_t paddr = 0;
-        const vaddr_t cur = dst + (vaddr_t)done;
-        const size_t remain = bytes - done;
-        Assert(vga_guest_write_chunk(cur, remain, &host, &chunk, &paddr),
-               "vga: cannot translate capture destination vaddr=" FMT_WORD,
-               (word_t)cur);
-        memcpy(host, (const uint8_t *)vmem + done, chunk);
+        const vaddr_t cur = addr + (vaddr_t)done;
+        Assert(guest_write_chunk(cur, len - done, &host, &chunk, &paddr),
+               "vga: cannot translate destination vaddr=" FMT_WORD, (word_t)cur);
+        memcpy(host, (const uint8_t *)buf + done, chunk);
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
         /*
          * The device writes guest PMEM directly, bypassing paddr_write().  If the
@@ -385,7 +305,7 @@ static void vga_capture_to_guest(vaddr_t dst)
          */
         if (unlikely(isa_jit_invalidation_active))
         {
-            Assert(chunk <= INT32_MAX, "vga: capture chunk is too large for JIT invalidation");
+            Assert(chunk <= INT32_MAX, "vga: write chunk is too large for JIT invalidation");
             isa_jit_invalidate_paddr(paddr, (int)chunk);
         }
 #endif
@@ -393,6 +313,541 @@ static void vga_capture_to_guest(vaddr_t dst)
     }
 }
 
+static void vga_capture_to_guest(vaddr_t dst)
+{
+    Assert(dst != 0, "vga: null capture destination");
+
+    /*
+     * Capture is deliberately host-side: NEMU already owns the authoritative
+     * hidden framebuffer, so copying it here avoids a guest loop that would spend
+     * one instruction stream on a full-screen memcpy whenever nanos-lite switches
+     * away from a stale foreground app.
+     */
+    vga_guest_write(dst, vmem, screen_size());
+}
+
+/*
+ * 2D command queue.  Commands are read from the guest ring and executed one
+ * row at a time: a framebuffer row is used in place, a guest row is staged in
+ * a host buffer so that rows straddling a page boundary (or living in user
+ * memory under paging) need one translation per page rather than per pixel.
+ * The per-row kernels are plain loops over host buffers with no pixel-level
+ * branches, which is the shape the compiler vectorises.
+ */
+typedef struct
+{
+    uint32_t op;
+    uint32_t flags;
+    uint64_t dst;
+    uint64_t src;
+    uint64_t aux;
+    uint32_t dst_pitch;
+    uint32_t src_pitch;
+    uint16_t dst_x, dst_y, dst_w, dst_h;
+    uint16_t src_x, src_y, src_w, src_h;
+    uint32_t color;
+    uint32_t bpp;
+} VGACmd;
+
+_Static_assert(sizeof(VGACmd) == NEMU_GPU_CMD_SIZE, "GPU command size mismatch");
+_Static_assert(offsetof(VGACmd, aux) == NEMU_GPU_CMD_AUX, "GPU command layout mismatch");
+_Static_assert(offsetof(VGACmd, dst_x) == NEMU_GPU_CMD_DST_X, "GPU command layout mismatch");
+_Static_assert(offsetof(VGACmd, src_x) == NEMU_GPU_CMD_SRC_X, "GPU command layout mismatch");
+_Static_assert(offsetof(VGACmd, bpp) == NEMU_GPU_CMD_BPP, "GPU command layout mismatch");
+
+typedef struct
+{
+    bool fb;
+    vaddr_t base;
+    size_t pitch;
+    uint32_t bpp;
+} VGASurface;
+
+enum
+{
+    VGA_STAGE_SRC,
+    VGA_STAGE_SRC2,
+    VGA_STAGE_DST,
+    VGA_STAGE_XMAP,
+    VGA_STAGE_RECT,
+    VGA_NR_STAGE,
+};
+
+static uint8_t *vga_stage[VGA_NR_STAGE];
+static size_t vga_stage_cap[VGA_NR_STAGE];
+static uint32_t vga_queue_head = 0;
+
+static void *vga_stage_buf(int idx, size_t bytes)
+{
+    if (bytes > vga_stage_cap[idx])
+    {
+        vga_stage[idx] = realloc(vga_stage[idx], bytes);
+        Assert(vga_stage[idx] != NULL, "vga: cannot allocate %zu staging bytes", bytes);
+        vga_stage_cap[idx] = bytes;
+    }
+
+    return vga_stage[idx];
+}
+
+static VGASurface vga_surface(bool fb, uint64_t addr, uint32_t pitch, uint32_t bpp)
+{
+    if (fb)
+    {
+        Assert(bpp == sizeof(uint32_t), "vga: framebuffer surfaces are 32 bpp, got %u bytes", bpp);
+        return (VGASurface){.fb = true, .pitch = (size_t)screen_width() * sizeof(uint32_t), .bpp = bpp};
+    }
+
+    Assert(addr != 0, "vga: null surface in GPU command");
+    return (VGASurface){.fb = false, .base = (vaddr_t)addr, .pitch = pitch, .bpp = bpp};
+}
+
+static void vga_surface_check(const VGASurface *s, int x, int y, int w, int h)
+{
+    if (!s->fb)
+        return;
+
+    const int sw = (int)screen_width();
+    const int sh = (int)screen_height();
+    Assert(x + w <= sw && y + h <= sh,
+           "vga: GPU rectangle outside framebuffer x=%d y=%d w=%d h=%d screen=%dx%d",
+           x, y, w, h, sw, sh);
+}
+
+static uint8_t *vga_fb_row(int x, int y)
+{
+    return (uint8_t *)vmem + ((size_t)y * screen_width() + (size_t)x) * sizeof(uint32_t);
+}
+
+static vaddr_t vga_surface_addr(const VGASurface *s, int x, int y)
+{
+    return s->base + (vaddr_t)((size_t)y * s->pitch + (size_t)x * s->bpp);
+}
+
+/* Host view of `bytes` bytes of row y from x on; guest rows are copied into `stage`. */
+static uint8_t *vga_row_get(const VGASurface *s, int x, int y, size_t bytes, void *stage)
+{
+    if (s->fb)
+        return vga_fb_row(x, y);
+
+    vga_guest_read(vga_surface_addr(s, x, y), stage, bytes);
+    return stage;
+}
+
+/* Like vga_row_get(), but framebuffer rows are copied too, for when the kernel overwrites them. */
+static uint8_t *vga_row_copy(const VGASurface *s, int x, int y, size_t bytes, void *stage)
+{
+    if (s->fb)
+    {
+        memcpy(stage, vga_fb_row(x, y), bytes);
+        return stage;
+    }
+
+    vga_guest_read(vga_surface_addr(s, x, y), stage, bytes);
+    return stage;
+}
+
+/* Snapshot a whole w x h rectangle, rows packed at w * bpp bytes. */
+static const uint8_t *vga_rect_copy(const VGASurface *s, int x, int y, int w, int h)
+{
+    const size_t bytes = (size_t)w * s->bpp;
+    uint8_t *rect = vga_stage_buf(VGA_STAGE_RECT, bytes * (size_t)h);
+
+    for (int row = 0; row < h; row++)
+    {
+        vga_row_copy(s, x, y + row, bytes, rect + (size_t)row * bytes);
+    }
+    return rect;
+}
+
+static bool vga_same_surface(const VGASurface *dst, const VGASurface *src)
+{
+    return dst->fb == src->fb && dst->base == src->base && dst->pitch == src->pitch;
+}
+
+/*
+ * Row order for a same-size operation within one surface: bottom-up when the
+ * destination starts after the source, exactly as memmove would for one
+ * linear buffer.
+ */
+static bool vga_rows_backward(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const size_t dst_off = (size_t)cmd->dst_y * dst->pitch + (size_t)cmd->dst_x * dst->bpp;
+    const size_t src_off = (size_t)cmd->src_y * src->pitch + (size_t)cmd->src_x * src->bpp;
+    return vga_same_surface(dst, src) && dst_off > src_off;
+}
+
+/* Publish a row produced by a kernel; in-place framebuffer rows are already there. */
+static void vga_row_put(const VGASurface *s, int x, int y, size_t bytes, const uint8_t *row)
+{
+    if (s->fb)
+    {
+        uint8_t *dst = vga_fb_row(x, y);
+        if (dst != row)
+        {
+            memmove(dst, row, bytes);
+        }
+        return;
+    }
+
+    vga_guest_write(vga_surface_addr(s, x, y), row, bytes);
+}
+
+/* A destination row to be fully overwritten: the framebuffer row itself, or a stage. */
+static uint8_t *vga_row_out(const VGASurface *s, int x, int y, void *stage)
+{
+    return s->fb ? vga_fb_row(x, y) : stage;
+}
+
+static void vga_fill_row(uint8_t *row, int w, uint32_t bpp, uint32_t color)
+{
+    if (bpp == 1)
+    {
+        memset(row, (int)(color & 0xffu), (size_t)w);
+        return;
+    }
+
+    uint32_t *p = (uint32_t *)row;
+    for (int i = 0; i < w; i++)
+    {
+        p[i] = color;
+    }
+}
+
+static void vga_colorkey_row(uint8_t *dst, const uint8_t *src, int w, uint32_t bpp, uint32_t key)
+{
+    if (bpp == 1)
+    {
+        const uint8_t key8 = (uint8_t)key;
+        for (int i = 0; i < w; i++)
+        {
+            dst[i] = src[i] == key8 ? dst[i] : src[i];
+        }
+        return;
+    }
+
+    uint32_t *d = (uint32_t *)dst;
+    const uint32_t *s = (const uint32_t *)src;
+    for (int i = 0; i < w; i++)
+    {
+        d[i] = s[i] == key ? d[i] : s[i];
+    }
+}
+
+static void vga_pal8_row(uint32_t *dst, const uint8_t *src, int w, const uint32_t lut[256])
+{
+    for (int i = 0; i < w; i++)
+    {
+        dst[i] = lut[src[i]];
+    }
+}
+
+/* Blend two ARGB pixels, f in [0, 256]; red/blue and alpha/green share a multiply each. */
+static inline uint32_t vga_lerp_argb(uint32_t a, uint32_t b, uint32_t f)
+{
+    const uint32_t g = 256u - f;
+    const uint32_t rb = (((a & 0x00ff00ffu) * g + (b & 0x00ff00ffu) * f) >> 8) & 0x00ff00ffu;
+    const uint32_t ag = (((a >> 8) & 0x00ff00ffu) * g + ((b >> 8) & 0x00ff00ffu) * f) & 0xff00ff00u;
+    return rb | ag;
+}
+
+/*
+ * Source coordinate of destination pixel d, in 24.8 fixed point, sampling at
+ * pixel centres and clamped to the first pixel.
+ */
+static uint32_t vga_bilinear_pos(int d, int src_len, int dst_len)
+{
+    const int64_t pos = (((int64_t)d * 2 + 1) * src_len * 256) / ((int64_t)dst_len * 2) - 128;
+    return pos < 0 ? 0 : (uint32_t)pos;
+}
+
+static void vga_gpu_fill(const VGACmd *cmd, const VGASurface *dst)
+{
+    const int x = cmd->dst_x, y = cmd->dst_y, w = cmd->dst_w, h = cmd->dst_h;
+    uint8_t *stage = vga_stage_buf(VGA_STAGE_DST, (size_t)w * dst->bpp);
+
+    for (int row = 0; row < h; row++)
+    {
+        uint8_t *out = vga_row_out(dst, x, y + row, stage);
+        vga_fill_row(out, w, dst->bpp, cmd->color);
+        vga_row_put(dst, x, y + row, (size_t)w * dst->bpp, out);
+    }
+}
+
+static void vga_gpu_copy(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const int w = cmd->dst_w, h = cmd->dst_h;
+    const size_t bytes = (size_t)w * dst->bpp;
+    uint8_t *stage = vga_stage_buf(VGA_STAGE_SRC, bytes);
+
+    /*
+     * Within a row the source is staged (or memmove'd for the framebuffer), so
+     * horizontal overlap is harmless.  Across rows, vga_rows_backward() picks
+     * the order.
+     */
+    const bool backward = vga_rows_backward(cmd, dst, src);
+
+    for (int i = 0; i < h; i++)
+    {
+        const int row = backward ? h - 1 - i : i;
+        const uint8_t *in = vga_row_get(src, cmd->src_x, cmd->src_y + row, bytes, stage);
+        vga_row_put(dst, cmd->dst_x, cmd->dst_y + row, bytes, in);
+    }
+}
+
+static void vga_gpu_colorkey(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const int w = cmd->dst_w, h = cmd->dst_h;
+    const size_t bytes = (size_t)w * dst->bpp;
+    uint8_t *src_stage = vga_stage_buf(VGA_STAGE_SRC, bytes);
+    uint8_t *dst_stage = vga_stage_buf(VGA_STAGE_DST, bytes);
+
+    /*
+     * The kernel reads the destination too, so within one surface the source
+     * row is staged before the destination row is touched, in the same row
+     * order as vga_gpu_copy().
+     */
+    const bool same = vga_same_surface(dst, src);
+    const bool backward = vga_rows_backward(cmd, dst, src);
+
+    for (int i = 0; i < h; i++)
+    {
+        const int row = backward ? h - 1 - i : i;
+        const uint8_t *in = same ? vga_row_copy(src, cmd->src_x, cmd->src_y + row, bytes, src_stage)
+                                 : vga_row_get(src, cmd->src_x, cmd->src_y + row, bytes, src_stage);
+        uint8_t *out = vga_row_get(dst, cmd->dst_x, cmd->dst_y + row, bytes, dst_stage);
+        vga_colorkey_row(out, in, w, dst->bpp, cmd->color);
+        vga_row_put(dst, cmd->dst_x, cmd->dst_y + row, bytes, out);
+    }
+}
+
+static void vga_gpu_stretch_nearest(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const int dw = cmd->dst_w, dh = cmd->dst_h, sw = cmd->src_w, sh = cmd->src_h;
+    const uint32_t bpp = dst->bpp;
+    uint8_t *src_stage = vga_stage_buf(VGA_STAGE_SRC, (size_t)sw * bpp);
+    uint8_t *dst_stage = vga_stage_buf(VGA_STAGE_DST, (size_t)dw * bpp);
+    uint32_t *xmap = vga_stage_buf(VGA_STAGE_XMAP, (size_t)dw * sizeof(uint32_t));
+
+    /* Same floor mapping as miniSDL's software path: sx = dx * sw / dw. */
+    for (int dx = 0; dx < dw; dx++)
+    {
+        xmap[dx] = (uint32_t)((int64_t)dx * sw / dw);
+    }
+
+    /* Rows are resampled, so no row order is safe in place: snapshot the source. */
+    const uint8_t *rect = vga_same_surface(dst, src) ? vga_rect_copy(src, cmd->src_x, cmd->src_y, sw, sh) : NULL;
+    int cached = -1;
+    const uint8_t *in = NULL;
+
+    for (int dy = 0; dy < dh; dy++)
+    {
+        const int sy = (int)((int64_t)dy * sh / dh);
+
+        if (rect != NULL)
+        {
+            in = rect + (size_t)sy * sw * bpp;
+        }
+        else if (sy != cached)
+        {
+            in = vga_row_get(src, cmd->src_x, cmd->src_y + sy, (size_t)sw * bpp, src_stage);
+            cached = sy;
+        }
+
+        uint8_t *out = vga_row_out(dst, cmd->dst_x, cmd->dst_y + dy, dst_stage);
+
+        if (bpp == 1)
+        {
+            for (int dx = 0; dx < dw; dx++)
+            {
+                out[dx] = in[xmap[dx]];
+            }
+        }
+        else
+        {
+            const uint32_t *in32 = (const uint32_t *)in;
+            uint32_t *out32 = (uint32_t *)out;
+            for (int dx = 0; dx < dw; dx++)
+            {
+                out32[dx] = in32[xmap[dx]];
+            }
+        }
+
+        vga_row_put(dst, cmd->dst_x, cmd->dst_y + dy, (size_t)dw * bpp, out);
+    }
+}
+
+static void vga_gpu_stretch_bilinear(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const int dw = cmd->dst_w, dh = cmd->dst_h, sw = cmd->src_w, sh = cmd->src_h;
+    Assert(dst->bpp == sizeof(uint32_t), "vga: bilinear stretch needs 32 bpp surfaces");
+
+    const size_t src_bytes = (size_t)sw * sizeof(uint32_t);
+    uint32_t *top_stage = vga_stage_buf(VGA_STAGE_SRC, src_bytes);
+    uint32_t *bottom_stage = vga_stage_buf(VGA_STAGE_SRC2, src_bytes);
+    uint32_t *dst_stage = vga_stage_buf(VGA_STAGE_DST, (size_t)dw * sizeof(uint32_t));
+    uint32_t *xmap = vga_stage_buf(VGA_STAGE_XMAP, (size_t)dw * sizeof(uint32_t));
+
+    /* xmap packs the left source column above the 8-bit horizontal weight. */
+    for (int dx = 0; dx < dw; dx++)
+    {
+        const uint32_t pos = vga_bilinear_pos(dx, sw, dw);
+        uint32_t x0 = pos >> 8;
+        uint32_t fx = pos & 0xffu;
+
+        if (x0 >= (uint32_t)sw - 1)
+        {
+            x0 = (uint32_t)sw - 1;
+            fx = 0;
+        }
+        xmap[dx] = (x0 << 8) | fx;
+    }
+
+    /* As for nearest stretch, a source in the destination surface is snapshotted first. */
+    const uint32_t *rect = vga_same_surface(dst, src)
+                               ? (const uint32_t *)vga_rect_copy(src, cmd->src_x, cmd->src_y, sw, sh)
+                               : NULL;
+
+    for (int dy = 0; dy < dh; dy++)
+    {
+        const uint32_t pos = vga_bilinear_pos(dy, sh, dh);
+        uint32_t y0 = pos >> 8;
+        uint32_t fy = pos & 0xffu;
+
+        if (y0 >= (uint32_t)sh - 1)
+        {
+            y0 = (uint32_t)sh - 1;
+            fy = 0;
+        }
+
+        const uint32_t *top;
+        const uint32_t *bottom;
+
+        if (rect != NULL)
+        {
+            top = rect + (size_t)y0 * sw;
+            bottom = fy == 0 ? top : top + sw;
+        }
+        else
+        {
+            top = (const uint32_t *)vga_row_get(src, cmd->src_x, cmd->src_y + (int)y0, src_bytes, top_stage);
+            bottom = fy == 0 ? top
+                             : (const uint32_t *)vga_row_get(src, cmd->src_x, cmd->src_y + (int)y0 + 1,
+                                                             src_bytes, bottom_stage);
+        }
+        uint32_t *out = (uint32_t *)vga_row_out(dst, cmd->dst_x, cmd->dst_y + dy, dst_stage);
+
+        for (int dx = 0; dx < dw; dx++)
+        {
+            const uint32_t x0 = xmap[dx] >> 8;
+            const uint32_t fx = xmap[dx] & 0xffu;
+            const uint32_t x1 = fx == 0 ? x0 : x0 + 1;
+            const uint32_t t = vga_lerp_argb(top[x0], top[x1], fx);
+            const uint32_t b = vga_lerp_argb(bottom[x0], bottom[x1], fx);
+            out[dx] = vga_lerp_argb(t, b, fy);
+        }
+
+        vga_row_put(dst, cmd->dst_x, cmd->dst_y + dy, (size_t)dw * sizeof(uint32_t), (const uint8_t *)out);
+    }
+}
+
+static void vga_gpu_pal8(const VGACmd *cmd, const VGASurface *dst, const VGASurface *src)
+{
+    const int w = cmd->dst_w, h = cmd->dst_h;
+    uint32_t lut[256];
+
+    Assert(cmd->aux != 0, "vga: PAL8 command without a palette");
+    vga_guest_read((vaddr_t)cmd->aux, lut, sizeof(lut));
+
+    uint8_t *src_stage = vga_stage_buf(VGA_STAGE_SRC, (size_t)w);
+    uint8_t *dst_stage = vga_stage_buf(VGA_STAGE_DST, (size_t)w * sizeof(uint32_t));
+
+    for (int row = 0; row < h; row++)
+    {
+        const uint8_t *in = vga_row_get(src, cmd->src_x, cmd->src_y + row, (size_t)w, src_stage);
+        uint8_t *out = vga_row_out(dst, cmd->dst_x, cmd->dst_y + row, dst_stage);
+        vga_pal8_row((uint32_t *)out, in, w, lut);
+        vga_row_put(dst, cmd->dst_x, cmd->dst_y + row, (size_t)w * sizeof(uint32_t), out);
+    }
+}
+
+static void vga_gpu_exec(const VGACmd *cmd)
+{
+    if (cmd->dst_w == 0 || cmd->dst_h == 0)
+        return;
+
+    const bool pal8 = cmd->op == NEMU_GPU_OP_PAL8;
+    const uint32_t bpp = pal8 ? sizeof(uint32_t) : cmd->bpp;
+    Assert(bpp == 1 || bpp == sizeof(uint32_t), "vga: unsupported GPU pixel size %u", cmd->bpp);
+
+    const VGASurface dst = vga_surface(cmd->flags & NEMU_GPU_FLAG_DST_FB, cmd->dst, cmd->dst_pitch, bpp);
+    vga_surface_check(&dst, cmd->dst_x, cmd->dst_y, cmd->dst_w, cmd->dst_h);
+
+    VGASurface src = {0};
+    if (cmd->op != NEMU_GPU_OP_FILL)
+    {
+        const bool stretch = cmd->op == NEMU_GPU_OP_STRETCH;
+        const int sw = stretch ? cmd->src_w : cmd->dst_w;
+        const int sh = stretch ? cmd->src_h : cmd->dst_h;
+
+        if (sw == 0 || sh == 0)
+            return;
+
+        src = vga_surface(cmd->flags & NEMU_GPU_FLAG_SRC_FB, cmd->src, cmd->src_pitch, pal8 ? 1 : bpp);
+        vga_surface_check(&src, cmd->src_x, cmd->src_y, sw, sh);
+    }
+
+    switch (cmd->op)
+    {
+    case NEMU_GPU_OP_FILL:
+        vga_gpu_fill(cmd, &dst);
+        break;
+    case NEMU_GPU_OP_COPY:
+        vga_gpu_copy(cmd, &dst, &src);
+        break;
+    case NEMU_GPU_OP_COLORKEY:
+        vga_gpu_colorkey(cmd, &dst, &src);
+        break;
+    case NEMU_GPU_OP_STRETCH:
+        if (cmd->flags & NEMU_GPU_FLAG_BILINEAR)
+            vga_gpu_stretch_bilinear(cmd, &dst, &src);
+        else
+            vga_gpu_stretch_nearest(cmd, &dst, &src);
+        break;
+    case NEMU_GPU_OP_PAL8:
+        vga_gpu_pal8(cmd, &dst, &src);
+        break;
+    default:
+        panic("vga: unknown GPU command %u", cmd->op);
+    }
+
+    if (dst.fb)
+    {
+        mark_vmem_dirty_rect(cmd->dst_x, cmd->dst_y,
+                             cmd->dst_x + cmd->dst_w - 1, cmd->dst_y + cmd->dst_h - 1);
+        vga_fps_count_blit((uint64_t)cmd->dst_w * cmd->dst_h * sizeof(uint32_t));
+    }
+}
+
+static void vga_queue_drain()
+{
+    const uint32_t size = vgactl_port_base[NEMU_VGACTL_QUEUE_SIZE];
+    const uint32_t tail = vgactl_port_base[NEMU_VGACTL_QUEUE_TAIL];
+    const vaddr_t base = (vaddr_t)(((uint64_t)vgactl_port_base[NEMU_VGACTL_QUEUE_BASE_HI] << 32) |
+                                   vgactl_port_base[NEMU_VGACTL_QUEUE_BASE_LO]);
+
+    Assert(size != 0 && (size & (size - 1)) == 0, "vga: GPU queue size %u is not a power of two", size);
+    Assert(base != 0, "vga: GPU queue has no base address");
+    Assert(tail - vga_queue_head <= size, "vga: GPU queue tail %u overruns head %u", tail, vga_queue_head);
+
+    while (vga_queue_head != tail)
+    {
+        VGACmd cmd;
+        vga_guest_read(base + (vaddr_t)(vga_queue_head & (size - 1)) * NEMU_GPU_CMD_SIZE, &cmd, sizeof(cmd));
+        vga_gpu_exec(&cmd);
+        vga_queue_head++;
+    }
+}
+
 static void vgactl_io_handler(uint32_t offset, int len, bool is_write)
 {
     if (!is_write || len != sizeof(uint32_t))
@@ -427,6 +882,56 @@ static void vgactl_io_handler(uint32_t offset, int len, bool is_write)
         vga_capture_to_guest((vaddr_t)vgactl_port_base[NEMU_VGACTL_CAPTURE_DST]);
         vgactl_port_base[NEMU_VGACTL_CAPTURE_CMD] = 0;
     }
+    else if (reg == NEMU_VGACTL_QUEUE_BASE_LO || reg == NEMU_VGACTL_QUEUE_BASE_HI ||
+             reg == NEMU_VGACTL_QUEUE_SIZE)
+    {
+        vga_queue_head = 0;
+        vgactl_port_base[NEMU_VGACTL_QUEUE_TAIL] = 0;
+    }
+    else if (reg == NEMU_VGACTL_QUEUE_TAIL)
+    {
+        vga_queue_drain();
+    }
+
+    /* HEAD belongs to the device; a guest store to it is simply undone. */
+    vgactl_port_base[NEMU_VGACTL_QUEUE_HEAD] = vga_queue_head;
+}
+
+static inline bool vga_row_dirty(const uint64_t *rows, int y)
+{
+    return ((rows[y >> 6] >> (y & 63)) & 1u) != 0;
+}
+
+static void vga_set_dirty_rows(uint64_t *rows, int y0, int y1)
+{
+    for (int y = y0; y <= y1;)
+    {
+        const int bit = y & 63;
+        const int n = y1 - y + 1 < 64 - bit ? y1 - y + 1 : 64 - bit;
+        const uint64_t mask = n == 64 ? ~0ull : ((1ull << n) - 1u) << bit;
+
+        rows[y >> 6] |= mask;
+        y += n;
+    }
+}
+
+static uint64_t vga_dirty_row_count()
+{
+    uint64_t rows = 0;
+
+    for (int i = 0; i < VGA_DIRTY_WORDS; i++)
+        rows += (uint64_t)__builtin_popcountll(dirty_rows[i]);
+
+    return rows;
+}
+
+static void clear_vmem_dirty()
+{
+    if (!vmem_dirty)
+        return;
+
+    memset(dirty_rows, 0, sizeof(dirty_rows));
+    vmem_dirty = false;
 }
 
 static void mark_vmem_dirty_rect(int x0, int y0, int x1, int y1)
@@ -446,6 +951,8 @@ static void mark_vmem_dirty_rect(int x0, int y0, int x1, int y1)
     if (x0 > x1 || y0 > y1)
         return;
 
+    vga_set_dirty_rows(dirty_rows, y0, y1);
+
     if (!vmem_dirty)
     {
         dirty_x0 = x0;
@@ -476,14 +983,12 @@ static void mark_vmem_dirty_full()
 }
 #endif
 
-static void vmem_io_handler(uint32_t offset, int len, bool is_write)
+/* Account for `len` bytes the guest has just written at framebuffer `offset`. */
+static void vga_note_vmem_write(uint32_t offset, int len)
 {
-    if (!is_write || len <= 0)
-        return;
+    const uint64_t fb_size = vga_vmem_size;
 
-    const uint64_t fb_size = screen_size();
-
-    if ((uint64_t)offset >= fb_size)
+    if (len <= 0 || (uint64_t)offset >= fb_size)
         return;
     vga_fps_count_vmem_write(offset, len, fb_size);
 
@@ -500,8 +1005,14 @@ static void vmem_io_handler(uint32_t offset, int len, bool is_write)
 
     if (start_row == end_row)
     {
-        mark_vmem_dirty_rect((int)(start_pixel % (uint64_t)width), start_row,
-                             (int)(end_pixel % (uint64_t)width), end_row);
+        const int x0 = (int)(start_pixel % (uint64_t)width);
+        const int x1 = (int)(end_pixel % (uint64_t)width);
+
+        /* A pixel loop keeps landing on a row and span that are already dirty. */
+        if (vmem_dirty && vga_row_dirty(dirty_rows, start_row) && x0 >= dirty_x0 && x1 <= dirty_x1)
+            return;
+
+        mark_vmem_dirty_rect(x0, start_row, x1, end_row);
     }
     else
     {
@@ -515,6 +1026,27 @@ static void vmem_io_handler(uint32_t offset, int len, bool is_write)
     }
 }
 
+static void vmem_io_handler(uint32_t offset, int len, bool is_write)
+{
+    if (is_write)
+        vga_note_vmem_write(offset, len);
+}
+
+word_t vga_vmem_read(paddr_t addr, int len)
+{
+    difftest_skip_ref();
+    return host_read((uint8_t *)vmem + (addr - CONFIG_FB_ADDR), len);
+}
+
+void vga_vmem_write(paddr_t addr, int len, word_t data)
+{
+    const uint32_t offset = addr - CONFIG_FB_ADDR;
+
+    difftest_skip_ref();
+    host_write((uint8_t *)vmem + offset, len, data);
+    vga_note_vmem_write(offset, len);
+}
+
 #ifdef CONFIG_VGA_SHOW_SCREEN
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
@@ -523,7 +1055,28 @@ static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
 static SDL_Texture *texture = NULL;
 
-static void init_screen()
+/* Find the next run of set rows in [*y, y_end] and advance *y past it. */
+static bool vga_next_dirty_run(const uint64_t *rows, int *y, int y_end, int *run_y0, int *run_y1)
+{
+    int cur = *y;
+
+    while (cur <= y_end && !vga_row_dirty(rows, cur))
+        cur++;
+
+    if (cur > y_end)
+        return false;
+
+    *run_y0 = cur;
+
+    while (cur <= y_end && vga_row_dirty(rows, cur))
+        cur++;
+
+    *run_y1 = cur - 1;
+    *y = cur;
+    return true;
+}
+
+static void create_screen()
 {
     char title[128];
     sprintf(title, "%s-NEMU", str(__GUEST_ISA__));
@@ -541,21 +1094,29 @@ static void init_screen()
     SDL_RenderPresent(renderer);
 }
 
+#ifndef CONFIG_VGA_RENDER_THREAD
 static void upload_dirty_texture()
 {
     if (!vmem_dirty)
         return;
 
-    SDL_Rect rect = {
-        .x = dirty_x0,
-        .y = dirty_y0,
-        .w = dirty_x1 - dirty_x0 + 1,
-        .h = dirty_y1 - dirty_y0 + 1,
-    };
-    uint8_t *pixels = (uint8_t *)vmem + ((size_t)rect.y * SCREEN_W + (size_t)rect.x) * sizeof(uint32_t);
-    SDL_UpdateTexture(texture, &rect, pixels, SCREEN_W * sizeof(uint32_t));
-    vmem_dirty = false;
+    int y = dirty_y0;
+    int run_y0 = 0;
+    int run_y1 = 0;
+
+    while (vga_next_dirty_run(dirty_rows, &y, dirty_y1, &run_y0, &run_y1))
+    {
+        SDL_Rect rect = {
+            .x = dirty_x0,
+            .y = run_y0,
+            .w = dirty_x1 - dirty_x0 + 1,
+            .h = run_y1 - run_y0 + 1,
+        };
+        uint8_t *pixels = (uint8_t *)vmem + ((size_t)rect.y * SCREEN_W + (size_t)rect.x) * sizeof(uint32_t);
+        SDL_UpdateTexture(texture, &rect, pixels, SCREEN_W * sizeof(uint32_t));
+    }
 }
+#endif
 
 static SDL_Rect screen_dst_rect()
 {
@@ -637,14 +1198,241 @@ void vga_translate_mouse_position(int *x, int *y)
     *y = (int)guest_y;
 }
 
-static inline void update_screen()
+static void present_texture()
 {
-    upload_dirty_texture();
     SDL_RenderClear(renderer);
     SDL_Rect dst = screen_dst_rect();
     SDL_RenderCopy(renderer, texture, NULL, &dst);
     SDL_RenderPresent(renderer);
 }
+
+#ifdef CONFIG_VGA_RENDER_THREAD
+#include <device/alarm.h>
+#include <pthread.h>
+#include <time.h>
+
+bool device_queue_sdl_event(const SDL_Event *event);
+
+/*
+ * Frame hand-off between the CPU thread and the display thread.  The CPU side
+ * copies only the dirty scanlines of vmem into present_buf and ORs them into
+ * present_rows, widening present_rect to bound them; the display thread copies
+ * the pending rows into its own front_buf and uploads from there after
+ * dropping the lock.  Neither side
+ * holds present_lock across an SDL call, so a slow texture upload or a vsync
+ * wait in SDL_RenderPresent never stalls guest execution.
+ */
+static pthread_t render_thread;
+static pthread_mutex_t present_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t present_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t *present_buf = NULL;
+static uint32_t *front_buf = NULL;
+static SDL_Rect present_rect;
+static uint64_t present_rows[VGA_DIRTY_WORDS];
+static bool present_dirty = false;
+static bool present_pending = false;
+static bool render_ready = false;
+
+static void copy_rect(uint32_t *dst, const uint32_t *src, const SDL_Rect *rect)
+{
+    const size_t row_bytes = (size_t)rect->w * sizeof(uint32_t);
+
+    for (int row = rect->y; row < rect->y + rect->h; row++)
+    {
+        const size_t offset = (size_t)row * SCREEN_W + (size_t)rect->x;
+        memcpy(dst + offset, src + offset, row_bytes);
+    }
+}
+
+/* Copy the rows set in `rows` within `bound`, limited to bound's columns. */
+static void copy_dirty_rows(uint32_t *dst, const uint32_t *src, const uint64_t *rows, const SDL_Rect *bound)
+{
+    int y = bound->y;
+    int run_y0 = 0;
+    int run_y1 = 0;
+
+    while (vga_next_dirty_run(rows, &y, bound->y + bound->h - 1, &run_y0, &run_y1))
+    {
+        const SDL_Rect run = {.x = bound->x, .y = run_y0, .w = bound->w, .h = run_y1 - run_y0 + 1};
+        copy_rect(dst, src, &run);
+    }
+}
+
+static void merge_rect(SDL_Rect *acc, const SDL_Rect *rect)
+{
+    int x1 = acc->x + acc->w;
+    int y1 = acc->y + acc->h;
+
+    if (rect->x + rect->w > x1)
+        x1 = rect->x + rect->w;
+
+    if (rect->y + rect->h > y1)
+        y1 = rect->y + rect->h;
+
+    if (rect->x < acc->x)
+        acc->x = rect->x;
+
+    if (rect->y < acc->y)
+        acc->y = rect->y;
+
+    acc->w = x1 - acc->x;
+    acc->h = y1 - acc->y;
+}
+
+static void *render_thread_main(void *arg)
+{
+    (void)arg;
+    create_screen();
+
+    pthread_mutex_lock(&present_lock);
+    render_ready = true;
+    pthread_cond_broadcast(&present_cond);
+    pthread_mutex_unlock(&present_lock);
+
+    while (true)
+    {
+        /*
+         * SDL wants its event pump on the thread that created the window.
+         * Events are translated here, where the renderer geometry is valid,
+         * and queued for device_update() on the CPU thread.
+         */
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            device_queue_sdl_event(&event);
+        }
+
+        pthread_mutex_lock(&present_lock);
+
+        if (!present_pending)
+        {
+            /*
+             * Wake up at least once per guest timer tick even without a new
+             * frame so host input keeps flowing while the guest is busy.
+             */
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 1000000000L / TIMER_HZ;
+
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&present_cond, &present_lock, &deadline);
+        }
+
+        const bool pending = present_pending;
+        const bool dirty = present_dirty;
+        const SDL_Rect rect = present_rect;
+        uint64_t rows[VGA_DIRTY_WORDS];
+
+        if (dirty)
+        {
+            memcpy(rows, present_rows, sizeof(rows));
+            memset(present_rows, 0, sizeof(present_rows));
+            copy_dirty_rows(front_buf, present_buf, rows, &rect);
+        }
+        present_pending = false;
+        present_dirty = false;
+        pthread_mutex_unlock(&present_lock);
+
+        if (dirty)
+        {
+            int y = rect.y;
+            int run_y0 = 0;
+            int run_y1 = 0;
+
+            while (vga_next_dirty_run(rows, &y, rect.y + rect.h - 1, &run_y0, &run_y1))
+            {
+                const SDL_Rect run = {.x = rect.x, .y = run_y0, .w = rect.w, .h = run_y1 - run_y0 + 1};
+                const uint32_t *pixels = front_buf + (size_t)run.y * SCREEN_W + (size_t)run.x;
+                SDL_UpdateTexture(texture, &run, pixels, SCREEN_W * sizeof(uint32_t));
+            }
+        }
+
+        if (pending)
+        {
+            present_texture();
+        }
+    }
+
+    return NULL;
+}
+
+static void init_screen()
+{
+    present_buf = malloc(screen_size());
+    front_buf = malloc(screen_size());
+    Assert(present_buf != NULL && front_buf != NULL, "vga: cannot allocate present buffers");
+    memcpy(present_buf, vmem, screen_size());
+    memcpy(front_buf, vmem, screen_size());
+    clear_vmem_dirty();
+
+    Assert(pthread_create(&render_thread, NULL, render_thread_main, NULL) == 0,
+           "vga: cannot create display thread");
+
+    /*
+     * Keep the window creation synchronous from the caller's point of view:
+     * the guest must not issue its first SYNC before the texture exists.
+     */
+    pthread_mutex_lock(&present_lock);
+    while (!render_ready)
+    {
+        pthread_cond_wait(&present_cond, &present_lock);
+    }
+    pthread_mutex_unlock(&present_lock);
+}
+
+static inline void update_screen()
+{
+    pthread_mutex_lock(&present_lock);
+
+    if (vmem_dirty)
+    {
+        SDL_Rect rect = {
+            .x = dirty_x0,
+            .y = dirty_y0,
+            .w = dirty_x1 - dirty_x0 + 1,
+            .h = dirty_y1 - dirty_y0 + 1,
+        };
+        copy_dirty_rows(present_buf, vmem, dirty_rows, &rect);
+
+        for (int i = 0; i < VGA_DIRTY_WORDS; i++)
+            present_rows[i] |= dirty_rows[i];
+
+        if (present_dirty)
+        {
+            /*
+             * The display thread has not consumed the previous frame yet.
+             * present_buf already holds its pixels, so widening the rectangle
+             * and the row set is enough; the older frame is simply never shown
+             * on its own.
+             */
+            merge_rect(&present_rect, &rect);
+        }
+        else
+        {
+            present_rect = rect;
+            present_dirty = true;
+        }
+    }
+    present_pending = true;
+    pthread_cond_signal(&present_cond);
+    pthread_mutex_unlock(&present_lock);
+}
+#else
+static void init_screen()
+{
+    create_screen();
+}
+
+static inline void update_screen()
+{
+    upload_dirty_texture();
+    present_texture();
+}
+#endif
 #else
 static void init_screen() {}
 
@@ -692,9 +1480,10 @@ void vga_update_screen()
     {
         const bool had_dirty = vmem_dirty;
         const uint64_t dirty_area = had_dirty
-                                        ? (uint64_t)(dirty_x1 - dirty_x0 + 1) * (uint64_t)(dirty_y1 - dirty_y0 + 1)
+                                        ? (uint64_t)(dirty_x1 - dirty_x0 + 1) * vga_dirty_row_count()
                                         : 0;
         update_screen();
+        clear_vmem_dirty();
         vga_fps_count_frame(had_dirty, dirty_area);
         vgactl_port_base[NEMU_VGACTL_SYNC] = 0;
     }
@@ -708,13 +1497,15 @@ void init_vga()
     add_pio_map("vgactl", CONFIG_VGA_CTL_PORT, vgactl_port_base,
                 VGACTL_NR_REGS * sizeof(uint32_t), vgactl_io_handler);
 #else
-    add_mmio_map("vgactl", CONFIG_VGA_CTL_MMIO, vgactl_port_base,
-                 VGACTL_NR_REGS * sizeof(uint32_t), vgactl_io_handler);
+    add_mmio_map_notify("vgactl", CONFIG_VGA_CTL_MMIO, vgactl_port_base,
+                        VGACTL_NR_REGS * sizeof(uint32_t), vgactl_io_handler);
 #endif
 
+    assert(screen_height() <= NEMU_MAX_SCREEN_H);
     vmem = new_space(screen_size());
+    vga_vmem_size = screen_size();
     IFDEF(CONFIG_VGA_SHOW_SCREEN, memset(vmem, 0, screen_size()));
-    add_mmio_map("vmem", CONFIG_FB_ADDR, vmem, screen_size(), vmem_io_handler);
+    add_mmio_map_notify("vmem", CONFIG_FB_ADDR, vmem, screen_size(), vmem_io_handler);
     IFDEF(CONFIG_VGA_SHOW_SCREEN, mark_vmem_dirty_full());
     IFDEF(CONFIG_VGA_SHOW_SCREEN, init_screen());
     init_vga_fps_counter();
@@ -0,0 +1,696 @@
+#include <common.h>
+#include <utils.h>
+#include <device/map.h>
+#include <device/alarm.h>
+#include <memory/paddr.h>
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+#include <isa-jit.h>
+#endif
+#ifdef CONFIG_HAS_PLIC
+#include <device/intc.h>
+#endif
+
+#define NEMU_PLATFORM_CONSTANTS_ONLY
+#include "../../../abstract-machine/am/src/platform/nemu/include/nemu.h"
+#undef NEMU_PLATFORM_CONSTANTS_ONLY
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * virtio-mmio block device.
+ *
+ * The CPU thread owns the virtqueue: a QueueNotify write walks the avail ring,
+ * turns each descriptor chain into an iovec list over PMEM and hands it to one
+ * host I/O thread, which runs preadv/pwritev against the image.  Finished
+ * requests come back through a second ring and are published by
+ * virtio_blk_poll() from device_update(), again on the CPU thread, so the used
+ * ring, status bytes, JIT invalidation and the PLIC line are never touched
+ * concurrently with the guest.  The I/O thread only ever writes the data
+ * buffers, which the guest must not look at before the used entry appears.
+ */
+
+#define VIRTIO_BLK_SECTOR 512u
+#define VIRTIO_BLK_QUEUE_MAX 128u
+#define VIRTIO_BLK_SEG_MAX (VIRTIO_BLK_QUEUE_MAX - 2u)
+#define VIRTIO_BLK_ID_BYTES 20u
+
+#define VIRTIO_BLK_F_SEG_MAX 2
+#define VIRTIO_BLK_F_RO 5
+#define VIRTIO_BLK_F_BLK_SIZE 6
+#define VIRTIO_BLK_F_FLUSH 9
+#define VIRTIO_F_VERSION_1 32
+
+#define VIRTQ_DESC_F_NEXT 1u
+#define VIRTQ_DESC_F_WRITE 2u
+#define VIRTQ_DESC_F_INDIRECT 4u
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1u
+
+enum
+{
+    VIRTIO_BLK_T_IN = 0,
+    VIRTIO_BLK_T_OUT = 1,
+    VIRTIO_BLK_T_FLUSH = 4,
+    VIRTIO_BLK_T_GET_ID = 8,
+};
+
+enum
+{
+    VIRTIO_BLK_S_OK = 0,
+    VIRTIO_BLK_S_IOERR = 1,
+    VIRTIO_BLK_S_UNSUPP = 2,
+    VIRTIO_BLK_S_PENDING = 0xff, // internal: queued for the I/O thread
+};
+
+static const uint64_t virtio_blk_features =
+    (1ull << VIRTIO_BLK_F_SEG_MAX) | (1ull << VIRTIO_BLK_F_BLK_SIZE) |
+    (1ull << VIRTIO_BLK_F_FLUSH) | (1ull << VIRTIO_F_VERSION_1);
+
+typedef struct
+{
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} VirtqDesc;
+
+typedef struct
+{
+    uint8_t *host;
+    paddr_t paddr;
+    uint32_t len;
+    bool write;
+} VirtqSeg;
+
+typedef struct
+{
+    uint32_t type;
+    uint64_t sector;
+    int niov;
+    struct iovec iov[VIRTIO_BLK_QUEUE_MAX];
+    paddr_t paddr[VIRTIO_BLK_QUEUE_MAX];
+    uint32_t plen[VIRTIO_BLK_QUEUE_MAX];
+    uint32_t bytes;
+    uint8_t *status;
+    uint8_t result;
+    bool busy;
+} VirtioBlkReq;
+
+static uint32_t *virtio_regs = NULL;
+static int virtio_blk_fd = -1;
+static uint64_t virtio_blk_size = 0;
+/* Set for the default image, which is not ours to write; see open_virtio_blk_image(). */
+static bool virtio_blk_ro = false;
+
+/* Virtqueue state, CPU thread only. */
+static bool vq_ready = false;
+static uint32_t vq_num = 0;
+static uint64_t vq_desc = 0, vq_avail = 0, vq_used = 0;
+static uint16_t vq_last_avail = 0, vq_used_idx = 0;
+static uint32_t vq_inflight = 0;
+static uint32_t virtio_interrupt_status = 0;
+
+/* One request slot per descriptor head: a head cannot be reused while in flight. */
+static VirtioBlkReq vq_req[VIRTIO_BLK_QUEUE_MAX];
+
+/* Head indices travelling to and from the I/O thread, guarded by io_lock. */
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t io_submit_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t io_done_cond = PTHREAD_COND_INITIALIZER;
+static uint16_t io_submit[VIRTIO_BLK_QUEUE_MAX];
+static uint32_t io_submit_head = 0, io_submit_tail = 0;
+static uint16_t io_done[VIRTIO_BLK_QUEUE_MAX];
+static uint32_t io_done_head = 0, io_done_tail = 0;
+
+static uint32_t virtio_reg(uint32_t offset)
+{
+    return virtio_regs[offset / sizeof(uint32_t)];
+}
+
+static void virtio_set_reg(uint32_t offset, uint32_t value)
+{
+    virtio_regs[offset / sizeof(uint32_t)] = value;
+}
+
+static uint64_t virtio_reg64(uint32_t low_offset)
+{
+    return (uint64_t)virtio_reg(low_offset) | ((uint64_t)virtio_reg(low_offset + 4) << 32);
+}
+
+static uint8_t *virtio_guest_ptr(uint64_t addr, uint64_t len)
+{
+    Assert(len > 0 && len <= CONFIG_MSIZE && (paddr_t)addr == addr &&
+               in_pmem_range((paddr_t)addr, (int)len),
+           "virtio-blk: guest range [0x%" PRIx64 ", +0x%" PRIx64 ") is outside PMEM", addr, len);
+    return guest_to_host((paddr_t)addr);
+}
+
+static uint16_t vq_read16(uint64_t addr)
+{
+    uint16_t v;
+    memcpy(&v, virtio_guest_ptr(addr, sizeof(v)), sizeof(v));
+    return v;
+}
+
+static void vq_write16(uint64_t addr, uint16_t v)
+{
+    memcpy(virtio_guest_ptr(addr, sizeof(v)), &v, sizeof(v));
+}
+
+static void virtio_update_irq(void)
+{
+    IFDEF(CONFIG_HAS_PLIC, dev_set_irq(NEMU_IRQ_VIRTIO_BLK, virtio_interrupt_status != 0));
+}
+
+/* Collect the chain starting at `head` as host segments; returns the segment count. */
+static int vq_gather(uint16_t head, VirtqSeg *seg)
+{
+    const VirtqDesc *table = (const VirtqDesc *)virtio_guest_ptr(vq_desc, (uint64_t)vq_num * sizeof(VirtqDesc));
+    uint16_t idx = head;
+    int n = 0;
+
+    for (uint32_t walked = 0;; walked++)
+    {
+        Assert(idx < vq_num && walked < vq_num, "virtio-blk: malformed descriptor chain at head %u", head);
+
+        VirtqDesc d;
+        memcpy(&d, &table[idx], sizeof(d));
+        Assert(!(d.flags & VIRTQ_DESC_F_INDIRECT), "virtio-blk: indirect descriptors were not offered");
+        Assert(n == 0 || !seg[n - 1].write || (d.flags & VIRTQ_DESC_F_WRITE) || d.len == 0,
+               "virtio-blk: readable descriptor after a writable one");
+
+        if (d.len > 0)
+        {
+            seg[n++] = (VirtqSeg){
+                .host = virtio_guest_ptr(d.addr, d.len),
+                .paddr = (paddr_t)d.addr,
+                .len = d.len,
+                .write = (d.flags & VIRTQ_DESC_F_WRITE) != 0,
+            };
+        }
+
+        if (!(d.flags & VIRTQ_DESC_F_NEXT))
+        {
+            return n;
+        }
+        idx = d.next;
+    }
+}
+
+/*
+ * Parse one request.  virtio 1 does not fix the framing, so the header is the
+ * first 16 readable bytes and the status is the last writable byte, wherever
+ * the descriptor boundaries fall; everything in between is data.
+ */
+static void virtio_blk_parse(VirtioBlkReq *req, uint16_t head)
+{
+    VirtqSeg seg[VIRTIO_BLK_QUEUE_MAX];
+    const int n = vq_gather(head, seg);
+    uint8_t hdr[16];
+    uint32_t got = 0, skip = 0;
+    int i = 0;
+
+    while (got < sizeof(hdr))
+    {
+        Assert(i < n && !seg[i].write, "virtio-blk: request %u has no header", head);
+        uint32_t take = seg[i].len - skip;
+        if (take > sizeof(hdr) - got)
+        {
+            take = sizeof(hdr) - got;
+        }
+        memcpy(hdr + got, seg[i].host + skip, take);
+        got += take;
+        skip += take;
+        if (skip == seg[i].len)
+        {
+            i++;
+            skip = 0;
+        }
+    }
+
+    Assert(n > i && seg[n - 1].write, "virtio-blk: request %u has no status byte", head);
+    req->status = seg[n - 1].host + seg[n - 1].len - 1;
+    seg[n - 1].len--;
+
+    memcpy(&req->type, hdr, sizeof(req->type));
+    memcpy(&req->sector, hdr + 8, sizeof(req->sector));
+    req->niov = 0;
+    req->bytes = 0;
+    req->result = VIRTIO_BLK_S_PENDING;
+
+    const bool want_write = req->type == VIRTIO_BLK_T_IN || req->type == VIRTIO_BLK_T_GET_ID;
+
+    for (; i < n; i++, skip = 0)
+    {
+        if (seg[i].len == skip)
+        {
+            continue;
+        }
+        if (seg[i].write != want_write)
+        {
+            req->result = VIRTIO_BLK_S_IOERR;
+        }
+
+        req->iov[req->niov] = (struct iovec){seg[i].host + skip, seg[i].len - skip};
+        req->paddr[req->niov] = seg[i].paddr + skip;
+        req->plen[req->niov] = seg[i].len - skip;
+        req->bytes += seg[i].len - skip;
+        req->niov++;
+    }
+
+    switch (req->type)
+    {
+    case VIRTIO_BLK_T_IN:
+    case VIRTIO_BLK_T_OUT:
+    {
+        const uint64_t capacity = (virtio_blk_size + VIRTIO_BLK_SECTOR - 1) / VIRTIO_BLK_SECTOR;
+
+        if ((req->type == VIRTIO_BLK_T_OUT && virtio_blk_ro) || req->bytes % VIRTIO_BLK_SECTOR != 0 ||
+            req->sector > capacity || req->bytes / VIRTIO_BLK_SECTOR > capacity - req->sector)
+        {
+            req->result = VIRTIO_BLK_S_IOERR;
+        }
+        break;
+    }
+    case VIRTIO_BLK_T_FLUSH:
+        break;
+    case VIRTIO_BLK_T_GET_ID:
+    {
+        /* Answered on the CPU thread: a NUL-padded serial, truncated to the buffer. */
+        static const char id[VIRTIO_BLK_ID_BYTES] = "nemu-virtio-blk";
+        uint32_t done = 0;
+
+        for (int k = 0; k < req->niov && done < VIRTIO_BLK_ID_BYTES && req->result == VIRTIO_BLK_S_PENDING; k++)
+        {
+            uint32_t take = req->iov[k].iov_len;
+            if (take > VIRTIO_BLK_ID_BYTES - done)
+            {
+                take = VIRTIO_BLK_ID_BYTES - done;
+            }
+            memcpy(req->iov[k].iov_base, id + done, take);
+            done += take;
+        }
+        if (req->result == VIRTIO_BLK_S_PENDING)
+        {
+            req->bytes = done;
+            req->result = VIRTIO_BLK_S_OK;
+        }
+        break;
+    }
+    default:
+        req->result = VIRTIO_BLK_S_UNSUPP;
+        break;
+    }
+}
+
+/* Run the whole iovec list, resuming after short transfers. */
+static bool virtio_blk_xfer(VirtioBlkReq *req, bool write)
+{
+    struct iovec iov[VIRTIO_BLK_QUEUE_MAX];
+    struct iovec *cur = iov;
+    int n = req->niov;
+    off_t off = (off_t)(req->sector * VIRTIO_BLK_SECTOR);
+
+    memcpy(iov, req->iov, sizeof(iov[0]) * n);
+
+    while (n > 0)
+    {
+        ssize_t r = write ? pwritev(virtio_blk_fd, cur, n, off) : preadv(virtio_blk_fd, cur, n, off);
+
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r < 0 || (r == 0 && write))
+        {
+            return false;
+        }
+        if (r == 0)
+        {
+            /* The image need not end on a sector boundary; the tail reads as zeroes. */
+            for (int i = 0; i < n; i++)
+            {
+                memset(cur[i].iov_base, 0, cur[i].iov_len);
+            }
+            return true;
+        }
+
+        off += r;
+        while (r > 0)
+        {
+            if ((size_t)r >= cur->iov_len)
+            {
+                r -= cur->iov_len;
+                cur++;
+                n--;
+            }
+            else
+            {
+                cur->iov_base = (uint8_t *)cur->iov_base + r;
+                cur->iov_len -= r;
+                r = 0;
+            }
+        }
+    }
+
+    return true;
+}
+
+static uint8_t virtio_blk_execute(VirtioBlkReq *req)
+{
+    switch (req->type)
+    {
+    case VIRTIO_BLK_T_IN:
+        return virtio_blk_xfer(req, false) ? VIRTIO_BLK_S_OK : VIRTIO_BLK_S_IOERR;
+    case VIRTIO_BLK_T_OUT:
+        return virtio_blk_xfer(req, true) ? VIRTIO_BLK_S_OK : VIRTIO_BLK_S_IOERR;
+    case VIRTIO_BLK_T_FLUSH:
+        return fdatasync(virtio_blk_fd) == 0 ? VIRTIO_BLK_S_OK : VIRTIO_BLK_S_IOERR;
+    default:
+        return VIRTIO_BLK_S_UNSUPP;
+    }
+}
+
+static void *virtio_blk_io_main(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&io_lock);
+        while (io_submit_head == io_submit_tail)
+        {
+            pthread_cond_wait(&io_submit_cond, &io_lock);
+        }
+        const uint16_t head = io_submit[io_submit_head++ % VIRTIO_BLK_QUEUE_MAX];
+        pthread_mutex_unlock(&io_lock);
+
+        const uint8_t result = virtio_blk_execute(&vq_req[head]);
+
+        pthread_mutex_lock(&io_lock);
+        vq_req[head].result = result;
+        io_done[io_done_tail++ % VIRTIO_BLK_QUEUE_MAX] = head;
+        pthread_cond_signal(&io_done_cond);
+        pthread_mutex_unlock(&io_lock);
+
+        device_wakeup();
+    }
+
+    return NULL;
+}
+
+static void virtio_blk_complete(uint16_t head)
+{
+    VirtioBlkReq *req = &vq_req[head];
+    uint32_t written = 1;
+
+    if (req->result == VIRTIO_BLK_S_OK && (req->type == VIRTIO_BLK_T_IN || req->type == VIRTIO_BLK_T_GET_ID))
+    {
+        written += req->bytes;
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+        /* Like the legacy disk, a DMA read may overwrite translated code. */
+        for (int i = 0; i < req->niov && unlikely(isa_jit_invalidation_active); i++)
+        {
+            isa_jit_invalidate_paddr(req->paddr[i], (int)req->plen[i]);
+        }
+#endif
+    }
+
+    *req->status = req->result;
+    req->busy = false;
+
+    const uint64_t elem = vq_used + 4 + (uint64_t)(vq_used_idx % vq_num) * 8;
+    const uint32_t used_elem[2] = {head, written};
+    memcpy(virtio_guest_ptr(elem, sizeof(used_elem)), used_elem, sizeof(used_elem));
+    vq_write16(vq_used + 2, ++vq_used_idx);
+
+    if (!(vq_read16(vq_avail) & VIRTQ_AVAIL_F_NO_INTERRUPT))
+    {
+        virtio_interrupt_status |= 1u;
+        virtio_update_irq();
+    }
+}
+
+void virtio_blk_poll()
+{
+    if (vq_inflight == 0)
+    {
+        return;
+    }
+
+    uint16_t done[VIRTIO_BLK_QUEUE_MAX];
+    uint32_t n = 0;
+
+    pthread_mutex_lock(&io_lock);
+    while (io_done_head != io_done_tail)
+    {
+        done[n++] = io_done[io_done_head++ % VIRTIO_BLK_QUEUE_MAX];
+    }
+    pthread_mutex_unlock(&io_lock);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        virtio_blk_complete(done[i]);
+    }
+    vq_inflight -= n;
+}
+
+static void virtio_blk_process(void)
+{
+    if (!vq_ready || virtio_blk_fd < 0)
+    {
+        return;
+    }
+
+    const uint16_t avail_idx = vq_read16(vq_avail + 2);
+    uint16_t submit[VIRTIO_BLK_QUEUE_MAX];
+    uint32_t nsubmit = 0;
+
+    while (vq_last_avail != avail_idx)
+    {
+        const uint16_t head = vq_read16(vq_avail + 4 + (uint64_t)(vq_last_avail % vq_num) * 2);
+        vq_last_avail++;
+
+        Assert(head < vq_num && !vq_req[head].busy,
+               "virtio-blk: descriptor head %u is invalid or still in flight", head);
+        VirtioBlkReq *req = &vq_req[head];
+        req->busy = true;
+        virtio_blk_parse(req, head);
+
+        if (req->result != VIRTIO_BLK_S_PENDING)
+        {
+            virtio_blk_complete(head);
+            continue;
+        }
+        submit[nsubmit++] = head;
+    }
+
+    if (nsubmit == 0)
+    {
+        return;
+    }
+
+    /* Hand over the whole notify batch at once; the heads bound the ring occupancy. */
+    pthread_mutex_lock(&io_lock);
+    for (uint32_t i = 0; i < nsubmit; i++)
+    {
+        io_submit[io_submit_tail++ % VIRTIO_BLK_QUEUE_MAX] = submit[i];
+    }
+    pthread_cond_signal(&io_submit_cond);
+    pthread_mutex_unlock(&io_lock);
+    vq_inflight += nsubmit;
+}
+
+static void virtio_blk_reset(void)
+{
+    /* The guest may reuse every buffer after a reset, so wait for the I/O thread first. */
+    while (vq_inflight > 0)
+    {
+        pthread_mutex_lock(&io_lock);
+        while (io_done_head == io_done_tail)
+        {
+            pthread_cond_wait(&io_done_cond, &io_lock);
+        }
+        pthread_mutex_unlock(&io_lock);
+        virtio_blk_poll();
+    }
+
+    vq_ready = false;
+    vq_num = 0;
+    vq_last_avail = 0;
+    vq_used_idx = 0;
+    virtio_interrupt_status = 0;
+    virtio_update_irq();
+
+    for (uint32_t off = NEMU_VIRTIO_DEVICE_FEATURES_SEL; off < NEMU_VIRTIO_CONFIG_GENERATION; off += 4)
+    {
+        virtio_set_reg(off, 0);
+    }
+}
+
+static void virtio_blk_io_handler(uint32_t offset, int len, bool is_write)
+{
+    if (offset >= NEMU_VIRTIO_CONFIG)
+    {
+        /* Config space is constant for this device; any access width is fine. */
+        return;
+    }
+
+    Assert(offset % sizeof(uint32_t) == 0 && len == sizeof(uint32_t),
+           "virtio-blk: only aligned 32-bit register accesses are supported");
+
+    const uint32_t queue_sel = virtio_reg(NEMU_VIRTIO_QUEUE_SEL);
+
+    if (!is_write)
+    {
+        switch (offset)
+        {
+        case NEMU_VIRTIO_DEVICE_FEATURES:
+        {
+            const uint32_t sel = virtio_reg(NEMU_VIRTIO_DEVICE_FEATURES_SEL);
+            const uint64_t features = virtio_blk_features | (virtio_blk_ro ? 1ull << VIRTIO_BLK_F_RO : 0);
+            virtio_set_reg(offset, sel < 2 ? (uint32_t)(features >> (32 * sel)) : 0);
+            break;
+        }
+        case NEMU_VIRTIO_QUEUE_NUM_MAX:
+            virtio_set_reg(offset, queue_sel == 0 ? VIRTIO_BLK_QUEUE_MAX : 0);
+            break;
+        case NEMU_VIRTIO_QUEUE_READY:
+            virtio_set_reg(offset, queue_sel == 0 && vq_ready);
+            break;
+        case NEMU_VIRTIO_INTERRUPT_STATUS:
+            /* Let a polling guest see completions without waiting for device_update(). */
+            virtio_blk_poll();
+            virtio_set_reg(offset, virtio_interrupt_status);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    const uint32_t value = virtio_reg(offset);
+
+    switch (offset)
+    {
+    case NEMU_VIRTIO_QUEUE_NUM:
+        Assert(queue_sel != 0 || (value > 0 && value <= VIRTIO_BLK_QUEUE_MAX && (value & (value - 1)) == 0),
+               "virtio-blk: queue size %u must be a power of two up to %u", value, VIRTIO_BLK_QUEUE_MAX);
+        break;
+    case NEMU_VIRTIO_QUEUE_READY:
+        if (queue_sel != 0)
+        {
+            break;
+        }
+        vq_ready = (value & 1u) != 0;
+        if (vq_ready)
+        {
+            vq_num = virtio_reg(NEMU_VIRTIO_QUEUE_NUM);
+            vq_desc = virtio_reg64(NEMU_VIRTIO_QUEUE_DESC_LO);
+            vq_avail = virtio_reg64(NEMU_VIRTIO_QUEUE_DRIVER_LO);
+            vq_used = virtio_reg64(NEMU_VIRTIO_QUEUE_DEVICE_LO);
+            vq_last_avail = 0;
+            vq_used_idx = 0;
+            virtio_guest_ptr(vq_desc, (uint64_t)vq_num * sizeof(VirtqDesc));
+            virtio_guest_ptr(vq_avail, 6 + (uint64_t)vq_num * 2);
+            virtio_guest_ptr(vq_used, 6 + (uint64_t)vq_num * 8);
+        }
+        break;
+    case NEMU_VIRTIO_QUEUE_NOTIFY:
+        if (value == 0)
+        {
+            virtio_blk_process();
+        }
+        break;
+    case NEMU_VIRTIO_INTERRUPT_ACK:
+        virtio_interrupt_status &= ~value;
+        virtio_update_irq();
+        break;
+    case NEMU_VIRTIO_STATUS:
+        if (value == 0)
+        {
+            virtio_blk_reset();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Only an image configured explicitly is opened for writing.  The Navy ramdisk
+ * fallback is the legacy disk's image too, so it is read-only here and the
+ * guest is offered VIRTIO_BLK_F_RO.
+ */
+static void open_virtio_blk_image(void)
+{
+    char navy_path[4096];
+    const char *path = CONFIG_VIRTIO_BLK_IMG_PATH;
+
+    virtio_blk_ro = path[0] == '\0';
+
+    if (virtio_blk_ro)
+    {
+        const char *navy_home = getenv("NAVY_HOME");
+
+        if (navy_home == NULL || navy_home[0] == '\0' ||
+            snprintf(navy_path, sizeof(navy_path), "%s/build/ramdisk.img", navy_home) >= (int)sizeof(navy_path))
+        {
+            Log("virtio-blk: no image configured, device is absent");
+            return;
+        }
+        path = navy_path;
+    }
+
+    struct stat st;
+    const int fd = open(path, (virtio_blk_ro ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        Log("virtio-blk: cannot use image '%s': %s", path, fd < 0 ? strerror(errno) : "empty");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+
+    virtio_blk_fd = fd;
+    virtio_blk_size = (uint64_t)st.st_size;
+    Log("virtio-blk: using image '%s'%s, size = %" PRIu64 " bytes", path, virtio_blk_ro ? " read-only" : "",
+        virtio_blk_size);
+}
+
+void init_virtio_blk()
+{
+    virtio_regs = (uint32_t *)new_space(NEMU_VIRTIO_MMIO_SIZE);
+    memset(virtio_regs, 0, NEMU_VIRTIO_MMIO_SIZE);
+    open_virtio_blk_image();
+
+    virtio_set_reg(NEMU_VIRTIO_MAGIC, NEMU_VIRTIO_MAGIC_VALUE);
+    virtio_set_reg(NEMU_VIRTIO_VERSION, 2);
+    /* Device ID 0 is how virtio-mmio says "nothing here". */
+    virtio_set_reg(NEMU_VIRTIO_DEVICE_ID, virtio_blk_fd >= 0 ? NEMU_VIRTIO_ID_BLOCK : 0);
+    virtio_set_reg(NEMU_VIRTIO_VENDOR_ID, 0x554d454e); // "NEMU"
+
+    const uint64_t capacity = (virtio_blk_size + VIRTIO_BLK_SECTOR - 1) / VIRTIO_BLK_SECTOR;
+    virtio_set_reg(NEMU_VIRTIO_CONFIG + NEMU_VIRTIO_BLK_CAPACITY, (uint32_t)capacity);
+    virtio_set_reg(NEMU_VIRTIO_CONFIG + NEMU_VIRTIO_BLK_CAPACITY + 4, (uint32_t)(capacity >> 32));
+    virtio_set_reg(NEMU_VIRTIO_CONFIG + NEMU_VIRTIO_BLK_SEG_MAX, VIRTIO_BLK_SEG_MAX);
+    virtio_set_reg(NEMU_VIRTIO_CONFIG + NEMU_VIRTIO_BLK_BLK_SIZE, VIRTIO_BLK_SECTOR);
+
+    if (virtio_blk_fd >= 0)
+    {
+        pthread_t thread;
+        int ret = pthread_create(&thread, NULL, virtio_blk_io_main, NULL);
+        Assert(ret == 0, "virtio-blk: cannot create the I/O thread");
+        pthread_detach(thread);
+    }
+
+    add_mmio_map("virtio-blk", CONFIG_VIRTIO_BLK_MMIO, virtio_regs, NEMU_VIRTIO_MMIO_SIZE,
+                 virtio_blk_io_handler);
+}
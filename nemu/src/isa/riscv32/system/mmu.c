@@ -1,5 +1,6 @@
 #include "common.h"
 #include "debug.h"
+#include <cpu/cpu.h>
 #include <isa.h>
 #include <memory/paddr.h>
 #include <memory/vaddr.h>
@@ -94,7 +95,14 @@ paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type)
     paddr_t pte1_addr = root + (paddr_t)(vpn1 * 4u);
     uint32_t pte1 = (uint32_t)paddr_read(pte1_addr, 4);
 
-    Assert((pte1 & PTE_V) != 0, "Not a valid pte at %u", (word_t)pte1_addr);
+    /*
+     * An absent or inadequate mapping is a page fault for the guest to handle,
+     * e.g. a page the kernel has not loaded yet or a copy-on-write page.
+     */
+    if ((pte1 & PTE_V) == 0)
+    {
+        return (paddr_t)MEM_RET_FAIL;
+    }
 
     uint32_t pte1_rwx = pte1 & (PTE_R | PTE_W | PTE_X);
     /*
@@ -112,32 +120,17 @@ paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type)
     paddr_t pte0_addr = l0_pt + (paddr_t)(vpn0 * 4u);
     uint32_t pte0 = (uint32_t)paddr_read(pte0_addr, 4);
 
-    // if (!(pte0 & PTE_V))
-    // {
-    //     printf("MMU: vaddr=0x%08x len=%d type=%d satp=0x%08x\n",
-    //         (uint32_t)vaddr, len, type, (uint32_t)cpu.csr.satp);
-    //     printf("MMU: vpn1=%u vpn0=%u root=0x%08x pte1_addr=0x%08x pte1=0x%08x\n",
-    //         vpn1, vpn0, (uint32_t)root, (uint32_t)pte1_addr, pte1);
-    //     printf("MMU: l0_base=0x%08x pte0_addr=0x%08x pte0=0x%08x\n",
-    //         (uint32_t)l0_pt, (uint32_t)pte0_addr, pte0);
-    // }
-
-    Assert((pte0 & PTE_V) != 0, "PTE 0 invalid");
-
-    uint32_t pte0_rwx = pte0 & (PTE_R | PTE_W | PTE_X);
-    assert(pte0_rwx != 0); // must be leaf at level 0 in our assumption
-
-    if (type == MEM_TYPE_IFETCH)
+    // A level-0 PTE must be a leaf.
+    if ((pte0 & PTE_V) == 0 || (pte0 & (PTE_R | PTE_W | PTE_X)) == 0)
     {
-        assert((pte0 & PTE_X) != 0);
+        return (paddr_t)MEM_RET_FAIL;
     }
-    else if (type == MEM_TYPE_READ)
-    {
-        assert((pte0 & PTE_R) != 0);
-    }
-    else if (type == MEM_TYPE_WRITE)
+
+    const uint32_t need = type == MEM_TYPE_IFETCH ? PTE_X : type == MEM_TYPE_READ ? PTE_R : PTE_W;
+
+    if ((pte0 & need) == 0)
     {
-        assert((pte0 & PTE_W) != 0);
+        return (paddr_t)MEM_RET_FAIL;
     }
 
     /*
@@ -148,3 +141,23 @@ paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type)
     const paddr_t pg_paddr = (paddr_t)(((paddr_t)(pte0 >> 10)) << 12);
     return pg_paddr | (paddr_t)MEM_RET_OK;
 }
+
+void isa_mmu_fault(vaddr_t vaddr, int type)
+{
+    if (!cpu_exec_can_abort())
+    {
+        return;
+    }
+
+    /*
+     * As on riscv64, cpu.pc still names the faulting instruction: the
+     * interpreter commits dnpc afterwards and the JIT flushes dirty registers
+     * and stores the guest PC before its slow-path memory helpers.
+     */
+    const word_t cause = type == MEM_TYPE_IFETCH  ? RISCV32_CAUSE_INST_PAGE_FAULT
+                         : type == MEM_TYPE_READ ? RISCV32_CAUSE_LOAD_PAGE_FAULT
+                                                 : RISCV32_CAUSE_STORE_PAGE_FAULT;
+
+    cpu.pc = isa_raise_intr_tval(cause, cpu.pc, vaddr);
+    cpu_exec_abort_instr();
+}
@@ -0,0 +1,62 @@
+#ifndef __RISCV64_ISA_HART_H__
+#define __RISCV64_ISA_HART_H__
+
+#include <common.h>
+
+/*
+ * RISC-V64 hart scheduling hooks. `cpu` always holds the running hart; the
+ * other harts are parked in hart.c and swapped in by the CPU loop at batch
+ * boundaries. Without CONFIG_RV64_SMP there is exactly one hart and these
+ * hooks describe that trivially.
+ */
+
+/* Value of the read-only mhartid CSR for the running hart. */
+extern rtlreg_t riscv64_mhartid;
+
+/* LR/SC reservation of the running hart; dropped on trap entry and hart switch. */
+extern vaddr_t riscv64_lr_addr;
+extern bool riscv64_lr_valid;
+
+/*
+ * Machine interrupt-enable of the running hart, and the backing word for mip
+ * reads.  mip is not stored state: riscv64_pending_mip() derives it from the
+ * CLINT and PLIC lines of the running hart each time it is consulted.
+ */
+#define RISCV64_MIP_MSIP ((word_t)1u << 3)
+#define RISCV64_MIP_MTIP ((word_t)1u << 7)
+#define RISCV64_MIP_MEIP ((word_t)1u << 11)
+#define RISCV64_MIE_MASK (RISCV64_MIP_MSIP | RISCV64_MIP_MTIP | RISCV64_MIP_MEIP)
+
+extern rtlreg_t riscv64_mie;
+extern rtlreg_t riscv64_mip;
+
+word_t riscv64_pending_mip(void);
+
+/* Number of harts in the machine, including stopped ones. */
+int isa_hart_count(void);
+
+/* Return true when hart `id` has been started and takes part in scheduling. */
+bool isa_hart_running(int id);
+
+/*
+ * Start a stopped secondary hart at `pc` in M-mode with a0 = hart ID and
+ * a1 = `opaque`, following the SBI HSM hart_start convention.  Returns false
+ * for hart 0, unknown IDs, and harts that are already running.
+ */
+bool isa_hart_start(int id, vaddr_t pc, word_t opaque);
+
+/* Instructions the running hart may still retire before it must yield. */
+uint32_t isa_hart_budget(void);
+
+/*
+ * Give up the rest of the running hart's slice because it is waiting in wfi.
+ * Returns false when there is no other hart to run, or when every running
+ * hart has yielded in turn since one last did real work, so the caller can
+ * idle the host instead.
+ */
+bool isa_hart_yield(void);
+
+/* Charge `executed` instructions to the running hart and rotate when its slice ends. */
+void isa_hart_account(uint32_t executed);
+
+#endif
@@ -39,4 +39,8 @@ void init_isa()
 
     /* Initialize this virtual computer system. */
     restart();
+
+    /* Secondary harts stay stopped until the boot hart starts them. */
+    void riscv64_init_harts();
+    riscv64_init_harts();
 }
@@ -3,6 +3,10 @@
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
 #include <cpu/ifetch.h>
+#ifdef CONFIG_HAS_CLINT
+#include <device/alarm.h>
+#endif
+#include <isa-hart.h>
 #ifdef CONFIG_RV64_JIT
 #include <isa-jit.h>
 #endif
@@ -73,6 +77,19 @@ enum
     RV64_RELOP_GEU,
 };
 
+enum
+{
+    RV64_AMO_SWAP,
+    RV64_AMO_ADD,
+    RV64_AMO_XOR,
+    RV64_AMO_AND,
+    RV64_AMO_OR,
+    RV64_AMO_MIN,
+    RV64_AMO_MAX,
+    RV64_AMO_MINU,
+    RV64_AMO_MAXU,
+};
+
 /* Extract the 12-bit CSR address from bits [31:20] of SYSTEM instructions. */
 static inline uint32_t csr_addr(uint32_t inst)
 {
@@ -320,13 +337,55 @@ static inline rtlreg_t *riscv64_get_csr_or_trap(Decode *s, word_t addr, bool wil
         return NULL;
     }
 
+    /* The reference counts instructions and time its own way. */
+    if (addr == 0xc00 || addr == 0xc01 || addr == 0xc02)
+    {
+        difftest_skip_ref();
+    }
+
     return getCSRAddress(addr);
 }
 
 /* Write a CSR, applying the local WARL normalisation that RV64 currently models. */
 static inline void riscv64_write_csr(word_t addr, rtlreg_t *csr, word_t value)
 {
-    *csr = addr == 0x300 ? riscv64_mstatus_normalise(value) : value;
+    switch (addr)
+    {
+    case 0x300:
+        *csr = riscv64_mstatus_normalise(value);
+        break;
+    case 0x304:
+        *csr = value & RISCV64_MIE_MASK;
+        /* Enabling a line that is already pending must be noticed by the CPU loop. */
+        IFDEF(CONFIG_HAS_CLINT, cpu.INTR = true);
+        break;
+    case 0x344:
+        /* MSIP, MTIP and MEIP are read-only: they are cleared at the CLINT or PLIC. */
+        break;
+    default:
+        *csr = value;
+        break;
+    }
+}
+
+/*
+ * wfi is only a hint, so it may return at any time.  With a CLINT it parks the
+ * host until the next comparator deadline or host event poll, unless an
+ * enabled interrupt is already pending (taken or not, per mstatus.MIE) or
+ * another hart can use the time.  Without a CLINT the legacy SIGVTALRM tick
+ * counts host CPU time, so sleeping would stall it and wfi stays a no-op.
+ */
+static inline void riscv64_wfi(void)
+{
+    difftest_skip_ref();
+#ifdef CONFIG_HAS_CLINT
+    if ((riscv64_pending_mip() & riscv64_mie) != 0 || isa_hart_yield())
+    {
+        return;
+    }
+
+    device_idle(UINT64_MAX);
+#endif
 }
 
 /* Evaluate one branch comparison using signedness selected by the decoded funct3. */
@@ -480,6 +539,105 @@ static inline word_t riscv64_remuw(word_t src1, word_t src2)
     return rv64_sext32(dividend % divisor);
 }
 
+/*
+ * Load a 32- or 64-bit AMO operand.  W forms sign-extend the loaded word to
+ * XLEN, which is both the value written to rd and the operand for MIN/MAX.
+ */
+static inline word_t riscv64_amo_load(word_t addr, int len)
+{
+    const word_t value = Mr(addr, len);
+    return len == 4 ? rv64_sext32((uint32_t)value) : value;
+}
+
+/* Combine the loaded memory value with rs2 for one AMO operation. */
+static inline word_t riscv64_amo_apply(int op, word_t mem, word_t src, int len)
+{
+    if (len == 4)
+    {
+        src = rv64_sext32((uint32_t)src);
+    }
+
+    switch (op)
+    {
+    case RV64_AMO_SWAP:
+        return src;
+    case RV64_AMO_ADD:
+        return mem + src;
+    case RV64_AMO_XOR:
+        return mem ^ src;
+    case RV64_AMO_AND:
+        return mem & src;
+    case RV64_AMO_OR:
+        return mem | src;
+    case RV64_AMO_MIN:
+        return (sword_t)mem < (sword_t)src ? mem : src;
+    case RV64_AMO_MAX:
+        return (sword_t)mem > (sword_t)src ? mem : src;
+    case RV64_AMO_MINU:
+        if (len == 4)
+            return (uint32_t)mem < (uint32_t)src ? mem : src;
+        return mem < src ? mem : src;
+    case RV64_AMO_MAXU:
+        if (len == 4)
+            return (uint32_t)mem > (uint32_t)src ? mem : src;
+        return mem > src ? mem : src;
+    default:
+        panic("unsupported AMO op = %d", op);
+    }
+}
+
+/*
+ * Execute one AMO as a read-modify-write.  Harts are interleaved between whole
+ * instructions, so no other hart can observe the gap between load and store.
+ * Misaligned AMOs raise the store/AMO misaligned trap before memory is read.
+ */
+static inline void riscv64_amo(Decode *s, int rd, int op, word_t addr, word_t src, int len)
+{
+    if (!riscv64_check_store_alignment(s, addr, len))
+    {
+        return;
+    }
+
+    const word_t old = riscv64_amo_load(addr, len);
+    Mw(addr, len, riscv64_amo_apply(op, old, src, len));
+    R(rd) = old;
+}
+
+/* LR loads the word and registers a reservation on its address. */
+static inline void riscv64_lr(Decode *s, int rd, word_t addr, int len)
+{
+    if (!riscv64_check_load_alignment(s, addr, len))
+    {
+        return;
+    }
+
+    R(rd) = riscv64_amo_load(addr, len);
+    riscv64_lr_addr = addr;
+    riscv64_lr_valid = true;
+}
+
+/*
+ * SC stores only while the reservation from the matching LR is still held and
+ * writes 0 to rd on success, 1 on failure.  Either way the reservation is
+ * consumed.
+ */
+static inline void riscv64_sc(Decode *s, int rd, word_t addr, word_t src, int len)
+{
+    if (!riscv64_check_store_alignment(s, addr, len))
+    {
+        return;
+    }
+
+    const bool ok = riscv64_lr_valid && riscv64_lr_addr == addr;
+    riscv64_lr_valid = false;
+
+    if (ok)
+    {
+        Mw(addr, len, src);
+    }
+    R(rd) = ok ? 0 : 1;
+}
+
 /*
  * Execute MRET in architectural order: validate privilege and MPP, restore MIE
  * from MPIE, set MPIE, clear MPP, optionally clear MPRV, update privilege, and
@@ -647,6 +805,29 @@ static int decode_exec(Decode *s)
     INSTPAT("0000001 ????? ????? 110 ????? 01110 11", remw, R, R(rd) = riscv64_remw(src1, src2));
     INSTPAT("0000001 ????? ????? 111 ????? 01110 11", remuw, R, R(rd) = riscv64_remuw(src1, src2));
 
+    INSTPAT("00010?? 00000 ????? 010 ????? 01011 11", lr_w, R, riscv64_lr(s, rd, src1, 4));
+    INSTPAT("00011?? ????? ????? 010 ????? 01011 11", sc_w, R, riscv64_sc(s, rd, src1, src2, 4));
+    INSTPAT("00001?? ????? ????? 010 ????? 01011 11", amoswap_w, R, riscv64_amo(s, rd, RV64_AMO_SWAP, src1, src2, 4));
+    INSTPAT("00000?? ????? ????? 010 ????? 01011 11", amoadd_w, R, riscv64_amo(s, rd, RV64_AMO_ADD, src1, src2, 4));
+    INSTPAT("00100?? ????? ????? 010 ????? 01011 11", amoxor_w, R, riscv64_amo(s, rd, RV64_AMO_XOR, src1, src2, 4));
+    INSTPAT("01100?? ????? ????? 010 ????? 01011 11", amoand_w, R, riscv64_amo(s, rd, RV64_AMO_AND, src1, src2, 4));
+    INSTPAT("01000?? ????? ????? 010 ????? 01011 11", amoor_w, R, riscv64_amo(s, rd, RV64_AMO_OR, src1, src2, 4));
+    INSTPAT("10000?? ????? ????? 010 ????? 01011 11", amomin_w, R, riscv64_amo(s, rd, RV64_AMO_MIN, src1, src2, 4));
+    INSTPAT("10100?? ????? ????? 010 ????? 01011 11", amomax_w, R, riscv64_amo(s, rd, RV64_AMO_MAX, src1, src2, 4));
+    INSTPAT("11000?? ????? ????? 010 ????? 01011 11", amominu_w, R, riscv64_amo(s, rd, RV64_AMO_MINU, src1, src2, 4));
+    INSTPAT("11100?? ????? ????? 010 ????? 01011 11", amomaxu_w, R, riscv64_amo(s, rd, RV64_AMO_MAXU, src1, src2, 4));
+    INSTPAT("00010?? 00000 ????? 011 ????? 01011 11", lr_d, R, riscv64_lr(s, rd, src1, 8));
+    INSTPAT("00011?? ????? ????? 011 ????? 01011 11", sc_d, R, riscv64_sc(s, rd, src1, src2, 8));
+    INSTPAT("00001?? ????? ????? 011 ????? 01011 11", amoswap_d, R, riscv64_amo(s, rd, RV64_AMO_SWAP, src1, src2, 8));
+    INSTPAT("00000?? ????? ????? 011 ????? 01011 11", amoadd_d, R, riscv64_amo(s, rd, RV64_AMO_ADD, src1, src2, 8));
+    INSTPAT("00100?? ????? ????? 011 ????? 01011 11", amoxor_d, R, riscv64_amo(s, rd, RV64_AMO_XOR, src1, src2, 8));
+    INSTPAT("01100?? ????? ????? 011 ????? 01011 11", amoand_d, R, riscv64_amo(s, rd, RV64_AMO_AND, src1, src2, 8));
+    INSTPAT("01000?? ????? ????? 011 ????? 01011 11", amoor_d, R, riscv64_amo(s, rd, RV64_AMO_OR, src1, src2, 8));
+    INSTPAT("10000?? ????? ????? 011 ????? 01011 11", amomin_d, R, riscv64_amo(s, rd, RV64_AMO_MIN, src1, src2, 8));
+    INSTPAT("10100?? ????? ????? 011 ????? 01011 11", amomax_d, R, riscv64_amo(s, rd, RV64_AMO_MAX, src1, src2, 8));
+    INSTPAT("11000?? ????? ????? 011 ????? 01011 11", amominu_d, R, riscv64_amo(s, rd, RV64_AMO_MINU, src1, src2, 8));
+    INSTPAT("11100?? ????? ????? 011 ????? 01011 11", amomaxu_d, R, riscv64_amo(s, rd, RV64_AMO_MAXU, src1, src2, 8));
+
     INSTPAT("??????? ????? ????? 000 ????? 11000 11", beq, B, riscv64_branch(s, RV64_RELOP_EQ, src1, src2, imm));
     INSTPAT("??????? ????? ????? 001 ????? 11000 11", bne, B, riscv64_branch(s, RV64_RELOP_NE, src1, src2, imm));
     INSTPAT("??????? ????? ????? 100 ????? 11000 11", blt, B, riscv64_branch(s, RV64_RELOP_LT, src1, src2, imm));
@@ -693,7 +874,7 @@ static int decode_exec(Decode *s)
     INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak, N,
             riscv64_raise_trap(s, RISCV64_CAUSE_BREAKPOINT, 0));
     INSTPAT("0011000 00010 00000 000 00000 11100 11", mret, N, riscv64_mret(s));
-    INSTPAT("0001000 00101 00000 000 00000 11100 11", wfi, N, difftest_skip_ref());
+    INSTPAT("0001000 00101 00000 000 00000 11100 11", wfi, N, riscv64_wfi());
     INSTPAT("0001001 ????? ????? 000 00000 11100 11", sfence_vma, N, riscv64_sfence_vma(s));
 
     INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw, CSR,
@@ -1006,8 +1006,27 @@ static uint32_t jit_data_tlb_index(uint64_t vpn, word_t satp, uint32_t state)
                       (RV64_JIT_DATA_TLB_SIZE - 1u));
 }
 
-/* Fill or hit the RV64/Sv39 data TLB for ordinary translated PMEM accesses. */
-static bool jit_translate_pmem(vaddr_t addr, uint32_t len, int type, paddr_t *paddr)
+/* Check a direct physical range: PMEM, or with `allow_io` a range wholly outside it. */
+static bool jit_data_direct_range(paddr_t addr, uint32_t len, bool allow_io)
+{
+    if (jit_data_pmem_range(addr, len))
+    {
+        return true;
+    }
+
+    const paddr_t end = addr + (paddr_t)len - 1u;
+    return allow_io && len != 0 && end >= addr && !in_pmem(addr) && !in_pmem(end);
+}
+
+/*
+ * Fill or hit the RV64/Sv39 data TLB for ordinary translated PMEM accesses.
+ * With `allow_io` a walk may also resolve to a device address; such pages are
+ * returned but never cached, because native TLB guards treat every entry as
+ * PMEM.  The caller then goes to paddr_read()/paddr_write() directly, which
+ * serves the framebuffer and plain-memory MMIO without a callback.
+ */
+static bool jit_translate_pmem(vaddr_t addr, uint32_t len, int type, paddr_t *paddr,
+                               bool allow_io)
 {
     const word_t satp = cpu.csr.satp;
     const word_t mode = jit_data_satp_mode(satp);
@@ -1017,7 +1036,7 @@ static bool jit_translate_pmem(vaddr_t addr, uint32_t len, int type, paddr_t *pa
     {
         const paddr_t direct = (paddr_t)addr;
 
-        if (!jit_data_pmem_range(direct, len))
+        if (!jit_data_direct_range(direct, len, allow_io))
         {
             return false;
         }
@@ -1034,7 +1053,7 @@ static bool jit_translate_pmem(vaddr_t addr, uint32_t len, int type, paddr_t *pa
     {
         const paddr_t direct = (paddr_t)addr;
 
-        if (!jit_data_pmem_range(direct, len))
+        if (!jit_data_direct_range(direct, len, allow_io))
         {
             return false;
         }
@@ -1127,7 +1146,12 @@ static bool jit_translate_pmem(vaddr_t addr, uint32_t len, int type, paddr_t *pa
 
             if (!jit_data_pmem_range(translated, len))
             {
-                return false;
+                if (!jit_data_direct_range(translated, len, allow_io))
+                {
+                    return false;
+                }
+                *paddr = translated;
+                return true;
             }
 
             jit_data_tlb_unref_entry(entry);
@@ -1171,16 +1195,23 @@ static uint64_t jit_load_vaddr_raw(vaddr_t addr, uint32_t len)
 {
     /*
      * The JIT data TLB only accepts cases where a strict Sv39 walk proves that
-     * the final physical byte range is ordinary PMEM.  MMIO, faulting,
-     * cross-page, and otherwise ambiguous accesses fall back to vaddr_read(),
-     * which remains the architectural reference for visible failure behaviour.
+     * the final physical byte range is ordinary PMEM.  A walk that proves a
+     * device range reads it through paddr_read().  Faulting, cross-page, and
+     * otherwise ambiguous accesses fall back to vaddr_read(), which remains the
+     * architectural reference for visible failure behaviour.
      */
     paddr_t paddr = 0;
 
     JIT_STAT_INC(helper_load_count);
 
-    if (jit_translate_pmem(addr, len, MEM_TYPE_READ, &paddr))
+    if (jit_translate_pmem(addr, len, MEM_TYPE_READ, &paddr, true))
     {
+        if (!in_pmem(paddr))
+        {
+            /* Already translated: skip vaddr_read()'s second page walk. */
+            return (uint64_t)paddr_read(paddr, (int)len);
+        }
+
         JIT_STAT_INC(data_tlb_direct_loads);
         return (uint64_t)host_read(guest_to_host(paddr), (int)len);
     }
@@ -1263,14 +1294,22 @@ static void jit_store_vaddr(vaddr_t addr, uint32_t len, uint64_t data)
      * A data-TLB hit skips the repeated page walk but still commits through
      * paddr_write().  That keeps device boundaries, source invalidation, and
      * page-table dependency flushing under the same write-side hook used by the
-     * interpreter.  Anything not proven ordinary PMEM uses vaddr_write().
+     * interpreter.  A translation that lands outside PMEM commits through
+     * paddr_write(); anything not translated here uses vaddr_write().
      */
     paddr_t paddr = 0;
 
     JIT_STAT_INC(helper_store_count);
 
-    if (jit_translate_pmem(addr, len, MEM_TYPE_WRITE, &paddr))
+    if (jit_translate_pmem(addr, len, MEM_TYPE_WRITE, &paddr, true))
     {
+        if (!in_pmem(paddr))
+        {
+            /* No code or page tables live outside PMEM, so nothing to invalidate. */
+            paddr_write(paddr, (int)len, (word_t)data);
+            return;
+        }
+
         JIT_STAT_INC(data_tlb_direct_stores);
         (void)jit_store_pmem_direct_continue(paddr, len, data);
         return;
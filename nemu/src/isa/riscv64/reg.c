@@ -1,7 +1,15 @@
 #include <isa.h>
 #include "local-include/reg.h"
+#include <isa-hart.h>
+#include <utils.h>
 #include <stdio.h> // printf
 
+extern uint64_t g_nr_guest_instr;
+
+/* Backing words for the read-only counters, refreshed on every access. */
+static rtlreg_t riscv64_instret = 0;
+static rtlreg_t riscv64_time = 0;
+
 #define REG_FMT ("%-8s " FMT_WORD "%-5s" FMT_DECIMAL_WORD "%-5s" FMT_DECIMAL_WORD_SIGN "\n")
 
 const char *regs[] = {
@@ -19,11 +27,17 @@ typedef struct
 static const csr_disp_t csr_list[] = {
     {0x180, "satp"},
     {0x300, "mstatus"},
+    {0x304, "mie"},
     {0x305, "mtvec"},
     {0x340, "mscratch"},
     {0x341, "mepc"},
     {0x342, "mcause"},
     {0x343, "mtval"},
+    {0x344, "mip"},
+    {0xc00, "cycle"},
+    {0xc01, "time"},
+    {0xc02, "instret"},
+    {0xf14, "mhartid"},
 };
 
 static size_t csr_list_len(void)
@@ -120,6 +134,8 @@ rtlreg_t *getCSRAddress(const word_t address)
         return &cpu.csr.satp;
     case 0x300:
         return &cpu.csr.mstatus;
+    case 0x304:
+        return &riscv64_mie;
     case 0x305:
         return &cpu.csr.mtvec;
     case 0x340:
@@ -130,6 +146,28 @@ rtlreg_t *getCSRAddress(const word_t address)
         return &cpu.csr.mcause;
     case 0x343:
         return &cpu.csr.mtval;
+    case 0x344:
+        /* Refresh on every access; the pending lines belong to the devices. */
+        riscv64_mip = riscv64_pending_mip();
+        return &riscv64_mip;
+    case 0xc00:
+    case 0xc02:
+        /*
+         * There is no timing model, so a cycle is one retired instruction.
+         * The count covers instructions before the one reading it.
+         */
+        riscv64_instret = (rtlreg_t)g_nr_guest_instr;
+        return &riscv64_instret;
+    case 0xc01:
+        /* Host uptime in microseconds, the clock behind CLINT mtime. */
+        riscv64_time = (rtlreg_t)get_time();
+        return &riscv64_time;
+    case 0xf14:
+        /*
+         * mhartid lives outside CPU_state so the DiffTest register ABI keeps
+         * its layout; hart.c updates it whenever another hart is scheduled.
+         */
+        return &riscv64_mhartid;
     default:
         Assert(false, "Invalid csr address: " FMT_WORD "\n", address);
         return NULL; // Keep the compiler happy after Assert().
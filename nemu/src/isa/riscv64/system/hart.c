@@ -0,0 +1,205 @@
+#include <isa.h>
+#include <isa-hart.h>
+
+/*
+ * RV64 harts.
+ *
+ * Every hart shares PMEM, devices and the JIT block cache; only architectural
+ * register state is private.  Translated code and the interpreter address the
+ * global `cpu` directly, so `cpu` is always the running hart and the others are
+ * parked in hart_state[].  The CPU loop charges each batch to the running hart
+ * and hart_switch() rotates round-robin when the slice is used up.  JIT blocks
+ * and data-TLB entries are already tagged by satp and privilege, so they stay
+ * valid across a switch without a flush.
+ *
+ * Interleaving on one host thread makes each guest instruction atomic with
+ * respect to the other harts, which is what the A extension in inst.c relies
+ * on.  LR reservations are simply dropped when a hart is descheduled: SC then
+ * fails and the guest retries, which is always a legal outcome.
+ */
+
+rtlreg_t riscv64_mhartid = 0;
+vaddr_t riscv64_lr_addr = 0;
+bool riscv64_lr_valid = false;
+rtlreg_t riscv64_mie = 0;
+rtlreg_t riscv64_mip = 0;
+
+#ifdef CONFIG_RV64_SMP
+/* Short enough for spinlock hand-off to feel responsive, long enough to amortise the swap. */
+#define RV64_HART_QUANTUM 4096u
+
+static CPU_state hart_state[CONFIG_RV64_NR_HARTS];
+static rtlreg_t hart_mie[CONFIG_RV64_NR_HARTS];
+static bool hart_running[CONFIG_RV64_NR_HARTS];
+static int hart_current = 0;
+static int hart_nr_running = 1;
+static uint32_t hart_slice = 0;
+static int hart_wfi_streak = 0;
+static bool hart_yielded = false;
+
+void riscv64_init_harts()
+{
+    memset(hart_state, 0, sizeof(hart_state));
+    memset(hart_mie, 0, sizeof(hart_mie));
+    memset(hart_running, 0, sizeof(hart_running));
+    hart_running[0] = true;
+    hart_current = 0;
+    hart_nr_running = 1;
+    hart_slice = 0;
+    hart_wfi_streak = 0;
+    hart_yielded = false;
+    riscv64_mhartid = 0;
+    riscv64_lr_valid = false;
+    riscv64_mie = 0;
+}
+
+int isa_hart_count()
+{
+    return CONFIG_RV64_NR_HARTS;
+}
+
+bool isa_hart_running(int id)
+{
+    return id >= 0 && id < CONFIG_RV64_NR_HARTS && hart_running[id];
+}
+
+bool isa_hart_start(int id, vaddr_t pc, word_t opaque)
+{
+    if (id <= 0 || id >= CONFIG_RV64_NR_HARTS || hart_running[id])
+    {
+        return false;
+    }
+
+    CPU_state *hart = &hart_state[id];
+    memset(hart, 0, sizeof(*hart));
+    hart->pc = pc;
+    hart->gpr[10]._64 = (word_t)id;
+    hart->gpr[11]._64 = opaque;
+    hart->csr.mstatus = riscv64_mstatus_normalise(0);
+    hart->prvi = RISCV64_PRIV_M;
+    hart_mie[id] = 0;
+    hart_running[id] = true;
+    hart_nr_running++;
+    return true;
+}
+
+uint32_t isa_hart_budget()
+{
+    return hart_nr_running > 1 ? RV64_HART_QUANTUM - hart_slice : UINT32_MAX;
+}
+
+static void hart_switch(int next)
+{
+    /*
+     * Without a CLINT, device interrupts are latched in cpu.INTR without a
+     * target hart.  Carry a pending one over to the incoming hart instead of
+     * parking it with a hart that may keep interrupts masked for a long time.
+     * With a CLINT, cpu.INTR is only a hint and the incoming hart re-evaluates
+     * its own mip lines.
+     */
+    IFNDEF(CONFIG_HAS_CLINT, const bool intr = cpu.INTR);
+    cpu.INTR = false;
+    hart_state[hart_current] = cpu;
+    hart_mie[hart_current] = riscv64_mie;
+
+    cpu = hart_state[next];
+    cpu.INTR = MUXDEF(CONFIG_HAS_CLINT, true, cpu.INTR || intr);
+    hart_current = next;
+    riscv64_mhartid = (rtlreg_t)next;
+    riscv64_mie = hart_mie[next];
+    riscv64_lr_valid = false;
+}
+
+bool isa_hart_yield()
+{
+    if (hart_nr_running <= 1)
+    {
+        return false;
+    }
+
+    if (++hart_wfi_streak >= hart_nr_running)
+    {
+        hart_wfi_streak = 0;
+        return false;
+    }
+
+    hart_slice = RV64_HART_QUANTUM;
+    hart_yielded = true;
+    return true;
+}
+
+void isa_hart_account(uint32_t executed)
+{
+    if (hart_nr_running <= 1)
+    {
+        return;
+    }
+
+    hart_slice += executed;
+
+    if (hart_slice < RV64_HART_QUANTUM)
+    {
+        return;
+    }
+
+    hart_slice = 0;
+
+    /* A slice that ran out on its own did real work, so the harts are not all idle. */
+    if (!hart_yielded)
+    {
+        hart_wfi_streak = 0;
+    }
+    hart_yielded = false;
+
+    int next = hart_current;
+    do
+    {
+        next = (next + 1) % CONFIG_RV64_NR_HARTS;
+    } while (!hart_running[next]);
+
+    if (next != hart_current)
+    {
+        hart_switch(next);
+    }
+}
+#else
+void riscv64_init_harts()
+{
+    riscv64_mhartid = 0;
+    riscv64_lr_valid = false;
+    riscv64_mie = 0;
+}
+
+int isa_hart_count()
+{
+    return 1;
+}
+
+bool isa_hart_running(int id)
+{
+    return id == 0;
+}
+
+bool isa_hart_start(int id, vaddr_t pc, word_t opaque)
+{
+    (void)id;
+    (void)pc;
+    (void)opaque;
+    return false;
+}
+
+uint32_t isa_hart_budget()
+{
+    return UINT32_MAX;
+}
+
+bool isa_hart_yield()
+{
+    return false;
+}
+
+void isa_hart_account(uint32_t executed)
+{
+    (void)executed;
+}
+#endif
@@ -1,4 +1,8 @@
 #include <isa.h>
+#include <isa-hart.h>
+#ifdef CONFIG_HAS_CLINT
+#include <device/intc.h>
+#endif
 
 #define MSTATUS_MIE_BIT 3
 #define MSTATUS_MPIE_BIT 7
@@ -12,7 +16,9 @@
  */
 #define MSTATUS_GVA_BIT 38
 
+#define IRQ_SOFT ((word_t)0x8000000000000003ull)
 #define IRQ_TIMER ((word_t)0x8000000000000007ull)
+#define IRQ_EXTERNAL ((word_t)0x800000000000000bull)
 
 static inline uint64_t get_bit(uint64_t csr, unsigned bit)
 {
@@ -63,6 +69,7 @@ word_t isa_raise_intr_tval(word_t NO, vaddr_t epc, word_t tval)
     cpu.csr.mepc = epc;
     cpu.csr.mcause = NO;
     cpu.csr.mtval = tval;
+    riscv64_lr_valid = false;
 
 #ifdef CONFIG_DIFFTEST
     extern void (*ref_difftest_raise_intr)(uint64_t NO);
@@ -91,8 +98,50 @@ word_t isa_raise_intr(word_t NO, vaddr_t epc)
     return isa_raise_intr_tval(NO, epc, 0);
 }
 
+word_t riscv64_pending_mip()
+{
+#ifdef CONFIG_HAS_CLINT
+    const int hart = (int)riscv64_mhartid;
+    word_t mip = 0;
+
+    mip |= clint_msip(hart) ? RISCV64_MIP_MSIP : 0;
+    mip |= clint_mtip(hart) ? RISCV64_MIP_MTIP : 0;
+    IFDEF(CONFIG_HAS_PLIC, mip |= plic_meip(hart) ? RISCV64_MIP_MEIP : 0);
+    return mip;
+#else
+    return 0;
+#endif
+}
+
 word_t isa_query_intr()
 {
+#ifdef CONFIG_HAS_CLINT
+    /*
+     * cpu.INTR is only a hint that some line may have risen.  Drop it once
+     * nothing enabled is pending; keep it while mstatus.MIE masks a pending
+     * line so the interrupt is taken as soon as the guest re-enables.
+     */
+    const word_t pending = riscv64_pending_mip() & riscv64_mie;
+
+    if (pending == 0)
+    {
+        cpu.INTR = false;
+        return INTR_EMPTY;
+    }
+
+    if (!(cpu.csr.mstatus & ((word_t)1u << MSTATUS_MIE_BIT)))
+    {
+        return INTR_EMPTY;
+    }
+
+    /* Standard M-mode priority: external, then software, then timer. */
+    if (pending & RISCV64_MIP_MEIP)
+    {
+        return IRQ_EXTERNAL;
+    }
+
+    return (pending & RISCV64_MIP_MSIP) ? IRQ_SOFT : IRQ_TIMER;
+#else
     if (cpu.INTR && (cpu.csr.mstatus & ((word_t)1u << MSTATUS_MIE_BIT)))
     {
         cpu.INTR = false;
@@ -100,4 +149,5 @@ word_t isa_query_intr()
     }
 
     return INTR_EMPTY;
+#endif
 }
@@ -1,4 +1,5 @@
 #include <isa.h>
+#include <cpu/cpu.h>
 #include <memory/vaddr.h>
 #include <memory/paddr.h>
 
@@ -250,3 +251,25 @@ paddr_t isa_mmu_translate(vaddr_t vaddr, int len, int type)
 
     return (paddr_t)MEM_RET_FAIL;
 }
+
+void isa_mmu_fault(vaddr_t vaddr, int type)
+{
+    if (!cpu_exec_can_abort())
+    {
+        return;
+    }
+
+    /*
+     * Every translated access is issued with cpu.pc still at the instruction
+     * that made it: the interpreter commits dnpc afterwards and the JIT stores
+     * the guest PC before calling a memory helper.  Nothing of the instruction
+     * has been committed yet, so the handler can map the page and mret back to
+     * retry it.
+     */
+    const word_t cause = type == MEM_TYPE_IFETCH  ? RISCV64_CAUSE_INST_PAGE_FAULT
+                         : type == MEM_TYPE_READ ? RISCV64_CAUSE_LOAD_PAGE_FAULT
+                                                 : RISCV64_CAUSE_STORE_PAGE_FAULT;
+
+    cpu.pc = isa_raise_intr_tval(cause, cpu.pc, vaddr);
+    cpu_exec_abort_instr();
+}
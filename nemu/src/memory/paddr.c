@@ -1,6 +1,8 @@
 #include <memory/host.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
 #include <device/mmio.h>
+#include <device/vga.h>
 #include <isa.h>
 #if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
 #include <isa-jit.h>
@@ -28,6 +30,72 @@ paddr_t host_to_guest(uint8_t *haddr)
     return haddr - pmem + CONFIG_MBASE;
 }
 
+static bool guest_chunk(vaddr_t addr, size_t wanted, int type, uint8_t **host, size_t *len, paddr_t *paddr_out)
+{
+    if (wanted == 0)
+    {
+        return false;
+    }
+
+    paddr_t paddr = 0;
+    const int mmu = isa_mmu_check(addr, 1, type);
+
+    if (mmu == MMU_DIRECT)
+    {
+        paddr = (paddr_t)addr;
+    }
+    else if (mmu == MMU_TRANSLATE)
+    {
+        const paddr_t ret = isa_mmu_translate(addr, 1, type);
+
+        if ((ret & (paddr_t)PAGE_MASK) != MEM_RET_OK)
+        {
+            return false;
+        }
+
+        paddr = (ret & ~(paddr_t)PAGE_MASK) | (paddr_t)(addr & PAGE_MASK);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (!in_pmem(paddr))
+    {
+        return false;
+    }
+
+    size_t chunk = PAGE_SIZE - (size_t)(addr & PAGE_MASK);
+    const paddr_t pmem_end = (paddr_t)CONFIG_MBASE + (paddr_t)CONFIG_MSIZE;
+
+    if ((paddr_t)(paddr + chunk) > pmem_end)
+    {
+        chunk = (size_t)(pmem_end - paddr);
+    }
+
+    if (chunk > wanted)
+    {
+        chunk = wanted;
+    }
+
+    *host = guest_to_host(paddr);
+    *len = chunk;
+    *paddr_out = paddr;
+    return chunk > 0;
+}
+
+bool guest_read_chunk(vaddr_t addr, size_t wanted, uint8_t **host, size_t *len)
+{
+    paddr_t paddr;
+
+    return guest_chunk(addr, wanted, MEM_TYPE_READ, host, len, &paddr);
+}
+
+bool guest_write_chunk(vaddr_t addr, size_t wanted, uint8_t **host, size_t *len, paddr_t *paddr)
+{
+    return guest_chunk(addr, wanted, MEM_TYPE_WRITE, host, len, paddr);
+}
+
 static word_t pmem_read(paddr_t addr, int len)
 {
     return host_read(pmem_host_addr(addr), len);
@@ -107,6 +175,11 @@ word_t paddr_read(paddr_t addr, int len)
         return data;
     }
 
+    if (in_vmem_range(addr, len))
+    {
+        return vga_vmem_read(addr, len);
+    }
+
     MUXDEF(
         CONFIG_DEVICE,
         return mmio_read(addr, len),
@@ -150,6 +223,17 @@ void paddr_write(paddr_t addr, int len, word_t data)
 #endif
         return;
     }
+
+    /*
+     * The framebuffer is the one device range that sees PMEM-like store
+     * traffic.  It skips the MMIO map lookup and callback; vga.c marks the
+     * written scanlines dirty from the address alone.
+     */
+    if (in_vmem_range(addr, len))
+    {
+        vga_vmem_write(addr, len, data);
+        return;
+    }
     MUXDEF(CONFIG_DEVICE, mmio_write(addr, len, data),
            panic("address = " FMT_PADDR " is out of bound of pmem [" FMT_PADDR ", " FMT_PADDR ") at pc = " FMT_WORD,
                  addr, CONFIG_MBASE, CONFIG_MBASE + CONFIG_MSIZE, cpu.pc));
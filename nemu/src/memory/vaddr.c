@@ -31,6 +31,17 @@ static inline bool rv32_mmu_direct_mode(int type)
 }
 #endif
 
+// Only the RISC-V MMUs raise page faults; elsewhere a failed translation panics.
+static inline void mmu_fault(vaddr_t addr, int type)
+{
+#if defined(CONFIG_ISA_riscv32) || defined(CONFIG_ISA_riscv64)
+    isa_mmu_fault(addr, type);
+#else
+    (void)addr;
+    (void)type;
+#endif
+}
+
 /*
  * isa_mmu_translate() packs a page-aligned physical page address with a small
  * status code in the low PAGE_MASK bits.  Splitting those two parts here keeps
@@ -98,6 +109,7 @@ word_t vaddr_ifetch(vaddr_t addr, int len)
         }
 
         // MEM_RET_FAIL or unknown code
+        mmu_fault(addr, MEM_TYPE_IFETCH);
         panic("vaddr_ifetch: mmu translate failed");
     }
 
@@ -139,6 +151,7 @@ word_t vaddr_read(vaddr_t addr, int len)
             panic("vaddr_read: cross-page access not supported yet");
         }
 
+        mmu_fault(addr, MEM_TYPE_READ);
         panic("vaddr_read: mmu translate failed");
     }
 
@@ -190,6 +203,7 @@ void vaddr_write(vaddr_t addr, int len, word_t data)
             assert(0 && "vaddr_write: cross-page access not supported yet");
         }
 
+        mmu_fault(addr, MEM_TYPE_WRITE);
         assert(0 && "vaddr_write: mmu translate failed");
     }
 